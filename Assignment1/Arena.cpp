@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+#include "MappedFile.h"
+#include "Arena.h"
+
+static_assert(sizeof(ArenaSurface) == 96, "ArenaSurface is stored as is");
+static_assert(sizeof(ArenaObstacle) == 32, "ArenaObstacle is stored as is");
+static_assert(sizeof(ArenaLight) == 64, "ArenaLight is stored as is");
+static_assert(sizeof(ArenaSpawn) == 16, "ArenaSpawn is stored as is");
+
+ArenaView ArenaDescription::View() const
+{
+	ArenaView view;
+	view.surfaces = surfaces.data();
+	view.obstacles = obstacles.data();
+	view.lights = lights.data();
+	view.spawns = spawns.data();
+	view.numSurfaces = (int)surfaces.size();
+	view.numObstacles = (int)obstacles.size();
+	view.numLights = (int)lights.size();
+	view.numSpawns = (int)spawns.size();
+	return view;
+}
+
+static void Set3(float *v, float x, float y, float z)
+{
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+}
+
+static void Set4(float *v, float x, float y, float z, float w)
+{
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+	v[3] = w;
+}
+
+static ArenaSurface MakeSurface(ArenaSurfaceKind kind, float ox, float oy, float oz, float ux, float uy, float uz,
+	float vx, float vy, float vz, float diffuse)
+{
+	ArenaSurface surface;
+	memset(&surface, 0, sizeof(surface));
+	Set3(surface.origin, ox, oy, oz);
+	Set3(surface.dir1, ux, uy, uz);
+	Set3(surface.dir2, vx, vy, vz);
+	surface.length = 200.0f;
+	surface.width = 200.0f;
+	surface.meshSize = 10;
+	surface.kind = kind;
+	Set3(surface.ambient, 0.6f, 0.0f, 0.0f);
+	Set3(surface.diffuse, diffuse, diffuse, diffuse);
+	Set3(surface.specular, 0.04f, 0.04f, 0.04f);
+	surface.shininess = 0.05f;
+	return surface;
+}
+
+void MakeDefaultArena(ArenaDescription &arena)
+{
+	arena = ArenaDescription();
+
+	// Both meshes sit 2.5 below the robots' origin
+	arena.surfaces.push_back(MakeSurface(ArenaTerrain, -100.0f, -2.5f, 100.0f, 1, 0, 0, 0, 0, -1, 0.2f));
+	arena.surfaces.push_back(MakeSurface(ArenaWall, -100.0f, -2.5f, -60.0f, 1, 0, 0, 0, 1, 0, 0.3f));
+
+	const float obstacles[3][4] = { { -12.0f, -1.0f, 7.0f, 2.0f }, { 25.0f, 1.5f, -17.0f, 4.0f }, { 25.0f, 7.5f, -17.0f, 2.0f } };
+	for (int i = 0; i < 3; i++)
+	{
+		ArenaObstacle obstacle;
+		Set3(obstacle.position, obstacles[i][0], obstacles[i][1], obstacles[i][2]);
+		Set3(obstacle.scale, obstacles[i][3], obstacles[i][3], obstacles[i][3]);
+		obstacle.angle = 0.0f;
+		obstacle.health = 1.0f;
+		arena.obstacles.push_back(obstacle);
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		ArenaLight light;
+		Set4(light.position, i == 0 ? -4.0f : 4.0f, 8.0f, 8.0f, 1.0f);
+		Set4(light.ambient, 0.2f, 0.2f, 0.2f, 1.0f);
+		Set4(light.diffuse, 1.0f, 1.0f, 1.0f, 1.0f);
+		Set4(light.specular, 1.0f, 1.0f, 1.0f, 1.0f);
+		arena.lights.push_back(light);
+	}
+
+	ArenaSpawn spawn = { 0.0f, 0.0f, 0.0f, 0 };
+	arena.spawns.push_back(spawn);
+}
+
+static uint32_t AlignUp(uint64_t offset)
+{
+	return (uint32_t)((offset + ArenaFileAlignment - 1) & ~(uint64_t)(ArenaFileAlignment - 1));
+}
+
+static bool WriteSection(FILE *file, uint64_t &position, uint32_t offset, const void *records, size_t recordSize, int count)
+{
+	static const unsigned char padding[ArenaFileAlignment] = { 0 };
+	size_t gap = (size_t)(offset - position);
+	if (fwrite(padding, 1, gap, file) != gap)
+		return false;
+	if (count > 0 && fwrite(records, recordSize, (size_t)count, file) != (size_t)count)
+		return false;
+	position = offset + (uint64_t)recordSize * count;
+	return true;
+}
+
+bool WriteArenaFile(const char *path, const ArenaView &arena)
+{
+	ArenaFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "ARNA", 4);
+	header.version = ArenaFileVersion;
+	header.numSurfaces = (uint32_t)arena.numSurfaces;
+	header.numObstacles = (uint32_t)arena.numObstacles;
+	header.numLights = (uint32_t)arena.numLights;
+	header.numSpawns = (uint32_t)arena.numSpawns;
+
+	// Offsets are 32-bit, which still leaves room for tens of millions of obstacles
+	uint64_t end = AlignUp(sizeof(ArenaFileHeader));
+	header.surfaceOffset = (uint32_t)end;
+	end = AlignUp(end + (uint64_t)arena.numSurfaces * sizeof(ArenaSurface));
+	header.obstacleOffset = (uint32_t)end;
+	end = AlignUp(end + (uint64_t)arena.numObstacles * sizeof(ArenaObstacle));
+	header.lightOffset = (uint32_t)end;
+	end = AlignUp(end + (uint64_t)arena.numLights * sizeof(ArenaLight));
+	header.spawnOffset = (uint32_t)end;
+	end += (uint64_t)arena.numSpawns * sizeof(ArenaSpawn);
+	if (end > 0xffffffffULL)
+		return false;
+	header.fileSize = end;
+
+	// Write to a temporary name first so a crash never leaves a truncated arena behind
+	char tempPath[512];
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+	FILE *file = fopen(tempPath, "wb");
+	if (!file)
+		return false;
+
+	uint64_t position = sizeof(header);
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && WriteSection(file, position, header.surfaceOffset, arena.surfaces, sizeof(ArenaSurface), arena.numSurfaces);
+	ok = ok && WriteSection(file, position, header.obstacleOffset, arena.obstacles, sizeof(ArenaObstacle), arena.numObstacles);
+	ok = ok && WriteSection(file, position, header.lightOffset, arena.lights, sizeof(ArenaLight), arena.numLights);
+	ok = ok && WriteSection(file, position, header.spawnOffset, arena.spawns, sizeof(ArenaSpawn), arena.numSpawns);
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+	{
+		remove(tempPath);
+		return false;
+	}
+
+	remove(path);
+	return rename(tempPath, path) == 0;
+}
+
+static bool SectionInBounds(uint32_t offset, uint32_t count, size_t recordSize, uint64_t fileSize)
+{
+	return offset % ArenaFileAlignment == 0 && offset >= sizeof(ArenaFileHeader)
+		&& (uint64_t)offset + (uint64_t)count * recordSize <= fileSize;
+}
+
+bool ValidateArenaFile(const MappedFile &file, ArenaView &view)
+{
+	memset(&view, 0, sizeof(view));
+	if (!file.IsOpen() || file.GetSize() < sizeof(ArenaFileHeader))
+		return false;
+
+	const ArenaFileHeader *header = (const ArenaFileHeader*)file.GetData();
+	if (memcmp(header->magic, "ARNA", 4) != 0 || header->version != ArenaFileVersion
+		|| header->fileSize > file.GetSize())
+		return false;
+
+	if (!SectionInBounds(header->surfaceOffset, header->numSurfaces, sizeof(ArenaSurface), header->fileSize)
+		|| !SectionInBounds(header->obstacleOffset, header->numObstacles, sizeof(ArenaObstacle), header->fileSize)
+		|| !SectionInBounds(header->lightOffset, header->numLights, sizeof(ArenaLight), header->fileSize)
+		|| !SectionInBounds(header->spawnOffset, header->numSpawns, sizeof(ArenaSpawn), header->fileSize))
+		return false;
+
+	// Surfaces become meshes, the only records whose values could make loading fail
+	const ArenaSurface *surfaces = (const ArenaSurface*)(file.GetData() + header->surfaceOffset);
+	if (header->numSurfaces > (uint32_t)ArenaMaxSurfaces)
+		return false;
+	for (uint32_t i = 0; i < header->numSurfaces; i++)
+	{
+		if (surfaces[i].meshSize < 1 || surfaces[i].meshSize > ArenaMaxMeshSize
+			|| (surfaces[i].kind != ArenaTerrain && surfaces[i].kind != ArenaWall))
+			return false;
+	}
+
+	view.surfaces = surfaces;
+	view.obstacles = (const ArenaObstacle*)(file.GetData() + header->obstacleOffset);
+	view.lights = (const ArenaLight*)(file.GetData() + header->lightOffset);
+	view.spawns = (const ArenaSpawn*)(file.GetData() + header->spawnOffset);
+	view.numSurfaces = (int)header->numSurfaces;
+	view.numObstacles = (int)header->numObstacles;
+	view.numLights = (int)header->numLights;
+	view.numSpawns = (int)header->numSpawns;
+	return true;
+}
@@ -0,0 +1,126 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Arena.h
+//	Versioned binary arena layout: terrain and wall surfaces, obstacle instances,
+//	lights and spawn points. Every section is an array of fixed-size records stored
+//	exactly as it sits in memory, so a mapped file is used in place through an
+//	ArenaView with no per-object parsing; only the header and section bounds are
+//	checked. The same view can point at an ArenaDescription being built in memory.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class MappedFile;
+
+// Bump whenever a record or the header changes
+const uint32_t ArenaFileVersion = 1;
+
+// The scene has a mesh pool of this size and GL at least this many lights
+const int ArenaMaxSurfaces = 16;
+const int ArenaMaxLights = 8;
+const int ArenaMaxMeshSize = 256;
+
+enum ArenaSurfaceKind
+{
+	ArenaTerrain,		// the ground robots drive on
+	ArenaWall
+};
+
+// A flat quad mesh from origin, length along dir1 and width along dir2
+struct ArenaSurface
+{
+	float origin[3];
+	float dir1[3];
+	float dir2[3];
+	float length, width;
+	int32_t meshSize;
+	int32_t kind;		// ArenaSurfaceKind
+	float ambient[3];
+	float diffuse[3];
+	float specular[3];
+	float shininess;
+	uint32_t reserved;
+};
+
+// Obstacle cube of width 2 scaled per axis, rotated angle degrees around y
+struct ArenaObstacle
+{
+	float position[3];
+	float scale[3];
+	float angle;
+	float health;
+};
+
+// Positions are in eye space, as the lights have always been set up
+struct ArenaLight
+{
+	float position[4];
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+};
+
+struct ArenaSpawn
+{
+	float x, z;
+	float angle;		// heading in degrees
+	uint32_t team;
+};
+
+struct ArenaFileHeader
+{
+	char magic[4];			// "ARNA"
+	uint32_t version;
+	uint64_t fileSize;
+	uint32_t numSurfaces;
+	uint32_t numObstacles;
+	uint32_t numLights;
+	uint32_t numSpawns;
+	uint32_t surfaceOffset;	// byte offsets of the record arrays, each aligned to ArenaFileAlignment
+	uint32_t obstacleOffset;
+	uint32_t lightOffset;
+	uint32_t spawnOffset;
+	uint32_t reserved[6];
+};
+
+const uint32_t ArenaFileAlignment = 64;
+
+// Read-only look at an arena's records, wherever they live
+struct ArenaView
+{
+	const ArenaSurface *surfaces;
+	const ArenaObstacle *obstacles;
+	const ArenaLight *lights;
+	const ArenaSpawn *spawns;
+	int numSurfaces;
+	int numObstacles;
+	int numLights;
+	int numSpawns;
+};
+
+// An arena being built or edited
+struct ArenaDescription
+{
+	std::vector<ArenaSurface> surfaces;
+	std::vector<ArenaObstacle> obstacles;
+	std::vector<ArenaLight> lights;
+	std::vector<ArenaSpawn> spawns;
+
+	ArenaView View() const;
+};
+
+// The arena the game has always started in: red ground and back wall, three
+// obstacles and two lights
+void MakeDefaultArena(ArenaDescription &arena);
+
+bool WriteArenaFile(const char *path, const ArenaView &arena);
+
+// Checks magic, version and the section bounds of a mapped arena file and points
+// view into it. Returns false, leaving view empty, if the file is stale or corrupt.
+bool ValidateArenaFile(const MappedFile &file, ArenaView &view);
+
+#endif	//ARENA_H
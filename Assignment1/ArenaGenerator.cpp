@@ -0,0 +1,220 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "ArenaGenerator.h"
+
+// Cells of the spawn clearance grid, obstacles stay out of the cells around a spawn point
+static const float ClearanceCell = 10.0f;
+
+static const float WallHeight = 40.0f;
+static const int WallMeshSize = 10;
+
+static uint32_t NextRandom(uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Uniform in [0, 1), exact in float so every machine draws the same values
+static float NextUnit(uint32_t &state)
+{
+	return (float)(NextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+static float NextRange(uint32_t &state, float low, float high)
+{
+	return low + (high - low) * NextUnit(state);
+}
+
+static void Set3(float *v, float x, float y, float z)
+{
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+}
+
+static void Set4(float *v, float x, float y, float z, float w)
+{
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+	v[3] = w;
+}
+
+static ArenaSurface MakeSurface(ArenaSurfaceKind kind, const float origin[3], const float dir1[3], const float dir2[3],
+	float length, float width, int meshSize)
+{
+	ArenaSurface surface;
+	memset(&surface, 0, sizeof(surface));
+	memcpy(surface.origin, origin, sizeof(surface.origin));
+	memcpy(surface.dir1, dir1, sizeof(surface.dir1));
+	memcpy(surface.dir2, dir2, sizeof(surface.dir2));
+	surface.length = length;
+	surface.width = width;
+	surface.meshSize = meshSize;
+	surface.kind = kind;
+	float diffuse = kind == ArenaWall ? 0.3f : 0.2f;
+	Set3(surface.ambient, 0.6f, 0.0f, 0.0f);
+	Set3(surface.diffuse, diffuse, diffuse, diffuse);
+	Set3(surface.specular, 0.04f, 0.04f, 0.04f);
+	surface.shininess = 0.05f;
+	return surface;
+}
+
+float GeneratedArenaHalfSize(const ArenaGeneratorSettings &settings)
+{
+	float halfSize = 5.0f * sqrtf((float)settings.numObstacles);
+	return halfSize > 100.0f ? halfSize : 100.0f;
+}
+
+bool GenerateArena(const ArenaGeneratorSettings &settings, ArenaDescription &arena)
+{
+	if (settings.numObstacles < 0 || settings.numRobots < 0 || settings.numWalls < 0
+		|| settings.numWalls > ArenaMaxSurfaces - 1
+		|| settings.terrainMeshSize < 1 || settings.terrainMeshSize > ArenaMaxMeshSize)
+		return false;
+
+	arena = ArenaDescription();
+	// xorshift never leaves 0, so that seed is moved
+	uint32_t random = settings.seed * 2654435761u + 1;
+	if (random == 0)
+		random = 1;
+	float halfSize = GeneratedArenaHalfSize(settings);
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+
+	// Terrain over the whole arena, 2.5 below the robots like the built-in ground
+	const float groundOrigin[3] = { -halfSize, -2.5f, halfSize };
+	const float east[3] = { 1.0f, 0.0f, 0.0f };
+	const float north[3] = { 0.0f, 0.0f, -1.0f };
+	arena.surfaces.push_back(MakeSurface(ArenaTerrain, groundOrigin, east, north, 2.0f * halfSize, 2.0f * halfSize,
+		settings.terrainMeshSize));
+
+	// Boundary walls first, all facing inwards, then partitions at random
+	const float sides[4][2][3] = {
+		{ { -halfSize, -2.5f, -halfSize }, { 1.0f, 0.0f, 0.0f } },
+		{ { halfSize, -2.5f, halfSize }, { -1.0f, 0.0f, 0.0f } },
+		{ { -halfSize, -2.5f, halfSize }, { 0.0f, 0.0f, -1.0f } },
+		{ { halfSize, -2.5f, -halfSize }, { 0.0f, 0.0f, 1.0f } }
+	};
+	for (int i = 0; i < settings.numWalls; i++)
+	{
+		if (i < 4)
+		{
+			arena.surfaces.push_back(MakeSurface(ArenaWall, sides[i][0], sides[i][1], up, 2.0f * halfSize, WallHeight,
+				WallMeshSize));
+			continue;
+		}
+
+		float length = NextRange(random, 0.2f, 0.6f) * 2.0f * halfSize;
+		float along = NextRange(random, -halfSize, halfSize - length);
+		float across = NextRange(random, -0.8f * halfSize, 0.8f * halfSize);
+		bool alongX = (NextRandom(random) & 1) != 0;
+		float origin[3] = { alongX ? along : across, -2.5f, alongX ? across : along };
+		float dir[3] = { alongX ? 1.0f : 0.0f, 0.0f, alongX ? 0.0f : 1.0f };
+		arena.surfaces.push_back(MakeSurface(ArenaWall, origin, dir, up, length, WallHeight, WallMeshSize));
+	}
+
+	// Spawn points, with the grid cells around each kept clear of obstacles
+	int gridSize = (int)(2.0f * halfSize / ClearanceCell) + 1;
+	std::vector<unsigned char> blocked((size_t)gridSize * gridSize, 0);
+	arena.spawns.resize(settings.numRobots);
+	for (int i = 0; i < settings.numRobots; i++)
+	{
+		ArenaSpawn &spawn = arena.spawns[i];
+		spawn.x = NextRange(random, -0.9f * halfSize, 0.9f * halfSize);
+		spawn.z = NextRange(random, -0.9f * halfSize, 0.9f * halfSize);
+		spawn.angle = (float)(NextRandom(random) % 360);
+		spawn.team = (uint32_t)(i % 2);
+
+		int cx = (int)((spawn.x + halfSize) / ClearanceCell), cz = (int)((spawn.z + halfSize) / ClearanceCell);
+		for (int z = cz - 1; z <= cz + 1; z++)
+		{
+			for (int x = cx - 1; x <= cx + 1; x++)
+			{
+				if (x >= 0 && z >= 0 && x < gridSize && z < gridSize)
+					blocked[(size_t)z * gridSize + x] = 1;
+			}
+		}
+	}
+
+	// Cubes resting on the ground. A few tries to miss the spawn points, then placed anyway
+	// so the count is always what was asked for.
+	arena.obstacles.resize(settings.numObstacles);
+	for (int i = 0; i < settings.numObstacles; i++)
+	{
+		ArenaObstacle &obstacle = arena.obstacles[i];
+		float x = 0.0f, z = 0.0f;
+		for (int attempt = 0; attempt < 8; attempt++)
+		{
+			x = NextRange(random, -0.95f * halfSize, 0.95f * halfSize);
+			z = NextRange(random, -0.95f * halfSize, 0.95f * halfSize);
+			int cx = (int)((x + halfSize) / ClearanceCell), cz = (int)((z + halfSize) / ClearanceCell);
+			if (!blocked[(size_t)cz * gridSize + cx])
+				break;
+		}
+
+		float scale = NextRange(random, 1.0f, 4.0f);
+		Set3(obstacle.position, x, -2.5f + scale, z);
+		Set3(obstacle.scale, scale, scale, scale);
+		obstacle.angle = NextRange(random, 0.0f, 90.0f);
+		obstacle.health = 1.0f;
+	}
+
+	// The built-in arena's two lights
+	for (int i = 0; i < 2; i++)
+	{
+		ArenaLight light;
+		Set4(light.position, i == 0 ? -4.0f : 4.0f, 8.0f, 8.0f, 1.0f);
+		Set4(light.ambient, 0.2f, 0.2f, 0.2f, 1.0f);
+		Set4(light.diffuse, 1.0f, 1.0f, 1.0f, 1.0f);
+		Set4(light.specular, 1.0f, 1.0f, 1.0f, 1.0f);
+		arena.lights.push_back(light);
+	}
+	return true;
+}
+
+static uint64_t HashBytes(uint64_t hash, const void *data, size_t size)
+{
+	// FNV-1a
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t ArenaContentHash(const ArenaView &arena)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	hash = HashBytes(hash, arena.surfaces, (size_t)arena.numSurfaces * sizeof(ArenaSurface));
+	hash = HashBytes(hash, arena.obstacles, (size_t)arena.numObstacles * sizeof(ArenaObstacle));
+	hash = HashBytes(hash, arena.lights, (size_t)arena.numLights * sizeof(ArenaLight));
+	hash = HashBytes(hash, arena.spawns, (size_t)arena.numSpawns * sizeof(ArenaSpawn));
+	return hash;
+}
+
+bool WriteArenaManifest(const char *path, const ArenaGeneratorSettings &settings, const ArenaView &arena)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "generator %u\n", ArenaGeneratorVersion);
+	fprintf(file, "arguments --generate %u %d %d %d %d\n", settings.seed, settings.numObstacles, settings.numRobots,
+		settings.numWalls, settings.terrainMeshSize);
+	fprintf(file, "seed %u\n", settings.seed);
+	fprintf(file, "obstacles %d\n", arena.numObstacles);
+	fprintf(file, "robots %d\n", arena.numSpawns);
+	fprintf(file, "walls %d\n", settings.numWalls);
+	fprintf(file, "terrain %d\n", settings.terrainMeshSize);
+	fprintf(file, "surfaces %d\n", arena.numSurfaces);
+	fprintf(file, "lights %d\n", arena.numLights);
+	fprintf(file, "halfsize %.3f\n", GeneratedArenaHalfSize(settings));
+	fprintf(file, "hash %016llx\n", (unsigned long long)ArenaContentHash(arena));
+	return fclose(file) == 0;
+}
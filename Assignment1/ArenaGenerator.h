@@ -0,0 +1,42 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	ArenaGenerator.h
+//	Seeded procedural arenas for probing scaling limits: any number of obstacles,
+//	robot spawn points, walls and any terrain resolution, from a handful up to
+//	millions of instances. The same settings give the same arena, bit for bit, on
+//	any machine; the manifest written next to a generated arena records the settings
+//	and a hash of the records so benchmark and soak runs can be repeated and checked.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARENAGENERATOR_H
+#define ARENAGENERATOR_H
+
+#include <stdint.h>
+#include "Arena.h"
+
+// Bump whenever the same settings would generate a different arena
+const uint32_t ArenaGeneratorVersion = 1;
+
+struct ArenaGeneratorSettings
+{
+	uint32_t seed;
+	int numObstacles;
+	int numRobots;		// spawn points, the first is the player's
+	int numWalls;		// the first four close the arena, the rest split it
+	int terrainMeshSize;
+};
+
+// Half size of the square arena: about one obstacle per 100 square units, never
+// smaller than the built-in arena
+float GeneratedArenaHalfSize(const ArenaGeneratorSettings &settings);
+
+// Returns false if a count is negative, or walls or terrain exceed the Arena.h limits
+bool GenerateArena(const ArenaGeneratorSettings &settings, ArenaDescription &arena);
+
+// FNV-1a over every record, equal hashes mean identical arenas
+uint64_t ArenaContentHash(const ArenaView &arena);
+
+// Text file of "key value" lines: the generator version, the settings (and the
+// --generate arguments that reproduce them), the record counts and the content hash
+bool WriteArenaManifest(const char *path, const ArenaGeneratorSettings &settings, const ArenaView &arena);
+
+#endif	//ARENAGENERATOR_H
@@ -0,0 +1,327 @@
+#include <math.h>
+#include <string.h>
+#include "BattleSim.h"
+#include "FastTrig.h"
+
+static const float Pi = 3.14159265358979323846f;
+static const float DegToRad = Pi / 180.0f;
+
+// Default design values the tuning constants below are relative to
+static const float ReferenceMass = 275.0f;
+static const float ReferenceSpinner = 5.0f;
+
+
+RobotDesign DefaultRobotDesign()
+{
+	RobotDesign design;
+	design.bodyWidth = 10.0f;
+	design.bodyLength = 4.0f;
+	design.bodyDepth = 5.0f;
+	design.wheelLength = 0.25f * design.bodyWidth;
+	design.spinnerLength = 0.5f * design.bodyWidth;
+	return design;
+}
+
+BattleConfig DefaultBattleConfig(uint32_t seed)
+{
+	BattleConfig config;
+	config.seed = seed;
+	config.designs[0] = DefaultRobotDesign();
+	config.designs[1] = DefaultRobotDesign();
+	config.arenaHalfSize = 90.0f;
+	config.maxTicks = 6000;		// a minute at the 10 ms tick
+	return config;
+}
+
+// Body box, two wheels and the spinner disk, the spinner counts with its area
+float RobotMass(const RobotDesign &design)
+{
+	return design.bodyWidth * design.bodyLength * design.bodyDepth
+		+ 4.0f * design.wheelLength * design.wheelLength
+		+ 2.0f * design.spinnerLength * design.spinnerLength;
+}
+
+// Bigger wheels cover more ground per revolution, weight slows them down
+float RobotTopSpeed(const RobotDesign &design)
+{
+	return 0.4f * design.wheelLength * sqrtf(ReferenceMass / RobotMass(design));
+}
+
+// The wheels push further out on a wider robot, so it turns slower
+float RobotTurnRate(const RobotDesign &design)
+{
+	return 22.5f / (0.5f * (design.bodyWidth + design.bodyDepth));
+}
+
+float RobotSpinnerReach(const RobotDesign &design)
+{
+	return 0.5f * design.bodyDepth + 1.1f * design.spinnerLength;
+}
+
+// Circle that separates two bodies, wheels included
+static float RobotRadius(const RobotDesign &design)
+{
+	float width = design.bodyWidth + 2.0f * design.wheelLength;
+	return 0.5f * (width > design.bodyDepth ? width : design.bodyDepth);
+}
+
+static float Clamp(float value, float low, float high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+static uint32_t NextRandom(uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+void ResetBattle(BattleState &state, const BattleConfig &config)
+{
+	memset(&state, 0, sizeof(state));
+	state.config = config;
+	state.tick = 0;
+
+	// Spread similar seeds apart, xorshift must not start at 0
+	state.randomState = config.seed * 2654435761u ^ 0x9E3779B9u;
+	if (state.randomState == 0)
+		state.randomState = 1;
+
+	float start = 0.6f * config.arenaHalfSize;
+	for (int i = 0; i < 2; i++)
+	{
+		BattleRobot &robot = state.robots[i];
+		// Seeded offsets along the end wall and off straight ahead
+		float offset = (float)(NextRandom(state.randomState) & 1023) / 1023.0f - 0.5f;
+		float skew = (float)(NextRandom(state.randomState) & 1023) / 1023.0f - 0.5f;
+		robot.x = offset * config.arenaHalfSize;
+		robot.z = i == 0 ? -start : start;
+		robot.angle = (i == 0 ? 0.0f : 180.0f) + 90.0f * skew;
+		robot.health = 1.0f;
+	}
+}
+
+// Spinner of attacker against the body of target, both ways round in StepBattle()
+static void StrikeCheck(BattleState &state, int attacker, int target)
+{
+	BattleRobot &a = state.robots[attacker];
+	BattleRobot &t = state.robots[target];
+	const RobotDesign &aDesign = state.config.designs[attacker];
+	const RobotDesign &tDesign = state.config.designs[target];
+
+	if (!a.spinnerOn || a.spinUp > 0)
+		return;
+
+	float reach = RobotSpinnerReach(aDesign);
+	float aSin, aCos;
+	FastSinCosDegrees(a.angle, aSin, aCos);
+	float ax = a.x + reach * aSin;
+	float az = a.z + reach * aCos;
+
+	// Spinner centre in the target's frame, nearest point of its footprint
+	float s, c;
+	FastSinCosDegrees(t.angle, s, c);
+	float dx = ax - t.x, dz = az - t.z;
+	float localX = dx * c - dz * s;
+	float localZ = dx * s + dz * c;
+	float halfWidth = 0.5f * tDesign.bodyWidth + tDesign.wheelLength;
+	float halfDepth = 0.5f * tDesign.bodyDepth;
+	float nearX = Clamp(localX, -halfWidth, halfWidth);
+	float nearZ = Clamp(localZ, -halfDepth, halfDepth);
+	float gapX = localX - nearX, gapZ = localZ - nearZ;
+	if (gapX * gapX + gapZ * gapZ > aDesign.spinnerLength * aDesign.spinnerLength)
+		return;
+
+	// Spinner energy grows with the disk's size, heavier targets take it better. The
+	// attacker soaks part of the blow too, the more so the more of it is spinner.
+	float size = aDesign.spinnerLength / ReferenceSpinner;
+	float targetMass = RobotMass(tDesign);
+	float attackerMass = RobotMass(aDesign);
+	float glance = 0.25f + (float)(NextRandom(state.randomState) & 1023) / 1023.0f;		// 0.25 to 1.25
+	float damage = 0.06f * glance * size * size * sqrtf(ReferenceMass / targetMass);
+	float spinnerShare = 2.0f * aDesign.spinnerLength * aDesign.spinnerLength / attackerMass;
+	t.health -= damage;
+	a.health -= 0.5f * damage * spinnerShare;
+	a.damageDealt += damage;
+	a.hits++;
+	a.spinUp = (int)(20.0f * size * size);
+
+	// Both robots are thrown apart along the line between them
+	float nx = t.x - a.x, nz = t.z - a.z;
+	float length = sqrtf(nx * nx + nz * nz);
+	if (length < 1e-4f)
+	{
+		nx = aSin;
+		nz = aCos;
+		length = 1.0f;
+	}
+	nx /= length;
+	nz /= length;
+	float impulse = 0.8f * size * size * ReferenceMass;
+	t.vx += nx * impulse / targetMass;
+	t.vz += nz * impulse / targetMass;
+	a.vx -= nx * 0.5f * impulse / attackerMass;
+	a.vz -= nz * 0.5f * impulse / attackerMass;
+}
+
+bool StepBattle(BattleState &state, const BattleAction actions[2])
+{
+	const BattleConfig &config = state.config;
+	if (state.tick >= config.maxTicks || state.robots[0].health <= 0.0f || state.robots[1].health <= 0.0f)
+		return false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		BattleRobot &robot = state.robots[i];
+		const RobotDesign &design = config.designs[i];
+
+		robot.angle += RobotTurnRate(design) * Clamp(actions[i].turn, -1.0f, 1.0f);
+		if (robot.angle >= 360.0f)
+			robot.angle -= 360.0f;
+		else if (robot.angle < 0.0f)
+			robot.angle += 360.0f;
+
+		float speed = RobotTopSpeed(design) * Clamp(actions[i].move, -1.0f, 1.0f);
+		float s, c;
+		FastSinCosDegrees(robot.angle, s, c);
+		robot.x += speed * s + robot.vx;
+		robot.z += speed * c + robot.vz;
+
+		// Ground friction on whatever a hit added
+		robot.vx *= 0.9f;
+		robot.vz *= 0.9f;
+
+		if (actions[i].spinnerOn != robot.spinnerOn)
+		{
+			robot.spinnerOn = actions[i].spinnerOn;
+			if (robot.spinnerOn)
+				robot.spinUp = (int)(20.0f * design.spinnerLength / ReferenceSpinner);
+		}
+		if (robot.spinUp > 0)
+			robot.spinUp--;
+	}
+
+	StrikeCheck(state, 0, 1);
+	StrikeCheck(state, 1, 0);
+
+	// Bodies do not pass through each other, the lighter one gives way more
+	BattleRobot &r0 = state.robots[0];
+	BattleRobot &r1 = state.robots[1];
+	float minDistance = RobotRadius(config.designs[0]) + RobotRadius(config.designs[1]);
+	float dx = r1.x - r0.x, dz = r1.z - r0.z;
+	float distanceSq = dx * dx + dz * dz;
+	if (distanceSq < minDistance * minDistance && distanceSq > 1e-8f)
+	{
+		float distance = sqrtf(distanceSq);
+		float push = (minDistance - distance) / distance;
+		float m0 = RobotMass(config.designs[0]), m1 = RobotMass(config.designs[1]);
+		float share0 = m1 / (m0 + m1);
+		r0.x -= dx * push * share0;
+		r0.z -= dz * push * share0;
+		r1.x += dx * push * (1.0f - share0);
+		r1.z += dz * push * (1.0f - share0);
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		BattleRobot &robot = state.robots[i];
+		float limit = config.arenaHalfSize - RobotRadius(config.designs[i]);
+		if (robot.x < -limit || robot.x > limit)
+		{
+			robot.x = Clamp(robot.x, -limit, limit);
+			robot.vx = 0.0f;
+		}
+		if (robot.z < -limit || robot.z > limit)
+		{
+			robot.z = Clamp(robot.z, -limit, limit);
+			robot.vz = 0.0f;
+		}
+	}
+
+	state.tick++;
+	return state.tick < config.maxTicks && r0.health > 0.0f && r1.health > 0.0f;
+}
+
+BattleResult GetBattleResult(const BattleState &state)
+{
+	BattleResult result;
+	result.ticks = state.tick;
+	for (int i = 0; i < 2; i++)
+	{
+		result.health[i] = state.robots[i].health > 0.0f ? state.robots[i].health : 0.0f;
+		result.hits[i] = state.robots[i].hits;
+		result.damageDealt[i] = state.robots[i].damageDealt;
+	}
+
+	// A knockout wins outright, otherwise the healthier robot on points
+	if (result.health[0] > result.health[1])
+		result.winner = 0;
+	else if (result.health[1] > result.health[0])
+		result.winner = 1;
+	else
+		result.winner = -1;
+	return result;
+}
+
+BattleAction ScriptedBattleAction(BattleState &state, int robot)
+{
+	BattleRobot &self = state.robots[robot];
+	const BattleRobot &other = state.robots[1 - robot];
+	const RobotDesign &design = state.config.designs[robot];
+
+	float dx = other.x - self.x, dz = other.z - self.z;
+	float distance = sqrtf(dx * dx + dz * dz);
+
+	// Now and then come in from the side rather than head on
+	uint32_t random = NextRandom(state.randomState);
+	if (self.flankTicks > 0)
+		self.flankTicks--;
+	else if ((random & 127) == 0)
+	{
+		self.flankTicks = 30 + (int)((random >> 7) & 63);
+		self.flankAngle = (random >> 13) & 1 ? 40.0f : -40.0f;
+	}
+
+	float bearing = atan2f(dx, dz) / DegToRad;
+	if (self.flankTicks > 0 && distance > 2.0f * RobotSpinnerReach(design))
+		bearing += self.flankAngle;
+	float error = bearing - self.angle;
+	while (error > 180.0f)
+		error -= 360.0f;
+	while (error < -180.0f)
+		error += 360.0f;
+
+	BattleAction action;
+	action.turn = Clamp(error / RobotTurnRate(design), -1.0f, 1.0f);
+	action.spinnerOn = distance < 40.0f;
+
+	// Drive when roughly facing the target, back off while the spinner winds up again
+	if (self.spinUp > 0 && distance < 1.5f * RobotSpinnerReach(design))
+		action.move = -0.5f;
+	else if (fabsf(error) < 30.0f)
+		action.move = 1.0f;
+	else
+		action.move = 0.3f;
+
+	// A little hesitation keeps equal designs from mirroring each other forever
+	if (((random >> 20) & 7) == 0)
+		action.move *= 0.25f;
+	return action;
+}
+
+BattleResult RunBattle(const BattleConfig &config)
+{
+	BattleState state;
+	ResetBattle(state, config);
+
+	BattleAction actions[2];
+	do
+	{
+		actions[0] = ScriptedBattleAction(state, 0);
+		actions[1] = ScriptedBattleAction(state, 1);
+	} while (StepBattle(state, actions));
+
+	return GetBattleResult(state);
+}
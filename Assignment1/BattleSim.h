@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	BattleSim.h
+//	Headless one-on-one fight between two robot designs, no GL and no timing, for
+//	evaluating designs over many matches. A match is a plain value stepped at a
+//	fixed 10 ms tick (the rate animationHandler runs at), and everything random
+//	comes from the match seed, so the same seed and designs always give the same
+//	result on the same build, whichever thread runs it.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BATTLESIM_H
+#define BATTLESIM_H
+
+#include <stdint.h>
+
+// The shape parameters main.cpp draws robots with; they decide speed, reach, weight and damage
+struct RobotDesign
+{
+	float bodyWidth;
+	float bodyLength;		// height of the body box
+	float bodyDepth;
+	float wheelLength;		// wheel radius
+	float spinnerLength;	// spinner disk radius
+};
+
+// The robot main.cpp draws: robotBodyWidth 10 and the proportions derived from it
+RobotDesign DefaultRobotDesign();
+
+// Continuous driver input for one tick. turn and move run from -1 to 1, full
+// deflection is what holding an arrow key does (3 degrees, 1 unit per tick).
+struct BattleAction
+{
+	float turn;				// +1 counter-clockwise
+	float move;				// +1 forwards
+	bool spinnerOn;
+};
+
+struct BattleRobot
+{
+	float x, z;
+	float angle;			// degrees, 0 faces +z
+	float vx, vz;			// knockback velocity, decays with ground friction
+	float health;			// starts at 1, out at 0
+	bool spinnerOn;
+	int spinUp;				// ticks until the spinner is back to full speed after a hit
+	int hits;
+	float damageDealt;
+
+	// ScriptedBattleAction() state
+	int flankTicks;			// ticks left approaching from the side
+	float flankAngle;
+};
+
+struct BattleConfig
+{
+	uint32_t seed;
+	RobotDesign designs[2];
+	float arenaHalfSize;	// square arena, walls at +-arenaHalfSize
+	int maxTicks;			// a draw on health after this many ticks
+};
+
+BattleConfig DefaultBattleConfig(uint32_t seed);
+
+struct BattleState
+{
+	BattleConfig config;
+	BattleRobot robots[2];
+	int tick;
+	uint32_t randomState;
+};
+
+struct BattleResult
+{
+	int winner;				// 0 or 1, -1 for a draw
+	int ticks;
+	float health[2];
+	int hits[2];
+	float damageDealt[2];
+};
+
+// Robots start at opposite ends of the arena facing each other, spinners off
+void ResetBattle(BattleState &state, const BattleConfig &config);
+
+// Advances one tick. Returns true while the match is still going.
+bool StepBattle(BattleState &state, const BattleAction actions[2]);
+
+// Outcome so far, final once StepBattle() has returned false
+BattleResult GetBattleResult(const BattleState &state);
+
+// Built-in driver: turns towards the opponent, closes in with the spinner running
+// and circles now and then, with a seeded bit of hesitation so matches differ
+BattleAction ScriptedBattleAction(BattleState &state, int robot);
+
+// Plays a whole match with ScriptedBattleAction() driving both robots
+BattleResult RunBattle(const BattleConfig &config);
+
+// Derived per design values, shared by the simulation and anything that wants to report them
+float RobotMass(const RobotDesign &design);
+float RobotTopSpeed(const RobotDesign &design);			// units per tick at full move
+float RobotTurnRate(const RobotDesign &design);			// degrees per tick at full turn
+float RobotSpinnerReach(const RobotDesign &design);		// spinner centre ahead of the body centre
+
+#endif	//BATTLESIM_H
@@ -0,0 +1,189 @@
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include "BattleVecEnv.h"
+#include "FastTrig.h"
+#include "JobSystem.h"
+
+// Environments handed to a worker at a time
+static const uint32_t EnvGrain = 32;
+
+
+BattleVecEnv::BattleVecEnv(int numEnvs, int agentsPerEnv, const BattleConfig &config, JobSystem *jobs)
+{
+	this->numEnvs = numEnvs > 0 ? numEnvs : 1;
+	this->agentsPerEnv = agentsPerEnv == 2 ? 2 : 1;
+	this->config = config;
+	this->jobs = jobs;
+
+	int numAgents = this->numEnvs * this->agentsPerEnv;
+	states.resize(this->numEnvs);
+	episodes.resize(this->numEnvs);
+	observations.resize(numAgents * BattleObservationSize);
+	terminalObservations.resize(numAgents * BattleObservationSize);
+	rewards.resize(numAgents);
+	dones.resize(this->numEnvs);
+	winners.resize(this->numEnvs);
+
+	Reset();
+}
+
+void BattleVecEnv::Reset()
+{
+	for (int env = 0; env < numEnvs; env++)
+	{
+		episodes[env] = 0;
+		ResetEnv(env);
+		Observe(env, &observations[env * agentsPerEnv * BattleObservationSize]);
+		for (int agent = 0; agent < agentsPerEnv; agent++)
+			rewards[env * agentsPerEnv + agent] = 0.0f;
+		dones[env] = 0;
+		winners[env] = -1;
+	}
+}
+
+void BattleVecEnv::ResetEnv(int env)
+{
+	// Seed from the environment and its episode number, the same whichever thread resets it
+	uint32_t hash = config.seed ^ (uint32_t)env * 0x9E3779B9u ^ episodes[env] * 0x85EBCA6Bu;
+	hash ^= hash >> 16;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 13;
+
+	BattleConfig episodeConfig = config;
+	episodeConfig.seed = hash;
+	ResetBattle(states[env], episodeConfig);
+}
+
+void BattleVecEnv::Step(const float *actions)
+{
+	if (jobs)
+	{
+		auto body = [this, actions](uint32_t begin, uint32_t end) { StepRange(actions, begin, end); };
+		jobs->ParallelFor((uint32_t)numEnvs, EnvGrain, body);
+	}
+	else
+		StepRange(actions, 0, (uint32_t)numEnvs);
+}
+
+void BattleVecEnv::StepRange(const float *actions, uint32_t begin, uint32_t end)
+{
+	for (uint32_t env = begin; env < end; env++)
+	{
+		BattleState &state = states[env];
+		const float *envActions = actions + env * agentsPerEnv * BattleActionSize;
+
+		BattleAction stepActions[2];
+		for (int agent = 0; agent < 2; agent++)
+		{
+			if (agent < agentsPerEnv)
+			{
+				const float *action = envActions + agent * BattleActionSize;
+				stepActions[agent].turn = action[0];
+				stepActions[agent].move = action[1];
+				stepActions[agent].spinnerOn = action[2] > 0.0f;
+			}
+			else
+				stepActions[agent] = ScriptedBattleAction(state, agent);
+		}
+
+		float health[2] = { state.robots[0].health, state.robots[1].health };
+		bool running = StepBattle(state, stepActions);
+
+		float *envRewards = &rewards[env * agentsPerEnv];
+		int winner = running ? -1 : GetBattleResult(state).winner;
+		for (int agent = 0; agent < agentsPerEnv; agent++)
+		{
+			float taken = health[agent] - state.robots[agent].health;
+			float dealt = health[1 - agent] - state.robots[1 - agent].health;
+			float reward = dealt - taken;
+			if (winner >= 0)
+				reward += winner == agent ? 1.0f : -1.0f;
+			envRewards[agent] = reward;
+		}
+
+		float *envObservations = &observations[env * agentsPerEnv * BattleObservationSize];
+		dones[env] = running ? 0 : 1;
+		winners[env] = (int8_t)winner;
+		if (!running)
+		{
+			Observe((int)env, &terminalObservations[env * agentsPerEnv * BattleObservationSize]);
+			episodes[env]++;
+			ResetEnv((int)env);
+		}
+		Observe((int)env, envObservations);
+	}
+}
+
+void BattleVecEnv::Observe(int env, float *out) const
+{
+	const BattleState &state = states[env];
+	float arena = state.config.arenaHalfSize;
+
+	for (int agent = 0; agent < agentsPerEnv; agent++)
+	{
+		const BattleRobot &self = state.robots[agent];
+		const BattleRobot &other = state.robots[1 - agent];
+		float s, c;
+		FastSinCosDegrees(self.angle, s, c);
+
+		// Ahead is the robot's forwards (sin, cos), right is (-cos, sin) seen from above
+		float dx = other.x - self.x, dz = other.z - self.z;
+		float relativeSin, relativeCos;
+		FastSinCosDegrees(other.angle - self.angle, relativeSin, relativeCos);
+
+		float *o = out + agent * BattleObservationSize;
+		o[0] = self.health;
+		o[1] = other.health;
+		o[2] = self.x / arena;
+		o[3] = self.z / arena;
+		o[4] = s;
+		o[5] = c;
+		o[6] = (-dx * c + dz * s) / arena;
+		o[7] = (dx * s + dz * c) / arena;
+		o[8] = sqrtf(dx * dx + dz * dz) / (2.8284271f * arena);
+		o[9] = relativeSin;
+		o[10] = relativeCos;
+		o[11] = -self.vx * c + self.vz * s;
+		o[12] = self.vx * s + self.vz * c;
+		o[13] = self.spinnerOn ? 1.0f : 0.0f;
+		o[14] = self.spinnerOn && self.spinUp == 0 ? 1.0f : 0.0f;
+		o[15] = other.spinnerOn ? 1.0f : 0.0f;
+	}
+}
+
+uint64_t BattleVecEnv::GetEpisodeCount() const
+{
+	uint64_t count = 0;
+	for (int env = 0; env < numEnvs; env++)
+		count += episodes[env];
+	return count;
+}
+
+
+double BenchmarkBattleEnv(int numEnvs, int numSteps, JobSystem *jobs)
+{
+	BattleVecEnv env(numEnvs, 1, DefaultBattleConfig(1), jobs);
+
+	// Random actions, drawn up front so the timing is the environment alone
+	std::vector<float> actions(numEnvs * BattleActionSize * 16);
+	uint32_t random = 12345;
+	for (size_t i = 0; i < actions.size(); i++)
+	{
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		actions[i] = (float)(random & 0xFFFF) / 32767.5f - 1.0f;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	for (int step = 0; step < numSteps; step++)
+		env.Step(&actions[(step & 15) * numEnvs * BattleActionSize]);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	double stepsPerSecond = (double)numEnvs * numSteps / seconds;
+	printf("Battle environments: %d envs x %d steps in %.3f s, %.0f env steps/s, %llu episodes\n",
+		numEnvs, numSteps, seconds, stepsPerSecond, (unsigned long long)env.GetEpisodeCount());
+	return stepsPerSecond;
+}
@@ -0,0 +1,92 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	BattleVecEnv.h
+//	Many BattleSim matches stepped in lockstep for training controllers. Actions
+//	come in and observations, rewards and done flags go out through flat arrays
+//	allocated once in the constructor, environment-major, so a training loop can
+//	hand them straight to its tensors. Step() spreads the environments over
+//	JobSystem workers and allocates nothing.
+//
+//	An environment whose match ends is reset on the spot with the next seed of its
+//	own sequence (its done flag tells the caller), and the observation of the final
+//	state is kept in the terminal observation array.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BATTLEVECENV_H
+#define BATTLEVECENV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "BattleSim.h"
+
+class JobSystem;
+
+// Floats per agent. Everything is relative to the agent's own robot and roughly in -1..1:
+//	0 own health				1 opponent health
+//	2, 3 own x, z / arena		4, 5 sin, cos of own heading
+//	6, 7 opponent right, ahead of the agent / arena
+//	8 distance / arena diagonal	9, 10 sin, cos of the opponent's heading relative to ours
+//	11, 12 knockback right, ahead	13 own spinner on
+//	14 own spinner at speed		15 opponent spinner on
+const int BattleObservationSize = 16;
+
+// Floats per agent: turn (-1..1, + counter-clockwise), move (-1..1), spinner (on when > 0)
+const int BattleActionSize = 3;
+
+class BattleVecEnv
+{
+public:
+	// agentsPerEnv 1 drives robot 0 and leaves robot 1 to ScriptedBattleAction(),
+	// 2 drives both (self-play). Episode seeds follow from config.seed.
+	BattleVecEnv(int numEnvs, int agentsPerEnv, const BattleConfig &config, JobSystem *jobs = NULL);
+
+	BattleVecEnv(const BattleVecEnv &) = delete;
+	BattleVecEnv &operator=(const BattleVecEnv &) = delete;
+
+	// Starts every environment over from the first seed of its sequence
+	void Reset();
+
+	// actions holds numEnvs * agentsPerEnv * BattleActionSize floats
+	void Step(const float *actions);
+
+	int GetEnvCount() const { return numEnvs; }
+	int GetAgentsPerEnv() const { return agentsPerEnv; }
+
+	// numEnvs * agentsPerEnv * BattleObservationSize floats, after the last Reset() or Step()
+	const float *GetObservations() const { return observations.data(); }
+	// Final observation of the episodes that ended in the last Step(), same layout
+	const float *GetTerminalObservations() const { return terminalObservations.data(); }
+	// numEnvs * agentsPerEnv: damage dealt minus damage taken, plus 1 for a win and -1 for a loss
+	const float *GetRewards() const { return rewards.data(); }
+	// numEnvs: 1 where the episode ended in the last Step()
+	const uint8_t *GetDones() const { return dones.data(); }
+	// numEnvs: winner of the episode that just ended, 0 or 1, -1 for a draw
+	const int8_t *GetWinners() const { return winners.data(); }
+
+	uint64_t GetEpisodeCount() const;
+	const BattleState &GetState(int env) const { return states[env]; }
+
+private:
+	void ResetEnv(int env);
+	void StepRange(const float *actions, uint32_t begin, uint32_t end);
+	void Observe(int env, float *out) const;
+
+	int numEnvs;
+	int agentsPerEnv;
+	BattleConfig config;
+	JobSystem *jobs;
+
+	std::vector<BattleState> states;
+	std::vector<uint32_t> episodes;		// per environment, picks the next seed
+	std::vector<float> observations;
+	std::vector<float> terminalObservations;
+	std::vector<float> rewards;
+	std::vector<uint8_t> dones;
+	std::vector<int8_t> winners;
+};
+
+// Steps numEnvs single-agent environments numSteps times with random actions.
+// Prints and returns environment steps per second.
+double BenchmarkBattleEnv(int numEnvs, int numSteps, JobSystem *jobs = NULL);
+
+#endif	//BATTLEVECENV_H
@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	BitStream.h
+//	Packing values into the fewest bits for network packets. BitWriter fills a
+//	caller-owned buffer and reports overflow instead of writing past it; BitReader
+//	returns zeros and sets a flag once it runs off the end, so a truncated or
+//	hostile packet can be detected after reading it through.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class BitWriter
+{
+public:
+	BitWriter(uint8_t *buffer, size_t size) : buffer(buffer), size(size), bitPosition(0), overflow(false)
+	{
+		for (size_t i = 0; i < size; i++)
+			buffer[i] = 0;
+	}
+
+	// Lowest bits bits of value, bits <= 32
+	void Write(uint32_t value, int bits)
+	{
+		for (int i = 0; i < bits; i++)
+		{
+			size_t byte = bitPosition >> 3;
+			if (byte >= size)
+			{
+				overflow = true;
+				return;
+			}
+			if (value & (1u << i))
+				buffer[byte] |= (uint8_t)(1u << (bitPosition & 7));
+			bitPosition++;
+		}
+	}
+
+	void WriteBool(bool value) { Write(value ? 1 : 0, 1); }
+
+	// Two's complement, value must fit in bits
+	void WriteSigned(int32_t value, int bits) { Write((uint32_t)value & Mask(bits), bits); }
+
+	size_t GetBytes() const { return (bitPosition + 7) >> 3; }
+	size_t GetBits() const { return bitPosition; }
+	bool Overflowed() const { return overflow; }
+
+	static uint32_t Mask(int bits) { return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1; }
+
+private:
+	uint8_t *buffer;
+	size_t size;
+	size_t bitPosition;
+	bool overflow;
+};
+
+class BitReader
+{
+public:
+	BitReader(const uint8_t *buffer, size_t size) : buffer(buffer), size(size), bitPosition(0), overflow(false)
+	{}
+
+	uint32_t Read(int bits)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < bits; i++)
+		{
+			size_t byte = bitPosition >> 3;
+			if (byte >= size)
+			{
+				overflow = true;
+				return 0;
+			}
+			if (buffer[byte] & (1u << (bitPosition & 7)))
+				value |= 1u << i;
+			bitPosition++;
+		}
+		return value;
+	}
+
+	bool ReadBool() { return Read(1) != 0; }
+
+	int32_t ReadSigned(int bits)
+	{
+		uint32_t value = Read(bits);
+		if (bits < 32 && (value & (1u << (bits - 1))))
+			value |= ~BitWriter::Mask(bits);
+		return (int32_t)value;
+	}
+
+	bool Overflowed() const { return overflow; }
+
+private:
+	const uint8_t *buffer;
+	size_t size;
+	size_t bitPosition;
+	bool overflow;
+};
+
+#endif	//BITSTREAM_H
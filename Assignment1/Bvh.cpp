@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include "JobSystem.h"
+#include "Bvh.h"
+
+static const int BvhBins = 16;
+static const int BvhMaxLeafSize = 4;
+// Nodes at depth BvhMaxDepth - 1 stay leaves however many primitives they hold, so
+// the fixed traversal stacks below (one pending node per level) never overflow
+static const int BvhMaxDepth = 64;
+
+
+// Slab test. Returns the entry distance, or a value > tMax when the box is missed.
+static inline float IntersectBox(const Aabb & box, const float origin[3], const float invDir[3], float tMax)
+{
+	float t0 = 0.0f, t1 = tMax;
+	for (int k = 0; k < 3; k++)
+	{
+		float tNear = (box.min[k] - origin[k]) * invDir[k];
+		float tFar = (box.max[k] - origin[k]) * invDir[k];
+		if (tNear > tFar)
+		{
+			float swap = tNear; tNear = tFar; tFar = swap;
+		}
+		t0 = tNear > t0 ? tNear : t0;
+		t1 = tFar < t1 ? tFar : t1;
+		if (t0 > t1)
+			return 1e30f;
+	}
+	return t0;
+}
+
+// Box against one frustum: 0 outside, 1 intersecting, 2 entirely inside
+static inline int ClassifyBox(const Aabb & box, const BvhFrustum & frustum)
+{
+	int result = 2;
+	for (int i = 0; i < 6; i++)
+	{
+		const float *plane = frustum.planes[i];
+
+		// Corner furthest along the plane normal, and the one furthest against it
+		float far = plane[3], near = plane[3];
+		for (int k = 0; k < 3; k++)
+		{
+			float lo = plane[k] * box.min[k], hi = plane[k] * box.max[k];
+			far += lo > hi ? lo : hi;
+			near += lo > hi ? hi : lo;
+		}
+		if (far < 0.0f)
+			return 0;
+		if (near < 0.0f)
+			result = 1;
+	}
+	return result;
+}
+
+Bvh::Bvh()
+{}
+
+void Bvh::Build(const Aabb *boxes, int count)
+{
+	nodes.clear();
+	primBoxes.assign(boxes, boxes + count);
+	primIndices.resize(count);
+
+	std::vector<float> centroids(count * 3);
+	for (int i = 0; i < count; i++)
+	{
+		primIndices[i] = i;
+		for (int k = 0; k < 3; k++)
+			centroids[i * 3 + k] = 0.5f * (boxes[i].min[k] + boxes[i].max[k]);
+	}
+
+	if (count == 0)
+		return;
+
+	nodes.reserve(2 * count);
+	Node root;
+	root.leftOrFirst = 0;
+	root.count = count;
+	root.box.SetEmpty();
+	for (int i = 0; i < count; i++)
+		root.box.Grow(boxes[i]);
+	nodes.push_back(root);
+
+	// Explicit work list of (node, depth) instead of recursion, children are always
+	// appended after their parent
+	std::vector<std::pair<int, int>> work;
+	work.push_back(std::make_pair(0, 0));
+	while (!work.empty())
+	{
+		int nodeIndex = work.back().first;
+		int depth = work.back().second;
+		work.pop_back();
+		if (depth >= BvhMaxDepth - 1)
+			continue;
+		Subdivide(nodeIndex, centroids);
+		if (nodes[nodeIndex].count == 0)
+		{
+			work.push_back(std::make_pair(nodes[nodeIndex].leftOrFirst, depth + 1));
+			work.push_back(std::make_pair(nodes[nodeIndex].leftOrFirst + 1, depth + 1));
+		}
+	}
+}
+
+void Bvh::Subdivide(int nodeIndex, std::vector<float> & centroids)
+{
+	Node node = nodes[nodeIndex];
+	int first = node.leftOrFirst;
+	int count = node.count;
+	if (count <= 1)
+		return;
+
+	// Centroid bounds decide the binning range
+	Aabb centroidBox;
+	centroidBox.SetEmpty();
+	for (int i = first; i < first + count; i++)
+		centroidBox.Grow(&centroids[primIndices[i] * 3]);
+
+	float bestCost = 1e30f;
+	int bestAxis = -1;
+	int bestSplit = 0;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lo = centroidBox.min[axis], hi = centroidBox.max[axis];
+		if (hi - lo < 1e-6f)
+			continue;
+
+		Aabb binBoxes[BvhBins];
+		int binCounts[BvhBins] = { 0 };
+		for (int b = 0; b < BvhBins; b++)
+			binBoxes[b].SetEmpty();
+
+		float scale = BvhBins / (hi - lo);
+		for (int i = first; i < first + count; i++)
+		{
+			int p = primIndices[i];
+			int b = (int)((centroids[p * 3 + axis] - lo) * scale);
+			b = b < BvhBins - 1 ? b : BvhBins - 1;
+			binCounts[b]++;
+			binBoxes[b].Grow(primBoxes[p]);
+		}
+
+		// Sweep from both ends to get the area and count on each side of every plane
+		float leftArea[BvhBins - 1], rightArea[BvhBins - 1];
+		int leftCount[BvhBins - 1], rightCount[BvhBins - 1];
+		Aabb leftBox, rightBox;
+		leftBox.SetEmpty();
+		rightBox.SetEmpty();
+		int leftSum = 0, rightSum = 0;
+		for (int b = 0; b < BvhBins - 1; b++)
+		{
+			leftSum += binCounts[b];
+			leftBox.Grow(binBoxes[b]);
+			leftCount[b] = leftSum;
+			leftArea[b] = leftBox.SurfaceArea();
+
+			rightSum += binCounts[BvhBins - 1 - b];
+			rightBox.Grow(binBoxes[BvhBins - 1 - b]);
+			rightCount[BvhBins - 2 - b] = rightSum;
+			rightArea[BvhBins - 2 - b] = rightBox.SurfaceArea();
+		}
+
+		for (int b = 0; b < BvhBins - 1; b++)
+		{
+			if (leftCount[b] == 0 || rightCount[b] == 0)
+				continue;
+			float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	float leafCost = count * node.box.SurfaceArea();
+	int mid;
+	if (bestAxis >= 0 && (bestCost < leafCost || count > BvhMaxLeafSize))
+	{
+		float lo = centroidBox.min[bestAxis];
+		float scale = BvhBins / (centroidBox.max[bestAxis] - lo);
+		int *begin = &primIndices[first];
+		int *split = std::partition(begin, begin + count, [&](int p)
+		{
+			int b = (int)((centroids[p * 3 + bestAxis] - lo) * scale);
+			return (b < BvhBins - 1 ? b : BvhBins - 1) <= bestSplit;
+		});
+		mid = first + (int)(split - begin);
+	}
+	else if (count > BvhMaxLeafSize)
+	{
+		// All centroids coincide, any even split will do
+		mid = first + count / 2;
+	}
+	else
+		return;
+
+	Node left, right;
+	left.leftOrFirst = first;
+	left.count = mid - first;
+	right.leftOrFirst = mid;
+	right.count = first + count - mid;
+	left.box.SetEmpty();
+	right.box.SetEmpty();
+	for (int i = first; i < mid; i++)
+		left.box.Grow(primBoxes[primIndices[i]]);
+	for (int i = mid; i < first + count; i++)
+		right.box.Grow(primBoxes[primIndices[i]]);
+
+	int childIndex = (int)nodes.size();
+	nodes.push_back(left);
+	nodes.push_back(right);
+	nodes[nodeIndex].leftOrFirst = childIndex;
+	nodes[nodeIndex].count = 0;
+}
+
+void Bvh::Refit(const Aabb *boxes)
+{
+	for (size_t i = 0; i < primBoxes.size(); i++)
+		primBoxes[i] = boxes[i];
+
+	// Children always come after their parent, so a reverse sweep is bottom-up
+	for (int n = (int)nodes.size() - 1; n >= 0; n--)
+	{
+		Node &node = nodes[n];
+		node.box.SetEmpty();
+		if (node.count > 0)
+		{
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+				node.box.Grow(primBoxes[primIndices[i]]);
+		}
+		else
+		{
+			node.box.Grow(nodes[node.leftOrFirst].box);
+			node.box.Grow(nodes[node.leftOrFirst + 1].box);
+		}
+	}
+}
+
+template <bool AnyHit>
+bool Bvh::Traverse(const BvhRay & ray, BvhHit & hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	float invDir[3];
+	for (int k = 0; k < 3; k++)
+		invDir[k] = ray.dir[k] != 0.0f ? 1.0f / ray.dir[k] : 1e30f;
+
+	hit.primitive = -1;
+	hit.t = ray.tMax;
+
+	int stack[BvhMaxDepth];
+	int stackSize = 0;
+	int current = 0;
+	if (IntersectBox(nodes[0].box, ray.origin, invDir, hit.t) > hit.t)
+		return false;
+
+	for (;;)
+	{
+		const Node &node = nodes[current];
+		if (node.count > 0)
+		{
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+			{
+				int p = primIndices[i];
+				float t = IntersectBox(primBoxes[p], ray.origin, invDir, hit.t);
+				if (t <= hit.t)
+				{
+					hit.t = t;
+					hit.primitive = p;
+					if (AnyHit)
+						return true;
+				}
+			}
+		}
+		else
+		{
+			// Visit the nearer child first so the far one is usually culled by hit.t
+			int a = node.leftOrFirst, b = node.leftOrFirst + 1;
+			float ta = IntersectBox(nodes[a].box, ray.origin, invDir, hit.t);
+			float tb = IntersectBox(nodes[b].box, ray.origin, invDir, hit.t);
+			if (ta > tb)
+			{
+				int si = a; a = b; b = si;
+				float st = ta; ta = tb; tb = st;
+			}
+			if (ta <= hit.t)
+			{
+				if (tb <= hit.t)
+					stack[stackSize++] = b;
+				current = a;
+				continue;
+			}
+		}
+
+		if (stackSize == 0)
+			break;
+		current = stack[--stackSize];
+	}
+
+	return hit.primitive >= 0;
+}
+
+bool Bvh::Raycast(const BvhRay & ray, BvhHit & hit) const
+{
+	return Traverse<false>(ray, hit);
+}
+
+bool Bvh::Occluded(const BvhRay & ray) const
+{
+	BvhHit hit;
+	return Traverse<true>(ray, hit);
+}
+
+void Bvh::OccludedBatch(const BvhRay *rays, int count, bool *occluded, JobSystem *jobs) const
+{
+	auto body = [this, rays, occluded](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			occluded[i] = Occluded(rays[i]);
+	};
+
+	if (jobs)
+		jobs->ParallelFor((uint32_t)count, 256, body);
+	else
+		body(0, (uint32_t)count);
+}
+
+void Bvh::CullFrustums(const BvhFrustum *frustums, int count, uint32_t *visibleMasks) const
+{
+	for (size_t p = 0; p < primBoxes.size(); p++)
+		visibleMasks[p] = 0;
+	if (nodes.empty() || count <= 0)
+		return;
+	if (count > BvhMaxFrustums)
+		count = BvhMaxFrustums;
+
+	// Each entry carries the views still undecided for the node and the ones that already contain it
+	struct Entry
+	{
+		int node;
+		uint32_t active;
+		uint32_t inside;
+	};
+	Entry stack[BvhMaxDepth];
+	int stackSize = 0;
+
+	Entry entry;
+	entry.node = 0;
+	entry.active = count == 32 ? 0xFFFFFFFFu : (1u << count) - 1;
+	entry.inside = 0;
+	stack[stackSize++] = entry;
+
+	while (stackSize > 0)
+	{
+		entry = stack[--stackSize];
+		const Node &node = nodes[entry.node];
+
+		for (int v = 0; v < count; v++)
+		{
+			uint32_t bit = 1u << v;
+			if (!(entry.active & bit))
+				continue;
+			int side = ClassifyBox(node.box, frustums[v]);
+			if (side != 1)
+			{
+				entry.active &= ~bit;
+				if (side == 2)
+					entry.inside |= bit;
+			}
+		}
+		if (!entry.active && !entry.inside)
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+			{
+				int p = primIndices[i];
+				uint32_t mask = entry.inside;
+				for (int v = 0; v < count; v++)
+				{
+					if ((entry.active & (1u << v)) && ClassifyBox(primBoxes[p], frustums[v]) != 0)
+						mask |= 1u << v;
+				}
+				visibleMasks[p] = mask;
+			}
+		}
+		else if (!entry.active)
+		{
+			// Inside every view that sees it, the whole subtree is accepted as is
+			int subtree[BvhMaxDepth];
+			int subtreeSize = 0;
+			subtree[subtreeSize++] = entry.node;
+			while (subtreeSize > 0)
+			{
+				const Node &inner = nodes[subtree[--subtreeSize]];
+				if (inner.count > 0)
+				{
+					for (int i = inner.leftOrFirst; i < inner.leftOrFirst + inner.count; i++)
+						visibleMasks[primIndices[i]] = entry.inside;
+				}
+				else
+				{
+					subtree[subtreeSize++] = inner.leftOrFirst;
+					subtree[subtreeSize++] = inner.leftOrFirst + 1;
+				}
+			}
+		}
+		else
+		{
+			Entry child = entry;
+			child.node = node.leftOrFirst;
+			stack[stackSize++] = child;
+			child.node = node.leftOrFirst + 1;
+			stack[stackSize++] = child;
+		}
+	}
+}
+
+static inline bool BoxesOverlap(const Aabb & a, const Aabb & b)
+{
+	return a.min[0] <= b.max[0] && a.max[0] >= b.min[0]
+		&& a.min[1] <= b.max[1] && a.max[1] >= b.min[1]
+		&& a.min[2] <= b.max[2] && a.max[2] >= b.min[2];
+}
+
+int Bvh::QueryOverlaps(const Aabb & box, int *results, int maxResults) const
+{
+	if (nodes.empty())
+		return 0;
+
+	int found = 0;
+	int stack[BvhMaxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0 && found < maxResults)
+	{
+		const Node &node = nodes[stack[--stackSize]];
+		if (!BoxesOverlap(node.box, box))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count && found < maxResults; i++)
+			{
+				if (BoxesOverlap(primBoxes[primIndices[i]], box))
+					results[found++] = primIndices[i];
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.leftOrFirst;
+			stack[stackSize++] = node.leftOrFirst + 1;
+		}
+	}
+	return found;
+}
+
+
+static float RandomRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+double BenchmarkBvh(int numBoxes, int numRays, JobSystem *jobs)
+{
+	// Arena-sized scene: boxes scattered over the 200 x 200 floor, up to 20 high
+	srand(1234);
+	std::vector<Aabb> boxes(numBoxes);
+	for (int i = 0; i < numBoxes; i++)
+	{
+		float c[3] = { RandomRange(-100, 100), RandomRange(0, 20), RandomRange(-100, 100) };
+		float h = RandomRange(0.25f, 2.0f);
+		for (int k = 0; k < 3; k++)
+		{
+			boxes[i].min[k] = c[k] - h;
+			boxes[i].max[k] = c[k] + h;
+		}
+	}
+
+	std::vector<BvhRay> rays(numRays);
+	for (int i = 0; i < numRays; i++)
+	{
+		BvhRay &ray = rays[i];
+		ray.origin[0] = RandomRange(-100, 100);
+		ray.origin[1] = RandomRange(0, 20);
+		ray.origin[2] = RandomRange(-100, 100);
+		ray.dir[0] = RandomRange(-1, 1);
+		ray.dir[1] = RandomRange(-0.2f, 0.2f);
+		ray.dir[2] = RandomRange(-1, 1);
+		ray.tMax = 100.0f;
+	}
+
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+	Bvh bvh;
+	bvh.Build(boxes.data(), numBoxes);
+	double buildSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	start = Clock::now();
+	int hits = 0;
+	for (int i = 0; i < numRays; i++)
+	{
+		BvhHit hit;
+		hits += bvh.Raycast(rays[i], hit) ? 1 : 0;
+	}
+	double closestSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	bool *occluded = new bool[numRays];
+	start = Clock::now();
+	bvh.OccludedBatch(rays.data(), numRays, occluded, jobs);
+	double batchSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	delete[] occluded;
+
+	start = Clock::now();
+	bvh.Refit(boxes.data());
+	double refitSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	double raysPerSecond = numRays / (closestSeconds > 0.0 ? closestSeconds : 1e-9);
+	printf("BVH benchmark: %d boxes, %d nodes, build %.2f ms, refit %.2f ms\n", numBoxes, bvh.GetNodeCount(),
+		buildSeconds * 1000.0, refitSeconds * 1000.0);
+	printf("  closest hit: %.2f Mrays/s (%d hits), batched line of sight: %.2f Mrays/s (%s)\n",
+		raysPerSecond / 1e6, hits, numRays / (batchSeconds > 0.0 ? batchSeconds : 1e-9) / 1e6,
+		jobs ? "parallel" : "single thread");
+	return raysPerSecond;
+}
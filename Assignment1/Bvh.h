@@ -0,0 +1,129 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Bvh.h
+//	Bounding volume hierarchy over axis-aligned boxes, for ray queries against the
+//	arena (mouse picking, line of sight). Built top-down with a binned surface area
+//	heuristic; Refit() updates the boxes of moving primitives in place without
+//	rebuilding the tree.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class JobSystem;
+
+struct Aabb
+{
+	float min[3];
+	float max[3];
+
+	void SetEmpty()
+	{
+		min[0] = min[1] = min[2] = 1e30f;
+		max[0] = max[1] = max[2] = -1e30f;
+	}
+
+	void Grow(const Aabb & rhs)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (rhs.min[k] < min[k]) min[k] = rhs.min[k];
+			if (rhs.max[k] > max[k]) max[k] = rhs.max[k];
+		}
+	}
+
+	void Grow(const float p[3])
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (p[k] < min[k]) min[k] = p[k];
+			if (p[k] > max[k]) max[k] = p[k];
+		}
+	}
+
+	float SurfaceArea() const
+	{
+		float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+		return dx < 0.0f ? 0.0f : 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+};
+
+struct BvhRay
+{
+	float origin[3];
+	float dir[3];		// need not be normalized, t is in units of dir
+	float tMax;
+};
+
+struct BvhHit
+{
+	int primitive;		// index into the boxes given to Build()
+	float t;
+};
+
+// Six planes (a, b, c, d), a point is inside when a*x + b*y + c*z + d >= 0 for all of them
+struct BvhFrustum
+{
+	float planes[6][4];
+};
+
+// Views culled together by CullFrustums(), one bit per view in the masks
+const int BvhMaxFrustums = 32;
+
+class Bvh
+{
+public:
+	Bvh();
+
+	// Primitives are referred to by their index in boxes
+	void Build(const Aabb *boxes, int count);
+
+	// Same primitives in the same order, new boxes. Tree quality degrades if
+	// primitives move far from where they were built, rebuild then.
+	void Refit(const Aabb *boxes);
+
+	// Closest hit along the ray, false if nothing is hit before tMax
+	bool Raycast(const BvhRay & ray, BvhHit & hit) const;
+
+	// Any hit before tMax, cheaper than Raycast()
+	bool Occluded(const BvhRay & ray) const;
+
+	// Line-of-sight for many rays at once, spread over jobs when given
+	void OccludedBatch(const BvhRay *rays, int count, bool *occluded, JobSystem *jobs = NULL) const;
+
+	// Visibility of every primitive in up to BvhMaxFrustums views with one walk of the
+	// tree: bit v of visibleMasks[p] is set when primitive p may be seen by frustums[v].
+	// Subtrees entirely inside a frustum are accepted without testing their children.
+	void CullFrustums(const BvhFrustum *frustums, int count, uint32_t *visibleMasks) const;
+
+	// Primitives whose boxes overlap box, at most maxResults of them. Returns the number found.
+	int QueryOverlaps(const Aabb & box, int *results, int maxResults) const;
+
+	int GetPrimitiveCount() const { return (int)primBoxes.size(); }
+	int GetNodeCount() const { return (int)nodes.size(); }
+
+private:
+	struct Node
+	{
+		Aabb box;
+		int leftOrFirst;	// first child index for inner nodes, first primIndices slot for leaves
+		int count;			// primitive count for leaves, 0 for inner nodes
+	};
+
+	void Subdivide(int nodeIndex, std::vector<float> & centroids);
+	template <bool AnyHit>
+	bool Traverse(const BvhRay & ray, BvhHit & hit) const;
+
+	std::vector<Node> nodes;
+	std::vector<int> primIndices;
+	std::vector<Aabb> primBoxes;
+};
+
+// Builds a BVH over numBoxes random boxes and times numRays random rays against it.
+// Prints and returns closest-hit rays per second.
+double BenchmarkBvh(int numBoxes, int numRays, JobSystem *jobs = NULL);
+
+#endif	//BVH_H
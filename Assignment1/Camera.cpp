@@ -0,0 +1,148 @@
+#include <math.h>
+#include "Camera.h"
+
+#define PI 3.14159265358979323846
+
+
+Camera::Camera()
+{
+	mode = CameraFixed;
+	eye[0] = 0.0f; eye[1] = 20.0f; eye[2] = 40.0f;
+	target[0] = target[1] = target[2] = 0.0f;
+	fovy = 60.0f;
+	zNear = 0.2f;
+	zFar = 100.0f;
+	followDistance = 25.0f;
+	followHeight = 12.0f;
+	SetViewport(0.0f, 0.0f, 1.0f, 1.0f);
+	Update(1, 1);
+}
+
+void Camera::SetViewport(float x, float y, float width, float height)
+{
+	viewport[0] = x;
+	viewport[1] = y;
+	viewport[2] = width;
+	viewport[3] = height;
+}
+
+void Camera::SetLookAt(float eyeX, float eyeY, float eyeZ, float targetX, float targetY, float targetZ)
+{
+	eye[0] = eyeX; eye[1] = eyeY; eye[2] = eyeZ;
+	target[0] = targetX; target[1] = targetY; target[2] = targetZ;
+}
+
+void Camera::SetPerspective(float fovy, float zNear, float zFar)
+{
+	this->fovy = fovy;
+	this->zNear = zNear;
+	this->zFar = zFar;
+}
+
+void Camera::Follow(float x, float z, float angle)
+{
+	// Robots face +z when angle is 0, glRotatef(angle, 0, 1, 0) turns that to (sin, 0, cos)
+	float rad = (float)((PI / 180) * angle);
+	float forwardX = sinf(rad), forwardZ = cosf(rad);
+	SetLookAt(x - followDistance * forwardX, followHeight, z - followDistance * forwardZ,
+		x + 10.0f * forwardX, 0.0f, z + 10.0f * forwardZ);
+}
+
+void Camera::Update(int windowWidth, int windowHeight)
+{
+	pixelViewport[0] = (int)(viewport[0] * windowWidth + 0.5f);
+	pixelViewport[1] = (int)(viewport[1] * windowHeight + 0.5f);
+	pixelViewport[2] = (int)((viewport[0] + viewport[2]) * windowWidth + 0.5f) - pixelViewport[0];
+	pixelViewport[3] = (int)((viewport[1] + viewport[3]) * windowHeight + 0.5f) - pixelViewport[1];
+	float aspect = pixelViewport[3] > 0 ? (float)pixelViewport[2] / pixelViewport[3] : 1.0f;
+
+	// gluPerspective
+	float f = 1.0f / tanf((float)((PI / 360) * fovy));
+	for (int i = 0; i < 16; i++)
+		projection.m[i] = 0.0f;
+	projection.m[0] = f / aspect;
+	projection.m[5] = f;
+	projection.m[10] = (zFar + zNear) / (zNear - zFar);
+	projection.m[11] = -1.0f;
+	projection.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+
+	// gluLookAt. Straight down needs another up vector than y.
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	if (mode == CameraOverhead)
+	{
+		up[1] = 0.0f;
+		up[2] = -1.0f;
+	}
+
+	float forward[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+	float length = sqrtf(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+	if (length > 0.0f)
+	{
+		forward[0] /= length; forward[1] /= length; forward[2] /= length;
+	}
+
+	float side[3] = {
+		forward[1] * up[2] - forward[2] * up[1],
+		forward[2] * up[0] - forward[0] * up[2],
+		forward[0] * up[1] - forward[1] * up[0]
+	};
+	length = sqrtf(side[0] * side[0] + side[1] * side[1] + side[2] * side[2]);
+	if (length > 0.0f)
+	{
+		side[0] /= length; side[1] /= length; side[2] /= length;
+	}
+
+	float trueUp[3] = {
+		side[1] * forward[2] - side[2] * forward[1],
+		side[2] * forward[0] - side[0] * forward[2],
+		side[0] * forward[1] - side[1] * forward[0]
+	};
+
+	for (int k = 0; k < 3; k++)
+	{
+		modelview.m[k * 4 + 0] = side[k];
+		modelview.m[k * 4 + 1] = trueUp[k];
+		modelview.m[k * 4 + 2] = -forward[k];
+		modelview.m[k * 4 + 3] = 0.0f;
+	}
+	modelview.m[12] = -(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]);
+	modelview.m[13] = -(trueUp[0] * eye[0] + trueUp[1] * eye[1] + trueUp[2] * eye[2]);
+	modelview.m[14] = forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2];
+	modelview.m[15] = 1.0f;
+
+	Matrix4 clip = projection * modelview;
+	FrustumFromMatrix(clip.m, frustum);
+}
+
+void Camera::GetPixelViewport(int viewport[4]) const
+{
+	for (int i = 0; i < 4; i++)
+		viewport[i] = pixelViewport[i];
+}
+
+bool Camera::ContainsPixel(int x, int y) const
+{
+	return x >= pixelViewport[0] && x < pixelViewport[0] + pixelViewport[2]
+		&& y >= pixelViewport[1] && y < pixelViewport[1] + pixelViewport[3];
+}
+
+
+void FrustumFromMatrix(const float clip[16], BvhFrustum & frustum)
+{
+	// Gribb/Hartmann: each plane is the last row of the matrix plus or minus another row
+	for (int i = 0; i < 6; i++)
+	{
+		int row = i / 2;
+		float sign = (i & 1) ? -1.0f : 1.0f;
+		float *plane = frustum.planes[i];
+		for (int k = 0; k < 4; k++)
+			plane[k] = clip[k * 4 + 3] + sign * clip[k * 4 + row];
+
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f)
+		{
+			for (int k = 0; k < 4; k++)
+				plane[k] /= length;
+		}
+	}
+}
@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Camera.h
+//	View cameras for rendering several views of the arena in one frame. A camera
+//	owns its viewport (as fractions of the window, so it survives resizing) and
+//	computes the same matrices gluPerspective/gluLookAt would, on the CPU, so they
+//	can be loaded with glLoadMatrixf and also turned into a culling frustum.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "Bvh.h"
+#include "Transform.h"
+
+enum CameraMode
+{
+	CameraFixed,		// eye and target as set
+	CameraFollow,		// behind and above a robot, looking where it is heading
+	CameraOverhead		// straight down on the target
+};
+
+class Camera
+{
+public:
+	Camera();
+
+	void SetViewport(float x, float y, float width, float height);
+	void SetLookAt(float eyeX, float eyeY, float eyeZ, float targetX, float targetY, float targetZ);
+	void SetPerspective(float fovy, float zNear, float zFar);
+
+	// Places a CameraFollow camera behind a robot at (x, z) facing angle degrees
+	void Follow(float x, float z, float angle);
+
+	// Recomputes the matrices and frustum for a window of the given size
+	void Update(int windowWidth, int windowHeight);
+
+	// Viewport in pixels, as glViewport wants it
+	void GetPixelViewport(int viewport[4]) const;
+	bool ContainsPixel(int x, int y) const;		// window coordinates, origin bottom left
+
+	CameraMode mode;
+	float eye[3];
+	float target[3];
+	float fovy, zNear, zFar;
+	float followDistance, followHeight;
+
+	// Column major, valid after Update()
+	Matrix4 projection;
+	Matrix4 modelview;
+	BvhFrustum frustum;
+
+private:
+	float viewport[4];			// x, y, width, height as fractions of the window
+	int pixelViewport[4];
+};
+
+// Planes of the frustum of a combined projection * modelview matrix, in world space
+void FrustumFromMatrix(const float clip[16], BvhFrustum & frustum);
+
+#endif	//CAMERA_H
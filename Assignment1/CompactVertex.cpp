@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "CompactVertex.h"
+
+// Vertices decoded at a time when measuring
+static const int CompactDecodeBlock = 256;
+
+const char *GetVertexFormatName(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormatFloat: return "float";
+	case VertexFormatHalf: return "half";
+	case VertexFormatQuantized: return "quantized";
+	default: return "unknown";
+	}
+}
+
+int GetVertexFormatStride(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormatFloat: return 6 * sizeof(float);
+	case VertexFormatHalf: return 5 * sizeof(uint16_t);
+	case VertexFormatQuantized: return 3 * sizeof(uint16_t) + 2 * sizeof(int8_t);
+	default: return 0;
+	}
+}
+
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t magnitude = bits & 0x7fffffffu;
+
+	if (magnitude >= 0x7f800000u)
+		return (uint16_t)(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));	// infinity, NaN
+	if (magnitude >= 0x477ff000u)
+		return (uint16_t)(sign | 0x7c00u);		// rounds past 65504
+	if (magnitude < 0x33000000u)
+		return (uint16_t)sign;					// rounds to zero
+
+	uint32_t result, remainder, halfway;
+	if (magnitude < 0x38800000u)
+	{
+		// Subnormal half, in steps of 2^-24
+		uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+		int shift = 126 - (int)(magnitude >> 23);
+		result = mantissa >> shift;
+		remainder = mantissa & ((1u << shift) - 1u);
+		halfway = 1u << (shift - 1);
+	}
+	else
+	{
+		// Rebias the exponent from 127 to 15 and drop 13 mantissa bits
+		result = (magnitude - 0x38000000u) >> 13;
+		remainder = magnitude & 0x1fffu;
+		halfway = 0x1000u;
+	}
+	if (remainder > halfway || (remainder == halfway && (result & 1u)))
+		result++;
+	return (uint16_t)(sign | result);
+}
+
+float HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+	uint32_t exponent = (half >> 10) & 0x1fu;
+	uint32_t mantissa = half & 0x3ffu;
+
+	if (exponent == 0)
+	{
+		float value = (float)mantissa * 5.9604644775390625e-8f;		// 2^-24
+		return sign ? -value : value;
+	}
+
+	uint32_t bits = exponent == 31 ? sign | 0x7f800000u | (mantissa << 13) : sign | ((exponent + 112) << 23) | (mantissa << 13);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static float SignNotZero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Projects onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the
+// upper one, so the whole sphere lands on one square
+void OctahedralEncode(const float normal[3], float &u, float &v)
+{
+	float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	if (length <= 0.0f)
+	{
+		u = v = 0.0f;
+		return;
+	}
+	float x = normal[0] / length, y = normal[1] / length;
+	if (normal[2] < 0.0f)
+	{
+		u = (1.0f - fabsf(y)) * SignNotZero(x);
+		v = (1.0f - fabsf(x)) * SignNotZero(y);
+	}
+	else
+	{
+		u = x;
+		v = y;
+	}
+}
+
+void OctahedralDecode(float u, float v, float normal[3])
+{
+	float x = u, y = v, z = 1.0f - fabsf(u) - fabsf(v);
+	if (z < 0.0f)
+	{
+		x = (1.0f - fabsf(v)) * SignNotZero(u);
+		y = (1.0f - fabsf(u)) * SignNotZero(v);
+	}
+	float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+// Rounding each coordinate on its own is not always closest on the sphere, so the
+// four neighbouring codes are tried and the one decoding nearest the normal is kept
+static void OctahedralEncode8(const float normal[3], int8_t code[2])
+{
+	float u, v;
+	OctahedralEncode(normal, u, v);
+	float baseU = floorf(u * 127.0f), baseV = floorf(v * 127.0f);
+	float best = -2.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		float codeU = std::max(-127.0f, std::min(127.0f, baseU + (float)(i & 1)));
+		float codeV = std::max(-127.0f, std::min(127.0f, baseV + (float)(i >> 1)));
+		float decoded[3];
+		OctahedralDecode(codeU / 127.0f, codeV / 127.0f, decoded);
+		float dot = decoded[0] * normal[0] + decoded[1] * normal[1] + decoded[2] * normal[2];
+		if (dot > best)
+		{
+			best = dot;
+			code[0] = (int8_t)codeU;
+			code[1] = (int8_t)codeV;
+		}
+	}
+}
+
+CompactVertices::CompactVertices() : format(VertexFormatFloat), numVertices(0)
+{
+	origin[0] = origin[1] = origin[2] = 0.0f;
+	step[0] = step[1] = step[2] = 0.0f;
+}
+
+void CompactVertices::Clear()
+{
+	numVertices = 0;
+	data.clear();
+	data.shrink_to_fit();
+}
+
+void CompactVertices::Encode(VertexFormat format, const float *vertexData, int numVertices)
+{
+	this->format = format;
+	this->numVertices = numVertices;
+	int stride = GetVertexFormatStride(format);
+	data.assign((size_t)numVertices * stride, 0);
+	data.shrink_to_fit();
+
+	// Bounds of the positions, the low corner is the origin
+	float high[3] = { 0.0f, 0.0f, 0.0f };
+	for (int k = 0; k < 3; k++)
+		origin[k] = numVertices > 0 ? vertexData[k] : 0.0f;
+	for (int i = 0; i < numVertices; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			origin[k] = std::min(origin[k], vertexData[6 * i + k]);
+			high[k] = i == 0 ? vertexData[k] : std::max(high[k], vertexData[6 * i + k]);
+		}
+	}
+	for (int k = 0; k < 3; k++)
+		step[k] = (high[k] - origin[k]) / 65535.0f;
+
+	for (int i = 0; i < numVertices; i++)
+	{
+		const float *position = &vertexData[6 * i], *normal = &vertexData[6 * i + 3];
+		uint8_t *out = &data[(size_t)i * stride];
+		if (format == VertexFormatFloat)
+		{
+			memcpy(out, position, 6 * sizeof(float));
+		}
+		else if (format == VertexFormatHalf)
+		{
+			uint16_t packed[5];
+			for (int k = 0; k < 3; k++)
+				packed[k] = FloatToHalf(position[k] - origin[k]);
+			float u, v;
+			OctahedralEncode(normal, u, v);
+			packed[3] = FloatToHalf(u);
+			packed[4] = FloatToHalf(v);
+			memcpy(out, packed, sizeof(packed));
+		}
+		else
+		{
+			uint16_t packed[3];
+			for (int k = 0; k < 3; k++)
+			{
+				float steps = step[k] > 0.0f ? (position[k] - origin[k]) / step[k] + 0.5f : 0.0f;
+				packed[k] = (uint16_t)std::max(0.0f, std::min(65535.0f, steps));
+			}
+			int8_t code[2];
+			OctahedralEncode8(normal, code);
+			memcpy(out, packed, sizeof(packed));
+			memcpy(out + sizeof(packed), code, sizeof(code));
+		}
+	}
+}
+
+void CompactVertices::Decode(int first, int count, float *vertexData) const
+{
+	int stride = GetVertexFormatStride(format);
+	for (int i = 0; i < count; i++)
+	{
+		const uint8_t *in = &data[(size_t)(first + i) * stride];
+		float *position = &vertexData[6 * i], *normal = &vertexData[6 * i + 3];
+		if (format == VertexFormatFloat)
+		{
+			memcpy(position, in, 6 * sizeof(float));
+		}
+		else if (format == VertexFormatHalf)
+		{
+			uint16_t packed[5];
+			memcpy(packed, in, sizeof(packed));
+			for (int k = 0; k < 3; k++)
+				position[k] = origin[k] + HalfToFloat(packed[k]);
+			OctahedralDecode(HalfToFloat(packed[3]), HalfToFloat(packed[4]), normal);
+		}
+		else
+		{
+			uint16_t packed[3];
+			int8_t code[2];
+			memcpy(packed, in, sizeof(packed));
+			memcpy(code, in + sizeof(packed), sizeof(code));
+			for (int k = 0; k < 3; k++)
+				position[k] = origin[k] + step[k] * (float)packed[k];
+			OctahedralDecode(code[0] / 127.0f, code[1] / 127.0f, normal);
+		}
+	}
+}
+
+VertexFormatError MeasureVertexFormat(const CompactVertices &vertices, const float *vertexData)
+{
+	VertexFormatError error = { 0.0f, 0.0f };
+	float decoded[6 * CompactDecodeBlock];
+	for (int first = 0; first < vertices.GetVertexCount(); first += CompactDecodeBlock)
+	{
+		int count = std::min(CompactDecodeBlock, vertices.GetVertexCount() - first);
+		vertices.Decode(first, count, decoded);
+		for (int i = 0; i < count; i++)
+		{
+			const float *original = &vertexData[6 * (first + i)], *result = &decoded[6 * i];
+			float dx = result[0] - original[0], dy = result[1] - original[1], dz = result[2] - original[2];
+			error.maxPosition = std::max(error.maxPosition, sqrtf(dx * dx + dy * dy + dz * dz));
+
+			float lengths = sqrtf(original[3] * original[3] + original[4] * original[4] + original[5] * original[5]) *
+				sqrtf(result[3] * result[3] + result[4] * result[4] + result[5] * result[5]);
+			if (lengths <= 0.0f)
+				continue;
+			float cosine = (original[3] * result[3] + original[4] * result[4] + original[5] * result[5]) / lengths;
+			float degrees = acosf(std::max(-1.0f, std::min(1.0f, cosine))) * 57.29578f;
+			error.maxNormalDegrees = std::max(error.maxNormalDegrees, degrees);
+		}
+	}
+	return error;
+}
+
+void ReportVertexFormats(const char *name, const float *vertexData, int numVertices)
+{
+	printf("Vertex formats for %s, %d vertices:\n", name, numVertices);
+	size_t floatBytes = (size_t)numVertices * GetVertexFormatStride(VertexFormatFloat);
+	CompactVertices vertices;
+	for (int f = 0; f < VertexFormatCount; f++)
+	{
+		vertices.Encode((VertexFormat)f, vertexData, numVertices);
+		VertexFormatError error = MeasureVertexFormat(vertices, vertexData);
+		size_t bytes = vertices.GetByteSize();
+		printf("  %-9s %2d bytes/vertex, %8zu bytes, %5.1f%% saved, position error %.5f, normal error %.3f degrees\n",
+			GetVertexFormatName((VertexFormat)f), GetVertexFormatStride((VertexFormat)f), bytes,
+			floatBytes > 0 ? 100.0 * (double)(floatBytes - bytes) / (double)floatBytes : 0.0, error.maxPosition,
+			error.maxNormalDegrees);
+	}
+}
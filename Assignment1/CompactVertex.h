@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	CompactVertex.h
+//	Smaller vertex formats for meshes kept in memory and decoded as they are drawn.
+//	Positions are stored relative to the mesh's own origin (the low corner of its
+//	bounds), either as half floats or as 16 bit steps across the bounds; normals are
+//	folded onto an octahedron and stored as two numbers. Input and decoded output are
+//	the interleaved position + normal layout of MeshVertex and ModelMesh, 6 floats a
+//	vertex.
+//
+//	ReportVertexFormats() encodes a mesh in every format and prints the bytes each
+//	saves with the worst position and normal error, to pick a format per mesh.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef COMPACTVERTEX_H
+#define COMPACTVERTEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+enum VertexFormat
+{
+	VertexFormatFloat,		// float position and normal, 24 bytes
+	VertexFormatHalf,		// half position from the origin, half octahedral normal, 10 bytes
+	VertexFormatQuantized,	// 16 bit position across the bounds, 8 bit octahedral normal, 8 bytes
+	VertexFormatCount
+};
+
+const char *GetVertexFormatName(VertexFormat format);
+int GetVertexFormatStride(VertexFormat format);
+
+// IEEE half precision, rounded to nearest even; out of range values become infinity
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+
+// Unit normal to a point of the square [-1, 1]^2 and back
+void OctahedralEncode(const float normal[3], float &u, float &v);
+void OctahedralDecode(float u, float v, float normal[3]);
+
+class CompactVertices
+{
+public:
+	CompactVertices();
+
+	// Encodes numVertices vertices of 6 floats. Replaces what was held before.
+	void Encode(VertexFormat format, const float *vertexData, int numVertices);
+	void Clear();
+
+	// count vertices from first, 6 floats each
+	void Decode(int first, int count, float *vertexData) const;
+
+	VertexFormat GetFormat() const { return format; }
+	int GetVertexCount() const { return numVertices; }
+	size_t GetByteSize() const { return data.size(); }
+
+private:
+	VertexFormat format;
+	int numVertices;
+	float origin[3];
+	float step[3];			// position units per quantization step
+	std::vector<uint8_t> data;
+};
+
+struct VertexFormatError
+{
+	float maxPosition;		// largest distance from the original position
+	float maxNormalDegrees;	// largest angle from the original normal
+};
+
+VertexFormatError MeasureVertexFormat(const CompactVertices &vertices, const float *vertexData);
+
+// Prints bytes, saving and error of every format for one mesh
+void ReportVertexFormats(const char *name, const float *vertexData, int numVertices);
+
+#endif	//COMPACTVERTEX_H
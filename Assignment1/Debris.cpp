@@ -0,0 +1,306 @@
+#include <math.h>
+#include <gl/glut.h>
+#include "FastTrig.h"
+#include "Primitives.h"
+#include "Debris.h"
+
+// Standard cube the pieces are scaled from
+static constexpr PrimitiveMesh<24, 36> pieceCube = MakeCube();
+
+// Merge once this many chunks are asleep, or when nothing is moving any more
+static const uint32_t MergeThreshold = 64;
+static const float SleepSpeed = 0.3f;
+static const float SleepTime = 0.5f;
+
+
+static uint32_t NextRandom(uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Cut positions of one slab: -1, jittered inner cuts, 1
+static void MakeCuts(uint32_t &state, int cutsPerAxis, float *cuts)
+{
+	cuts[0] = -1.0f;
+	for (int i = 1; i < cutsPerAxis; i++)
+	{
+		float jitter = (float)(NextRandom(state) >> 8) / 16777216.0f - 0.5f;
+		cuts[i] = -1.0f + 2.0f * (i + 0.6f * jitter) / cutsPerAxis;
+	}
+	cuts[cutsPerAxis] = 1.0f;
+}
+
+void MakeFracturePattern(uint32_t seed, int cutsPerAxis, std::vector<FracturePiece> &pieces)
+{
+	pieces.clear();
+	if (cutsPerAxis < 1)
+		cutsPerAxis = 1;
+
+	// Every x slab gets its own y cuts and every column its own z cuts, so the
+	// cracks do not line up like a grid
+	uint32_t state = seed ? seed : 1;
+	std::vector<float> xCuts(cutsPerAxis + 1), yCuts(cutsPerAxis + 1), zCuts(cutsPerAxis + 1);
+	MakeCuts(state, cutsPerAxis, xCuts.data());
+	for (int i = 0; i < cutsPerAxis; i++)
+	{
+		MakeCuts(state, cutsPerAxis, yCuts.data());
+		for (int j = 0; j < cutsPerAxis; j++)
+		{
+			MakeCuts(state, cutsPerAxis, zCuts.data());
+			for (int k = 0; k < cutsPerAxis; k++)
+			{
+				FracturePiece piece;
+				piece.center[0] = 0.5f * (xCuts[i] + xCuts[i + 1]);
+				piece.center[1] = 0.5f * (yCuts[j] + yCuts[j + 1]);
+				piece.center[2] = 0.5f * (zCuts[k] + zCuts[k + 1]);
+				piece.halfExtents[0] = 0.5f * (xCuts[i + 1] - xCuts[i]);
+				piece.halfExtents[1] = 0.5f * (yCuts[j + 1] - yCuts[j]);
+				piece.halfExtents[2] = 0.5f * (zCuts[k + 1] - zCuts[k]);
+				pieces.push_back(piece);
+			}
+		}
+	}
+}
+
+
+DebrisSystem::DebrisSystem(uint32_t maxChunks, int maxBatches, int cutsPerAxis)
+	: chunks(maxChunks)
+{
+	MakeFracturePattern(0x5EED1234u, cutsPerAxis, pattern);
+	this->maxBatches = maxBatches > 0 ? maxBatches : 1;
+	gravity = -30.0f;
+	groundY = -2.5f;
+	awakeCount = 0;
+	sleepingCount = 0;
+	randomState = 0x2545F491u;
+}
+
+DebrisSystem::~DebrisSystem()
+{
+	// Display lists die with the GL context when the window closes, only
+	// delete them here while it may still be around
+	for (size_t i = 0; i < batches.size(); i++)
+		glDeleteLists(batches[i].displayList, 1);
+}
+
+// Uniform in [0, 1)
+float DebrisSystem::Random()
+{
+	return (float)(NextRandom(randomState) >> 8) / 16777216.0f;
+}
+
+int DebrisSystem::Shatter(const float center[3], const float scale[3], float angle, const float impact[3],
+	float strength, const DebrisMaterial &material)
+{
+	// Make room from the sleeping chunks before dropping pieces
+	if (chunks.GetLiveCount() + pattern.size() > chunks.GetCapacity() && sleepingCount > 0)
+		MergeSleeping();
+
+	float s, c;
+	FastSinCosDegrees(angle, s, c);
+
+	int created = 0;
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		PoolHandle handle = chunks.Create();
+		DebrisChunk *chunk = chunks.Get(handle);
+		if (!chunk)
+			break;
+
+		// Piece centre in world space, same rotation as glRotatef(angle, 0, 1, 0)
+		const FracturePiece &piece = pattern[i];
+		float local[3] = { piece.center[0] * scale[0], piece.center[1] * scale[1], piece.center[2] * scale[2] };
+		chunk->position[0] = center[0] + c * local[0] + s * local[2];
+		chunk->position[1] = center[1] + local[1];
+		chunk->position[2] = center[2] - s * local[0] + c * local[2];
+		for (int k = 0; k < 3; k++)
+			chunk->halfExtents[k] = piece.halfExtents[k] * scale[k];
+
+		// Away from the impact, faster for pieces near it, always a little upwards
+		float away[3], length = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			away[k] = chunk->position[k] - impact[k];
+			length += away[k] * away[k];
+		}
+		length = sqrtf(length);
+		float speed = strength * (0.4f + 0.6f * Random()) / (1.0f + 0.2f * length);
+		for (int k = 0; k < 3; k++)
+			chunk->velocity[k] = length > 0.0f ? speed * away[k] / length : 0.0f;
+		chunk->velocity[1] += 0.3f * strength * Random();
+
+		chunk->yaw = angle;
+		chunk->pitch = 0.0f;
+		chunk->yawSpeed = 360.0f * (Random() - 0.5f);
+		chunk->pitchSpeed = 720.0f * (Random() - 0.5f);
+		chunk->restTime = 0.0f;
+		chunk->sleeping = false;
+		chunk->material = material;
+		awakeCount++;
+		created++;
+	}
+	return created;
+}
+
+void DebrisSystem::Update(float dt)
+{
+	if (awakeCount == 0)
+		return;
+
+	chunks.ForEach([this, dt](DebrisChunk &chunk)
+	{
+		if (chunk.sleeping)
+			return;
+
+		chunk.velocity[1] += gravity * dt;
+		for (int k = 0; k < 3; k++)
+			chunk.position[k] += chunk.velocity[k] * dt;
+		chunk.yaw += chunk.yawSpeed * dt;
+		chunk.pitch += chunk.pitchSpeed * dt;
+
+		// Height of the tumbled box above its centre
+		float s, c;
+		FastSinCosDegrees(chunk.pitch, s, c);
+		float halfHeight = fabsf(c) * chunk.halfExtents[1] + fabsf(s) * chunk.halfExtents[2];
+		float radius = chunk.halfExtents[0] > chunk.halfExtents[2] ? chunk.halfExtents[0] : chunk.halfExtents[2];
+
+		if (chunk.position[1] - halfHeight < groundY)
+		{
+			// Bounce, slide and settle onto the nearest face
+			chunk.position[1] = groundY + halfHeight;
+			if (chunk.velocity[1] < 0.0f)
+				chunk.velocity[1] *= -0.3f;
+			chunk.velocity[0] *= 0.85f;
+			chunk.velocity[2] *= 0.85f;
+			chunk.yawSpeed *= 0.8f;
+			chunk.pitchSpeed *= 0.6f;
+			float face = 90.0f * floorf(chunk.pitch / 90.0f + 0.5f);
+			chunk.pitch += (face - chunk.pitch) * 0.3f;
+		}
+		for (size_t w = 0; w < walls.size(); w++)
+		{
+			const DebrisWall &wall = walls[w];
+			float offset[3] = { chunk.position[0] - wall.origin[0], chunk.position[1] - wall.origin[1],
+				chunk.position[2] - wall.origin[2] };
+			float u = offset[0] * wall.along[0] + offset[1] * wall.along[1] + offset[2] * wall.along[2];
+			float v = offset[0] * wall.up[0] + offset[1] * wall.up[1] + offset[2] * wall.up[2];
+			float d = offset[0] * wall.normal[0] + offset[1] * wall.normal[1] + offset[2] * wall.normal[2];
+			if (fabsf(d) >= radius || u < -radius || u > wall.length + radius || v < -radius || v > wall.height + radius)
+				continue;
+
+			// Out to the side the chunk is on, bouncing off if it moves into the wall
+			float side = d < 0.0f ? -1.0f : 1.0f;
+			float into = chunk.velocity[0] * wall.normal[0] + chunk.velocity[1] * wall.normal[1] +
+				chunk.velocity[2] * wall.normal[2];
+			for (int k = 0; k < 3; k++)
+			{
+				chunk.position[k] += (side * radius - d) * wall.normal[k];
+				if (into * side < 0.0f)
+					chunk.velocity[k] -= 1.3f * into * wall.normal[k];
+			}
+		}
+
+		float speed = fabsf(chunk.velocity[0]) + fabsf(chunk.velocity[1]) + fabsf(chunk.velocity[2]);
+		chunk.restTime = speed < SleepSpeed ? chunk.restTime + dt : 0.0f;
+		if (chunk.restTime > SleepTime)
+		{
+			chunk.sleeping = true;
+			chunk.pitch = 90.0f * floorf(chunk.pitch / 90.0f + 0.5f);
+			chunk.position[1] = groundY + (fmodf(fabsf(chunk.pitch), 180.0f) < 45.0f ? chunk.halfExtents[1] : chunk.halfExtents[2]);
+			awakeCount--;
+			sleepingCount++;
+		}
+	});
+}
+
+void DebrisSystem::AddWall(const float origin[3], const float along[3], const float up[3], float length, float height)
+{
+	DebrisWall wall;
+	float alongLength = sqrtf(along[0] * along[0] + along[1] * along[1] + along[2] * along[2]);
+	float upLength = sqrtf(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+	if (alongLength <= 0.0f || upLength <= 0.0f)
+		return;
+	for (int k = 0; k < 3; k++)
+	{
+		wall.origin[k] = origin[k];
+		wall.along[k] = along[k] / alongLength;
+		wall.up[k] = up[k] / upLength;
+	}
+	wall.normal[0] = wall.along[1] * wall.up[2] - wall.along[2] * wall.up[1];
+	wall.normal[1] = wall.along[2] * wall.up[0] - wall.along[0] * wall.up[2];
+	wall.normal[2] = wall.along[0] * wall.up[1] - wall.along[1] * wall.up[0];
+	float normalLength = sqrtf(wall.normal[0] * wall.normal[0] + wall.normal[1] * wall.normal[1] +
+		wall.normal[2] * wall.normal[2]);
+	if (normalLength <= 0.0f)
+		return;
+	for (int k = 0; k < 3; k++)
+		wall.normal[k] /= normalLength;
+	wall.length = length;
+	wall.height = height;
+	walls.push_back(wall);
+}
+
+void DebrisSystem::PrepareDraw()
+{
+	if (sleepingCount >= MergeThreshold || (sleepingCount > 0 && awakeCount == 0))
+		MergeSleeping();
+}
+
+void DebrisSystem::MergeSleeping()
+{
+	// The oldest batch makes way when there are too many
+	if ((int)batches.size() >= maxBatches)
+	{
+		glDeleteLists(batches[0].displayList, 1);
+		batches.erase(batches.begin());
+	}
+
+	Batch batch;
+	batch.displayList = glGenLists(1);
+	batch.numPieces = 0;
+	glNewList(batch.displayList, GL_COMPILE);
+
+	// Destroying swaps the last live chunk into the freed spot, so walk backwards
+	for (uint32_t i = chunks.GetLiveCount(); i-- > 0;)
+	{
+		PoolHandle handle = chunks.GetLiveHandle(i);
+		DebrisChunk *chunk = chunks.Get(handle);
+		if (!chunk->sleeping)
+			continue;
+
+		DrawChunk(*chunk);
+		batch.numPieces++;
+		chunks.Destroy(handle);
+	}
+
+	glEndList();
+	batches.push_back(batch);
+	sleepingCount = 0;
+}
+
+void DebrisSystem::DrawChunk(const DebrisChunk &chunk) const
+{
+	glMaterialfv(GL_FRONT, GL_AMBIENT, chunk.material.ambient);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, chunk.material.specular);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, chunk.material.diffuse);
+	glMaterialfv(GL_FRONT, GL_SHININESS, chunk.material.shininess);
+
+	glPushMatrix();
+	glTranslatef(chunk.position[0], chunk.position[1], chunk.position[2]);
+	glRotatef(chunk.yaw, 0.0, 1.0, 0.0);
+	glRotatef(chunk.pitch, 1.0, 0.0, 0.0);
+	glScalef(chunk.halfExtents[0], chunk.halfExtents[1], chunk.halfExtents[2]);
+	DrawPrimitive(pieceCube.View());
+	glPopMatrix();
+}
+
+void DebrisSystem::Draw() const
+{
+	for (size_t i = 0; i < batches.size(); i++)
+		glCallList(batches[i].displayList);
+
+	chunks.ForEach([this](const DebrisChunk &chunk) { DrawChunk(chunk); });
+}
@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Debris.h
+//	Destructible obstacles. Cubes are pre-fractured once at start-up into an
+//	irregular set of box pieces (a brick-like tiling with jittered cuts); Shatter()
+//	replaces a cube with those pieces as debris chunks taken from a fixed pool.
+//	Chunks fall, bounce and tumble until they come to rest, then sleep. Sleeping
+//	chunks are merged into static batches (display lists) and their pool slots
+//	reused, and only the newest batches are kept, so memory and frame time stay
+//	bounded however much gets destroyed.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DEBRIS_H
+#define DEBRIS_H
+
+#include <stdint.h>
+#include <vector>
+#include "ObjectPool.h"
+
+// One piece of the fracture pattern, in the space of a standard cube (-1..1)
+struct FracturePiece
+{
+	float center[3];
+	float halfExtents[3];
+};
+
+// Irregular tiling of the standard cube into cutsPerAxis^3 box pieces
+void MakeFracturePattern(uint32_t seed, int cutsPerAxis, std::vector<FracturePiece> &pieces);
+
+struct DebrisMaterial
+{
+	float ambient[4];
+	float specular[4];
+	float diffuse[4];
+	float shininess[1];
+};
+
+struct DebrisChunk
+{
+	float position[3];
+	float velocity[3];
+	float halfExtents[3];
+	float yaw, pitch;					// degrees, around y and then the chunk's own x
+	float yawSpeed, pitchSpeed;			// degrees per second
+	float restTime;						// seconds spent nearly still
+	bool sleeping;
+	DebrisMaterial material;
+};
+
+// Upright rectangle chunks bounce off, from whichever side they are on
+struct DebrisWall
+{
+	float origin[3];
+	float along[3];		// unit, the wall runs length along it
+	float up[3];		// unit, the wall stands height along it
+	float normal[3];	// unit, along x up
+	float length, height;
+};
+
+class DebrisSystem
+{
+public:
+	DebrisSystem(uint32_t maxChunks = 1024, int maxBatches = 16, int cutsPerAxis = 3);
+	~DebrisSystem();
+
+	DebrisSystem(const DebrisSystem &) = delete;
+	DebrisSystem &operator=(const DebrisSystem &) = delete;
+
+	// Breaks a cube centred at center, scaled by scale and turned angle degrees around y,
+	// into the fracture pieces, blown away from impact with speeds up to strength.
+	// Returns the number of chunks created, fewer than the pattern has if the pool is full.
+	int Shatter(const float center[3], const float scale[3], float angle, const float impact[3],
+		float strength, const DebrisMaterial &material);
+
+	// Falling, bouncing and going to sleep
+	void Update(float dt);
+
+	// Walls of the arena, as the origin, directions and size of its wall surfaces
+	void AddWall(const float origin[3], const float along[3], const float up[3], float length, float height);
+	void ClearWalls() { walls.clear(); }
+
+	// GL thread, once per frame: merges sleeping chunks into static batches
+	void PrepareDraw();
+	void Draw() const;
+
+	bool HasAwakeChunks() const { return awakeCount > 0; }
+	uint32_t GetChunkCount() const { return chunks.GetLiveCount(); }
+	int GetBatchCount() const { return (int)batches.size(); }
+
+	float gravity;
+	float groundY;
+
+private:
+	struct Batch
+	{
+		unsigned int displayList;
+		int numPieces;
+	};
+
+	void DrawChunk(const DebrisChunk &chunk) const;
+	void MergeSleeping();
+	float Random();
+
+	std::vector<FracturePiece> pattern;
+	ObjectPool<DebrisChunk> chunks;
+	std::vector<Batch> batches;		// oldest first, at most maxBatches
+	std::vector<DebrisWall> walls;
+	int maxBatches;
+	uint32_t awakeCount;
+	uint32_t sleepingCount;
+	uint32_t randomState;
+};
+
+#endif	//DEBRIS_H
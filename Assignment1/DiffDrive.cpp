@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "FastTrig.h"
+#include "JobSystem.h"
+#include "Robot.h"
+#include "DiffDrive.h"
+
+static const float RadiansToDegrees = 57.29577951f;
+static const float DegreesToRadians = 0.01745329252f;
+
+// Robots per batched sine and cosine
+static const int DiffDriveBlock = 64;
+
+static float Clamp(float value, float low, float high)
+{
+	return std::max(low, std::min(high, value));
+}
+
+DiffDrive::DiffDrive(const DiffDriveSettings &settings) : settings(settings)
+{
+}
+
+void DiffDrive::SetRobotCount(int count)
+{
+	x.resize(count, 0.0f);
+	z.resize(count, 0.0f);
+	heading.resize(count, 0.0f);
+	wheelLeft.resize(count, 0.0f);
+	wheelRight.resize(count, 0.0f);
+	targetLeft.resize(count, 0.0f);
+	targetRight.resize(count, 0.0f);
+	contactLeft.resize(count, 0.0f);
+	contactRight.resize(count, 0.0f);
+	wheelAngleLeft.resize(count, 0.0f);
+	wheelAngleRight.resize(count, 0.0f);
+}
+
+void DiffDrive::ReadRobot(int index, const Robot &robot, bool stop)
+{
+	x[index] = robot.x;
+	z[index] = robot.z;
+	heading[index] = robot.angle;
+	wheelAngleLeft[index] = robot.leftWheelAngle;
+	wheelAngleRight[index] = robot.rightWheelAngle;
+	if (stop)
+	{
+		wheelLeft[index] = wheelRight[index] = 0.0f;
+		targetLeft[index] = targetRight[index] = 0.0f;
+		contactLeft[index] = contactRight[index] = 0.0f;
+	}
+}
+
+void DiffDrive::WriteRobot(int index, Robot &robot) const
+{
+	robot.x = x[index];
+	robot.z = z[index];
+	robot.angle = heading[index];
+	robot.leftWheelAngle = wheelAngleLeft[index];
+	robot.rightWheelAngle = wheelAngleRight[index];
+	robot.UpdateForwards();
+}
+
+void DiffDrive::SetWheelTargets(int index, float left, float right)
+{
+	targetLeft[index] = Clamp(left, -settings.maxWheelSpeed, settings.maxWheelSpeed);
+	targetRight[index] = Clamp(right, -settings.maxWheelSpeed, settings.maxWheelSpeed);
+}
+
+// Turning counter-clockwise drives the right wheel forwards and the left one back
+void DiffDrive::SetDriveInput(int index, float turn, float move, float turnShare)
+{
+	float left = move - turnShare * turn, right = move + turnShare * turn;
+	SetWheelTargets(index, left * settings.maxWheelSpeed, right * settings.maxWheelSpeed);
+}
+
+float DiffDrive::GetTurnRate(int index) const
+{
+	return (contactRight[index] - contactLeft[index]) / settings.trackWidth * RadiansToDegrees;
+}
+
+bool DiffDrive::IsMoving() const
+{
+	for (size_t i = 0; i < x.size(); i++)
+	{
+		if (wheelLeft[i] != 0.0f || wheelRight[i] != 0.0f || targetLeft[i] != 0.0f || targetRight[i] != 0.0f ||
+			contactLeft[i] != 0.0f || contactRight[i] != 0.0f)
+			return true;
+	}
+	return false;
+}
+
+void DiffDrive::Step(float dt, JobSystem *jobs)
+{
+	int count = (int)x.size();
+	auto body = [this, dt](uint32_t begin, uint32_t end)
+	{
+		StepRange((int)begin, (int)end, dt);
+	};
+	if (jobs && count >= 4096)
+		jobs->ParallelFor((uint32_t)count, 1024, body);
+	else
+		body(0, (uint32_t)count);
+}
+
+void DiffDrive::StepRange(int begin, int end, float dt)
+{
+	float wheelStep = settings.maxWheelAccel * dt;
+	float pushStep = settings.traction * dt;
+	float rollStep = settings.rollingResistance * dt;
+	float radius = settings.wheelRadius;
+	float invTrack = 1.0f / settings.trackWidth;
+
+	float midHeading[DiffDriveBlock], chord[DiffDriveBlock];
+	float sines[DiffDriveBlock], cosines[DiffDriveBlock];
+	for (int start = begin; start < end; start += DiffDriveBlock)
+	{
+		int count = std::min(DiffDriveBlock, end - start);
+		for (int k = 0; k < count; k++)
+		{
+			int i = start + k;
+
+			// Motors ramp the wheels, the wheels drive the contacts within traction
+			float left = wheelLeft[i] + Clamp(targetLeft[i] - wheelLeft[i], -wheelStep, wheelStep);
+			float right = wheelRight[i] + Clamp(targetRight[i] - wheelRight[i], -wheelStep, wheelStep);
+			float contactL = contactLeft[i], contactR = contactRight[i];
+			contactL -= Clamp(contactL, -rollStep, rollStep);
+			contactR -= Clamp(contactR, -rollStep, rollStep);
+			contactL += Clamp(radius * left - contactL, -pushStep, pushStep);
+			contactR += Clamp(radius * right - contactR, -pushStep, pushStep);
+			wheelLeft[i] = left;
+			wheelRight[i] = right;
+			contactLeft[i] = contactL;
+			contactRight[i] = contactR;
+			wheelAngleLeft[i] += left * dt * RadiansToDegrees;
+			wheelAngleRight[i] += right * dt * RadiansToDegrees;
+
+			// Along the arc: the chord points at the mean heading and is the arc length
+			// times sin(h) / h for half the turn h
+			float turn = (contactR - contactL) * invTrack * dt;
+			float half = 0.5f * turn, halfSq = half * half;
+			midHeading[k] = heading[i] + half * RadiansToDegrees;
+			heading[i] += turn * RadiansToDegrees;
+			chord[k] = 0.5f * (contactL + contactR) * dt * (1.0f - halfSq * (1.0f / 6.0f) * (1.0f - halfSq * 0.05f));
+		}
+
+		SinCosDegreesBatch(midHeading, sines, cosines, count);
+		for (int k = 0; k < count; k++)
+		{
+			x[start + k] += chord[k] * sines[k];
+			z[start + k] += chord[k] * cosines[k];
+		}
+	}
+}
+
+static float RandomRange(float low, float high)
+{
+	return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
+
+double BenchmarkDiffDrive(int numRobots, int numSteps, JobSystem *jobs)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// The robot main.cpp draws
+	DiffDriveSettings settings;
+	settings.wheelRadius = 2.5f;
+	settings.trackWidth = 12.5f;
+	settings.maxWheelSpeed = 12.0f;
+	settings.maxWheelAccel = 40.0f;
+	settings.traction = 60.0f;
+	settings.rollingResistance = 5.0f;
+	const float dt = 0.01f;
+
+	// Constant wheel speeds drive a circle, a full turn should come back to the start
+	DiffDrive circle(settings);
+	circle.SetRobotCount(1);
+	circle.SetWheelTargets(0, 6.0f, 10.0f);
+	for (int i = 0; i < 200; i++)
+		circle.Step(dt);
+	Robot start;
+	circle.WriteRobot(0, start);
+	float turnRate = circle.GetTurnRate(0);
+	int lapSteps = (int)floorf(360.0f / (turnRate * dt) + 0.5f);
+	float lapDt = 360.0f / (turnRate * lapSteps);
+	for (int i = 0; i < lapSteps; i++)
+		circle.Step(lapDt);
+	Robot lap;
+	circle.WriteRobot(0, lap);
+	float closure = sqrtf((lap.x - start.x) * (lap.x - start.x) + (lap.z - start.z) * (lap.z - start.z));
+
+	srand(1234);
+	DiffDrive drive(settings);
+	drive.SetRobotCount(numRobots);
+	for (int i = 0; i < numRobots; i++)
+	{
+		Robot robot(RandomRange(-1000.0f, 1000.0f), RandomRange(-1000.0f, 1000.0f), RandomRange(0.0f, 360.0f));
+		drive.ReadRobot(i, robot);
+	}
+
+	double stepSeconds = 0.0;
+	for (int step = 0; step < numSteps; step++)
+	{
+		// A fiftieth of the drivers change their input every step
+		for (int i = step % 50; i < numRobots; i += 50)
+			drive.SetDriveInput(i, RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f));
+
+		Clock::time_point begin = Clock::now();
+		drive.Step(dt, jobs);
+		stepSeconds += std::chrono::duration<double>(Clock::now() - begin).count();
+	}
+
+	double robotsPerSecond = (double)numRobots * numSteps / (stepSeconds > 0.0 ? stepSeconds : 1e-9);
+	printf("Differential drive benchmark: %d robots, %d steps of %.0f ms, %s\n", numRobots, numSteps, dt * 1000.0f,
+		jobs ? "parallel" : "single thread");
+	printf("  %.3f ms per step, %.1f M robots/s, circle of radius %.2f closes to %.4f after a lap\n",
+		stepSeconds * 1000.0 / numSteps, robotsPerSecond / 1e6,
+		0.5f * settings.trackWidth * (10.0f + 6.0f) / (10.0f - 6.0f), closure);
+	return robotsPerSecond;
+}
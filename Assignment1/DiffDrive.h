@@ -0,0 +1,86 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	DiffDrive.h
+//	Differential-drive kinematics for many robots at once. Each robot has a left and
+//	a right wheel whose angular velocities decide how it moves: the body drives at
+//	the mean of the two rim speeds and turns at their difference over the track.
+//	Motors ramp the wheels towards the speeds asked for within an acceleration limit,
+//	and the ground can only push each side of the robot as hard as friction allows,
+//	so a wheel asked to accelerate harder spins faster than the ground moves under
+//	it. Rolling resistance slows the body down through the same contact.
+//
+//	Robots are stored as separate arrays per attribute and Step() advances all of
+//	them, in blocks that share one batched sine and cosine, over jobs when given.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DIFFDRIVE_H
+#define DIFFDRIVE_H
+
+#include <stddef.h>
+#include <vector>
+
+class JobSystem;
+struct Robot;
+
+struct DiffDriveSettings
+{
+	float wheelRadius;
+	float trackWidth;			// between the left and right wheel contacts
+	float maxWheelSpeed;		// radians per second
+	float maxWheelAccel;		// radians per second per second, what the motors manage
+	float traction;				// friction coefficient times gravity, units per second per second
+	float rollingResistance;	// deceleration of a rolling robot, same units
+};
+
+class DiffDrive
+{
+public:
+	DiffDrive(const DiffDriveSettings &settings);
+
+	// New robots start at rest at the origin, the others keep their state
+	void SetRobotCount(int count);
+	int GetRobotCount() const { return (int)x.size(); }
+
+	// Takes the pose and wheel angles of robot, keeps the speeds unless stop
+	void ReadRobot(int index, const Robot &robot, bool stop = false);
+	// Writes pose and wheel angles back and updates forwards
+	void WriteRobot(int index, Robot &robot) const;
+
+	// Wheel speeds to ramp towards, radians per second, clamped to maxWheelSpeed. Or
+	// from driver input, turn and move from -1 to 1 as ApplyRobotAction() takes them;
+	// a full turn input alone turns on the spot at turnShare of the top wheel speed.
+	void SetWheelTargets(int index, float left, float right);
+	void SetDriveInput(int index, float turn, float move, float turnShare = 0.33f);
+
+	void Step(float dt, JobSystem *jobs = NULL);
+
+	// Forwards speed in units per second and turn rate in degrees per second,
+	// counter-clockwise positive like Robot::angle
+	float GetSpeed(int index) const { return 0.5f * (contactLeft[index] + contactRight[index]); }
+	float GetTurnRate(int index) const;
+	float GetMaxSpeed() const { return settings.wheelRadius * settings.maxWheelSpeed; }
+
+	// Whether any robot has wheels turning, a body moving or wheels asked to turn
+	bool IsMoving() const;
+
+	const DiffDriveSettings &GetSettings() const { return settings; }
+
+private:
+	void StepRange(int begin, int end, float dt);
+
+	DiffDriveSettings settings;
+
+	// Robots, structure of arrays. Contact speeds are how fast the ground moves
+	// under each side, the wheel rims match them unless a wheel slips.
+	std::vector<float> x, z;
+	std::vector<float> heading;					// degrees
+	std::vector<float> wheelLeft, wheelRight;	// radians per second
+	std::vector<float> targetLeft, targetRight;
+	std::vector<float> contactLeft, contactRight;
+	std::vector<float> wheelAngleLeft, wheelAngleRight;		// degrees
+};
+
+// numRobots robots each with a random drive input that changes now and then, stepped
+// numSteps times at 100 Hz. Prints time per step and returns robots stepped per second.
+double BenchmarkDiffDrive(int numRobots, int numSteps, JobSystem *jobs = NULL);
+
+#endif	//DIFFDRIVE_H
@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "FastTrig.h"
+
+// SSE2 is always there on x64 and the default for 32-bit builds
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FASTTRIG_SSE 1
+#include <emmintrin.h>
+#endif
+
+// AVX is compiled in on x86 and only used when the CPU and OS support it. GCC and clang
+// need the target attribute to accept the intrinsics outside an -mavx build.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define FASTTRIG_AVX 1
+#define FASTTRIG_AVX_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define FASTTRIG_AVX 1
+#define FASTTRIG_AVX_TARGET __attribute__((target("avx")))
+#include <immintrin.h>
+#endif
+
+static const float RadiansToQuadrants = 0.63661977236758134f;
+static const float DegreesToQuadrants = 1.0f / 90.0f;
+static const float DegreesToRadians = 0.017453292519943296f;
+
+
+static void SinCosScalar(const float *angles, float *sines, float *cosines, int count, bool degrees)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (degrees)
+			FastSinCosDegrees(angles[i], sines[i], cosines[i]);
+		else
+			FastSinCos(angles[i], sines[i], cosines[i]);
+	}
+}
+
+#ifdef FASTTRIG_SSE
+static void SinCosSse(const float *angles, float *sines, float *cosines, int count, bool degrees)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128i intOne = _mm_set1_epi32(1);
+	const __m128i intTwo = _mm_set1_epi32(2);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(angles + i);
+
+		// Nearest quadrant; conversion rounds to nearest, same as floor(x + 0.5) but at ties
+		__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(degrees ? DegreesToQuadrants : RadiansToQuadrants)));
+		__m128 qf = _mm_cvtepi32_ps(q);
+		__m128 r;
+		if (degrees)
+			r = _mm_mul_ps(_mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(90.0f))), _mm_set1_ps(DegreesToRadians));
+		else
+		{
+			r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(1.5703125f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(4.837512969970703125e-4f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(7.54978995489188216e-8f)));
+		}
+
+		__m128 r2 = _mm_mul_ps(r, r);
+		__m128 s = _mm_add_ps(_mm_set1_ps(8.3321608736e-3f), _mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)));
+		s = _mm_add_ps(_mm_set1_ps(-1.6666654611e-1f), _mm_mul_ps(r2, s));
+		s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+		__m128 c = _mm_add_ps(_mm_set1_ps(-1.388731625493765e-3f), _mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)));
+		c = _mm_add_ps(_mm_set1_ps(4.166664568298827e-2f), _mm_mul_ps(r2, c));
+		c = _mm_add_ps(_mm_sub_ps(one, _mm_mul_ps(half, r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), c));
+
+		// Odd quadrants swap sine and cosine, quadrants 2 and 3 negate the sine, 1 and 2 the cosine
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, intOne), intOne));
+		__m128 sine = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+		__m128 cosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+		__m128i sineSign = _mm_slli_epi32(_mm_and_si128(q, intTwo), 30);
+		__m128i cosineSign = _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, intOne), intTwo), 30);
+		_mm_storeu_ps(sines + i, _mm_xor_ps(sine, _mm_castsi128_ps(sineSign)));
+		_mm_storeu_ps(cosines + i, _mm_xor_ps(cosine, _mm_castsi128_ps(cosineSign)));
+	}
+	SinCosScalar(angles + i, sines + i, cosines + i, count - i, degrees);
+}
+#endif
+
+#ifdef FASTTRIG_AVX
+// AVX has no 256-bit integer operations, the quadrant bits are worked out per 128-bit half
+FASTTRIG_AVX_TARGET
+static void SinCosAvx(const float *angles, float *sines, float *cosines, int count, bool degrees)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m128i intOne = _mm_set1_epi32(1);
+	const __m128i intTwo = _mm_set1_epi32(2);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(angles + i);
+		__m256 qf = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(degrees ? DegreesToQuadrants : RadiansToQuadrants)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 r;
+		if (degrees)
+			r = _mm256_mul_ps(_mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(90.0f))), _mm256_set1_ps(DegreesToRadians));
+		else
+		{
+			r = _mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(1.5703125f)));
+			r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(4.837512969970703125e-4f)));
+			r = _mm256_sub_ps(r, _mm256_mul_ps(qf, _mm256_set1_ps(7.54978995489188216e-8f)));
+		}
+
+		__m256 r2 = _mm256_mul_ps(r, r);
+		__m256 s = _mm256_add_ps(_mm256_set1_ps(8.3321608736e-3f), _mm256_mul_ps(r2, _mm256_set1_ps(-1.9515295891e-4f)));
+		s = _mm256_add_ps(_mm256_set1_ps(-1.6666654611e-1f), _mm256_mul_ps(r2, s));
+		s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), s));
+		__m256 c = _mm256_add_ps(_mm256_set1_ps(-1.388731625493765e-3f), _mm256_mul_ps(r2, _mm256_set1_ps(2.443315711809948e-5f)));
+		c = _mm256_add_ps(_mm256_set1_ps(4.166664568298827e-2f), _mm256_mul_ps(r2, c));
+		c = _mm256_add_ps(_mm256_sub_ps(one, _mm256_mul_ps(half, r2)), _mm256_mul_ps(_mm256_mul_ps(r2, r2), c));
+
+		// Quadrant bits with SSE2 integer operations on each half
+		__m256i q = _mm256_cvtps_epi32(qf);
+		__m128i halves[2] = { _mm256_castsi256_si128(q), _mm256_extractf128_si256(q, 1) };
+		__m128i swapHalves[2], sineHalves[2], cosineHalves[2];
+		for (int h = 0; h < 2; h++)
+		{
+			swapHalves[h] = _mm_cmpeq_epi32(_mm_and_si128(halves[h], intOne), intOne);
+			sineHalves[h] = _mm_slli_epi32(_mm_and_si128(halves[h], intTwo), 30);
+			cosineHalves[h] = _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(halves[h], intOne), intTwo), 30);
+		}
+		__m256 swap = _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(swapHalves[0]), swapHalves[1], 1));
+		__m256 sineSign = _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(sineHalves[0]), sineHalves[1], 1));
+		__m256 cosineSign = _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(cosineHalves[0]), cosineHalves[1], 1));
+
+		__m256 sine = _mm256_blendv_ps(s, c, swap);
+		__m256 cosine = _mm256_blendv_ps(c, s, swap);
+		_mm256_storeu_ps(sines + i, _mm256_xor_ps(sine, sineSign));
+		_mm256_storeu_ps(cosines + i, _mm256_xor_ps(cosine, cosineSign));
+	}
+#ifdef FASTTRIG_SSE
+	SinCosSse(angles + i, sines + i, cosines + i, count - i, degrees);
+#else
+	SinCosScalar(angles + i, sines + i, cosines + i, count - i, degrees);
+#endif
+}
+
+static bool CpuHasAvx()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osSaves = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	return osSaves && avx && (_xgetbv(0) & 6) == 6;
+#else
+	return __builtin_cpu_supports("avx") != 0;
+#endif
+}
+#endif
+
+typedef void (*SinCosFunction)(const float *angles, float *sines, float *cosines, int count, bool degrees);
+
+static SinCosFunction PickSinCos()
+{
+#ifdef FASTTRIG_AVX
+	if (CpuHasAvx())
+		return SinCosAvx;
+#endif
+#ifdef FASTTRIG_SSE
+	return SinCosSse;
+#else
+	return SinCosScalar;
+#endif
+}
+
+static SinCosFunction BatchSinCos()
+{
+	static const SinCosFunction function = PickSinCos();
+	return function;
+}
+
+void SinCosBatch(const float *radians, float *sines, float *cosines, int count)
+{
+	BatchSinCos()(radians, sines, cosines, count, false);
+}
+
+void SinCosDegreesBatch(const float *degrees, float *sines, float *cosines, int count)
+{
+	BatchSinCos()(degrees, sines, cosines, count, true);
+}
+
+const char *GetFastTrigPath()
+{
+#ifdef FASTTRIG_AVX
+	if (BatchSinCos() == SinCosAvx)
+		return "AVX";
+#endif
+#ifdef FASTTRIG_SSE
+	if (BatchSinCos() == SinCosSse)
+		return "SSE2";
+#endif
+	return "scalar";
+}
+
+
+double MeasureFastTrigError()
+{
+	struct Path
+	{
+		const char *name;
+		SinCosFunction function;
+	};
+	Path paths[3];
+	int numPaths = 0;
+	paths[numPaths].name = "scalar";
+	paths[numPaths++].function = SinCosScalar;
+#ifdef FASTTRIG_SSE
+	paths[numPaths].name = "SSE2";
+	paths[numPaths++].function = SinCosSse;
+#endif
+#ifdef FASTTRIG_AVX
+	if (CpuHasAvx())
+	{
+		paths[numPaths].name = "AVX";
+		paths[numPaths++].function = SinCosAvx;
+	}
+#endif
+
+	// Dense near zero where headings live, sparser out to the stated limits
+	const int count = 1 << 20;
+	std::vector<float> radians(count), degrees(count), sines(count), cosines(count);
+	for (int i = 0; i < count; i++)
+	{
+		float t = (float)i / (count - 1);
+		radians[i] = i < count / 2 ? (t * 4.0f - 1.0f) * 10.0f : (t * 2.0f - 1.0f) * 8192.0f;
+		degrees[i] = i < count / 2 ? (t * 4.0f - 1.0f) * 720.0f : (t * 2.0f - 1.0f) * 2.0e6f;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	double worst = 0.0;
+	for (int p = 0; p < numPaths; p++)
+	{
+		double error = 0.0;
+		double seconds = 0.0;
+		for (int unit = 0; unit < 2; unit++)
+		{
+			const std::vector<float> &angles = unit == 0 ? radians : degrees;
+			Clock::time_point start = Clock::now();
+			paths[p].function(&angles[0], &sines[0], &cosines[0], count, unit == 1);
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			for (int i = 0; i < count; i++)
+			{
+				double angle = unit == 0 ? (double)angles[i] : fmod((double)angles[i], 360.0) * (3.14159265358979323846 / 180.0);
+				double sineError = fabs(sines[i] - sin(angle));
+				double cosineError = fabs(cosines[i] - cos(angle));
+				error = sineError > error ? sineError : error;
+				error = cosineError > error ? cosineError : error;
+			}
+		}
+		printf("FastTrig %-6s max error %.3g, %.0f M sincos/s\n", paths[p].name, error, 2.0 * count / seconds * 1e-6);
+		worst = error > worst ? error : worst;
+	}
+
+	// The C library for comparison
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		sines[i] = sinf(radians[i]);
+		cosines[i] = cosf(radians[i]);
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	printf("sinf/cosf        %.0f M sincos/s, batches use %s\n", count / seconds * 1e-6, GetFastTrigPath());
+	printf("FastTrig bound %.3g: %s\n", FastTrigMaxError, worst <= FastTrigMaxError ? "met" : "EXCEEDED");
+	return worst;
+}
@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	FastTrig.h
+//	Single precision sine and cosine together, from one range reduction and two
+//	short polynomials, for the many headings, wheel and debris angles updated every
+//	tick. Scalar versions are inline; the batch versions run 4 (SSE2) or 8 (AVX,
+//	picked at run time) angles at once.
+//
+//	Accuracy: absolute error below 2.5e-7 against double precision sin/cos for
+//	|radians| <= 8192 and |degrees| <= 2e6, which covers any angle the game
+//	accumulates. MeasureFastTrigError() checks this bound for every path.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef FASTTRIG_H
+#define FASTTRIG_H
+
+#include <math.h>
+
+// Stated bound, see above
+const float FastTrigMaxError = 2.5e-7f;
+
+// sin and cos of r for |r| <= pi/4
+inline void FastSinCosKernel(float r, float &s, float &c)
+{
+	float r2 = r * r;
+	s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+	c = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+}
+
+// Quadrant q of a reduced angle: rotate (sin r, cos r) by q * 90 degrees
+inline void FastSinCosQuadrant(int q, float s, float c, float &sine, float &cosine)
+{
+	switch (q & 3)
+	{
+	case 0: sine = s; cosine = c; break;
+	case 1: sine = c; cosine = -s; break;
+	case 2: sine = -s; cosine = -c; break;
+	default: sine = -c; cosine = s; break;
+	}
+}
+
+inline void FastSinCos(float radians, float &sine, float &cosine)
+{
+	// pi/2 in three parts, so q * part is exact for the first two
+	float qf = floorf(radians * 0.63661977236758134f + 0.5f);
+	float r = ((radians - qf * 1.5703125f) - qf * 4.837512969970703125e-4f) - qf * 7.54978995489188216e-8f;
+	float s, c;
+	FastSinCosKernel(r, s, c);
+	FastSinCosQuadrant((int)qf, s, c, sine, cosine);
+}
+
+// Degrees reduce exactly by whole quarter turns, so large accumulated angles stay accurate
+inline void FastSinCosDegrees(float degrees, float &sine, float &cosine)
+{
+	float qf = floorf(degrees * (1.0f / 90.0f) + 0.5f);
+	float r = (degrees - qf * 90.0f) * 0.017453292519943296f;
+	float s, c;
+	FastSinCosKernel(r, s, c);
+	FastSinCosQuadrant((int)qf, s, c, sine, cosine);
+}
+
+// count angles at once; sines and cosines may not overlap angles
+void SinCosBatch(const float *radians, float *sines, float *cosines, int count);
+void SinCosDegreesBatch(const float *degrees, float *sines, float *cosines, int count);
+
+// Which batch path runs on this machine: "AVX", "SSE2" or "scalar"
+const char *GetFastTrigPath();
+
+// Largest absolute error of every path over a dense sweep of angles, in radians and degrees,
+// against double precision. Prints it with the throughput of each path and returns the error.
+double MeasureFastTrigError();
+
+#endif	//FASTTRIG_H
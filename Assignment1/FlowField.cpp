@@ -0,0 +1,455 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "JobSystem.h"
+#include "NavGrid.h"
+#include "FlowField.h"
+
+static const float FlowUnreachable = 1e30f;
+static const float FlowTolerance = 1e-4f;		// in cells, smaller improvements end a sweep
+static const int FlowMaxPasses = 64;			// sweeps of one tile per round, a safety net
+
+enum FlowSide
+{
+	FlowLeft = 1,
+	FlowRight = 2,
+	FlowBack = 4,		// towards -z
+	FlowFront = 8
+};
+
+// Arrival time at a cell from its cheapest neighbours along x (a) and along z (b),
+// first-order upwind with unit cells
+static float SolveEikonal(float a, float b)
+{
+	if (a > b)
+		std::swap(a, b);
+	if (a >= FlowUnreachable)
+		return FlowUnreachable;
+	if (b - a >= 1.0f)
+		return a + 1.0f;
+	return 0.5f * (a + b + sqrtf(2.0f - (b - a) * (b - a)));
+}
+
+int FlowField::Cell(float x, float z) const
+{
+	int cx = (int)floorf((x - grid->GetMinX()) / grid->GetCellSize());
+	int cz = (int)floorf((z - grid->GetMinZ()) / grid->GetCellSize());
+	if (cx < 0 || cz < 0 || cx >= grid->GetWidth() || cz >= grid->GetHeight())
+		return -1;
+	return cz * grid->GetWidth() + cx;
+}
+
+bool FlowField::Sample(float x, float z, float &dirX, float &dirZ) const
+{
+	int cell = Cell(x, z);
+	if (cell < 0 || (dir[2 * cell] == 0 && dir[2 * cell + 1] == 0))
+		return false;
+	dirX = dir[2 * cell] * (1.0f / 127.0f);
+	dirZ = dir[2 * cell + 1] * (1.0f / 127.0f);
+	return true;
+}
+
+float FlowField::GetDistance(float x, float z) const
+{
+	int cell = Cell(x, z);
+	if (cell < 0 || cost[cell] >= FlowUnreachable)
+		return -1.0f;
+	return cost[cell] * grid->GetCellSize();
+}
+
+FlowFieldCache::FlowFieldCache(NavGrid &grid, int capacity) : grid(grid), useClock(0)
+{
+	// Never grows past capacity, so handed out pointers are not moved by a new field
+	fields.reserve(capacity > 0 ? capacity : 1);
+	memset(&stats, 0, sizeof(stats));
+}
+
+void FlowFieldCache::Clear()
+{
+	fields.clear();
+}
+
+const FlowField *FlowFieldCache::GetField(float goalX, float goalZ, JobSystem *jobs)
+{
+	stats.requests++;
+	int goalCell = grid.NearestWalkableCell(goalX, goalZ);
+	if (goalCell < 0)
+		return NULL;
+	grid.Update();
+
+	FlowField *field = NULL;
+	for (size_t i = 0; i < fields.size() && !field; i++)
+	{
+		if (fields[i].goalCell == goalCell)
+			field = &fields[i];
+	}
+
+	bool full = true;
+	if (field)
+	{
+		if (field->stamp == grid.GetChangeCounter())
+		{
+			stats.cacheHits++;
+			field->lastUse = ++useClock;
+			return field;
+		}
+
+		// Only removed blockers: the old distances are upper bounds to sweep down from
+		full = false;
+		for (int i = 0; i < grid.GetClustersX() * grid.GetClustersZ() && !full; i++)
+			full = grid.GetClusterBlockedStamp(i) > field->stamp;
+	}
+	else if (fields.size() < fields.capacity())
+	{
+		fields.push_back(FlowField());
+		field = &fields.back();
+	}
+	else
+	{
+		field = &fields[0];
+		for (size_t i = 1; i < fields.size(); i++)
+		{
+			if (fields[i].lastUse < field->lastUse)
+				field = &fields[i];
+		}
+	}
+
+	field->grid = &grid;
+	field->goalCell = goalCell;
+	field->lastUse = ++useClock;
+	Solve(*field, full, jobs);
+	field->stamp = grid.GetChangeCounter();
+	return field;
+}
+
+// Sweep active tiles in rounds until no border value changes. Tiles of one colour share
+// no edge, and a sweep only reads the cells across its tile's edges, so each colour's
+// tiles run in parallel without locks.
+void FlowFieldCache::Solve(FlowField &field, bool full, JobSystem *jobs)
+{
+	int tilesX = grid.GetClustersX(), tilesZ = grid.GetClustersZ();
+	int numTiles = tilesX * tilesZ;
+	active.assign(numTiles, 0);
+	touched.assign(numTiles, 0);
+
+	if (full)
+	{
+		size_t cells = (size_t)grid.GetWidth() * grid.GetHeight();
+		field.cost.assign(cells, FlowUnreachable);
+		field.dir.assign(2 * cells, 0);
+		field.cost[field.goalCell] = 0.0f;
+		int gx = field.goalCell % grid.GetWidth(), gz = field.goalCell / grid.GetWidth();
+		active[(gz / NavClusterSize) * tilesX + gx / NavClusterSize] = 1;
+		stats.fullSolves++;
+	}
+	else
+	{
+		for (int i = 0; i < numTiles; i++)
+			active[i] = grid.GetClusterChangedStamp(i) > field.stamp;
+		stats.partialSolves++;
+	}
+
+	bool any = true;
+	while (any)
+	{
+		any = false;
+		for (int colour = 0; colour < 2; colour++)
+		{
+			round.clear();
+			for (int i = 0; i < numTiles; i++)
+			{
+				if (active[i] && ((i % tilesX + i / tilesX) & 1) == colour)
+				{
+					round.push_back(i);
+					active[i] = 0;
+				}
+			}
+			if (round.empty())
+				continue;
+			any = true;
+
+			roundSides.assign(round.size(), 0);
+			auto body = [this, &field](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+					SweepTile(field, round[i], roundSides[i]);
+			};
+			if (jobs && round.size() > 1)
+				jobs->ParallelFor((uint32_t)round.size(), 1, body);
+			else
+				body(0, (uint32_t)round.size());
+			stats.tileSweeps += round.size();
+
+			for (size_t r = 0; r < round.size(); r++)
+			{
+				int tile = round[r], tx = tile % tilesX, tz = tile / tilesX;
+				touched[tile] = 1;
+				if ((roundSides[r] & FlowLeft) && tx > 0)
+					active[tile - 1] = 1;
+				if ((roundSides[r] & FlowRight) && tx + 1 < tilesX)
+					active[tile + 1] = 1;
+				if ((roundSides[r] & FlowBack) && tz > 0)
+					active[tile - tilesX] = 1;
+				if ((roundSides[r] & FlowFront) && tz + 1 < tilesZ)
+					active[tile + tilesX] = 1;
+			}
+		}
+	}
+
+	// Directions along a tile's edges depend on the tiles beside it
+	round.clear();
+	for (int i = 0; i < numTiles; i++)
+	{
+		int tx = i % tilesX, tz = i / tilesX;
+		if (touched[i] || (tx > 0 && touched[i - 1]) || (tx + 1 < tilesX && touched[i + 1])
+			|| (tz > 0 && touched[i - tilesX]) || (tz + 1 < tilesZ && touched[i + tilesX]))
+			round.push_back(i);
+	}
+	auto body = [this, &field](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			UpdateDirections(field, round[i]);
+	};
+	if (jobs && round.size() > 1)
+		jobs->ParallelFor((uint32_t)round.size(), 8, body);
+	else
+		body(0, (uint32_t)round.size());
+}
+
+// Fast sweeping over one tile, in all four diagonal orders until nothing improves.
+// The tile is copied out with a ring of its neighbours' cells, blocked cells and the
+// ring never change, so the sweeps need no bounds or walkability checks. The ring's
+// corners belong to diagonal tiles that may be sweeping at the same time and the
+// four-neighbour stencil never reads them, so they are left unreachable.
+// sidesChanged gets a FlowSide bit for every edge with a cell that improved.
+bool FlowFieldCache::SweepTile(FlowField &field, int tile, int &sidesChanged) const
+{
+	const int pitch = NavClusterSize + 2;
+	int width = grid.GetWidth(), height = grid.GetHeight();
+	int x0 = (tile % grid.GetClustersX()) * NavClusterSize, z0 = (tile / grid.GetClustersX()) * NavClusterSize;
+	int sizeX = std::min(width, x0 + NavClusterSize) - x0, sizeZ = std::min(height, z0 + NavClusterSize) - z0;
+	float *cost = field.cost.data();
+
+	float local[pitch * pitch];
+	unsigned char open[pitch * pitch];
+	for (int lz = 0; lz < sizeZ + 2; lz++)
+	{
+		for (int lx = 0; lx < sizeX + 2; lx++)
+		{
+			int x = x0 + lx - 1, z = z0 + lz - 1;
+			bool corner = (lx == 0 || lx == sizeX + 1) && (lz == 0 || lz == sizeZ + 1);
+			bool inside = !corner && x >= 0 && z >= 0 && x < width && z < height;
+			local[lz * pitch + lx] = inside ? cost[z * width + x] : FlowUnreachable;
+			open[lz * pitch + lx] = lx > 0 && lz > 0 && lx <= sizeX && lz <= sizeZ && grid.IsCellWalkable(x, z)
+				&& z * width + x != field.goalCell;
+		}
+	}
+
+	bool changedAny = false;
+	for (int pass = 0; pass < FlowMaxPasses; pass++)
+	{
+		bool changed = false;
+		for (int order = 0; order < 4; order++)
+		{
+			int stepX = (order & 1) ? -1 : 1, stepZ = (order & 2) ? -pitch : pitch;
+			int startX = stepX > 0 ? 1 : sizeX, startZ = stepZ > 0 ? 1 : sizeZ;
+			for (int row = 0, i = startZ * pitch; row < sizeZ; row++, i += stepZ)
+			{
+				for (int column = 0, j = i + startX; column < sizeX; column++, j += stepX)
+				{
+					if (!open[j])
+						continue;
+					float t = SolveEikonal(std::min(local[j - 1], local[j + 1]), std::min(local[j - pitch], local[j + pitch]));
+					if (t + FlowTolerance < local[j])
+					{
+						local[j] = t;
+						changed = true;
+					}
+				}
+			}
+		}
+		changedAny = changedAny || changed;
+		if (!changed)
+			break;
+	}
+
+	sidesChanged = 0;
+	if (!changedAny)
+		return false;
+	for (int lz = 1; lz <= sizeZ; lz++)
+	{
+		for (int lx = 1; lx <= sizeX; lx++)
+		{
+			float &value = cost[(z0 + lz - 1) * width + x0 + lx - 1];
+			if (local[lz * pitch + lx] == value)
+				continue;
+			value = local[lz * pitch + lx];
+			sidesChanged |= (lx == 1 ? FlowLeft : 0) | (lx == sizeX ? FlowRight : 0)
+				| (lz == 1 ? FlowBack : 0) | (lz == sizeZ ? FlowFront : 0);
+		}
+	}
+	return true;
+}
+
+// Down the distance gradient, taken upwind along each axis. Where the gradient
+// vanishes, as it can at a ridge between two ways round an obstacle, towards the
+// cheapest of the eight neighbours.
+void FlowFieldCache::UpdateDirections(FlowField &field, int tile) const
+{
+	int width = grid.GetWidth(), height = grid.GetHeight();
+	int x0 = (tile % grid.GetClustersX()) * NavClusterSize, z0 = (tile / grid.GetClustersX()) * NavClusterSize;
+	int x1 = std::min(width, x0 + NavClusterSize), z1 = std::min(height, z0 + NavClusterSize);
+	const float *cost = field.cost.data();
+
+	for (int z = z0; z < z1; z++)
+	{
+		for (int x = x0; x < x1; x++)
+		{
+			int cell = z * width + x;
+			float c = cost[cell];
+			float vx = 0.0f, vz = 0.0f;
+			if (c < FlowUnreachable && cell != field.goalCell)
+			{
+				float left = x > 0 ? cost[cell - 1] : FlowUnreachable;
+				float right = x + 1 < width ? cost[cell + 1] : FlowUnreachable;
+				float back = z > 0 ? cost[cell - width] : FlowUnreachable;
+				float front = z + 1 < height ? cost[cell + width] : FlowUnreachable;
+				if (left < right && left < c)
+					vx = left - c;
+				else if (right < c)
+					vx = c - right;
+				if (back < front && back < c)
+					vz = back - c;
+				else if (front < c)
+					vz = c - front;
+
+				if (vx == 0.0f && vz == 0.0f)
+				{
+					float best = c;
+					for (int dz = -1; dz <= 1; dz++)
+					{
+						for (int dx = -1; dx <= 1; dx++)
+						{
+							int nx = x + dx, nz = z + dz;
+							if (nx < 0 || nz < 0 || nx >= width || nz >= height || cost[nz * width + nx] >= best)
+								continue;
+							best = cost[nz * width + nx];
+							vx = (float)dx;
+							vz = (float)dz;
+						}
+					}
+				}
+
+				float length = sqrtf(vx * vx + vz * vz);
+				if (length > 0.0f)
+				{
+					vx *= 127.0f / length;
+					vz *= 127.0f / length;
+				}
+			}
+			field.dir[2 * cell] = (int8_t)lrintf(vx);
+			field.dir[2 * cell + 1] = (int8_t)lrintf(vz);
+		}
+	}
+}
+
+static float RandomRange(float low, float high)
+{
+	return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
+
+double BenchmarkFlowFields(int numBots, int numTicks, float halfSize, JobSystem *jobs)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	srand(4321);
+
+	// The same kind of arena as BenchmarkNavGrid()
+	int numObstacles = (int)(4.0f * halfSize * halfSize / 400.0f);
+	std::vector<NavFootprint> obstacles(numObstacles);
+	for (int i = 0; i < numObstacles; i++)
+	{
+		NavFootprint &footprint = obstacles[i];
+		footprint.x = RandomRange(-halfSize, halfSize);
+		footprint.z = RandomRange(-halfSize, halfSize);
+		footprint.halfX = RandomRange(1.0f, 4.0f);
+		footprint.halfZ = RandomRange(1.0f, 4.0f);
+		footprint.angle = RandomRange(0.0f, 90.0f);
+	}
+	NavGrid grid;
+	grid.Build(-halfSize, -halfSize, halfSize, halfSize, 2.0f, 2.0f);
+	for (int i = 0; i < numObstacles; i++)
+		grid.AddBlocker(obstacles[i]);
+	grid.Update();
+
+	float targetX, targetZ;
+	do
+	{
+		targetX = RandomRange(-halfSize, halfSize);
+		targetZ = RandomRange(-halfSize, halfSize);
+	} while (!grid.IsWalkable(targetX, targetZ));
+
+	FlowFieldCache cache(grid);
+	Clock::time_point start = Clock::now();
+	const FlowField *field = cache.GetField(targetX, targetZ, jobs);
+	double solveSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	if (!field)
+		return 0.0;
+
+	// The whole swarm converges on the target, one lookup per bot per tick
+	std::vector<float> bots(numBots * 2);
+	for (int i = 0; i < numBots; i++)
+	{
+		do
+		{
+			bots[2 * i] = RandomRange(-halfSize, halfSize);
+			bots[2 * i + 1] = RandomRange(-halfSize, halfSize);
+		} while (!grid.IsWalkable(bots[2 * i], bots[2 * i + 1]));
+	}
+
+	int arrived = 0;
+	start = Clock::now();
+	for (int tick = 0; tick < numTicks; tick++)
+	{
+		field = cache.GetField(targetX, targetZ, jobs);
+		for (int i = 0; i < numBots; i++)
+		{
+			float dirX, dirZ;
+			if (field->Sample(bots[2 * i], bots[2 * i + 1], dirX, dirZ))
+			{
+				bots[2 * i] += 0.5f * dirX;
+				bots[2 * i + 1] += 0.5f * dirZ;
+			}
+		}
+	}
+	double steerSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	for (int i = 0; i < numBots; i++)
+	{
+		float distance = field->GetDistance(bots[2 * i], bots[2 * i + 1]);
+		arrived += distance >= 0.0f && distance < 4.0f;
+	}
+
+	// Obstacles destroyed one at a time, each followed by the field's update
+	int removals = numObstacles < 50 ? numObstacles : 50;
+	uint64_t sweepsBefore = cache.GetStats().tileSweeps;
+	start = Clock::now();
+	for (int i = 0; i < removals; i++)
+	{
+		grid.RemoveBlocker(obstacles[i]);
+		field = cache.GetField(targetX, targetZ, jobs);
+	}
+	double updateSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	uint64_t updateSweeps = cache.GetStats().tileSweeps - sweepsBefore;
+
+	double samplesPerSecond = (double)numBots * numTicks / (steerSeconds > 0.0 ? steerSeconds : 1e-9);
+	printf("Flow field benchmark: %dx%d cells, %d obstacles, %s\n", grid.GetWidth(), grid.GetHeight(), numObstacles,
+		jobs ? "parallel" : "single thread");
+	printf("  solve %.2f ms, %d bots x %d ticks: %.1f M samples/s, %d bots arrived\n", solveSeconds * 1000.0,
+		numBots, numTicks, samplesPerSecond / 1e6, arrived);
+	printf("  obstacle removed and field updated: %.3f ms, %.1f tile sweeps of %d tiles each\n",
+		removals ? updateSeconds * 1000.0 / removals : 0.0, removals ? (double)updateSweeps / removals : 0.0,
+		grid.GetClustersX() * grid.GetClustersZ());
+	return samplesPerSecond;
+}
@@ -0,0 +1,97 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	FlowField.h
+//	Steering for swarms that converge on one target. A flow field holds, for every
+//	cell of a NavGrid, the travel distance to the target and the direction to drive
+//	in, so any number of robots steer with one array lookup each instead of a path
+//	query each. Distances solve the eikonal equation (fast sweeping) tile by tile,
+//	tiles being the grid's clusters: the tiles of a checkerboard colour are swept in
+//	parallel, and a tile whose border values change wakes its neighbours.
+//
+//	FlowFieldCache keeps the fields of the most recent targets. When obstacles are
+//	only removed, a field is brought up to date by sweeping the changed clusters and
+//	whatever they wake, everything else keeps its values; a cell that became blocked
+//	can lengthen paths anywhere, so then the field is solved again from scratch.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class NavGrid;
+class JobSystem;
+
+class FlowField
+{
+public:
+	// Unit direction to drive in at (x, z). Returns false off the grid, at the target's
+	// cell and where the target cannot be reached.
+	bool Sample(float x, float z, float &dirX, float &dirZ) const;
+
+	// Travel distance in world units, negative where unreachable or off the grid
+	float GetDistance(float x, float z) const;
+
+	int GetGoalCell() const { return goalCell; }
+
+private:
+	friend class FlowFieldCache;
+
+	int Cell(float x, float z) const;
+
+	const NavGrid *grid;
+	int goalCell;
+	uint32_t stamp;				// grid change counter the field is up to date with
+	uint32_t lastUse;
+	std::vector<float> cost;	// in cells
+	std::vector<int8_t> dir;	// x and z per cell, scaled to 127
+};
+
+struct FlowFieldStats
+{
+	uint64_t requests;
+	uint64_t cacheHits;
+	uint64_t fullSolves;
+	uint64_t partialSolves;
+	uint64_t tileSweeps;
+};
+
+class FlowFieldCache
+{
+public:
+	FlowFieldCache(NavGrid &grid, int capacity = 8);
+
+	// Field leading to the walkable cell nearest (goalX, goalZ), solved or updated as
+	// needed, NULL if there is no walkable cell there. jobs may be NULL. The pointer
+	// stays valid until the next call.
+	const FlowField *GetField(float goalX, float goalZ, JobSystem *jobs);
+
+	// Drop every field, after the grid has been built again
+	void Clear();
+
+	const FlowFieldStats &GetStats() const { return stats; }
+
+private:
+	void Solve(FlowField &field, bool full, JobSystem *jobs);
+	bool SweepTile(FlowField &field, int tile, int &sidesChanged) const;
+	void UpdateDirections(FlowField &field, int tile) const;
+
+	NavGrid &grid;
+	std::vector<FlowField> fields;
+	uint32_t useClock;
+	FlowFieldStats stats;
+
+	// Tiles to sweep, and scratch for each sweep round
+	std::vector<char> active;
+	std::vector<char> touched;
+	std::vector<int> round;
+	std::vector<int> roundSides;
+};
+
+// numBots bots on a random arena of the given half size steer by one flow field for
+// numTicks ticks, then obstacles are destroyed one by one and the field updated.
+// Prints solve, update and sampling times and returns samples per second.
+double BenchmarkFlowFields(int numBots, int numTicks, float halfSize, JobSystem *jobs = NULL);
+
+#endif	//FLOWFIELD_H
@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "FrameArena.h"
+
+
+FrameArena::FrameArena(size_t capacity)
+{
+	// One up-front allocation, only grown between frames by Reserve()
+	base = (unsigned char*)malloc(capacity);
+	this->capacity = base ? capacity : 0;
+	offset = 0;
+	peak = 0;
+	overflowCount = 0;
+}
+
+FrameArena::~FrameArena()
+{
+	free(base);
+	base = NULL;
+}
+
+bool FrameArena::Reserve(size_t newCapacity)
+{
+	if (newCapacity <= capacity)
+		return true;
+	if (offset != 0)
+		return false;
+
+	unsigned char *grown = (unsigned char*)malloc(newCapacity);
+	if (!grown)
+		return false;
+	free(base);
+	base = grown;
+	capacity = newCapacity;
+	return true;
+}
+
+void *FrameArena::Allocate(size_t size, size_t alignment)
+{
+	// Align the absolute address, alignment must be a power of two
+	uintptr_t current = (uintptr_t)(base + offset);
+	uintptr_t aligned = (current + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+	size_t newOffset = (size_t)(aligned - (uintptr_t)base) + size;
+
+	if (newOffset > capacity)
+	{
+		overflowCount++;
+		return NULL;
+	}
+
+	offset = newOffset;
+	if (offset > peak)
+		peak = offset;
+
+	return (void*)aligned;
+}
@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	FrameArena.h
+//	Linear (bump) allocator for data that only lives for a single frame, plus an
+//	STL-compatible allocator adapter so std containers can be built on top of it.
+//	Everything allocated from the arena is released at once by Reset().
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+class FrameArena
+{
+public:
+	typedef size_t Marker;
+
+	FrameArena(size_t capacity = 4 * 1024 * 1024);
+	~FrameArena();
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena &operator=(const FrameArena &) = delete;
+
+	// Grows the arena to at least capacity bytes. Only while nothing is allocated,
+	// between frames; returns false when the arena is in use or the memory is not there.
+	bool Reserve(size_t capacity);
+
+	// Returns NULL when the arena is exhausted, the overflow is counted so it can
+	// be reported and the capacity raised.
+	void *Allocate(size_t size, size_t alignment = alignof(max_align_t));
+
+	// Uninitialised storage for count objects of T. Intended for trivial types.
+	template <typename T>
+	T *AllocateArray(size_t count)
+	{
+		return (T*)Allocate(count * sizeof(T), alignof(T));
+	}
+
+	// Release everything allocated since the last Reset(), O(1)
+	void Reset()
+	{
+		offset = 0;
+	}
+
+	// Scoped sub-allocations: everything allocated after GetMarker() can be
+	// released early with Rewind()
+	Marker GetMarker() const { return offset; }
+	void Rewind(Marker marker)
+	{
+		if (marker <= offset)
+			offset = marker;
+	}
+
+	size_t GetUsed() const { return offset; }
+	size_t GetCapacity() const { return capacity; }
+	size_t GetPeak() const { return peak; }
+	unsigned int GetOverflowCount() const { return overflowCount; }
+
+private:
+	unsigned char *base;
+	size_t capacity;
+	size_t offset;
+	size_t peak;
+	unsigned int overflowCount;
+};
+
+// Allocator adapter for std containers. deallocate() is a no-op, memory goes back
+// to the arena when it is reset, so containers must not outlive the frame.
+template <typename T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameAllocator(FrameArena &arena) : arena(&arena)
+	{}
+
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U> &rhs) : arena(rhs.GetArena())
+	{}
+
+	T *allocate(size_t n)
+	{
+		void *p = arena->Allocate(n * sizeof(T), alignof(T));
+		if (!p)
+			throw std::bad_alloc();
+		return (T*)p;
+	}
+
+	void deallocate(T *, size_t)
+	{}
+
+	FrameArena *GetArena() const { return arena; }
+
+	template <typename U>
+	bool operator==(const FrameAllocator<U> &rhs) const { return arena == rhs.GetArena(); }
+	template <typename U>
+	bool operator!=(const FrameAllocator<U> &rhs) const { return arena != rhs.GetArena(); }
+
+private:
+	FrameArena *arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
+
+#endif	//FRAMEARENA_H
@@ -0,0 +1,386 @@
+#include <GL/glew.h>
+#include <gl/glut.h>
+#include <string.h>
+#include <chrono>
+#include "FrameCapture.h"
+
+
+FrameCapture::FrameCapture(int ringSize, int frameBuffers)
+{
+	this->ringSize = ringSize > 1 ? ringSize : 2;
+	numFrameBuffers = frameBuffers > 0 ? frameBuffers : 1;
+	capturing = false;
+	video = false;
+	width = height = 0;
+	fps = 60;
+	file = NULL;
+	nextSlot = 0;
+	frameNumber = 0;
+	lastVideoFrame = 0;
+	captured = 0;
+	dropped = 0;
+	captureSeconds = 0.0;
+	quit = false;
+	written = 0;
+	writeErrors = 0;
+}
+
+// Static destruction runs after the window and its context are gone
+FrameCapture::~FrameCapture()
+{
+	Finish();
+}
+
+bool FrameCapture::Start(const char *path, int width, int height, int fps, std::string &error)
+{
+	if (capturing)
+		Stop();
+
+	// The extension functions are only loaded once there is a context
+	static bool glewReady = false;
+	if (!glewReady)
+		glewReady = glewInit() == GLEW_OK;
+	if (!glewReady || !glGenBuffers || !glMapBuffer || !glFenceSync || !glClientWaitSync)
+	{
+		error = "frame capture needs pixel buffer objects and sync objects (OpenGL 3.2)";
+		return false;
+	}
+
+	this->path = path;
+	size_t length = this->path.size();
+	video = length >= 4 && this->path.compare(length - 4, 4, ".y4m") == 0;
+
+	// 4:2:0 chroma needs even dimensions
+	this->width = video ? width & ~1 : width;
+	this->height = video ? height & ~1 : height;
+	this->fps = fps > 0 ? fps : 60;
+	if (this->width <= 0 || this->height <= 0)
+	{
+		error = "nothing to capture in an empty window";
+		return false;
+	}
+
+	if (video)
+	{
+		file = fopen(path, "wb");
+		if (!file)
+		{
+			error = std::string("cannot create ") + path;
+			return false;
+		}
+		fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", this->width, this->height, this->fps);
+	}
+
+	size_t frameBytes = (size_t)this->width * this->height * 4;
+	slots.resize(ringSize);
+	for (int i = 0; i < ringSize; i++)
+	{
+		glGenBuffers(1, &slots[i].buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+		slots[i].fence = NULL;
+		slots[i].frame = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Everything the writer needs is allocated here, not per frame
+	pixels.resize(frameBytes * numFrameBuffers);
+	freeFrames.clear();
+	queuedFrames.clear();
+	freeFrames.reserve(numFrameBuffers);
+	queuedFrames.reserve(numFrameBuffers);
+	for (int i = numFrameBuffers - 1; i >= 0; i--)
+		freeFrames.push_back(i);
+	frameNumbers.assign(numFrameBuffers, 0);
+	size_t tgaBytes = 18 + (size_t)this->height * ((size_t)this->width * 3 + (this->width + 127) / 128) + 26;
+	scratch.resize(video ? frameBytes : tgaBytes);
+
+	nextSlot = 0;
+	frameNumber = 0;
+	lastVideoFrame = 0;
+	captured = 0;
+	dropped = 0;
+	captureSeconds = 0.0;
+	written = 0;
+	writeErrors = 0;
+	quit = false;
+	writer = std::thread(&FrameCapture::WriterMain, this);
+	capturing = true;
+	return true;
+}
+
+void FrameCapture::CaptureFrame()
+{
+	if (!capturing)
+		return;
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	frameNumber++;
+
+	// Hand over every readback the GPU has finished, oldest first, without waiting
+	for (int i = 0; i < ringSize; i++)
+	{
+		Slot &slot = slots[(nextSlot + i) % ringSize];
+		if (!slot.fence)
+			continue;
+		GLenum status = glClientWaitSync((GLsync)slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		Collect(slot);
+	}
+
+	// Start this frame's readback, unless the slot is still busy or the window changed size
+	Slot &slot = slots[nextSlot];
+	int windowWidth = glutGet(GLUT_WINDOW_WIDTH);
+	int windowHeight = glutGet(GLUT_WINDOW_HEIGHT);
+	bool sizeOk = video ? (windowWidth & ~1) == width && (windowHeight & ~1) == height
+		: windowWidth == width && windowHeight == height;
+	if (slot.fence || !sizeOk)
+		dropped++;
+	else
+	{
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadBuffer(GL_BACK);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.frame = frameNumber;
+		nextSlot = (nextSlot + 1) % ringSize;
+		captured++;
+	}
+
+	captureSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Copies a finished readback into a free frame buffer and queues it for the writer
+void FrameCapture::Collect(Slot &slot)
+{
+	int frame = -1;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!freeFrames.empty())
+		{
+			frame = freeFrames.back();
+			freeFrames.pop_back();
+		}
+	}
+
+	if (frame < 0)
+		dropped++;		// the writer is behind
+	else
+	{
+		size_t frameBytes = (size_t)width * height * 4;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		void *mapped = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+		bool ok = mapped != NULL;
+		if (ok)
+		{
+			memcpy(&pixels[frame * frameBytes], mapped, frameBytes);
+			ok = glUnmapBuffer(GL_PIXEL_PACK_BUFFER) == GL_TRUE;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (ok)
+			{
+				frameNumbers[frame] = slot.frame;
+				queuedFrames.push_back(frame);
+			}
+			else
+				freeFrames.push_back(frame);
+		}
+		if (ok)
+			wake.notify_one();
+		else
+			dropped++;
+	}
+
+	glDeleteSync((GLsync)slot.fence);
+	slot.fence = NULL;
+}
+
+void FrameCapture::Stop()
+{
+	if (!capturing)
+		return;
+
+	// Everything already read back still goes to disk
+	for (int i = 0; i < ringSize; i++)
+	{
+		Slot &slot = slots[(nextSlot + i) % ringSize];
+		if (slot.fence)
+		{
+			glClientWaitSync((GLsync)slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			Collect(slot);
+		}
+	}
+	for (int i = 0; i < ringSize; i++)
+		glDeleteBuffers(1, &slots[i].buffer);
+	Finish();
+}
+
+void FrameCapture::Finish()
+{
+	if (!capturing)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	writer.join();
+
+	if (file)
+	{
+		if (fclose(file) != 0)
+			writeErrors++;
+		file = NULL;
+	}
+	capturing = false;
+
+	printf("Capture %s: %u frames, %u written, %u dropped, %.2f ms per frame on the render thread\n",
+		path.c_str(), frameNumber, written.load(), GetDroppedFrames(), frameNumber ? 1000.0 * captureSeconds / frameNumber : 0.0);
+}
+
+void FrameCapture::WriterMain()
+{
+	size_t frameBytes = (size_t)width * height * 4;
+	for (;;)
+	{
+		int frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return quit || !queuedFrames.empty(); });
+			if (queuedFrames.empty())
+				return;		// quit and nothing left to write
+			frame = queuedFrames.front();
+			queuedFrames.erase(queuedFrames.begin());
+		}
+
+		if (WriteFrame(&pixels[frame * frameBytes], frameNumbers[frame]))
+			written++;
+		else
+			writeErrors++;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		freeFrames.push_back(frame);
+	}
+}
+
+bool FrameCapture::WriteFrame(const uint8_t *frame, uint32_t number)
+{
+	if (!video)
+		return WriteTga(frame, number);
+
+	// Repeat the last frame over the ones that were dropped, so the video keeps real time
+	if (lastVideoFrame != 0)
+	{
+		size_t bytes = (size_t)width * height * 3 / 2;
+		for (uint32_t gap = lastVideoFrame + 1; gap < number; gap++)
+		{
+			if (fwrite("FRAME\n", 1, 6, file) != 6 || fwrite(&scratch[0], 1, bytes, file) != bytes)
+				return false;
+		}
+	}
+	lastVideoFrame = number;
+	return WriteY4m(frame);
+}
+
+// BT.601 studio range, 2x2 chroma averaging. GL rows run bottom up, Y4M top down.
+bool FrameCapture::WriteY4m(const uint8_t *bgra)
+{
+	uint8_t *yPlane = &scratch[0];
+	uint8_t *uPlane = yPlane + width * height;
+	uint8_t *vPlane = uPlane + (width / 2) * (height / 2);
+	size_t stride = (size_t)width * 4;
+
+	for (int y = 0; y < height; y += 2)
+	{
+		const uint8_t *row0 = bgra + (height - 1 - y) * stride;
+		const uint8_t *row1 = row0 - stride;
+		uint8_t *y0 = yPlane + y * width;
+		uint8_t *y1 = y0 + width;
+		for (int x = 0; x < width; x += 2)
+		{
+			int sumR = 0, sumG = 0, sumB = 0;
+			const uint8_t *quad[4] = { row0 + x * 4, row0 + x * 4 + 4, row1 + x * 4, row1 + x * 4 + 4 };
+			uint8_t *luma[4] = { y0 + x, y0 + x + 1, y1 + x, y1 + x + 1 };
+			for (int k = 0; k < 4; k++)
+			{
+				int b = quad[k][0], g = quad[k][1], r = quad[k][2];
+				*luma[k] = (uint8_t)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+				sumR += r;
+				sumG += g;
+				sumB += b;
+			}
+			int r = sumR >> 2, g = sumG >> 2, b = sumB >> 2;
+			int c = (y / 2) * (width / 2) + x / 2;
+			uPlane[c] = (uint8_t)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+			vPlane[c] = (uint8_t)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+		}
+	}
+
+	size_t bytes = (size_t)width * height * 3 / 2;
+	return fwrite("FRAME\n", 1, 6, file) == 6 && fwrite(yPlane, 1, bytes, file) == bytes;
+}
+
+// 24-bit run-length encoded TGA, bottom-up like the GL rows, packets never cross a row
+bool FrameCapture::WriteTga(const uint8_t *bgra, uint32_t frame)
+{
+	uint8_t *out = &scratch[0];
+	memset(out, 0, 18);
+	out[2] = 10;							// RLE true colour
+	out[12] = (uint8_t)(width & 0xFF);
+	out[13] = (uint8_t)(width >> 8);
+	out[14] = (uint8_t)(height & 0xFF);
+	out[15] = (uint8_t)(height >> 8);
+	out[16] = 24;
+	size_t n = 18;
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t *row = bgra + (size_t)y * width * 4;
+		int x = 0;
+		while (x < width)
+		{
+			// Run of identical pixels, otherwise a literal packet up to the next run
+			int run = 1;
+			while (x + run < width && run < 128 && memcmp(row + (x + run) * 4, row + x * 4, 3) == 0)
+				run++;
+			if (run > 1)
+			{
+				out[n++] = (uint8_t)(0x80 | (run - 1));
+				memcpy(out + n, row + x * 4, 3);
+				n += 3;
+				x += run;
+				continue;
+			}
+
+			int literal = 1;
+			while (x + literal < width && literal < 128
+				&& !(x + literal + 1 < width && memcmp(row + (x + literal) * 4, row + (x + literal + 1) * 4, 3) == 0))
+				literal++;
+			out[n++] = (uint8_t)(literal - 1);
+			for (int k = 0; k < literal; k++, n += 3)
+				memcpy(out + n, row + (x + k) * 4, 3);
+			x += literal;
+		}
+	}
+
+	// TGA 2.0 footer
+	memset(out + n, 0, 8);
+	memcpy(out + n + 8, "TRUEVISION-XFILE.", 18);
+	n += 26;
+
+	char name[1024];
+	snprintf(name, sizeof(name), "%s_%06u.tga", path.c_str(), frame);
+	FILE *image = fopen(name, "wb");
+	if (!image)
+		return false;
+	bool ok = fwrite(out, 1, n, image) == n;
+	return fclose(image) == 0 && ok;
+}
@@ -0,0 +1,105 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	FrameCapture.h
+//	Records what the window shows without stalling the frame. Each frame is read
+//	back into one of a ring of pixel buffer objects, with a fence; the copy out of a
+//	PBO happens a few frames later, once its fence says the GPU is done, and the
+//	pixels go to a writer thread that encodes them to disk. Nothing on the GL
+//	thread ever waits: when the GPU or the writer falls behind the frame is dropped
+//	and counted instead.
+//
+//	Output is either a YUV4MPEG2 video (.y4m, plays in VLC and ffmpeg converts it
+//	to anything) or a numbered sequence of run-length compressed TGA images.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameCapture
+{
+public:
+	// ringSize PBOs in flight, frameBuffers frames queued for the writer at most
+	FrameCapture(int ringSize = 3, int frameBuffers = 8);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture &) = delete;
+	FrameCapture &operator=(const FrameCapture &) = delete;
+
+	// GL thread. A path ending in .y4m records video at fps, anything else is the
+	// prefix of prefix_000000.tga images. The capture size is fixed to width x height,
+	// frames of any other size are dropped. Returns false if the GL driver lacks
+	// pixel buffer objects or sync objects, or the output cannot be created.
+	bool Start(const char *path, int width, int height, int fps, std::string &error);
+
+	// GL thread, after the frame is drawn and before the buffers are swapped
+	void CaptureFrame();
+
+	// GL thread, with the context still current. Waits for the frames still in flight,
+	// then Finish().
+	void Stop();
+
+	// No GL calls, for exit paths where the context is already gone: frames still on
+	// the GPU are lost, the writer drains its queue, the file is closed and the counts
+	// are printed. Does nothing after Stop().
+	void Finish();
+
+	bool IsCapturing() const { return capturing; }
+
+	uint32_t GetCapturedFrames() const { return captured; }
+	uint32_t GetWrittenFrames() const { return written.load(); }
+	uint32_t GetDroppedFrames() const { return dropped + writeErrors.load(); }
+
+private:
+	struct Slot
+	{
+		unsigned int buffer;	// PBO
+		void *fence;			// GLsync, NULL while the slot is free
+		uint32_t frame;
+	};
+
+	void Collect(Slot &slot);
+	void WriterMain();
+	bool WriteFrame(const uint8_t *pixels, uint32_t frame);
+	bool WriteY4m(const uint8_t *pixels);
+	bool WriteTga(const uint8_t *pixels, uint32_t frame);
+
+	int ringSize;
+	int numFrameBuffers;
+	bool capturing;
+	bool video;
+	std::string path;
+	int width, height;
+	int fps;
+	FILE *file;						// video output, owned by the writer while capturing
+
+	std::vector<Slot> slots;
+	int nextSlot;
+	uint32_t frameNumber;
+	uint32_t captured;
+	uint32_t dropped;				// GPU not done yet, writer full, or wrong size
+	double captureSeconds;			// GL thread time spent in CaptureFrame()
+
+	// Frame buffers handed between the GL thread and the writer
+	std::vector<uint8_t> pixels;	// numFrameBuffers frames of width * height * 4 bytes
+	std::vector<int> freeFrames;
+	std::vector<int> queuedFrames;
+	std::vector<uint32_t> frameNumbers;
+	std::vector<uint8_t> scratch;	// writer only, one encoded frame
+	uint32_t lastVideoFrame;		// writer only, number of the last frame in the video, 0 before the first
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool quit;
+	std::thread writer;
+	std::atomic<uint32_t> written;
+	std::atomic<uint32_t> writeErrors;
+};
+
+#endif	//FRAMECAPTURE_H
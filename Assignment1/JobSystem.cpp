@@ -0,0 +1,139 @@
+#include "JobSystem.h"
+
+
+JobSystem::JobSystem(unsigned int workerCount)
+{
+	quit = false;
+	pendingJobs = 0;
+	rangeFunction = NULL;
+	rangeContext = NULL;
+	rangeCount = 0;
+	rangeGrain = 1;
+	rangeNext = 0;
+	rangeDone = 0;
+	rangeWorkers = 0;
+	rangeActive = false;
+
+	if (workerCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&JobSystem::WorkerMain, this));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void JobSystem::Submit(std::function<void()> job)
+{
+	pendingJobs++;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	wake.notify_one();
+}
+
+void JobSystem::RunRange(uint32_t count, uint32_t grain, RangeFunction function, void *context)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	// Not worth waking anybody
+	if (workers.empty() || count <= grain)
+	{
+		function(context, 0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> rangeLock(rangeMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		rangeFunction = function;
+		rangeContext = context;
+		rangeCount = count;
+		rangeGrain = grain;
+		rangeNext = 0;
+		rangeDone = 0;
+		rangeActive = true;
+	}
+	wake.notify_all();
+
+	// The caller works on the range too, then waits for chunks still in flight
+	while (WorkOnRange())
+		;
+	while (rangeDone.load() < count)
+		std::this_thread::yield();
+
+	// No worker may still be looking at this range once we return
+	rangeActive = false;
+	while (rangeWorkers.load() != 0)
+		std::this_thread::yield();
+}
+
+bool JobSystem::WorkOnRange()
+{
+	rangeWorkers++;
+	if (!rangeActive.load())
+	{
+		rangeWorkers--;
+		return false;
+	}
+
+	uint32_t begin = rangeNext.fetch_add(rangeGrain);
+	if (begin >= rangeCount)
+	{
+		rangeWorkers--;
+		return false;
+	}
+
+	uint32_t end = begin + rangeGrain < rangeCount ? begin + rangeGrain : rangeCount;
+	rangeFunction(rangeContext, begin, end);
+	rangeDone.fetch_add(end - begin);
+
+	rangeWorkers--;
+	return true;
+}
+
+void JobSystem::WorkerMain()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return quit || !jobs.empty() || rangeActive.load(); });
+
+			if (rangeActive.load())
+			{
+				lock.unlock();
+				if (!WorkOnRange())
+					std::this_thread::yield();
+				continue;
+			}
+
+			if (jobs.empty())
+				return;		// quit requested and nothing left to do
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job();
+		pendingJobs--;
+	}
+}
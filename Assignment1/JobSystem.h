@@ -0,0 +1,77 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	JobSystem.h
+//	Fixed set of worker threads shared by everything that runs off the main thread.
+//	Submit() queues fire-and-forget background jobs (file loading, mesh processing).
+//	ParallelFor() splits an index range across the workers and the calling thread and
+//	returns when the whole range is done; it does not allocate, so it can be used
+//	inside per-tick loops.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem
+{
+public:
+	// workerCount 0 uses one worker per hardware thread, minus the caller
+	JobSystem(unsigned int workerCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+
+	void Submit(std::function<void()> job);
+
+	// Calls body(begin, end) on disjoint chunks of [0, count), at most grain indices each
+	template <typename F>
+	void ParallelFor(uint32_t count, uint32_t grain, F &body)
+	{
+		RunRange(count, grain, &InvokeRange<F>, &body);
+	}
+
+	// Number of background jobs queued or running
+	unsigned int GetPendingJobs() const { return pendingJobs.load(); }
+	unsigned int GetWorkerCount() const { return (unsigned int)workers.size(); }
+
+private:
+	typedef void (*RangeFunction)(void *context, uint32_t begin, uint32_t end);
+
+	template <typename F>
+	static void InvokeRange(void *context, uint32_t begin, uint32_t end)
+	{
+		(*(F*)context)(begin, end);
+	}
+
+	void RunRange(uint32_t count, uint32_t grain, RangeFunction function, void *context);
+	bool WorkOnRange();
+	void WorkerMain();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::function<void()> > jobs;
+	std::atomic<unsigned int> pendingJobs;
+	bool quit;
+
+	// The range currently being split by ParallelFor(), one at a time
+	std::mutex rangeMutex;
+	RangeFunction rangeFunction;
+	void *rangeContext;
+	uint32_t rangeCount;
+	uint32_t rangeGrain;
+	std::atomic<uint32_t> rangeNext;
+	std::atomic<uint32_t> rangeDone;
+	std::atomic<unsigned int> rangeWorkers;
+	std::atomic<bool> rangeActive;
+};
+
+#endif	//JOBSYSTEM_H
@@ -0,0 +1,38 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	MappedFile.h
+//	Whole-file memory mapping. The view is copy-on-write: callers may modify the
+//	mapped bytes (e.g. recomputing normals in place) without touching the file.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Returns false if the file does not exist, is empty or cannot be mapped
+	bool Open(const char *path);
+	void Close();
+
+	bool IsOpen() const { return data != NULL; }
+	unsigned char *GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	unsigned char *data;
+	size_t size;
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#endif
+};
+
+#endif	//MAPPEDFILE_H
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "MappedFile.h"
+#include "MeshCache.h"
+
+static const uint32_t MeshCacheAlignment = 64;
+
+uint64_t MeshCacheHash(uint64_t hash, const void *data, size_t size)
+{
+	// FNV-1a
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t MeshCacheKey(int meshSize, const VECTOR3D & origin, double meshLength, double meshWidth,
+	const VECTOR3D & dir1, const VECTOR3D & dir2)
+{
+	uint64_t hash = MeshCacheHashSeed;
+	hash = MeshCacheHash(hash, &MeshCacheVersion, sizeof(MeshCacheVersion));
+	hash = MeshCacheHash(hash, &meshSize, sizeof(meshSize));
+	hash = MeshCacheHash(hash, &origin.x, 3 * sizeof(float));
+	hash = MeshCacheHash(hash, &meshLength, sizeof(meshLength));
+	hash = MeshCacheHash(hash, &meshWidth, sizeof(meshWidth));
+	hash = MeshCacheHash(hash, &dir1.x, 3 * sizeof(float));
+	hash = MeshCacheHash(hash, &dir2.x, 3 * sizeof(float));
+	return hash;
+}
+
+void MeshCachePath(const char *dir, uint64_t key, char *path, size_t pathSize)
+{
+	snprintf(path, pathSize, "%s/quadmesh_%016llx.bin", dir, (unsigned long long)key);
+}
+
+static uint32_t AlignUp(uint32_t offset)
+{
+	return (offset + MeshCacheAlignment - 1) & ~(MeshCacheAlignment - 1);
+}
+
+void CreateMeshCacheDirectory(const char *path)
+{
+	char dir[512];
+	strncpy(dir, path, sizeof(dir) - 1);
+	dir[sizeof(dir) - 1] = '\0';
+
+	char *slash = strrchr(dir, '/');
+	if (!slash)
+		return;
+	*slash = '\0';
+#ifdef _WIN32
+	_mkdir(dir);
+#else
+	mkdir(dir, 0755);
+#endif
+}
+
+bool WriteMeshCache(const char *path, uint64_t key, int meshSize, const float *vertexData, int numVertices,
+	const uint32_t *quadIndices, int numQuads)
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "QMSH", 4);
+	header.version = MeshCacheVersion;
+	header.key = key;
+	header.meshSize = (uint32_t)meshSize;
+	header.numVertices = (uint32_t)numVertices;
+	header.numQuads = (uint32_t)numQuads;
+	header.vertexOffset = AlignUp(sizeof(MeshCacheHeader));
+	header.indexOffset = AlignUp(header.vertexOffset + (uint32_t)numVertices * 6 * sizeof(float));
+
+	CreateMeshCacheDirectory(path);
+
+	// Write to a temporary name first so a crash never leaves a truncated cache behind
+	char tempPath[512];
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+	FILE *file = fopen(tempPath, "wb");
+	if (!file)
+		return false;
+
+	static const unsigned char padding[MeshCacheAlignment] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(padding, 1, header.vertexOffset - sizeof(header), file) == header.vertexOffset - sizeof(header);
+	ok = ok && fwrite(vertexData, 6 * sizeof(float), numVertices, file) == (size_t)numVertices;
+	size_t vertexEnd = header.vertexOffset + (size_t)numVertices * 6 * sizeof(float);
+	ok = ok && fwrite(padding, 1, header.indexOffset - vertexEnd, file) == header.indexOffset - vertexEnd;
+	ok = ok && fwrite(quadIndices, 4 * sizeof(uint32_t), numQuads, file) == (size_t)numQuads;
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+	{
+		remove(tempPath);
+		return false;
+	}
+
+	remove(path);
+	return rename(tempPath, path) == 0;
+}
+
+const MeshCacheHeader *ValidateMeshCache(const MappedFile &file, uint64_t key)
+{
+	if (!file.IsOpen() || file.GetSize() < sizeof(MeshCacheHeader))
+		return NULL;
+
+	const MeshCacheHeader *header = (const MeshCacheHeader*)file.GetData();
+	if (memcmp(header->magic, "QMSH", 4) != 0 || header->version != MeshCacheVersion || header->key != key)
+		return NULL;
+
+	uint64_t vertexEnd = (uint64_t)header->vertexOffset + (uint64_t)header->numVertices * 6 * sizeof(float);
+	uint64_t indexEnd = (uint64_t)header->indexOffset + (uint64_t)header->numQuads * 4 * sizeof(uint32_t);
+	if (header->vertexOffset % MeshCacheAlignment != 0 || header->indexOffset % MeshCacheAlignment != 0
+		|| vertexEnd > header->indexOffset || indexEnd > file.GetSize())
+		return NULL;
+
+	const uint32_t *indices = (const uint32_t*)(file.GetData() + header->indexOffset);
+	for (uint32_t i = 0; i < header->numQuads * 4; i++)
+	{
+		if (indices[i] >= header->numVertices)
+			return NULL;
+	}
+
+	return header;
+}
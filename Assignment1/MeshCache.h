@@ -0,0 +1,55 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	MeshCache.h
+//	Versioned binary cache for generated quad meshes. A cache file holds the packed
+//	vertex array (position + normal, 6 floats per vertex) and the quad index array
+//	exactly as they sit in memory, so a loaded mesh can point straight into the
+//	mapped file. The key is a hash of the InitMesh() parameters, a changed origin,
+//	size or direction produces a different file name and the old file is ignored.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "VECTOR3D.h"
+
+class MappedFile;
+
+// Bump whenever the layout or the mesh generation changes
+const uint32_t MeshCacheVersion = 1;
+
+struct MeshCacheHeader
+{
+	char magic[4];			// "QMSH"
+	uint32_t version;
+	uint64_t key;
+	uint32_t meshSize;
+	uint32_t numVertices;
+	uint32_t numQuads;
+	uint32_t vertexOffset;	// byte offset of the vertex block, 6 floats per vertex
+	uint32_t indexOffset;	// byte offset of the index block, 4 uint32 per quad
+	uint32_t reserved[5];
+};
+
+// FNV-1a over size bytes, continuing from hash; start from MeshCacheHashSeed
+const uint64_t MeshCacheHashSeed = 14695981039346656037ULL;
+uint64_t MeshCacheHash(uint64_t hash, const void *data, size_t size);
+
+uint64_t MeshCacheKey(int meshSize, const VECTOR3D & origin, double meshLength, double meshWidth,
+	const VECTOR3D & dir1, const VECTOR3D & dir2);
+
+// Writes "<dir>/quadmesh_<key>.bin" into path
+void MeshCachePath(const char *dir, uint64_t key, char *path, size_t pathSize);
+
+// Makes the directory path is in, if it is missing
+void CreateMeshCacheDirectory(const char *path);
+
+bool WriteMeshCache(const char *path, uint64_t key, int meshSize, const float *vertexData, int numVertices,
+	const uint32_t *quadIndices, int numQuads);
+
+// Checks magic, version, key and bounds of a mapped cache file. Returns the header
+// (pointing into the mapping) or NULL if the file is stale or corrupt.
+const MeshCacheHeader *ValidateMeshCache(const MappedFile &file, uint64_t key);
+
+#endif	//MESHCACHE_H
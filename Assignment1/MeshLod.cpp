@@ -0,0 +1,717 @@
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <gl/gl.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <queue>
+#include <thread>
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MeshLod.h"
+
+// Open edges weigh this much more than the triangles next to them
+static const double SimplifyBoundaryWeight = 1000.0;
+// Largest angle between the normals of two vertices joined, or a triangle turned by a collapse
+static const float SimplifyMaxNormalDegrees = 45.0f;
+// Shorter edges go first among equally good collapses, so flat areas thin out evenly
+// instead of one vertex swallowing a growing fan
+static const double SimplifyEdgeLengthWeight = 1e-5;
+
+// Symmetric 4x4 matrix of a sum of squared plane distances, upper triangle by rows
+struct Quadric
+{
+	double m[10];
+};
+
+static void AddPlane(Quadric &q, const double normal[3], double d, double weight)
+{
+	double a = normal[0], b = normal[1], c = normal[2];
+	q.m[0] += weight * a * a; q.m[1] += weight * a * b; q.m[2] += weight * a * c; q.m[3] += weight * a * d;
+	q.m[4] += weight * b * b; q.m[5] += weight * b * c; q.m[6] += weight * b * d;
+	q.m[7] += weight * c * c; q.m[8] += weight * c * d;
+	q.m[9] += weight * d * d;
+}
+
+static double QuadricError(const Quadric &q, const double p[3])
+{
+	double x = p[0], y = p[1], z = p[2];
+	return q.m[0] * x * x + 2.0 * q.m[1] * x * y + 2.0 * q.m[2] * x * z + 2.0 * q.m[3] * x
+		+ q.m[4] * y * y + 2.0 * q.m[5] * y * z + 2.0 * q.m[6] * y
+		+ q.m[7] * z * z + 2.0 * q.m[8] * z
+		+ q.m[9];
+}
+
+// Point minimising the quadric, false when it is not unique (flat or straight areas)
+static bool QuadricMinimum(const Quadric &q, double p[3])
+{
+	double a = q.m[0], b = q.m[1], c = q.m[2], e = q.m[4], f = q.m[5], i = q.m[7];
+	double det = a * (e * i - f * f) - b * (b * i - f * c) + c * (b * f - e * c);
+	double scale = fabs(a) + fabs(e) + fabs(i);
+	if (fabs(det) <= 1e-9 * scale * scale * scale || scale == 0.0)
+		return false;
+
+	double rx = -q.m[3], ry = -q.m[6], rz = -q.m[8];
+	p[0] = (rx * (e * i - f * f) - b * (ry * i - f * rz) + c * (ry * f - e * rz)) / det;
+	p[1] = (a * (ry * i - f * rz) - rx * (b * i - f * c) + c * (b * rz - ry * c)) / det;
+	p[2] = (a * (e * rz - ry * f) - b * (b * rz - ry * c) + rx * (b * f - e * c)) / det;
+	return true;
+}
+
+static void Cross(const double a[3], const double b[3], double out[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double Dot(const double a[3], const double b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static double Normalize(double v[3])
+{
+	double length = sqrt(Dot(v, v));
+	if (length > 0.0)
+	{
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+	return length;
+}
+
+static void ComputeBounds(ModelMesh &mesh)
+{
+	for (int k = 0; k < 3; k++)
+		mesh.boundsMin[k] = mesh.boundsMax[k] = mesh.vertices.empty() ? 0.0f : mesh.vertices[k];
+	for (size_t i = 0; i < mesh.vertices.size(); i += 6)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			mesh.boundsMin[k] = std::min(mesh.boundsMin[k], mesh.vertices[i + k]);
+			mesh.boundsMax[k] = std::max(mesh.boundsMax[k], mesh.vertices[i + k]);
+		}
+	}
+}
+
+// Everything the collapse loop works on
+class Simplifier
+{
+public:
+	Simplifier(const ModelMesh &mesh);
+	float Run(int targetTriangles);
+	void Output(ModelMesh &result) const;
+
+private:
+	struct Collapse
+	{
+		double cost;				// error plus the edge length term, the queue order
+		double error;				// squared distance to the planes merged, averaged by weight
+		int from, to;				// from goes away, to moves to position
+		uint32_t fromStamp, toStamp;
+		double position[3];
+
+		bool operator>(const Collapse &rhs) const { return cost > rhs.cost; }
+	};
+
+	void FaceNormal(int t, double normal[3], double &area) const;
+	void Consider(int a, int b);
+	bool Allowed(const Collapse &collapse, double normal[3]) const;
+	void Apply(const Collapse &collapse, const double normal[3]);
+
+	int numVertices;
+	std::vector<double> position, normal;
+	std::vector<Quadric> quadric;
+	std::vector<char> locked, removed;
+	std::vector<uint32_t> stamp;
+	std::vector<std::vector<int> > vertexTriangles;
+
+	std::vector<int> triangles;
+	std::vector<char> triangleRemoved;
+	int liveTriangles;
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > queue;
+	float minNormalDot;
+};
+
+Simplifier::Simplifier(const ModelMesh &mesh)
+{
+	numVertices = (int)(mesh.vertices.size() / 6);
+	position.resize(3 * numVertices);
+	normal.resize(3 * numVertices);
+	for (int v = 0; v < numVertices; v++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			position[3 * v + k] = mesh.vertices[6 * v + k];
+			normal[3 * v + k] = mesh.vertices[6 * v + 3 + k];
+		}
+	}
+	Quadric zero;
+	memset(&zero, 0, sizeof(zero));
+	quadric.assign(numVertices, zero);
+	locked.assign(numVertices, 0);
+	removed.assign(numVertices, 0);
+	stamp.assign(numVertices, 0);
+	vertexTriangles.resize(numVertices);
+	minNormalDot = cosf(SimplifyMaxNormalDegrees * 0.01745329252f);
+
+	// Degenerate triangles are dropped up front
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		int a = (int)mesh.indices[i], b = (int)mesh.indices[i + 1], c = (int)mesh.indices[i + 2];
+		if (a == b || b == c || a == c)
+			continue;
+		int t = (int)triangles.size() / 3;
+		triangles.push_back(a);
+		triangles.push_back(b);
+		triangles.push_back(c);
+		vertexTriangles[a].push_back(t);
+		vertexTriangles[b].push_back(t);
+		vertexTriangles[c].push_back(t);
+	}
+	liveTriangles = (int)triangles.size() / 3;
+	triangleRemoved.assign(liveTriangles, 0);
+
+	// Vertices sharing a position sit on a seam and stay where they are
+	std::map<std::vector<double>, int> seen;
+	for (int v = 0; v < numVertices; v++)
+	{
+		std::vector<double> key(&position[3 * v], &position[3 * v] + 3);
+		auto found = seen.insert(std::make_pair(key, v));
+		if (!found.second)
+			locked[v] = locked[found.first->second] = 1;
+	}
+
+	// Triangle planes weighted by area, and planes standing on the open edges
+	std::map<std::pair<int, int>, int> edgeUses;
+	for (int t = 0; t < liveTriangles; t++)
+	{
+		double n[3], area;
+		FaceNormal(t, n, area);
+		if (area <= 0.0)
+			continue;
+		const int *corner = &triangles[3 * t];
+		double d = -Dot(n, &position[3 * corner[0]]);
+		for (int k = 0; k < 3; k++)
+		{
+			AddPlane(quadric[corner[k]], n, d, area);
+			int a = corner[k], b = corner[(k + 1) % 3];
+			edgeUses[std::make_pair(std::min(a, b), std::max(a, b))]++;
+		}
+	}
+	for (int t = 0; t < liveTriangles; t++)
+	{
+		double n[3], area;
+		FaceNormal(t, n, area);
+		const int *corner = &triangles[3 * t];
+		for (int k = 0; k < 3; k++)
+		{
+			int a = corner[k], b = corner[(k + 1) % 3];
+			if (edgeUses[std::make_pair(std::min(a, b), std::max(a, b))] != 1)
+				continue;
+			double edge[3], side[3];
+			for (int j = 0; j < 3; j++)
+				edge[j] = position[3 * b + j] - position[3 * a + j];
+			double length = sqrt(Dot(edge, edge));
+			Cross(edge, n, side);
+			if (Normalize(side) <= 0.0)
+				continue;
+			double d = -Dot(side, &position[3 * a]);
+			AddPlane(quadric[a], side, d, SimplifyBoundaryWeight * length * length);
+			AddPlane(quadric[b], side, d, SimplifyBoundaryWeight * length * length);
+		}
+	}
+
+	for (auto &edge : edgeUses)
+		Consider(edge.first.first, edge.first.second);
+}
+
+void Simplifier::FaceNormal(int t, double n[3], double &area) const
+{
+	const int *corner = &triangles[3 * t];
+	const double *p0 = &position[3 * corner[0]], *p1 = &position[3 * corner[1]], *p2 = &position[3 * corner[2]];
+	double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	Cross(e1, e2, n);
+	area = 0.5 * Normalize(n);
+}
+
+// Queues the cheapest way to collapse edge a-b
+void Simplifier::Consider(int a, int b)
+{
+	if (removed[a] || removed[b] || (locked[a] && locked[b]))
+		return;
+
+	Collapse collapse;
+	collapse.from = locked[a] ? b : a;
+	collapse.to = locked[a] ? a : b;
+	Quadric q;
+	for (int k = 0; k < 10; k++)
+		q.m[k] = quadric[a].m[k] + quadric[b].m[k];
+
+	const double *pa = &position[3 * a], *pb = &position[3 * b];
+	double edgeSq = (pb[0] - pa[0]) * (pb[0] - pa[0]) + (pb[1] - pa[1]) * (pb[1] - pa[1]) +
+		(pb[2] - pa[2]) * (pb[2] - pa[2]);
+	double error;
+	if (locked[a] || locked[b])
+	{
+		memcpy(collapse.position, &position[3 * collapse.to], sizeof(collapse.position));
+		error = QuadricError(q, collapse.position);
+	}
+	else
+	{
+		// The minimum, when there is one near the edge, otherwise the better end or middle
+		double candidates[4][3];
+		int numCandidates = 0;
+		double best[3];
+		if (QuadricMinimum(q, best))
+		{
+			double dx = best[0] - 0.5 * (pa[0] + pb[0]), dy = best[1] - 0.5 * (pa[1] + pb[1]),
+				dz = best[2] - 0.5 * (pa[2] + pb[2]);
+			if (dx * dx + dy * dy + dz * dz <= edgeSq)
+				memcpy(candidates[numCandidates++], best, sizeof(best));
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			candidates[numCandidates][k] = pa[k];
+			candidates[numCandidates + 1][k] = pb[k];
+			candidates[numCandidates + 2][k] = 0.5 * (pa[k] + pb[k]);
+		}
+		numCandidates += 3;
+
+		error = -1.0;
+		for (int c = 0; c < numCandidates; c++)
+		{
+			double candidateError = QuadricError(q, candidates[c]);
+			if (error < 0.0 || candidateError < error)
+			{
+				error = candidateError;
+				memcpy(collapse.position, candidates[c], sizeof(collapse.position));
+			}
+		}
+	}
+
+	// The weights add up on the diagonal, the planes' normals being unit length
+	double weight = q.m[0] + q.m[4] + q.m[7];
+	error = std::max(0.0, error);
+	collapse.error = weight > 0.0 ? error / weight : 0.0;
+	collapse.cost = error + SimplifyEdgeLengthWeight * edgeSq * weight;
+	collapse.fromStamp = stamp[collapse.from];
+	collapse.toStamp = stamp[collapse.to];
+	queue.push(collapse);
+}
+
+// Keeps the surface manifold, the normals close and no triangle flipped; fills the
+// normal the kept vertex gets
+bool Simplifier::Allowed(const Collapse &collapse, double newNormal[3]) const
+{
+	int from = collapse.from, to = collapse.to;
+	const double *nFrom = &normal[3 * from], *nTo = &normal[3 * to];
+	if (Dot(nFrom, nTo) < minNormalDot)
+		return false;
+
+	// Normal in proportion to where the vertex lands along the edge
+	const double *pFrom = &position[3 * from], *pTo = &position[3 * to];
+	double edge[3] = { pTo[0] - pFrom[0], pTo[1] - pFrom[1], pTo[2] - pFrom[2] };
+	double offset[3] = { collapse.position[0] - pFrom[0], collapse.position[1] - pFrom[1],
+		collapse.position[2] - pFrom[2] };
+	double edgeSq = Dot(edge, edge);
+	double t = edgeSq > 0.0 ? std::max(0.0, std::min(1.0, Dot(offset, edge) / edgeSq)) : 0.5;
+	for (int k = 0; k < 3; k++)
+		newNormal[k] = nFrom[k] * (1.0 - t) + nTo[k] * t;
+	if (Normalize(newNormal) <= 0.0)
+		return false;
+
+	// The two ends may only share the neighbours of the triangles on the edge
+	std::vector<int> neighboursFrom, neighboursTo;
+	int shared = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int v = pass == 0 ? from : to;
+		std::vector<int> &neighbours = pass == 0 ? neighboursFrom : neighboursTo;
+		for (int t : vertexTriangles[v])
+		{
+			if (triangleRemoved[t])
+				continue;
+			const int *corner = &triangles[3 * t];
+			bool onEdge = false;
+			for (int k = 0; k < 3; k++)
+			{
+				if (corner[k] != v)
+					neighbours.push_back(corner[k]);
+				onEdge = onEdge || corner[k] == (pass == 0 ? to : from);
+			}
+			if (pass == 0 && onEdge)
+				shared++;
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+	}
+	int common = 0;
+	for (size_t i = 0, j = 0; i < neighboursFrom.size() && j < neighboursTo.size();)
+	{
+		if (neighboursFrom[i] < neighboursTo[j])
+			i++;
+		else if (neighboursFrom[i] > neighboursTo[j])
+			j++;
+		else
+		{
+			common++;
+			i++;
+			j++;
+		}
+	}
+	if (common > shared)
+		return false;
+
+	// Triangles that stay must not turn over or too far
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int v = pass == 0 ? from : to;
+		for (int t : vertexTriangles[v])
+		{
+			if (triangleRemoved[t])
+				continue;
+			const int *corner = &triangles[3 * t];
+			if ((corner[0] == from || corner[1] == from || corner[2] == from) &&
+				(corner[0] == to || corner[1] == to || corner[2] == to))
+				continue;
+
+			double before[3], area;
+			FaceNormal(t, before, area);
+			const double *p[3];
+			for (int k = 0; k < 3; k++)
+				p[k] = corner[k] == v ? collapse.position : &position[3 * corner[k]];
+			double e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+			double e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+			double after[3];
+			Cross(e1, e2, after);
+			if (Normalize(after) <= 0.0 || Dot(before, after) < minNormalDot)
+				return false;
+		}
+	}
+	return true;
+}
+
+void Simplifier::Apply(const Collapse &collapse, const double newNormal[3])
+{
+	int from = collapse.from, to = collapse.to;
+	for (int t : vertexTriangles[from])
+	{
+		if (triangleRemoved[t])
+			continue;
+		int *corner = &triangles[3 * t];
+		if (corner[0] == to || corner[1] == to || corner[2] == to)
+		{
+			triangleRemoved[t] = 1;
+			liveTriangles--;
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			if (corner[k] == from)
+				corner[k] = to;
+		}
+		vertexTriangles[to].push_back(t);
+	}
+
+	removed[from] = 1;
+	vertexTriangles[from].clear();
+	memcpy(&position[3 * to], collapse.position, 3 * sizeof(double));
+	memcpy(&normal[3 * to], newNormal, 3 * sizeof(double));
+	for (int k = 0; k < 10; k++)
+		quadric[to].m[k] += quadric[from].m[k];
+	stamp[to]++;
+
+	// Drop the dead triangles from the kept vertex and requeue its edges
+	std::vector<int> &list = vertexTriangles[to];
+	list.erase(std::remove_if(list.begin(), list.end(), [this](int t) { return triangleRemoved[t] != 0; }),
+		list.end());
+	std::vector<int> neighbours;
+	for (int t : list)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (triangles[3 * t + k] != to)
+				neighbours.push_back(triangles[3 * t + k]);
+		}
+	}
+	std::sort(neighbours.begin(), neighbours.end());
+	neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+	for (int n : neighbours)
+		Consider(to, n);
+}
+
+float Simplifier::Run(int targetTriangles)
+{
+	double largest = 0.0;
+	while (liveTriangles > targetTriangles && !queue.empty())
+	{
+		Collapse collapse = queue.top();
+		queue.pop();
+		if (removed[collapse.from] || removed[collapse.to] || stamp[collapse.from] != collapse.fromStamp ||
+			stamp[collapse.to] != collapse.toStamp)
+			continue;
+
+		// A refused collapse comes back when a neighbour changes the edge's stamps
+		double newNormal[3];
+		if (!Allowed(collapse, newNormal))
+			continue;
+		Apply(collapse, newNormal);
+		largest = std::max(largest, collapse.error);
+	}
+	return (float)sqrt(largest);
+}
+
+void Simplifier::Output(ModelMesh &result) const
+{
+	std::vector<int> remap(numVertices, -1);
+	result.vertices.clear();
+	result.indices.clear();
+	for (size_t t = 0; t < triangleRemoved.size(); t++)
+	{
+		if (triangleRemoved[t])
+			continue;
+		for (int k = 0; k < 3; k++)
+		{
+			int v = triangles[3 * t + k];
+			if (remap[v] < 0)
+			{
+				remap[v] = (int)(result.vertices.size() / 6);
+				for (int j = 0; j < 3; j++)
+					result.vertices.push_back((float)position[3 * v + j]);
+				for (int j = 0; j < 3; j++)
+					result.vertices.push_back((float)normal[3 * v + j]);
+			}
+			result.indices.push_back((uint32_t)remap[v]);
+		}
+	}
+
+	ComputeBounds(result);
+}
+
+float SimplifyMesh(const ModelMesh &mesh, int targetTriangles, ModelMesh &result)
+{
+	Simplifier simplifier(mesh);
+	float error = simplifier.Run(targetTriangles);
+	simplifier.Output(result);
+	return error;
+}
+
+void DrawMeshLevel(const ModelMesh &mesh)
+{
+	if (mesh.indices.empty())
+		return;
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), &mesh.vertices[0]);
+	glNormalPointer(GL_FLOAT, 6 * sizeof(float), &mesh.vertices[3]);
+	glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, mesh.indices.data());
+	glPopClientAttrib();
+}
+
+void PrimitiveToMesh(const PrimitiveView &primitive, ModelMesh &mesh)
+{
+	mesh.vertices.resize(6 * primitive.numVertices);
+	for (int v = 0; v < primitive.numVertices; v++)
+	{
+		memcpy(&mesh.vertices[6 * v], &primitive.positions[3 * v], 3 * sizeof(float));
+		memcpy(&mesh.vertices[6 * v + 3], &primitive.normals[3 * v], 3 * sizeof(float));
+	}
+	mesh.indices.assign(primitive.indices, primitive.indices + primitive.numIndices);
+	ComputeBounds(mesh);
+}
+
+
+// Cache file: header, a LodCacheLevel per level after the source, then each level's
+// vertices and indices in turn
+struct LodCacheHeader
+{
+	char magic[4];			// "QLOD"
+	uint32_t version;
+	uint64_t key;
+	uint32_t numLevels;
+	uint32_t reserved[3];
+};
+
+struct LodCacheLevel
+{
+	uint32_t numVertices;
+	uint32_t numIndices;
+	float error;
+	uint32_t reserved;
+};
+
+MeshLods::MeshLods() : fromCache(false), buildSeconds(0.0), building(false), ready(false)
+{
+}
+
+MeshLods::~MeshLods()
+{
+	// The worker writes into this object, wait for it before it goes away
+	while (building.load())
+		std::this_thread::yield();
+}
+
+void MeshLods::Build(const char *name, const ModelMesh &source, const int *targetTriangles, int numTargets,
+	const char *cacheDir, JobSystem &jobs)
+{
+	if (building.load() || ready.load())
+		return;
+
+	this->name = name;
+	levels.assign(1, source);
+	ComputeBounds(levels[0]);
+	errors.assign(1, 0.0f);
+	std::vector<int> targets(targetTriangles, targetTriangles + numTargets);
+	std::string dir = cacheDir ? cacheDir : "";
+
+	building = true;
+	jobs.Submit([this, targets, dir]()
+	{
+		BuildLevels(targets, dir);
+		ready.store(true, std::memory_order_release);
+		building = false;
+	});
+}
+
+void MeshLods::BuildLevels(const std::vector<int> &targets, const std::string &cacheDir)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point begin = Clock::now();
+
+	const ModelMesh &source = levels[0];
+	uint64_t key = MeshCacheHash(MeshCacheHashSeed, &LodCacheVersion, sizeof(LodCacheVersion));
+	key = MeshCacheHash(key, source.vertices.data(), source.vertices.size() * sizeof(float));
+	key = MeshCacheHash(key, source.indices.data(), source.indices.size() * sizeof(uint32_t));
+	key = MeshCacheHash(key, targets.data(), targets.size() * sizeof(int));
+	char path[512];
+	snprintf(path, sizeof(path), "%s/lod_%016llx.bin", cacheDir.c_str(), (unsigned long long)key);
+
+	fromCache = !cacheDir.empty() && ReadCache(path, key);
+	if (!fromCache)
+	{
+		// Each level from the one before, which is cheaper and keeps them nested
+		for (size_t i = 0; i < targets.size(); i++)
+		{
+			ModelMesh level;
+			float error = SimplifyMesh(levels.back(), targets[i], level);
+			errors.push_back(std::max(error, errors.back()));
+			levels.push_back(level);
+		}
+		if (!cacheDir.empty() && !WriteCache(path, key))
+			printf("Could not write LOD cache %s\n", path);
+	}
+
+	buildSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+bool MeshLods::ReadCache(const char *path, uint64_t key)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	LodCacheHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "QLOD", 4) == 0 &&
+		header.version == LodCacheVersion && header.key == key && header.numLevels < 64;
+	std::vector<LodCacheLevel> table(ok ? header.numLevels : 0);
+	ok = ok && fread(table.data(), sizeof(LodCacheLevel), table.size(), file) == table.size();
+
+	std::vector<ModelMesh> read;
+	for (size_t i = 0; ok && i < table.size(); i++)
+	{
+		ModelMesh level;
+		level.vertices.resize(6 * (size_t)table[i].numVertices);
+		level.indices.resize(table[i].numIndices);
+		ok = fread(level.vertices.data(), sizeof(float), level.vertices.size(), file) == level.vertices.size() &&
+			fread(level.indices.data(), sizeof(uint32_t), level.indices.size(), file) == level.indices.size();
+		for (size_t j = 0; ok && j < level.indices.size(); j++)
+			ok = level.indices[j] < table[i].numVertices;
+		read.push_back(level);
+	}
+	fclose(file);
+	if (!ok)
+		return false;
+
+	for (size_t i = 0; i < read.size(); i++)
+	{
+		ComputeBounds(read[i]);
+		levels.push_back(read[i]);
+		errors.push_back(table[i].error);
+	}
+	return true;
+}
+
+bool MeshLods::WriteCache(const char *path, uint64_t key) const
+{
+	LodCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "QLOD", 4);
+	header.version = LodCacheVersion;
+	header.key = key;
+	header.numLevels = (uint32_t)levels.size() - 1;
+
+	std::vector<LodCacheLevel> table(header.numLevels);
+	for (size_t i = 0; i < table.size(); i++)
+	{
+		memset(&table[i], 0, sizeof(LodCacheLevel));
+		table[i].numVertices = (uint32_t)(levels[i + 1].vertices.size() / 6);
+		table[i].numIndices = (uint32_t)levels[i + 1].indices.size();
+		table[i].error = errors[i + 1];
+	}
+
+	CreateMeshCacheDirectory(path);
+
+	// Temporary name first, as WriteMeshCache() does
+	char tempPath[512];
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+	FILE *file = fopen(tempPath, "wb");
+	if (!file)
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(table.data(), sizeof(LodCacheLevel), table.size(), file) == table.size();
+	for (size_t i = 1; ok && i < levels.size(); i++)
+	{
+		ok = fwrite(levels[i].vertices.data(), sizeof(float), levels[i].vertices.size(), file) ==
+			levels[i].vertices.size();
+		ok = ok && fwrite(levels[i].indices.data(), sizeof(uint32_t), levels[i].indices.size(), file) ==
+			levels[i].indices.size();
+	}
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+	{
+		remove(tempPath);
+		return false;
+	}
+
+	remove(path);
+	return rename(tempPath, path) == 0;
+}
+
+void MeshLods::Report() const
+{
+	if (!IsReady())
+	{
+		printf("%s: LODs still building\n", name.c_str());
+		return;
+	}
+
+	printf("%s: %d LODs %s in %.1f ms\n", name.c_str(), (int)levels.size() - 1,
+		fromCache ? "read from cache" : "built", buildSeconds * 1000.0);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		printf("  level %d: %5d triangles, %5d vertices, error %.4f\n", (int)i, (int)(levels[i].indices.size() / 3),
+			(int)(levels[i].vertices.size() / 6), errors[i]);
+	}
+}
@@ -0,0 +1,85 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	MeshLod.h
+//	Cheaper versions of dense meshes by quadric error edge collapse (Garland and
+//	Heckbert). Every vertex carries the sum of the squared distances to the planes of
+//	its triangles; collapsing an edge adds the two sums and places the vertex where
+//	that sum is smallest, cheapest collapse first, until the triangle count is
+//	reached.
+//
+//	Open edges keep their shape through a heavily weighted plane standing on each
+//	one, and vertices that share their position with another (a seam where the
+//	normal or texture changes, such as the closing column of a cylinder) never
+//	move, so hard normal edges survive as they are. Elsewhere a collapse takes the
+//	normals of its two ends in proportion to where it lands, and is refused if it
+//	joins vertices whose normals differ too much or turns a triangle too far.
+//
+//	MeshLods builds a chain of levels on a JobSystem worker and keeps it in a cache
+//	file next to the quad mesh caches, keyed by a hash of the source mesh and the
+//	targets, so later runs only read it back.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "ModelLoader.h"
+#include "Primitives.h"
+
+class JobSystem;
+
+// Bump whenever the cache layout or the simplifier's output changes
+const uint32_t LodCacheVersion = 1;
+
+// Collapses edges of mesh until it has at most targetTriangles, or nothing more can
+// go. Returns the largest collapse error, as a root mean square distance from the
+// planes the collapse merged; 0 if nothing collapsed.
+float SimplifyMesh(const ModelMesh &mesh, int targetTriangles, ModelMesh &result);
+
+// Draws a level with client-side vertex arrays, defined with GL (GL thread only)
+void DrawMeshLevel(const ModelMesh &mesh);
+
+class MeshLods
+{
+public:
+	MeshLods();
+	~MeshLods();
+
+	MeshLods(const MeshLods &) = delete;
+	MeshLods &operator=(const MeshLods &) = delete;
+
+	// Copies source and builds one level per target on a worker, each from the one
+	// before, or reads them from cacheDir (NULL for no cache). Call once.
+	void Build(const char *name, const ModelMesh &source, const int *targetTriangles, int numTargets,
+		const char *cacheDir, JobSystem &jobs);
+
+	// The levels may only be read once this is true. Level 0 is the source.
+	bool IsReady() const { return ready.load(std::memory_order_acquire); }
+	int GetLevelCount() const { return IsReady() ? (int)levels.size() : 0; }
+	const ModelMesh &GetLevel(int level) const { return levels[level]; }
+	float GetLevelError(int level) const { return errors[level]; }
+
+	// Triangles and error of every level, and where they came from
+	void Report() const;
+
+private:
+	void BuildLevels(const std::vector<int> &targets, const std::string &cacheDir);
+	bool ReadCache(const char *path, uint64_t key);
+	bool WriteCache(const char *path, uint64_t key) const;
+
+	std::string name;
+	std::vector<ModelMesh> levels;
+	std::vector<float> errors;
+	bool fromCache;
+	double buildSeconds;
+	std::atomic<bool> building;
+	std::atomic<bool> ready;
+};
+
+// Interleaved copy of a primitive, the layout SimplifyMesh() takes
+void PrimitiveToMesh(const PrimitiveView &primitive, ModelMesh &mesh);
+
+#endif	//MESHLOD_H
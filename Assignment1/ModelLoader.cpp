@@ -0,0 +1,896 @@
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <gl/gl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <unordered_map>
+#include "JobSystem.h"
+#include "ModelLoader.h"
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Shared helpers
+
+static bool ReadWholeFile(const char *path, std::vector<char> &data)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size < 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	data.resize((size_t)size);
+	bool ok = size == 0 || fread(data.data(), 1, (size_t)size, file) == (size_t)size;
+	fclose(file);
+	return ok;
+}
+
+struct VertexKey
+{
+	float v[6];
+	bool operator==(const VertexKey & rhs) const { return memcmp(v, rhs.v, sizeof(v)) == 0; }
+};
+
+struct VertexKeyHash
+{
+	size_t operator()(const VertexKey & key) const
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		const unsigned char *bytes = (const unsigned char*)key.v;
+		for (size_t i = 0; i < sizeof(key.v); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return (size_t)hash;
+	}
+};
+
+// Weld bit-identical vertices and remap the index buffer
+static void DeduplicateVertices(ModelMesh &mesh)
+{
+	size_t numVertices = mesh.vertices.size() / 6;
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+	unique.reserve(numVertices);
+
+	std::vector<float> welded;
+	welded.reserve(mesh.vertices.size());
+	std::vector<uint32_t> remap(numVertices);
+
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		VertexKey key;
+		memcpy(key.v, &mesh.vertices[i * 6], sizeof(key.v));
+		std::pair<std::unordered_map<VertexKey, uint32_t, VertexKeyHash>::iterator, bool> result =
+			unique.insert(std::make_pair(key, (uint32_t)(welded.size() / 6)));
+		if (result.second)
+			welded.insert(welded.end(), key.v, key.v + 6);
+		remap[i] = result.first->second;
+	}
+
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+		mesh.indices[i] = remap[mesh.indices[i]];
+	mesh.vertices.swap(welded);
+}
+
+// Area-weighted vertex normals, for files that do not carry any
+static void ComputeMeshNormals(ModelMesh &mesh)
+{
+	float *v = mesh.vertices.data();
+	size_t numVertices = mesh.vertices.size() / 6;
+	for (size_t i = 0; i < numVertices; i++)
+		v[i * 6 + 3] = v[i * 6 + 4] = v[i * 6 + 5] = 0.0f;
+
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+	{
+		float *a = &v[mesh.indices[t] * 6];
+		float *b = &v[mesh.indices[t + 1] * 6];
+		float *c = &v[mesh.indices[t + 2] * 6];
+		float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+		for (int k = 0; k < 3; k++)
+		{
+			a[3 + k] += n[k];
+			b[3 + k] += n[k];
+			c[3 + k] += n[k];
+		}
+	}
+
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		float *n = &v[i * 6 + 3];
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length > 0.0f)
+		{
+			n[0] /= length; n[1] /= length; n[2] /= length;
+		}
+	}
+}
+
+static void ComputeBounds(ModelMesh &mesh)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		mesh.boundsMin[k] = 0.0f;
+		mesh.boundsMax[k] = 0.0f;
+	}
+
+	size_t numVertices = mesh.vertices.size() / 6;
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			float p = mesh.vertices[i * 6 + k];
+			if (i == 0 || p < mesh.boundsMin[k]) mesh.boundsMin[k] = p;
+			if (i == 0 || p > mesh.boundsMax[k]) mesh.boundsMax[k] = p;
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Wavefront OBJ
+
+static const char *SkipSpaces(const char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+static const char *NextLine(const char *p)
+{
+	while (*p && *p != '\n')
+		p++;
+	return *p ? p + 1 : p;
+}
+
+// Resolves a 1-based (or negative, relative) OBJ index, -1 if out of range
+static int ResolveObjIndex(long index, size_t count)
+{
+	if (index > 0 && (size_t)index <= count)
+		return (int)(index - 1);
+	if (index < 0 && (size_t)(-index) <= count)
+		return (int)(count + index);
+	return -1;
+}
+
+bool LoadObjMesh(const char *path, ModelMesh &mesh, std::string &error)
+{
+	std::vector<char> text;
+	if (!ReadWholeFile(path, text))
+	{
+		error = "cannot read file";
+		return false;
+	}
+	text.push_back('\0');	// lets the parser stop on a terminator
+
+	std::vector<float> positions;
+	std::vector<float> normals;
+	bool hasNormals = false;
+
+	// Each face corner is a (position, normal) pair, deduplicated as it is read
+	std::unordered_map<uint64_t, uint32_t> corners;
+	std::vector<uint32_t> polygon;		// corners of the current face, reused
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	const char *p = text.data();
+	while (*p)
+	{
+		p = SkipSpaces(p);
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			char *end;
+			for (int k = 0; k < 3; k++)
+			{
+				positions.push_back(strtof(p + (k == 0 ? 2 : 0), &end));
+				p = end;
+			}
+		}
+		else if (p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			char *end;
+			for (int k = 0; k < 3; k++)
+			{
+				normals.push_back(strtof(p + (k == 0 ? 3 : 0), &end));
+				p = end;
+			}
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 2;
+			polygon.clear();
+
+			for (;;)
+			{
+				p = SkipSpaces(p);
+				if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#')
+					break;
+
+				char *end;
+				long vi = strtol(p, &end, 10), ni = 0;
+				if (end == p)
+				{
+					error = "malformed face";
+					return false;
+				}
+				p = end;
+				if (*p == '/')
+				{
+					p++;
+					if (*p != '/')
+					{
+						strtol(p, &end, 10);	// texture coordinate, not used
+						p = end;
+					}
+					if (*p == '/')
+					{
+						ni = strtol(p + 1, &end, 10);
+						p = end;
+					}
+				}
+
+				int position = ResolveObjIndex(vi, positions.size() / 3);
+				int normal = ResolveObjIndex(ni, normals.size() / 3);
+				if (position < 0)
+				{
+					error = "face index out of range";
+					return false;
+				}
+				if (normal >= 0)
+					hasNormals = true;
+
+				uint64_t key = ((uint64_t)(uint32_t)position << 32) | (uint32_t)(normal + 1);
+				std::pair<std::unordered_map<uint64_t, uint32_t>::iterator, bool> result =
+					corners.insert(std::make_pair(key, (uint32_t)(mesh.vertices.size() / 6)));
+				if (result.second)
+				{
+					mesh.vertices.insert(mesh.vertices.end(), &positions[position * 3], &positions[position * 3] + 3);
+					if (normal >= 0)
+						mesh.vertices.insert(mesh.vertices.end(), &normals[normal * 3], &normals[normal * 3] + 3);
+					else
+						mesh.vertices.insert(mesh.vertices.end(), 3, 0.0f);
+				}
+
+				polygon.push_back(result.first->second);
+			}
+
+			// Triangulate as a fan
+			for (size_t i = 1; i + 1 < polygon.size(); i++)
+			{
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[i]);
+				mesh.indices.push_back(polygon[i + 1]);
+			}
+		}
+		p = NextLine(p);
+	}
+
+	if (mesh.indices.empty())
+	{
+		error = "no faces";
+		return false;
+	}
+
+	if (!hasNormals)
+		ComputeMeshNormals(mesh);
+	ComputeBounds(mesh);
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// glTF 2.0, only what is needed to pull out triangle geometry. Node transforms,
+// materials and sparse accessors are not applied; meshes are taken in their own space.
+
+struct JsonValue
+{
+	enum Type { Null, Bool, Number, String, Array, Object };
+
+	Type type;
+	double number;
+	std::string string;
+	std::vector<JsonValue> items;		// array elements or object values
+	std::vector<std::string> keys;		// object keys, parallel to items
+
+	JsonValue() : type(Null), number(0.0)
+	{}
+
+	const JsonValue *Get(const char *key) const
+	{
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			if (keys[i] == key)
+				return &items[i];
+		}
+		return NULL;
+	}
+
+	const JsonValue *At(size_t index) const
+	{
+		return type == Array && index < items.size() ? &items[index] : NULL;
+	}
+
+	double GetNumber(const char *key, double defaultValue) const
+	{
+		const JsonValue *value = Get(key);
+		return value && value->type == Number ? value->number : defaultValue;
+	}
+};
+
+class JsonParser
+{
+public:
+	JsonParser(const char *text, const char *end) : p(text), end(end)
+	{}
+
+	bool Parse(JsonValue &value, int depth = 0)
+	{
+		SkipWhitespace();
+		if (p >= end || depth > 64)
+			return false;
+
+		if (*p == '{')
+		{
+			value.type = JsonValue::Object;
+			p++;
+			SkipWhitespace();
+			if (p < end && *p == '}')
+			{
+				p++;
+				return true;
+			}
+			for (;;)
+			{
+				std::string key;
+				SkipWhitespace();
+				if (!ParseString(key))
+					return false;
+				SkipWhitespace();
+				if (p >= end || *p != ':')
+					return false;
+				p++;
+				value.keys.push_back(key);
+				value.items.push_back(JsonValue());
+				if (!Parse(value.items.back(), depth + 1))
+					return false;
+				SkipWhitespace();
+				if (p < end && *p == ',')
+				{
+					p++;
+					continue;
+				}
+				if (p < end && *p == '}')
+				{
+					p++;
+					return true;
+				}
+				return false;
+			}
+		}
+		if (*p == '[')
+		{
+			value.type = JsonValue::Array;
+			p++;
+			SkipWhitespace();
+			if (p < end && *p == ']')
+			{
+				p++;
+				return true;
+			}
+			for (;;)
+			{
+				value.items.push_back(JsonValue());
+				if (!Parse(value.items.back(), depth + 1))
+					return false;
+				SkipWhitespace();
+				if (p < end && *p == ',')
+				{
+					p++;
+					continue;
+				}
+				if (p < end && *p == ']')
+				{
+					p++;
+					return true;
+				}
+				return false;
+			}
+		}
+		if (*p == '"')
+		{
+			value.type = JsonValue::String;
+			return ParseString(value.string);
+		}
+		if (Match("true"))
+		{
+			value.type = JsonValue::Bool;
+			value.number = 1.0;
+			return true;
+		}
+		if (Match("false"))
+		{
+			value.type = JsonValue::Bool;
+			return true;
+		}
+		if (Match("null"))
+			return true;
+
+		char *numberEnd;
+		value.type = JsonValue::Number;
+		value.number = strtod(p, &numberEnd);
+		if (numberEnd == p)
+			return false;
+		p = numberEnd;
+		return true;
+	}
+
+private:
+	void SkipWhitespace()
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+			p++;
+	}
+
+	bool Match(const char *word)
+	{
+		size_t length = strlen(word);
+		if ((size_t)(end - p) < length || strncmp(p, word, length) != 0)
+			return false;
+		p += length;
+		return true;
+	}
+
+	bool ParseString(std::string &out)
+	{
+		if (p >= end || *p != '"')
+			return false;
+		p++;
+		while (p < end && *p != '"')
+		{
+			if (*p == '\\' && p + 1 < end)
+			{
+				p++;
+				switch (*p)
+				{
+				case 'n': out += '\n'; break;
+				case 't': out += '\t'; break;
+				case 'r': out += '\r'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'u': out += '?'; p += 4; break;	// non-ASCII names are not needed here
+				default: out += *p; break;
+				}
+				p++;
+			}
+			else
+				out += *p++;
+		}
+		if (p >= end)
+			return false;
+		p++;
+		return true;
+	}
+
+	const char *p;
+	const char *end;
+};
+
+static bool DecodeBase64(const char *text, std::vector<unsigned char> &out)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	unsigned int accumulator = 0;
+	int bits = 0;
+	for (const char *c = text; *c && *c != '='; c++)
+	{
+		const char *found = strchr(alphabet, *c);
+		if (!found)
+			return false;
+		accumulator = (accumulator << 6) | (unsigned int)(found - alphabet);
+		bits += 6;
+		if (bits >= 8)
+		{
+			bits -= 8;
+			out.push_back((unsigned char)((accumulator >> bits) & 0xFF));
+		}
+	}
+	return true;
+}
+
+// Reads accessor elements as floats (components per element must match)
+static bool ReadAccessor(const JsonValue &doc, const std::vector<std::vector<unsigned char> > &buffers,
+	int accessorIndex, int components, std::vector<float> *floats, std::vector<uint32_t> *integers)
+{
+	const JsonValue *accessors = doc.Get("accessors");
+	const JsonValue *bufferViews = doc.Get("bufferViews");
+	const JsonValue *accessor = accessors ? accessors->At(accessorIndex) : NULL;
+	if (!accessor || !bufferViews)
+		return false;
+
+	const JsonValue *view = bufferViews->At((size_t)accessor->GetNumber("bufferView", -1));
+	if (!view)
+		return false;
+
+	size_t bufferIndex = (size_t)view->GetNumber("buffer", 0);
+	if (bufferIndex >= buffers.size())
+		return false;
+	const std::vector<unsigned char> &buffer = buffers[bufferIndex];
+
+	int componentType = (int)accessor->GetNumber("componentType", 0);
+	size_t count = (size_t)accessor->GetNumber("count", 0);
+	size_t componentSize = componentType == 5126 || componentType == 5125 ? 4 : componentType == 5123 ? 2 : 1;
+	size_t offset = (size_t)view->GetNumber("byteOffset", 0) + (size_t)accessor->GetNumber("byteOffset", 0);
+	size_t stride = (size_t)view->GetNumber("byteStride", 0);
+	if (stride == 0)
+		stride = componentSize * components;
+
+	if (count > 0 && offset + (count - 1) * stride + componentSize * components > buffer.size())
+		return false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned char *element = &buffer[offset + i * stride];
+		for (int k = 0; k < components; k++)
+		{
+			const unsigned char *c = element + k * componentSize;
+			if (floats && componentType == 5126)
+			{
+				float f;
+				memcpy(&f, c, 4);
+				floats->push_back(f);
+			}
+			else if (integers && componentType == 5125)
+			{
+				uint32_t u;
+				memcpy(&u, c, 4);
+				integers->push_back(u);
+			}
+			else if (integers && componentType == 5123)
+			{
+				uint16_t u;
+				memcpy(&u, c, 2);
+				integers->push_back(u);
+			}
+			else if (integers && componentType == 5121)
+				integers->push_back(*c);
+			else
+				return false;
+		}
+	}
+	return true;
+}
+
+bool LoadGltfMesh(const char *path, ModelMesh &mesh, std::string &error)
+{
+	std::vector<char> file;
+	if (!ReadWholeFile(path, file))
+	{
+		error = "cannot read file";
+		return false;
+	}
+
+	const char *jsonBegin = file.data();
+	const char *jsonEnd = file.data() + file.size();
+	std::vector<std::vector<unsigned char> > buffers;
+
+	// Binary container: 12 byte header, JSON chunk, optional BIN chunk
+	bool binary = file.size() >= 20 && memcmp(file.data(), "glTF", 4) == 0;
+	std::vector<unsigned char> binChunk;
+	if (binary)
+	{
+		uint32_t jsonLength;
+		memcpy(&jsonLength, &file[12], 4);
+		if (20 + (size_t)jsonLength > file.size())
+		{
+			error = "truncated glb";
+			return false;
+		}
+		jsonBegin = &file[20];
+		jsonEnd = jsonBegin + jsonLength;
+
+		size_t binOffset = 20 + jsonLength;
+		if (binOffset + 8 <= file.size())
+		{
+			uint32_t binLength;
+			memcpy(&binLength, &file[binOffset], 4);
+			if (binOffset + 8 + binLength <= file.size())
+				binChunk.assign(file.begin() + binOffset + 8, file.begin() + binOffset + 8 + binLength);
+		}
+	}
+
+	JsonValue doc;
+	JsonParser parser(jsonBegin, jsonEnd);
+	if (!parser.Parse(doc) || doc.type != JsonValue::Object)
+	{
+		error = "invalid JSON";
+		return false;
+	}
+
+	// Resolve buffers: GLB chunk, embedded base64, or a file next to the .gltf
+	const JsonValue *bufferList = doc.Get("buffers");
+	for (size_t i = 0; bufferList && i < bufferList->items.size(); i++)
+	{
+		const JsonValue *uri = bufferList->items[i].Get("uri");
+		buffers.push_back(std::vector<unsigned char>());
+		if (!uri)
+		{
+			buffers.back().swap(binChunk);
+			continue;
+		}
+
+		const std::string &u = uri->string;
+		size_t comma = u.find(',');
+		if (u.compare(0, 5, "data:") == 0 && comma != std::string::npos)
+		{
+			if (!DecodeBase64(u.c_str() + comma + 1, buffers.back()))
+			{
+				error = "bad base64 buffer";
+				return false;
+			}
+			continue;
+		}
+
+		std::string directory(path);
+		size_t slash = directory.find_last_of("/\\");
+		directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+		std::vector<char> bin;
+		if (!ReadWholeFile((directory + u).c_str(), bin))
+		{
+			error = "cannot read buffer " + u;
+			return false;
+		}
+		buffers.back().assign(bin.begin(), bin.end());
+	}
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	bool hasNormals = true;
+
+	const JsonValue *meshes = doc.Get("meshes");
+	for (size_t m = 0; meshes && m < meshes->items.size(); m++)
+	{
+		const JsonValue *primitives = meshes->items[m].Get("primitives");
+		for (size_t pi = 0; primitives && pi < primitives->items.size(); pi++)
+		{
+			const JsonValue &primitive = primitives->items[pi];
+			if ((int)primitive.GetNumber("mode", 4) != 4)
+				continue;	// only triangle lists
+
+			const JsonValue *attributes = primitive.Get("attributes");
+			if (!attributes || !attributes->Get("POSITION"))
+				continue;
+
+			std::vector<float> positions, normals;
+			std::vector<uint32_t> indices;
+			if (!ReadAccessor(doc, buffers, (int)attributes->GetNumber("POSITION", -1), 3, &positions, NULL))
+			{
+				error = "bad POSITION accessor";
+				return false;
+			}
+			if (attributes->Get("NORMAL")
+				&& !ReadAccessor(doc, buffers, (int)attributes->GetNumber("NORMAL", -1), 3, &normals, NULL))
+			{
+				error = "bad NORMAL accessor";
+				return false;
+			}
+			if (primitive.Get("indices")
+				&& !ReadAccessor(doc, buffers, (int)primitive.GetNumber("indices", -1), 1, NULL, &indices))
+			{
+				error = "bad index accessor";
+				return false;
+			}
+
+			size_t numVertices = positions.size() / 3;
+			if (normals.size() != positions.size())
+				hasNormals = false;
+			if (indices.empty())
+			{
+				for (size_t i = 0; i < numVertices; i++)
+					indices.push_back((uint32_t)i);
+			}
+
+			uint32_t base = (uint32_t)(mesh.vertices.size() / 6);
+			for (size_t i = 0; i < numVertices; i++)
+			{
+				mesh.vertices.insert(mesh.vertices.end(), &positions[i * 3], &positions[i * 3] + 3);
+				if (normals.size() == positions.size())
+					mesh.vertices.insert(mesh.vertices.end(), &normals[i * 3], &normals[i * 3] + 3);
+				else
+					mesh.vertices.insert(mesh.vertices.end(), 3, 0.0f);
+			}
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				if (indices[i] >= numVertices || indices[i + 1] >= numVertices || indices[i + 2] >= numVertices)
+				{
+					error = "index out of range";
+					return false;
+				}
+				mesh.indices.push_back(base + indices[i]);
+				mesh.indices.push_back(base + indices[i + 1]);
+				mesh.indices.push_back(base + indices[i + 2]);
+			}
+		}
+	}
+
+	if (mesh.indices.empty())
+	{
+		error = "no triangle primitives";
+		return false;
+	}
+
+	if (!hasNormals)
+		ComputeMeshNormals(mesh);
+	DeduplicateVertices(mesh);
+	ComputeBounds(mesh);
+	return true;
+}
+
+bool LoadModelMesh(const char *path, ModelMesh &mesh, std::string &error)
+{
+	const char *extension = strrchr(path, '.');
+	if (extension && (strcmp(extension, ".obj") == 0 || strcmp(extension, ".OBJ") == 0))
+		return LoadObjMesh(path, mesh, error);
+	if (extension && (strcmp(extension, ".gltf") == 0 || strcmp(extension, ".glb") == 0))
+		return LoadGltfMesh(path, mesh, error);
+
+	error = "unknown model format";
+	return false;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// ModelLoader
+
+ModelLoader::ModelLoader(JobSystem &jobs) : jobs(jobs)
+{
+	inFlight = 0;
+}
+
+ModelLoader::~ModelLoader()
+{
+	// Workers write into completed, wait for them before it goes away
+	while (inFlight.load() > 0)
+		std::this_thread::yield();
+
+	for (size_t i = 0; i < completed.size(); i++)
+		delete completed[i];
+}
+
+int ModelLoader::Request(const char *path)
+{
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		if (models[i].path == path)
+			return (int)i;
+	}
+
+	Model model;
+	model.path = path;
+	model.state = ModelPending;
+	model.displayList = 0;
+	model.numTriangles = 0;
+	for (int k = 0; k < 3; k++)
+		model.boundsMin[k] = model.boundsMax[k] = 0.0f;
+	models.push_back(model);
+
+	int id = (int)models.size() - 1;
+	std::string file = path;
+	inFlight++;
+	jobs.Submit([this, id, file]()
+	{
+		Decoded *decoded = new Decoded();
+		decoded->model = id;
+		decoded->ok = LoadModelMesh(file.c_str(), decoded->mesh, decoded->error);
+		if (decoded->ok)
+		{
+			ModelMesh &mesh = decoded->mesh;
+			OptimizeVertexCache(mesh.indices.data(), (int)mesh.indices.size(), (int)(mesh.vertices.size() / 6),
+				&decoded->cacheBefore, &decoded->cacheAfter);
+		}
+		{
+			std::lock_guard<std::mutex> lock(completedMutex);
+			completed.push_back(decoded);
+		}
+		inFlight--;
+	});
+
+	return id;
+}
+
+int ModelLoader::PumpUploads(int maxUploads)
+{
+	int uploaded = 0;
+	while (uploaded < maxUploads)
+	{
+		Decoded *decoded = NULL;
+		{
+			std::lock_guard<std::mutex> lock(completedMutex);
+			if (completed.empty())
+				break;
+			decoded = completed.front();
+			completed.erase(completed.begin());
+		}
+
+		Model &model = models[decoded->model];
+		if (!decoded->ok)
+		{
+			printf("Could not load model %s: %s\n", model.path.c_str(), decoded->error.c_str());
+			model.state = ModelFailed;
+			delete decoded;
+			continue;
+		}
+
+		// Vertex arrays are dereferenced while the list is compiled, so the
+		// decoded data can be dropped right after
+		const ModelMesh &mesh = decoded->mesh;
+		model.displayList = glGenLists(1);
+		glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), &mesh.vertices[0]);
+		glNormalPointer(GL_FLOAT, 6 * sizeof(float), &mesh.vertices[3]);
+		glNewList(model.displayList, GL_COMPILE);
+		glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, mesh.indices.data());
+		glEndList();
+		glPopClientAttrib();
+
+		model.numTriangles = (unsigned int)(mesh.indices.size() / 3);
+		memcpy(model.boundsMin, mesh.boundsMin, sizeof(model.boundsMin));
+		memcpy(model.boundsMax, mesh.boundsMax, sizeof(model.boundsMax));
+		model.state = ModelReady;
+		printf("Loaded model %s (%u triangles)\n", model.path.c_str(), model.numTriangles);
+		PrintVertexCacheStats(model.path.c_str(), decoded->cacheBefore, decoded->cacheAfter);
+
+		delete decoded;
+		uploaded++;
+	}
+	return uploaded;
+}
+
+bool ModelLoader::HasPendingWork() const
+{
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		if (models[i].state == ModelPending)
+			return true;
+	}
+	return false;
+}
+
+ModelState ModelLoader::GetState(int model) const
+{
+	if (model < 0 || model >= (int)models.size())
+		return ModelFailed;
+	return models[model].state;
+}
+
+void ModelLoader::GetBounds(int model, float boundsMin[3], float boundsMax[3]) const
+{
+	for (int k = 0; k < 3; k++)
+	{
+		boundsMin[k] = GetState(model) == ModelReady ? models[model].boundsMin[k] : 0.0f;
+		boundsMax[k] = GetState(model) == ModelReady ? models[model].boundsMax[k] : 0.0f;
+	}
+}
+
+bool ModelLoader::Draw(int model) const
+{
+	if (GetState(model) != ModelReady)
+		return false;
+
+	glCallList(models[model].displayList);
+	return true;
+}
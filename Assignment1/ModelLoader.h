@@ -0,0 +1,98 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	ModelLoader.h
+//	Background loading of artist-made meshes (Wavefront OBJ, glTF 2.0 .gltf/.glb).
+//	Files are read, parsed, vertex-deduplicated and reordered for the vertex cache
+//	on JobSystem workers; the GL thread picks up finished meshes in PumpUploads()
+//	and compiles them into display lists a few per frame, so the frame loop never
+//	waits on a file. Until a model is ModelReady the caller keeps drawing its own
+//	placeholder geometry.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MODELLOADER_H
+#define MODELLOADER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "VertexCache.h"
+
+class JobSystem;
+
+// Indexed triangle mesh, interleaved position (3 floats) + normal (3 floats)
+struct ModelMesh
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+// Synchronous decoders, safe to call from any thread
+bool LoadObjMesh(const char *path, ModelMesh &mesh, std::string &error);
+bool LoadGltfMesh(const char *path, ModelMesh &mesh, std::string &error);
+// Picks the decoder from the file extension
+bool LoadModelMesh(const char *path, ModelMesh &mesh, std::string &error);
+
+enum ModelState
+{
+	ModelPending,
+	ModelReady,
+	ModelFailed
+};
+
+class ModelLoader
+{
+public:
+	ModelLoader(JobSystem &jobs);
+	~ModelLoader();
+
+	ModelLoader(const ModelLoader &) = delete;
+	ModelLoader &operator=(const ModelLoader &) = delete;
+
+	// Starts decoding in the background and returns the model id. Requesting
+	// the same path twice returns the same id.
+	int Request(const char *path);
+
+	// GL thread only: upload at most maxUploads finished meshes. Returns the number uploaded.
+	int PumpUploads(int maxUploads = 1);
+
+	// True while any requested model is still decoding or waiting for upload
+	bool HasPendingWork() const;
+
+	ModelState GetState(int model) const;
+	void GetBounds(int model, float boundsMin[3], float boundsMax[3]) const;
+
+	// Returns false, drawing nothing, if the model is not ready
+	bool Draw(int model) const;
+
+private:
+	struct Model
+	{
+		std::string path;
+		ModelState state;
+		unsigned int displayList;
+		unsigned int numTriangles;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	struct Decoded
+	{
+		int model;
+		bool ok;
+		ModelMesh mesh;
+		std::string error;
+		VertexCacheStats cacheBefore, cacheAfter;
+	};
+
+	JobSystem &jobs;
+	std::vector<Model> models;			// GL thread only
+
+	std::mutex completedMutex;
+	std::vector<Decoded*> completed;	// filled by workers, drained by PumpUploads()
+	std::atomic<int> inFlight;
+};
+
+#endif	//MODELLOADER_H
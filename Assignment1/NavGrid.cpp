@@ -0,0 +1,953 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "FastTrig.h"
+#include "NavGrid.h"
+
+// Each cluster border has at most 8 entrances, see AddBorderEntrances()
+static const int NavMaxClusterNodes = 32;
+static const int NavClusterCells = NavClusterSize * NavClusterSize;
+static const int NavCacheSize = 4096;		// entries, a power of two
+static const int NavLongEntrance = 6;		// border spans this long get an entrance at each end
+static const int NavSnapCells = 3;			// how far a blocked start or goal looks for a walkable cell
+static const float NavDiagonal = 1.41421356f;
+static const float NavUnreachable = 1e30f;
+static const int NavNoParent = 0xffff;
+
+// Lazy-deletion heap for the searches inside one cluster, every cell is pushed at
+// most once per neighbour so it never overflows
+struct ClusterHeap
+{
+	struct Entry
+	{
+		float cost;
+		int cell;
+	};
+
+	Entry entries[NavClusterCells * 8];
+	int count;
+
+	ClusterHeap() : count(0)
+	{}
+
+	void Push(float cost, int cell)
+	{
+		int i = count++;
+		while (i > 0 && entries[(i - 1) / 2].cost > cost)
+		{
+			entries[i] = entries[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+		entries[i].cost = cost;
+		entries[i].cell = cell;
+	}
+
+	Entry Pop()
+	{
+		Entry top = entries[0];
+		Entry last = entries[--count];
+		int i = 0;
+		for (;;)
+		{
+			int child = 2 * i + 1;
+			if (child >= count)
+				break;
+			if (child + 1 < count && entries[child + 1].cost < entries[child].cost)
+				child++;
+			if (entries[child].cost >= last.cost)
+				break;
+			entries[i] = entries[child];
+			i = child;
+		}
+		entries[i] = last;
+		return top;
+	}
+};
+
+static float Octile(int dx, int dz)
+{
+	dx = abs(dx);
+	dz = abs(dz);
+	return dx > dz ? (dx - dz) + NavDiagonal * dz : (dz - dx) + NavDiagonal * dx;
+}
+
+NavGrid::NavGrid() : minX(0.0f), minZ(0.0f), cellSize(1.0f), agentRadius(0.0f), width(0), height(0), clustersX(0),
+	clustersZ(0), anyDirty(false), changeCounter(0), searchStamp(0), goalSearchClock(0)
+{
+	for (int i = 0; i < NavGoalSearches; i++)
+	{
+		goalSearches[i].cell = -1;
+		goalSearches[i].lastUse = 0;
+	}
+	memset(&stats, 0, sizeof(stats));
+}
+
+void NavGrid::Build(float minX, float minZ, float maxX, float maxZ, float cellSize, float agentRadius)
+{
+	this->minX = minX;
+	this->minZ = minZ;
+	this->cellSize = cellSize;
+	this->agentRadius = agentRadius;
+	width = std::max(1, (int)ceilf((maxX - minX) / cellSize));
+	height = std::max(1, (int)ceilf((maxZ - minZ) / cellSize));
+	blockers.assign((size_t)width * height, 0);
+
+	clustersX = (width + NavClusterSize - 1) / NavClusterSize;
+	clustersZ = (height + NavClusterSize - 1) / NavClusterSize;
+	clusters.assign((size_t)clustersX * clustersZ, Cluster());
+	for (int cz = 0; cz < clustersZ; cz++)
+	{
+		for (int cx = 0; cx < clustersX; cx++)
+		{
+			Cluster &cluster = clusters[cz * clustersX + cx];
+			cluster.x0 = cx * NavClusterSize;
+			cluster.z0 = cz * NavClusterSize;
+			cluster.x1 = std::min(width, cluster.x0 + NavClusterSize);
+			cluster.z1 = std::min(height, cluster.z0 + NavClusterSize);
+			cluster.changedStamp = 0;
+			cluster.blockedStamp = 0;
+			cluster.dirty = true;
+			cluster.gainedBlocked = false;
+		}
+	}
+	anyDirty = true;
+	changeCounter = 0;
+
+	nodeCost.assign(clusters.size() * NavMaxClusterNodes, 0.0f);
+	nodeParent.assign(clusters.size() * NavMaxClusterNodes, -1);
+	nodeVisit.assign(clusters.size() * NavMaxClusterNodes, 0);
+	searchStamp = 0;
+
+	for (int i = 0; i < NavGoalSearches; i++)
+	{
+		goalSearches[i].cell = -1;
+		goalSearches[i].lastUse = 0;
+	}
+	goalSearchClock = 0;
+
+	cache.assign(NavCacheSize, CacheEntry());
+	for (size_t i = 0; i < cache.size(); i++)
+		cache[i].startCell = -1;
+	memset(&stats, 0, sizeof(stats));
+}
+
+void NavGrid::AddBlocker(const NavFootprint &footprint)
+{
+	StampFootprint(footprint, 1);
+}
+
+void NavGrid::RemoveBlocker(const NavFootprint &footprint)
+{
+	StampFootprint(footprint, -1);
+}
+
+// Every cell whose centre lies in the footprint grown by the agent radius
+void NavGrid::StampFootprint(const NavFootprint &footprint, int delta)
+{
+	float s, c;
+	FastSinCosDegrees(footprint.angle, s, c);
+	float hx = footprint.halfX + agentRadius, hz = footprint.halfZ + agentRadius;
+	float extentX = fabsf(c) * hx + fabsf(s) * hz, extentZ = fabsf(s) * hx + fabsf(c) * hz;
+
+	int x0 = std::max(0, (int)floorf((footprint.x - extentX - minX) / cellSize));
+	int x1 = std::min(width - 1, (int)floorf((footprint.x + extentX - minX) / cellSize));
+	int z0 = std::max(0, (int)floorf((footprint.z - extentZ - minZ) / cellSize));
+	int z1 = std::min(height - 1, (int)floorf((footprint.z + extentZ - minZ) / cellSize));
+
+	for (int cz = z0; cz <= z1; cz++)
+	{
+		for (int cx = x0; cx <= x1; cx++)
+		{
+			// Back into the footprint's frame, the inverse of the glRotatef rotation
+			float wx = minX + (cx + 0.5f) * cellSize - footprint.x;
+			float wz = minZ + (cz + 0.5f) * cellSize - footprint.z;
+			float lx = c * wx - s * wz, lz = s * wx + c * wz;
+			if (fabsf(lx) > hx || fabsf(lz) > hz)
+				continue;
+
+			uint16_t &count = blockers[(size_t)cz * width + cx];
+			if (delta < 0 && count == 0)
+				continue;
+			bool wasBlocked = count > 0;
+			count = (uint16_t)(count + delta);
+			if (wasBlocked != (count > 0))
+			{
+				Cluster &cluster = clusters[(cz / NavClusterSize) * clustersX + cx / NavClusterSize];
+				cluster.dirty = true;
+				cluster.gainedBlocked = cluster.gainedBlocked || !wasBlocked;
+				anyDirty = true;
+			}
+		}
+	}
+}
+
+bool NavGrid::CellWalkable(int cx, int cz) const
+{
+	return cx >= 0 && cz >= 0 && cx < width && cz < height && blockers[(size_t)cz * width + cx] == 0;
+}
+
+bool NavGrid::IsWalkable(float x, float z) const
+{
+	return CellWalkable((int)floorf((x - minX) / cellSize), (int)floorf((z - minZ) / cellSize));
+}
+
+int NavGrid::ClusterOf(int cell) const
+{
+	return ((cell / width) / NavClusterSize) * clustersX + (cell % width) / NavClusterSize;
+}
+
+// Cells inside a cluster are numbered row by row from its corner
+int NavGrid::LocalCell(const Cluster &cluster, int cell) const
+{
+	return (cell / width - cluster.z0) * NavClusterSize + cell % width - cluster.x0;
+}
+
+int NavGrid::GridCell(const Cluster &cluster, int local) const
+{
+	return (cluster.z0 + local / NavClusterSize) * width + cluster.x0 + local % NavClusterSize;
+}
+
+int NavGrid::NodeIndex(const Cluster &cluster, int cell) const
+{
+	for (size_t i = 0; i < cluster.nodes.size(); i++)
+	{
+		if (cluster.nodes[i] == cell)
+			return (int)i;
+	}
+	return -1;
+}
+
+// Changed clusters and their neighbours, whose shared borders changed with them
+void NavGrid::RebuildDirtyClusters()
+{
+	if (!anyDirty)
+		return;
+
+	std::vector<char> rebuild(clusters.size(), 0);
+	uint32_t stamp = ++changeCounter;
+	for (int cz = 0; cz < clustersZ; cz++)
+	{
+		for (int cx = 0; cx < clustersX; cx++)
+		{
+			Cluster &cluster = clusters[cz * clustersX + cx];
+			if (!cluster.dirty)
+				continue;
+			cluster.dirty = false;
+			cluster.changedStamp = stamp;
+			if (cluster.gainedBlocked)
+				cluster.blockedStamp = stamp;
+			cluster.gainedBlocked = false;
+			rebuild[cz * clustersX + cx] = 1;
+			if (cx > 0) rebuild[cz * clustersX + cx - 1] = 1;
+			if (cx + 1 < clustersX) rebuild[cz * clustersX + cx + 1] = 1;
+			if (cz > 0) rebuild[(cz - 1) * clustersX + cx] = 1;
+			if (cz + 1 < clustersZ) rebuild[(cz + 1) * clustersX + cx] = 1;
+		}
+	}
+
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		if (rebuild[i])
+		{
+			RebuildCluster((int)i);
+			stats.clusterRebuilds++;
+		}
+	}
+
+	stats.abstractNodes = 0;
+	for (size_t i = 0; i < clusters.size(); i++)
+		stats.abstractNodes += (int)clusters[i].nodes.size();
+	anyDirty = false;
+}
+
+void NavGrid::RebuildCluster(int index)
+{
+	Cluster &cluster = clusters[index];
+	cluster.nodes.clear();
+	cluster.links.clear();
+
+	// Every border is walked in the same order from both of its clusters, so both
+	// sides agree on where the entrances are
+	int cx = index % clustersX, cz = index / clustersX;
+	int sizeX = cluster.x1 - cluster.x0, sizeZ = cluster.z1 - cluster.z0;
+	if (cz > 0)
+		AddBorderEntrances(cluster, cluster.x0, cluster.z0, 1, 0, 0, -1, sizeX);
+	if (cz + 1 < clustersZ)
+		AddBorderEntrances(cluster, cluster.x0, cluster.z1 - 1, 1, 0, 0, 1, sizeX);
+	if (cx > 0)
+		AddBorderEntrances(cluster, cluster.x0, cluster.z0, 0, 1, -1, 0, sizeZ);
+	if (cx + 1 < clustersX)
+		AddBorderEntrances(cluster, cluster.x1 - 1, cluster.z0, 0, 1, 1, 0, sizeZ);
+
+	// Distances between entrances, and the search tree of each, which refines a step
+	// between two entrances without searching again
+	int n = (int)cluster.nodes.size();
+	cluster.distances.assign((size_t)n * n, NavUnreachable);
+	cluster.trees.resize((size_t)n * NavClusterCells);
+	float dist[NavClusterCells];
+	int parent[NavClusterCells];
+	for (int i = 0; i < n; i++)
+	{
+		SearchCluster(index, cluster.nodes[i], dist, parent);
+		for (int j = 0; j < n; j++)
+			cluster.distances[i * n + j] = dist[LocalCell(cluster, cluster.nodes[j])];
+		for (int k = 0; k < NavClusterCells; k++)
+			cluster.trees[i * NavClusterCells + k] = (uint16_t)parent[k];
+	}
+}
+
+// Walk length cells from (x, z) in steps of (stepX, stepZ). Runs of cells that are open
+// on both sides of the border get one entrance in the middle, long runs one at each end.
+void NavGrid::AddBorderEntrances(Cluster &cluster, int x, int z, int stepX, int stepZ, int acrossX, int acrossZ,
+	int length)
+{
+	int spanStart = -1;
+	for (int i = 0; i <= length; i++)
+	{
+		int cx = x + i * stepX, cz = z + i * stepZ;
+		bool open = i < length && CellWalkable(cx, cz) && CellWalkable(cx + acrossX, cz + acrossZ);
+		if (open)
+		{
+			if (spanStart < 0)
+				spanStart = i;
+			continue;
+		}
+		if (spanStart < 0)
+			continue;
+
+		int spanLength = i - spanStart;
+		int picks[2] = { spanStart + spanLength / 2, -1 };
+		if (spanLength >= NavLongEntrance)
+		{
+			picks[0] = spanStart;
+			picks[1] = i - 1;
+		}
+		for (int p = 0; p < 2 && picks[p] >= 0; p++)
+		{
+			int cell = (z + picks[p] * stepZ) * width + x + picks[p] * stepX;
+			int node = NodeIndex(cluster, cell);
+			if (node < 0)
+			{
+				if ((int)cluster.nodes.size() >= NavMaxClusterNodes)
+					continue;
+				node = (int)cluster.nodes.size();
+				cluster.nodes.push_back(cell);
+			}
+			Link link = { node, cell + acrossZ * width + acrossX };
+			cluster.links.push_back(link);
+		}
+		spanStart = -1;
+	}
+}
+
+// Dijkstra from sourceCell over the cluster's cells, 8-connected without cutting
+// corners. dist and parent are indexed by cluster-local cell, parent leads to the source.
+void NavGrid::SearchCluster(int index, int sourceCell, float *dist, int *parent) const
+{
+	const Cluster &cluster = clusters[index];
+	for (int i = 0; i < NavClusterCells; i++)
+	{
+		dist[i] = NavUnreachable;
+		parent[i] = -1;
+	}
+
+	// The cluster's cells with a closed ring around them, so neighbours need no bounds checks
+	const int pitch = NavClusterSize + 2;
+	unsigned char open[pitch * pitch];
+	memset(open, 0, sizeof(open));
+	for (int z = cluster.z0; z < cluster.z1; z++)
+	{
+		const uint16_t *row = &blockers[(size_t)z * width];
+		for (int x = cluster.x0; x < cluster.x1; x++)
+			open[(z - cluster.z0 + 1) * pitch + x - cluster.x0 + 1] = row[x] == 0;
+	}
+
+	static const int offsets[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+	ClusterHeap heap;
+	int source = LocalCell(cluster, sourceCell);
+	dist[source] = 0.0f;
+	heap.Push(0.0f, source);
+	while (heap.count > 0)
+	{
+		ClusterHeap::Entry top = heap.Pop();
+		if (top.cost > dist[top.cell])
+			continue;
+
+		int lx = top.cell % NavClusterSize, lz = top.cell / NavClusterSize;
+		const unsigned char *here = &open[(lz + 1) * pitch + lx + 1];
+		for (int d = 0; d < 8; d++)
+		{
+			int dx = offsets[d][0], dz = offsets[d][1];
+			if (!here[dz * pitch + dx])
+				continue;
+			if (d >= 4 && (!here[dx] || !here[dz * pitch]))
+				continue;
+
+			int local = top.cell + dz * NavClusterSize + dx;
+			float cost = top.cost + (d >= 4 ? NavDiagonal : 1.0f);
+			if (cost < dist[local])
+			{
+				dist[local] = cost;
+				parent[local] = top.cell;
+				heap.Push(cost, local);
+			}
+		}
+	}
+}
+
+int NavGrid::NearestWalkableCell(float x, float z) const
+{
+	int cx = (int)floorf((x - minX) / cellSize), cz = (int)floorf((z - minZ) / cellSize);
+	if (cx < 0 || cz < 0 || cx >= width || cz >= height)
+		return -1;
+	if (CellWalkable(cx, cz))
+		return cz * width + cx;
+
+	int best = -1, bestDistance = 0;
+	for (int dz = -NavSnapCells; dz <= NavSnapCells; dz++)
+	{
+		for (int dx = -NavSnapCells; dx <= NavSnapCells; dx++)
+		{
+			int distance = dx * dx + dz * dz;
+			if (CellWalkable(cx + dx, cz + dz) && (best < 0 || distance < bestDistance))
+			{
+				best = (cz + dz) * width + cx + dx;
+				bestDistance = distance;
+			}
+		}
+	}
+	return best;
+}
+
+// Every cell the segment between the two cell centres touches must be walkable,
+// both cells beside it where it passes exactly through a corner
+bool NavGrid::LineOfSight(int fromCell, int toCell) const
+{
+	int x = fromCell % width, z = fromCell / width;
+	int x1 = toCell % width, z1 = toCell / width;
+	int dx = abs(x1 - x), dz = abs(z1 - z);
+	int sx = x1 > x ? 1 : -1, sz = z1 > z ? 1 : -1;
+	int error = dx - dz;
+	dx *= 2;
+	dz *= 2;
+	for (int n = 1 + abs(x1 - x) + abs(z1 - z); n > 0; n--)
+	{
+		if (!CellWalkable(x, z))
+			return false;
+		if (error > 0)
+		{
+			x += sx;
+			error -= dz;
+		}
+		else if (error < 0)
+		{
+			z += sz;
+			error += dx;
+		}
+		else
+		{
+			if (!CellWalkable(x + sx, z) || !CellWalkable(x, z + sz))
+				return false;
+			x += sx;
+			z += sz;
+			error += dx - dz;
+			n--;
+		}
+	}
+	return true;
+}
+
+// Bots tend to share a few goals, so the goal side of recent searches is kept
+const NavGrid::GoalSearch &NavGrid::SearchGoal(int goalCell)
+{
+	int cluster = ClusterOf(goalCell);
+	GoalSearch *oldest = &goalSearches[0];
+	for (int i = 0; i < NavGoalSearches; i++)
+	{
+		GoalSearch &search = goalSearches[i];
+		if (search.cell == goalCell && clusters[cluster].changedStamp <= search.stamp)
+		{
+			search.lastUse = ++goalSearchClock;
+			return search;
+		}
+		if (search.lastUse < oldest->lastUse)
+			oldest = &search;
+	}
+
+	oldest->cell = goalCell;
+	oldest->stamp = changeCounter;
+	oldest->lastUse = ++goalSearchClock;
+	SearchCluster(cluster, goalCell, oldest->dist, oldest->parent);
+	return *oldest;
+}
+
+void NavGrid::PushOpen(float f, float g, int node)
+{
+	OpenEntry entry = { f, g, node };
+	openNodes.push_back(entry);
+	std::push_heap(openNodes.begin(), openNodes.end(), std::greater<OpenEntry>());
+}
+
+// Like LineOfSight() between any two points: walks every cell the segment crosses
+bool NavGrid::SegmentClear(float x0, float z0, float x1, float z1) const
+{
+	float fx = (x0 - minX) / cellSize, fz = (z0 - minZ) / cellSize;
+	float dx = (x1 - minX) / cellSize - fx, dz = (z1 - minZ) / cellSize - fz;
+	int x = (int)floorf(fx), z = (int)floorf(fz);
+	int endX = (int)floorf(fx + dx), endZ = (int)floorf(fz + dz);
+	int sx = dx > 0.0f ? 1 : -1, sz = dz > 0.0f ? 1 : -1;
+
+	// Parameter along the segment of the next vertical and horizontal cell edge
+	float stepX = dx != 0.0f ? fabsf(1.0f / dx) : NavUnreachable;
+	float stepZ = dz != 0.0f ? fabsf(1.0f / dz) : NavUnreachable;
+	float nextX = dx != 0.0f ? (dx > 0.0f ? x + 1 - fx : fx - x) * stepX : NavUnreachable;
+	float nextZ = dz != 0.0f ? (dz > 0.0f ? z + 1 - fz : fz - z) * stepZ : NavUnreachable;
+
+	for (int n = abs(endX - x) + abs(endZ - z) + 1; n > 0; n--)
+	{
+		if (!CellWalkable(x, z))
+			return false;
+		if (nextX < nextZ)
+		{
+			x += sx;
+			nextX += stepX;
+		}
+		else if (nextZ < nextX)
+		{
+			z += sz;
+			nextZ += stepZ;
+		}
+		else
+		{
+			if (!CellWalkable(x + sx, z) || !CellWalkable(x, z + sz))
+				return false;
+			x += sx;
+			z += sz;
+			nextX += stepX;
+			nextZ += stepZ;
+			n--;
+		}
+	}
+	return true;
+}
+
+// Cell path from startCell to goalCell: the start and goal are joined to the entrances
+// of their clusters, the abstract graph is searched, then each step is refined
+bool NavGrid::Search(int startCell, int goalCell, std::vector<int> &cells)
+{
+	cells.clear();
+	int startCluster = ClusterOf(startCell), goalCluster = ClusterOf(goalCell);
+	const Cluster &first = clusters[startCluster];
+	const Cluster &last = clusters[goalCluster];
+
+	float startDist[NavClusterCells];
+	int startParent[NavClusterCells];
+	SearchCluster(startCluster, startCell, startDist, startParent);
+	const GoalSearch &goalSearch = SearchGoal(goalCell);
+	const float *goalDist = goalSearch.dist;
+	const int *goalParent = goalSearch.parent;
+
+	if (++searchStamp == 0)
+	{
+		std::fill(nodeVisit.begin(), nodeVisit.end(), 0);
+		searchStamp = 1;
+	}
+
+	int goalX = goalCell % width, goalZ = goalCell / width;
+	std::vector<OpenEntry> &open = openNodes;
+	open.clear();
+	float best = NavUnreachable;
+	int bestFrom = -1;		// last abstract node before the goal, -1 for a path within one cluster
+
+	if (startCluster == goalCluster)
+	{
+		int local = LocalCell(first, goalCell);
+		if (startDist[local] < NavUnreachable)
+		{
+			best = startDist[local];
+			PushOpen(best, best, -1);
+		}
+	}
+
+	for (size_t i = 0; i < first.nodes.size(); i++)
+	{
+		int cell = first.nodes[i];
+		float g = startDist[LocalCell(first, cell)];
+		if (g >= NavUnreachable)
+			continue;
+		int id = startCluster * NavMaxClusterNodes + (int)i;
+		nodeCost[id] = g;
+		nodeParent[id] = -1;
+		nodeVisit[id] = searchStamp;
+		PushOpen(g + Octile(cell % width - goalX, cell / width - goalZ), g, id);
+	}
+
+	bool found = false;
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<OpenEntry>());
+		OpenEntry top = open.back();
+		open.pop_back();
+		if (top.node < 0)
+		{
+			found = top.g <= best;
+			if (found)
+				break;
+			continue;
+		}
+		if (top.g > nodeCost[top.node])
+			continue;
+
+		int clusterIndex = top.node / NavMaxClusterNodes, node = top.node % NavMaxClusterNodes;
+		const Cluster &cluster = clusters[clusterIndex];
+		int cell = cluster.nodes[node];
+
+		if (clusterIndex == goalCluster)
+		{
+			float toGoal = goalDist[LocalCell(last, cell)];
+			if (toGoal < NavUnreachable && top.g + toGoal < best)
+			{
+				best = top.g + toGoal;
+				bestFrom = top.node;
+				PushOpen(best, best, -1);
+			}
+		}
+
+		int n = (int)cluster.nodes.size();
+		for (int j = 0; j < n; j++)
+		{
+			float edge = cluster.distances[node * n + j];
+			if (j == node || edge >= NavUnreachable)
+				continue;
+			int id = clusterIndex * NavMaxClusterNodes + j;
+			float g = top.g + edge;
+			if (nodeVisit[id] != searchStamp || g < nodeCost[id])
+			{
+				int next = cluster.nodes[j];
+				nodeCost[id] = g;
+				nodeParent[id] = top.node;
+				nodeVisit[id] = searchStamp;
+				PushOpen(g + Octile(next % width - goalX, next / width - goalZ), g, id);
+			}
+		}
+
+		for (size_t l = 0; l < cluster.links.size(); l++)
+		{
+			if (cluster.links[l].node != node)
+				continue;
+			int partnerCell = cluster.links[l].partnerCell;
+			int partnerCluster = ClusterOf(partnerCell);
+			int partner = NodeIndex(clusters[partnerCluster], partnerCell);
+			if (partner < 0)
+				continue;
+			int id = partnerCluster * NavMaxClusterNodes + partner;
+			float g = top.g + 1.0f;
+			if (nodeVisit[id] != searchStamp || g < nodeCost[id])
+			{
+				nodeCost[id] = g;
+				nodeParent[id] = top.node;
+				nodeVisit[id] = searchStamp;
+				PushOpen(g + Octile(partnerCell % width - goalX, partnerCell / width - goalZ), g, id);
+			}
+		}
+	}
+	if (!found)
+		return false;
+
+	// Abstract route, start side first
+	std::vector<int> route;
+	for (int id = bestFrom; id >= 0; id = nodeParent[id])
+		route.push_back(id);
+	std::reverse(route.begin(), route.end());
+
+	// Start to the first entrance (or the goal), following the start search back
+	int firstTarget = route.empty() ? goalCell : clusters[route[0] / NavMaxClusterNodes].nodes[route[0] % NavMaxClusterNodes];
+	for (int local = LocalCell(first, firstTarget); local >= 0; local = startParent[local])
+		cells.push_back(GridCell(first, local));
+	std::reverse(cells.begin(), cells.end());
+
+	for (size_t i = 1; i < route.size(); i++)
+	{
+		int fromCluster = route[i - 1] / NavMaxClusterNodes, toCluster = route[i] / NavMaxClusterNodes;
+		int fromCell = clusters[fromCluster].nodes[route[i - 1] % NavMaxClusterNodes];
+		int toCell = clusters[toCluster].nodes[route[i] % NavMaxClusterNodes];
+		if (fromCluster != toCluster)
+		{
+			cells.push_back(toCell);
+			continue;
+		}
+
+		// Within a cluster: the far entrance's tree leads forwards
+		const Cluster &cluster = clusters[fromCluster];
+		const uint16_t *tree = &cluster.trees[(route[i] % NavMaxClusterNodes) * NavClusterCells];
+		for (int local = tree[LocalCell(cluster, fromCell)]; local != NavNoParent; local = tree[local])
+			cells.push_back(GridCell(cluster, local));
+	}
+
+	// Last entrance to the goal, the goal search already leads towards the goal
+	if (!route.empty())
+	{
+		for (int local = goalParent[LocalCell(last, cells.back())]; local >= 0; local = goalParent[local])
+			cells.push_back(GridCell(last, local));
+	}
+	return true;
+}
+
+bool NavGrid::FindPath(float startX, float startZ, float goalX, float goalZ, NavPath &path)
+{
+	stats.queries++;
+	path.points.clear();
+
+	int startCell = NearestWalkableCell(startX, startZ);
+	int goalCell = NearestWalkableCell(goalX, goalZ);
+	if (startCell < 0 || goalCell < 0)
+	{
+		stats.failures++;
+		return false;
+	}
+
+	// Bring the graph and the cluster stamps up to date before trusting the cache
+	RebuildDirtyClusters();
+
+	uint32_t hash = (uint32_t)startCell * 2654435761u ^ (uint32_t)goalCell * 40503u;
+	CacheEntry &entry = cache[(hash ^ (hash >> 15)) & (NavCacheSize - 1)];
+	bool valid = entry.startCell == startCell && entry.goalCell == goalCell;
+	if (valid && !entry.found)
+		valid = entry.stamp == changeCounter;
+	for (size_t i = 0; valid && i < entry.clusters.size(); i++)
+		valid = clusters[entry.clusters[i]].changedStamp <= entry.stamp;
+
+	if (!valid)
+	{
+		std::vector<int> cells;
+		entry.startCell = startCell;
+		entry.goalCell = goalCell;
+		entry.stamp = changeCounter;
+		entry.found = Search(startCell, goalCell, cells);
+		entry.clusters.clear();
+		entry.path.points.clear();
+
+		if (entry.found)
+		{
+			// Clusters crossed, for invalidation
+			for (size_t i = 0; i < cells.size(); i++)
+			{
+				int cluster = ClusterOf(cells[i]);
+				if (entry.clusters.empty() || entry.clusters.back() != cluster)
+					entry.clusters.push_back(cluster);
+			}
+
+			// String pulling: from each waypoint go straight to the furthest cell in sight
+			size_t anchor = 0;
+			entry.path.points.push_back(minX + (cells[0] % width + 0.5f) * cellSize);
+			entry.path.points.push_back(minZ + (cells[0] / width + 0.5f) * cellSize);
+			while (anchor + 1 < cells.size())
+			{
+				size_t next = anchor + 1;
+				while (next + 1 < cells.size() && LineOfSight(cells[anchor], cells[next + 1]))
+					next++;
+				entry.path.points.push_back(minX + (cells[next] % width + 0.5f) * cellSize);
+				entry.path.points.push_back(minZ + (cells[next] / width + 0.5f) * cellSize);
+				anchor = next;
+			}
+			if (entry.path.points.size() == 2)
+			{
+				// Copied first, inserting a vector's own range into it is undefined
+				float x = entry.path.points[0], z = entry.path.points[1];
+				entry.path.points.push_back(x);
+				entry.path.points.push_back(z);
+			}
+		}
+	}
+	else
+		stats.cacheHits++;
+
+	if (!entry.found)
+	{
+		stats.failures++;
+		return false;
+	}
+
+	// Cells are shared by nearby starts and goals, the ends are the caller's own points.
+	// The first and last cell centres stay where the way past them is not straight,
+	// checked from the last point kept. With only the two, both may go if the way
+	// from start to goal is straight.
+	const std::vector<float> &points = entry.path.points;
+	size_t count = points.size();
+	path.points.push_back(startX);
+	path.points.push_back(startZ);
+	if (count > 4 || !SegmentClear(startX, startZ, goalX, goalZ))
+	{
+		if (!SegmentClear(startX, startZ, points[2], points[3]))
+			path.points.insert(path.points.end(), points.begin(), points.begin() + 2);
+		path.points.insert(path.points.end(), points.begin() + 2, points.end() - 2);
+		size_t last = path.points.size();
+		if (!SegmentClear(path.points[last - 2], path.points[last - 1], goalX, goalZ))
+			path.points.insert(path.points.end(), points.end() - 2, points.end());
+	}
+	path.points.push_back(goalX);
+	path.points.push_back(goalZ);
+	return true;
+}
+
+static float RandomRange(float low, float high)
+{
+	return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
+
+static bool PathClear(const NavGrid &grid, const NavPath &path)
+{
+	for (int i = 0; i + 1 < path.GetPointCount(); i++)
+	{
+		const float *leg = &path.points[2 * i];
+		if (!grid.SegmentClear(leg[0], leg[1], leg[2], leg[3]))
+			return false;
+	}
+	return true;
+}
+
+int CheckNavGridPaths(int numQueries, float halfSize)
+{
+	int bad = 0, found = 0;
+	NavPath path;
+
+	// Start and goal cells touch, but the straight line between the points clips the box
+	NavGrid grid;
+	grid.Build(-60.0f, -60.0f, 60.0f, 60.0f, 2.0f, 1.0f);
+	NavFootprint box = { 14.1f, 47.6f, 3.8f, 1.8f, 73.0f };
+	grid.AddBlocker(box);
+	if (!grid.FindPath(17.0f, 50.4f, 14.5f, 54.3f, path) || !PathClear(grid, path))
+	{
+		printf("NavGrid check: the two cell path crosses a blocked cell\n");
+		bad++;
+	}
+
+	// About one obstacle per 20 x 20 of floor, trips of up to 6 either way
+	srand(4321);
+	grid.Build(-halfSize, -halfSize, halfSize, halfSize, 2.0f, 1.0f);
+	int numObstacles = (int)(4.0f * halfSize * halfSize / 400.0f);
+	for (int i = 0; i < numObstacles; i++)
+	{
+		NavFootprint footprint = { RandomRange(-halfSize, halfSize), RandomRange(-halfSize, halfSize),
+			RandomRange(0.5f, 4.0f), RandomRange(0.5f, 4.0f), RandomRange(0.0f, 90.0f) };
+		grid.AddBlocker(footprint);
+	}
+	for (int i = 0; i < numQueries; i++)
+	{
+		float startX, startZ, goalX, goalZ;
+		do
+		{
+			startX = RandomRange(-halfSize, halfSize);
+			startZ = RandomRange(-halfSize, halfSize);
+		} while (!grid.IsWalkable(startX, startZ));
+		do
+		{
+			goalX = startX + RandomRange(-6.0f, 6.0f);
+			goalZ = startZ + RandomRange(-6.0f, 6.0f);
+		} while (!grid.IsWalkable(goalX, goalZ));
+		if (!grid.FindPath(startX, startZ, goalX, goalZ, path))
+			continue;
+		found++;
+		if (!PathClear(grid, path))
+		{
+			if (bad < 5)
+				printf("NavGrid check: path from (%g, %g) to (%g, %g) crosses a blocked cell\n", startX, startZ, goalX, goalZ);
+			bad++;
+		}
+	}
+	printf("NavGrid check: %d bad paths, %d random trips found\n", bad, found);
+	return bad;
+}
+
+double BenchmarkNavGrid(int numBots, int numTicks, float halfSize)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	srand(1234);
+
+	// About one obstacle per 20 x 20 of floor
+	int numObstacles = (int)(4.0f * halfSize * halfSize / 400.0f);
+	std::vector<NavFootprint> obstacles(numObstacles);
+	for (int i = 0; i < numObstacles; i++)
+	{
+		NavFootprint &footprint = obstacles[i];
+		footprint.x = RandomRange(-halfSize, halfSize);
+		footprint.z = RandomRange(-halfSize, halfSize);
+		footprint.halfX = RandomRange(1.0f, 4.0f);
+		footprint.halfZ = RandomRange(1.0f, 4.0f);
+		footprint.angle = RandomRange(0.0f, 90.0f);
+	}
+
+	Clock::time_point start = Clock::now();
+	NavGrid grid;
+	grid.Build(-halfSize, -halfSize, halfSize, halfSize, 2.0f, 2.0f);
+	for (int i = 0; i < numObstacles; i++)
+		grid.AddBlocker(obstacles[i]);
+	NavPath path;
+	grid.FindPath(0.0f, 0.0f, 0.0f, 0.0f, path);		// builds the abstract graph
+	double buildSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	// Bots chase one of four targets, walking their path a step per tick
+	std::vector<float> bots(numBots * 2);
+	for (int i = 0; i < numBots; i++)
+	{
+		do
+		{
+			bots[2 * i] = RandomRange(-halfSize, halfSize);
+			bots[2 * i + 1] = RandomRange(-halfSize, halfSize);
+		} while (!grid.IsWalkable(bots[2 * i], bots[2 * i + 1]));
+	}
+	float targets[4][2];
+	for (int t = 0; t < 4; t++)
+	{
+		do
+		{
+			targets[t][0] = RandomRange(-halfSize, halfSize);
+			targets[t][1] = RandomRange(-halfSize, halfSize);
+		} while (!grid.IsWalkable(targets[t][0], targets[t][1]));
+	}
+
+	NavStats before = grid.GetStats();
+	start = Clock::now();
+	for (int tick = 0; tick < numTicks; tick++)
+	{
+		for (int i = 0; i < numBots; i++)
+		{
+			float *bot = &bots[2 * i];
+			if (!grid.FindPath(bot[0], bot[1], targets[i % 4][0], targets[i % 4][1], path))
+				continue;
+			float dx = path.points[2] - bot[0], dz = path.points[3] - bot[1];
+			float length = sqrtf(dx * dx + dz * dz);
+			float step = length < 0.5f ? length : 0.5f;
+			if (length > 0.0f)
+			{
+				bot[0] += dx / length * step;
+				bot[1] += dz / length * step;
+			}
+		}
+	}
+	double querySeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	NavStats after = grid.GetStats();
+	uint64_t queries = after.queries - before.queries;
+	uint64_t hits = after.cacheHits - before.cacheHits;
+
+	// Obstacles destroyed one at a time, each followed by a fresh query across the arena
+	int removals = numObstacles < 50 ? numObstacles : 50;
+	start = Clock::now();
+	for (int i = 0; i < removals; i++)
+	{
+		grid.RemoveBlocker(obstacles[i]);
+		grid.FindPath(-0.9f * halfSize, -0.9f * halfSize, 0.9f * halfSize, 0.9f * halfSize, path);
+	}
+	double removalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	double queriesPerSecond = queries / (querySeconds > 0.0 ? querySeconds : 1e-9);
+	printf("NavGrid benchmark: %dx%d cells, %d obstacles, %d abstract nodes, build %.2f ms\n", grid.GetWidth(),
+		grid.GetHeight(), numObstacles, grid.GetStats().abstractNodes, buildSeconds * 1000.0);
+	printf("  %d bots x %d ticks: %.0f queries/s, %.1f%% from the path cache, %.2f ms per tick\n", numBots, numTicks,
+		queriesPerSecond, queries ? 100.0 * hits / queries : 0.0, querySeconds * 1000.0 / numTicks);
+	printf("  obstacle removed and path found again: %.3f ms each\n", removals ? removalSeconds * 1000.0 / removals : 0.0);
+	return queriesPerSecond;
+}
@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	NavGrid.h
+//	Walkable grid over the arena ground with hierarchical A* (HPA*) for bot AI.
+//	Obstacles stamp their footprints, grown by the agent radius, into per-cell
+//	blocker counts. The grid is cut into NavClusterSize square clusters; entrances
+//	along cluster borders become the nodes of an abstract graph whose intra-cluster
+//	edges are precomputed, so a query searches a few hundred nodes instead of the
+//	whole grid and then refines the route cluster by cluster. Adding or removing a
+//	footprint only rebuilds the clusters it touches (and their neighbours' shared
+//	borders), lazily at the next query.
+//
+//	Answers go through a path cache keyed on start and goal cell. A cached path is
+//	served until a cluster it crosses changes, so bots may ask for their path every
+//	tick. Not thread-safe: one thread queries and edits a grid.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef NAVGRID_H
+#define NAVGRID_H
+
+#include <stdint.h>
+#include <vector>
+
+// Cells per cluster side
+const int NavClusterSize = 16;
+
+// Recent goal-side cluster searches kept for reuse
+const int NavGoalSearches = 8;
+
+// Box on the ground centred at (x, z), rotated angle degrees around y like glRotatef
+struct NavFootprint
+{
+	float x, z;
+	float halfX, halfZ;
+	float angle;
+};
+
+// Waypoints from start to goal, x and z of each
+struct NavPath
+{
+	std::vector<float> points;
+
+	int GetPointCount() const { return (int)points.size() / 2; }
+};
+
+struct NavStats
+{
+	uint64_t queries;
+	uint64_t cacheHits;
+	uint64_t failures;			// no path, or start or goal off the grid
+	uint64_t clusterRebuilds;
+	int abstractNodes;
+};
+
+class NavGrid
+{
+public:
+	NavGrid();
+
+	// All cells walkable. Footprints are grown by agentRadius so that a path keeps
+	// the agent's centre, and with it the whole agent, clear of obstacles.
+	void Build(float minX, float minZ, float maxX, float maxZ, float cellSize, float agentRadius);
+
+	// Blockers are counted per cell so overlapping footprints can come and go in any
+	// order. RemoveBlocker() takes the footprint that was added.
+	void AddBlocker(const NavFootprint &footprint);
+	void RemoveBlocker(const NavFootprint &footprint);
+
+	bool IsWalkable(float x, float z) const;
+	// Every cell the segment between the two points crosses is walkable
+	bool SegmentClear(float x0, float z0, float x1, float z1) const;
+
+	// Cells are numbered row by row, z * width + x. The cell at (x, z), or when that is
+	// blocked the nearest walkable one within a few cells, -1 if there is none.
+	int NearestWalkableCell(float x, float z) const;
+	bool IsCellWalkable(int cx, int cz) const { return CellWalkable(cx, cz); }
+
+	// Applies added and removed blockers to the clusters, FindPath() does this itself.
+	// Each call that finds changes advances the change counter and stamps the changed
+	// clusters with it; blockedStamp also records changes that blocked cells, which
+	// make anything derived from the grid longer rather than only shorter.
+	void Update() { RebuildDirtyClusters(); }
+	uint32_t GetChangeCounter() const { return changeCounter; }
+	uint32_t GetClusterChangedStamp(int cluster) const { return clusters[cluster].changedStamp; }
+	uint32_t GetClusterBlockedStamp(int cluster) const { return clusters[cluster].blockedStamp; }
+
+	// Line-of-sight smoothed waypoints, starting at (startX, startZ) and ending at the
+	// goal. A start or goal inside a grown footprint moves to the nearest walkable cell
+	// within a few cells. Returns false, leaving path empty, when there is no path.
+	bool FindPath(float startX, float startZ, float goalX, float goalZ, NavPath &path);
+
+	const NavStats &GetStats() const { return stats; }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetClustersX() const { return clustersX; }
+	int GetClustersZ() const { return clustersZ; }
+	float GetMinX() const { return minX; }
+	float GetMinZ() const { return minZ; }
+	float GetCellSize() const { return cellSize; }
+
+private:
+	// An entrance cell and the cell across the border it leads to
+	struct Link
+	{
+		int node;			// index into Cluster::nodes
+		int partnerCell;
+	};
+
+	struct Cluster
+	{
+		int x0, z0, x1, z1;				// cell bounds, exclusive ends
+		std::vector<int> nodes;			// entrance cells
+		std::vector<Link> links;
+		std::vector<float> distances;	// nodes x nodes, within the cluster
+		std::vector<uint16_t> trees;	// per node, every local cell's parent towards it
+		uint32_t changedStamp;			// change counter when the cluster last changed
+		uint32_t blockedStamp;			// same, for the last change that blocked a cell
+		bool dirty;
+		bool gainedBlocked;
+	};
+
+	// Open list entry of the abstract search
+	struct OpenEntry
+	{
+		float f, g;
+		int node;		// -1 is the goal
+
+		bool operator>(const OpenEntry &rhs) const { return f > rhs.f; }
+	};
+
+	// Search from a goal over its cluster
+	struct GoalSearch
+	{
+		int cell;
+		uint32_t stamp;
+		uint32_t lastUse;
+		float dist[NavClusterSize * NavClusterSize];
+		int parent[NavClusterSize * NavClusterSize];
+	};
+
+	struct CacheEntry
+	{
+		int startCell, goalCell;
+		uint32_t stamp;
+		bool found;
+		std::vector<int> clusters;		// clusters the path crosses
+		NavPath path;
+	};
+
+	void StampFootprint(const NavFootprint &footprint, int delta);
+	void RebuildDirtyClusters();
+	void RebuildCluster(int cluster);
+	void AddBorderEntrances(Cluster &cluster, int x, int z, int stepX, int stepZ, int acrossX, int acrossZ, int length);
+	void SearchCluster(int cluster, int sourceCell, float *dist, int *parent) const;
+	int ClusterOf(int cell) const;
+	int LocalCell(const Cluster &cluster, int cell) const;
+	int GridCell(const Cluster &cluster, int local) const;
+	int NodeIndex(const Cluster &cluster, int cell) const;
+	bool CellWalkable(int cx, int cz) const;
+	bool LineOfSight(int fromCell, int toCell) const;
+	void PushOpen(float f, float g, int node);
+	const GoalSearch &SearchGoal(int goalCell);
+	bool Search(int startCell, int goalCell, std::vector<int> &cells);
+
+	float minX, minZ;
+	float cellSize;
+	float agentRadius;
+	int width, height;
+	int clustersX, clustersZ;
+	std::vector<uint16_t> blockers;
+	std::vector<Cluster> clusters;
+	bool anyDirty;
+	uint32_t changeCounter;
+
+	// Abstract search state, node id = cluster * MaxNodes + node, reset by stamping
+	std::vector<OpenEntry> openNodes;
+	std::vector<float> nodeCost;
+	std::vector<int> nodeParent;
+	std::vector<uint32_t> nodeVisit;
+	uint32_t searchStamp;
+	GoalSearch goalSearches[NavGoalSearches];
+	uint32_t goalSearchClock;
+
+	std::vector<CacheEntry> cache;
+	NavStats stats;
+};
+
+// Random boxes over an arena of the given half size, numBots bots each asking for a
+// path every tick while walking it, then obstacles destroyed one by one. Prints and
+// returns path queries per second.
+double BenchmarkNavGrid(int numBots, int numTicks, float halfSize);
+
+// Checks that no leg of a path crosses a blocked cell: first a short trip whose cell
+// path is two cells with an obstacle beside the straight line, then numQueries random
+// short trips among random boxes. Prints and returns the number of bad paths.
+int CheckNavGridPaths(int numQueries, float halfSize);
+
+#endif	//NAVGRID_H
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "Net.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+static const uintptr_t InvalidSocket = (uintptr_t)INVALID_SOCKET;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+static const uintptr_t InvalidSocket = (uintptr_t)-1;
+#endif
+
+
+bool ParseNetAddress(const char *text, NetAddress &address)
+{
+	const char *colon = strrchr(text, ':');
+	if (!colon)
+		return false;
+
+	int port = atoi(colon + 1);
+	if (port <= 0 || port > 65535)
+		return false;
+
+	std::string host(text, colon - text);
+	if (host == "localhost")
+		host = "127.0.0.1";
+
+	unsigned int a, b, c, d;
+	char extra;
+	if (sscanf(host.c_str(), "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 || a > 255 || b > 255 || c > 255 || d > 255)
+		return false;
+
+	address.ip = (a << 24) | (b << 16) | (c << 8) | d;
+	address.port = (uint16_t)port;
+	return true;
+}
+
+bool InitNetworking()
+{
+#ifdef _WIN32
+	WSADATA data;
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+	return true;
+#endif
+}
+
+void ShutdownNetworking()
+{
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+uint32_t NetTimeMs()
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+UdpSocket::UdpSocket()
+{
+	handle = InvalidSocket;
+}
+
+UdpSocket::~UdpSocket()
+{
+	Close();
+}
+
+bool UdpSocket::Open(uint16_t port)
+{
+	Close();
+
+	handle = (uintptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (handle == InvalidSocket)
+		return false;
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(handle, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	// Never block the frame loop
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	bool ok = ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+	bool ok = fcntl((int)handle, F_SETFL, O_NONBLOCK) != -1;
+#endif
+	if (!ok)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void UdpSocket::Close()
+{
+	if (handle == InvalidSocket)
+		return;
+#ifdef _WIN32
+	closesocket(handle);
+#else
+	close((int)handle);
+#endif
+	handle = InvalidSocket;
+}
+
+bool UdpSocket::IsOpen() const
+{
+	return handle != InvalidSocket;
+}
+
+bool UdpSocket::Send(const NetAddress &to, const void *data, size_t size)
+{
+	if (handle == InvalidSocket)
+		return false;
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(to.ip);
+	address.sin_port = htons(to.port);
+	return sendto(handle, (const char*)data, (int)size, 0, (const sockaddr*)&address, sizeof(address)) == (int)size;
+}
+
+size_t UdpSocket::Receive(NetAddress &from, void *data, size_t size)
+{
+	if (handle == InvalidSocket)
+		return 0;
+
+	sockaddr_in address;
+	socklen_t addressSize = sizeof(address);
+	int received = (int)recvfrom(handle, (char*)data, (int)size, 0, (sockaddr*)&address, &addressSize);
+	if (received <= 0)
+		return 0;
+
+	from.ip = ntohl(address.sin_addr.s_addr);
+	from.port = ntohs(address.sin_port);
+	return (size_t)received;
+}
+
+
+LinkSimulator::LinkSimulator()
+{
+	latencyMs = 0;
+	jitterMs = 0;
+	lossRate = 0.0f;
+	dropped = 0;
+	randomState = 0x1234567u;
+}
+
+void LinkSimulator::Configure(uint32_t latencyMs, uint32_t jitterMs, float lossRate)
+{
+	this->latencyMs = latencyMs;
+	this->jitterMs = jitterMs;
+	this->lossRate = lossRate;
+}
+
+// Uniform in [0, 1)
+float LinkSimulator::Random()
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return (float)(randomState >> 8) / 16777216.0f;
+}
+
+void LinkSimulator::Send(UdpSocket &socket, const NetAddress &to, const void *data, size_t size, uint32_t nowMs)
+{
+	if (!IsEnabled())
+	{
+		socket.Send(to, data, size);
+		return;
+	}
+
+	if (Random() < lossRate)
+	{
+		dropped++;
+		return;
+	}
+
+	// Jitter can reorder packets, as it would on a real network
+	DelayedPacket packet;
+	int delay = (int)latencyMs + (int)((2.0f * Random() - 1.0f) * jitterMs);
+	packet.releaseMs = nowMs + (delay > 0 ? delay : 0);
+	packet.to = to;
+	packet.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+	queue.push_back(std::move(packet));
+}
+
+void LinkSimulator::Pump(UdpSocket &socket, uint32_t nowMs)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		if ((int32_t)(nowMs - queue[i].releaseMs) >= 0)
+			socket.Send(queue[i].to, queue[i].data.data(), queue[i].data.size());
+		else
+		{
+			if (kept != i)
+				queue[kept] = std::move(queue[i]);
+			kept++;
+		}
+	}
+	queue.resize(kept);
+}
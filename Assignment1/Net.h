@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Net.h
+//	Non-blocking UDP sockets over Winsock or BSD sockets, and a link simulator that
+//	delays, jitters and drops outgoing packets so multiplayer can be tried out on
+//	localhost under realistic conditions.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef NET_H
+#define NET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct NetAddress
+{
+	uint32_t ip;		// host byte order
+	uint16_t port;
+
+	NetAddress() : ip(0), port(0) {}
+	NetAddress(uint32_t ip, uint16_t port) : ip(ip), port(port) {}
+
+	bool operator==(const NetAddress & rhs) const { return ip == rhs.ip && port == rhs.port; }
+	bool operator!=(const NetAddress & rhs) const { return !((*this) == rhs); }
+};
+
+// "a.b.c.d:port" or "localhost:port", returns false if it cannot be parsed
+bool ParseNetAddress(const char *text, NetAddress &address);
+
+// Winsock needs starting once per process, no-ops elsewhere
+bool InitNetworking();
+void ShutdownNetworking();
+
+// Monotonic milliseconds, for timestamps in net code that has no GLUT
+uint32_t NetTimeMs();
+
+class UdpSocket
+{
+public:
+	UdpSocket();
+	~UdpSocket();
+
+	UdpSocket(const UdpSocket &) = delete;
+	UdpSocket &operator=(const UdpSocket &) = delete;
+
+	// Port 0 picks any free port
+	bool Open(uint16_t port);
+	void Close();
+	bool IsOpen() const;
+
+	bool Send(const NetAddress &to, const void *data, size_t size);
+
+	// Returns the packet size, 0 when nothing is waiting
+	size_t Receive(NetAddress &from, void *data, size_t size);
+
+private:
+	uintptr_t handle;		// SOCKET on Windows, an int file descriptor elsewhere
+};
+
+// Sits between the game and a socket on the sending side. Packets are held back
+// latency +- jitter milliseconds and lost with the given probability.
+class LinkSimulator
+{
+public:
+	LinkSimulator();
+
+	void Configure(uint32_t latencyMs, uint32_t jitterMs, float lossRate);
+	bool IsEnabled() const { return latencyMs > 0 || jitterMs > 0 || lossRate > 0.0f; }
+
+	void Send(UdpSocket &socket, const NetAddress &to, const void *data, size_t size, uint32_t nowMs);
+
+	// Sends whatever is due
+	void Pump(UdpSocket &socket, uint32_t nowMs);
+
+	uint32_t GetDropped() const { return dropped; }
+
+private:
+	struct DelayedPacket
+	{
+		uint32_t releaseMs;
+		NetAddress to;
+		std::vector<uint8_t> data;
+	};
+
+	float Random();
+
+	uint32_t latencyMs;
+	uint32_t jitterMs;
+	float lossRate;
+	std::vector<DelayedPacket> queue;
+	uint32_t dropped;
+	uint32_t randomState;
+};
+
+#endif	//NET_H
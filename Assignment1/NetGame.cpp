@@ -0,0 +1,752 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "BitStream.h"
+#include "NetGame.h"
+
+static const uint32_t NetProtocolId = 0x4252;		// "BR"
+static const uint32_t NetTimeoutMs = 5000;
+static const uint32_t NetMaxPacketSize = 1200;
+static const uint32_t NetMaxCommandsPerPacket = 32;
+
+enum NetPacketType
+{
+	PacketHello = 1,		// client -> server, asks to join
+	PacketInput,			// client -> server, unacknowledged commands and the latest snapshot tick
+	PacketBye,				// client -> server
+	PacketWelcome,			// server -> client, the robot id it drives
+	PacketFull,				// server -> client, no free robot
+	PacketSnapshot,			// server -> client
+	PacketClosed			// server -> client, the game is over
+};
+
+
+void QuantizeRobot(const Robot &robot, NetRobotState &state)
+{
+	state.x = (int32_t)floorf(robot.x * 256.0f + 0.5f);
+	state.z = (int32_t)floorf(robot.z * 256.0f + 0.5f);
+
+	int angle = (int)floorf(robot.angle * 16.0f + 0.5f) % 5760;
+	state.angle = (uint16_t)(angle < 0 ? angle + 5760 : angle);
+
+	state.leftWheel = (uint8_t)((int)floorf(robot.leftWheelAngle * (256.0f / 360.0f) + 0.5f) & 255);
+	state.rightWheel = (uint8_t)((int)floorf(robot.rightWheelAngle * (256.0f / 360.0f) + 0.5f) & 255);
+	state.spinnerOn = robot.spinnerOn ? 1 : 0;
+}
+
+void DequantizeRobot(const NetRobotState &state, Robot &robot)
+{
+	robot.x = state.x / 256.0f;
+	robot.z = state.z / 256.0f;
+	robot.angle = state.angle / 16.0f;
+	robot.leftWheelAngle = state.leftWheel * (360.0f / 256.0f);
+	robot.rightWheelAngle = state.rightWheel * (360.0f / 256.0f);
+	robot.spinnerOn = state.spinnerOn != 0;
+	robot.UpdateForwards();
+}
+
+
+// Positions change by small amounts between snapshots, so most deltas fit in 10 bits
+static void WriteCoordinate(BitWriter &writer, int32_t value, int32_t base)
+{
+	int32_t delta = value - base;
+	writer.WriteBool(delta != 0);
+	if (delta == 0)
+		return;
+
+	bool small = delta >= -512 && delta < 512;
+	writer.WriteBool(small);
+	if (small)
+		writer.WriteSigned(delta, 10);
+	else
+		writer.WriteSigned(value, 24);
+}
+
+static int32_t ReadCoordinate(BitReader &reader, int32_t base)
+{
+	if (!reader.ReadBool())
+		return base;
+	if (reader.ReadBool())
+		return base + reader.ReadSigned(10);
+	return reader.ReadSigned(24);
+}
+
+static bool SameState(const NetRobotState &a, const NetRobotState &b)
+{
+	return a.x == b.x && a.z == b.z && a.angle == b.angle && a.leftWheel == b.leftWheel
+		&& a.rightWheel == b.rightWheel && a.spinnerOn == b.spinnerOn;
+}
+
+static int RobotSlotsUsed(uint64_t present)
+{
+	int used = 0;
+	for (int i = 0; i < MaxNetRobots; i++)
+	{
+		if (present & (1ull << i))
+			used = i + 1;
+	}
+	return used;
+}
+
+void WriteSnapshot(const NetSnapshot &snapshot, const NetSnapshot *baseline, BitWriter &writer)
+{
+	static const NetRobotState zero = { 0, 0, 0, 0, 0, 0 };
+	uint64_t basePresent = baseline ? baseline->present : 0;
+
+	// Only ids up to the highest one in either snapshot are written
+	int used = RobotSlotsUsed(snapshot.present | basePresent);
+	writer.Write(used, 7);
+
+	for (int i = 0; i < used; i++)
+	{
+		bool isPresent = (snapshot.present >> i) & 1;
+		bool wasPresent = (basePresent >> i) & 1;
+		const NetRobotState &base = wasPresent ? baseline->robots[i] : zero;
+		const NetRobotState &state = snapshot.robots[i];
+
+		// One bit for a robot that is unchanged or absent in both
+		bool changed = isPresent != wasPresent || (isPresent && !SameState(state, base));
+		writer.WriteBool(changed);
+		if (!changed)
+			continue;
+
+		writer.WriteBool(isPresent);
+		if (!isPresent)
+			continue;
+
+		WriteCoordinate(writer, state.x, base.x);
+		WriteCoordinate(writer, state.z, base.z);
+
+		writer.WriteBool(state.angle != base.angle);
+		if (state.angle != base.angle)
+			writer.Write(state.angle, 13);
+
+		bool wheels = state.leftWheel != base.leftWheel || state.rightWheel != base.rightWheel;
+		writer.WriteBool(wheels);
+		if (wheels)
+		{
+			writer.Write(state.leftWheel, 8);
+			writer.Write(state.rightWheel, 8);
+		}
+
+		writer.WriteBool(state.spinnerOn != 0);
+	}
+}
+
+bool ReadSnapshot(BitReader &reader, const NetSnapshot *baseline, NetSnapshot &snapshot)
+{
+	static const NetRobotState zero = { 0, 0, 0, 0, 0, 0 };
+	uint64_t basePresent = baseline ? baseline->present : 0;
+
+	int used = (int)reader.Read(7);
+	if (used > MaxNetRobots)
+		return false;
+
+	// Ids past the written ones are as in the baseline, which has none there
+	snapshot.present = 0;
+	for (int i = 0; i < used; i++)
+	{
+		bool wasPresent = (basePresent >> i) & 1;
+		const NetRobotState &base = wasPresent ? baseline->robots[i] : zero;
+		NetRobotState &state = snapshot.robots[i];
+
+		if (!reader.ReadBool())
+		{
+			if (wasPresent)
+			{
+				state = base;
+				snapshot.present |= 1ull << i;
+			}
+			continue;
+		}
+
+		if (!reader.ReadBool())
+			continue;
+
+		state.x = ReadCoordinate(reader, base.x);
+		state.z = ReadCoordinate(reader, base.z);
+		state.angle = reader.ReadBool() ? (uint16_t)reader.Read(13) : base.angle;
+		if (reader.ReadBool())
+		{
+			state.leftWheel = (uint8_t)reader.Read(8);
+			state.rightWheel = (uint8_t)reader.Read(8);
+		}
+		else
+		{
+			state.leftWheel = base.leftWheel;
+			state.rightWheel = base.rightWheel;
+		}
+		state.spinnerOn = reader.ReadBool() ? 1 : 0;
+		snapshot.present |= 1ull << i;
+	}
+
+	return !reader.Overflowed();
+}
+
+
+static void WriteHeader(BitWriter &writer, NetPacketType type)
+{
+	writer.Write(NetProtocolId, 16);
+	writer.Write(type, 3);
+}
+
+// Returns the packet type, 0 for packets that are not ours
+static int ReadHeader(BitReader &reader)
+{
+	if (reader.Read(16) != NetProtocolId)
+		return 0;
+	int type = (int)reader.Read(3);
+	return reader.Overflowed() ? 0 : type;
+}
+
+
+NetServer::NetServer()
+{
+	present = 0;
+	for (int i = 0; i < MaxNetClients; i++)
+		clients[i].connected = false;
+	memset(history, 0, sizeof(history));
+	tick = 0;
+	nextSnapshotMs = 0;
+	statsStartMs = 0;
+	statsBytes = 0;
+	statsSnapshots = 0;
+	bytesPerClientPerSecond = 0.0f;
+}
+
+bool NetServer::Start(uint16_t port, bool hostRobot)
+{
+	if (!socket.Open(port))
+		return false;
+
+	// The host's robot, where the single player one starts
+	robots[0] = Robot();
+	present = hostRobot ? 1 : 0;
+	tick = 0;
+	nextSnapshotMs = NetTimeMs();
+	statsStartMs = nextSnapshotMs;
+	return true;
+}
+
+void NetServer::Stop()
+{
+	// Straight out, the link simulator would hold it back past the close
+	uint8_t buffer[4];
+	BitWriter writer(buffer, sizeof(buffer));
+	WriteHeader(writer, PacketClosed);
+	for (int i = 0; socket.IsOpen() && i < MaxNetClients; i++)
+	{
+		if (clients[i].connected)
+			socket.Send(clients[i].address, buffer, writer.GetBytes());
+	}
+	socket.Close();
+	for (int i = 0; i < MaxNetClients; i++)
+		clients[i].connected = false;
+	present = 0;
+}
+
+void NetServer::ApplyLocalCommand(const RobotCommand &command)
+{
+	ApplyRobotCommand(robots[0], command);
+}
+
+// Lowest free robot id, spread around the arena facing the middle. Robot 0 is left
+// for the host so that ids mean the same with and without one.
+int NetServer::SpawnRobot()
+{
+	int robot = 1;
+	while (robot < MaxNetRobots && ((present >> robot) & 1))
+		robot++;
+	if (robot == MaxNetRobots)
+		return -1;
+
+	float spawnAngle = (float)(robot * 137.5);
+	float rad = spawnAngle * (3.14159265f / 180.0f);
+	robots[robot] = Robot(40.0f * sinf(rad), 40.0f * cosf(rad), spawnAngle + 180.0f);
+	present |= 1ull << robot;
+	return robot;
+}
+
+int NetServer::AddRobot()
+{
+	return SpawnRobot();
+}
+
+void NetServer::RemoveRobot(int id)
+{
+	if (id > 0 && id < MaxNetRobots)
+		present &= ~(1ull << id);
+}
+
+void NetServer::ApplyCommand(int id, const RobotCommand &command)
+{
+	if (id >= 0 && id < MaxNetRobots && ((present >> id) & 1))
+		ApplyRobotCommand(robots[id], command);
+}
+
+const Robot *NetServer::GetRobot(int id) const
+{
+	if (id < 0 || id >= MaxNetRobots || !((present >> id) & 1))
+		return NULL;
+	return &robots[id];
+}
+
+int NetServer::GetClientCount() const
+{
+	int count = 0;
+	for (int i = 0; i < MaxNetClients; i++)
+		count += clients[i].connected ? 1 : 0;
+	return count;
+}
+
+int NetServer::FindClient(const NetAddress &address) const
+{
+	for (int i = 0; i < MaxNetClients; i++)
+	{
+		if (clients[i].connected && clients[i].address == address)
+			return i;
+	}
+	return -1;
+}
+
+int NetServer::AddClient(const NetAddress &address, uint32_t nowMs)
+{
+	int client = 0;
+	while (client < MaxNetClients && clients[client].connected)
+		client++;
+	if (client == MaxNetClients)
+		return -1;
+
+	int robot = SpawnRobot();
+	if (robot < 0)
+		return -1;
+
+	Client &c = clients[client];
+	c.connected = true;
+	c.address = address;
+	c.robot = robot;
+	c.lastHeardMs = nowMs;
+	c.lastAppliedCommand = 0;
+	c.ackedTick = 0;
+	printf("Client %u.%u.%u.%u:%u joined as robot %d\n", address.ip >> 24, (address.ip >> 16) & 255,
+		(address.ip >> 8) & 255, address.ip & 255, address.port, robot);
+	return client;
+}
+
+void NetServer::RemoveClient(int client)
+{
+	printf("Robot %d left\n", clients[client].robot);
+	present &= ~(1ull << clients[client].robot);
+	clients[client].connected = false;
+}
+
+void NetServer::SendWelcome(const Client &client, uint32_t nowMs)
+{
+	uint8_t buffer[8];
+	BitWriter writer(buffer, sizeof(buffer));
+	WriteHeader(writer, PacketWelcome);
+	writer.Write(client.robot, 6);
+	link.Send(socket, client.address, buffer, writer.GetBytes(), nowMs);
+}
+
+void NetServer::HandlePacket(const NetAddress &from, const uint8_t *data, size_t size, uint32_t nowMs)
+{
+	BitReader reader(data, size);
+	int type = ReadHeader(reader);
+	int client = FindClient(from);
+
+	if (type == PacketHello)
+	{
+		// A repeated hello means our welcome got lost
+		if (client < 0)
+			client = AddClient(from, nowMs);
+		if (client >= 0)
+			SendWelcome(clients[client], nowMs);
+		else
+		{
+			uint8_t buffer[4];
+			BitWriter writer(buffer, sizeof(buffer));
+			WriteHeader(writer, PacketFull);
+			link.Send(socket, from, buffer, writer.GetBytes(), nowMs);
+		}
+		return;
+	}
+
+	if (client < 0)
+		return;
+	Client &c = clients[client];
+	c.lastHeardMs = nowMs;
+
+	if (type == PacketBye)
+	{
+		RemoveClient(client);
+		return;
+	}
+	if (type != PacketInput)
+		return;
+
+	uint32_t ackedTick = reader.Read(32);
+	uint32_t count = reader.Read(6);
+	uint32_t firstCommand = reader.Read(32);
+	if (reader.Overflowed())
+		return;
+	if (ackedTick > c.ackedTick && ackedTick <= tick)
+		c.ackedTick = ackedTick;
+
+	// Commands are resent until acknowledged, apply each one once and in order
+	for (uint32_t i = 0; i < count; i++)
+	{
+		RobotCommand command;
+		command.sequence = firstCommand + i;
+		command.turn = (int8_t)reader.ReadSigned(2);
+		command.move = (int8_t)reader.ReadSigned(2);
+		command.toggleSpinner = (uint8_t)reader.Read(1);
+		if (reader.Overflowed())
+			return;
+
+		// One step per command at most, whatever the client claims
+		command.turn = command.turn > 1 ? 1 : (command.turn < -1 ? -1 : command.turn);
+		command.move = command.move > 1 ? 1 : (command.move < -1 ? -1 : command.move);
+
+		if (command.sequence == c.lastAppliedCommand + 1)
+		{
+			ApplyRobotCommand(robots[c.robot], command);
+			c.lastAppliedCommand = command.sequence;
+		}
+	}
+}
+
+void NetServer::SendSnapshots(uint32_t nowMs)
+{
+	tick++;
+	NetSnapshot &snapshot = history[tick % 32];
+	snapshot.tick = tick;
+	snapshot.present = present;
+	for (int i = 0; i < MaxNetRobots; i++)
+	{
+		if ((present >> i) & 1)
+			QuantizeRobot(robots[i], snapshot.robots[i]);
+	}
+
+	uint8_t buffer[NetMaxPacketSize];
+	for (int i = 0; i < MaxNetClients; i++)
+	{
+		Client &c = clients[i];
+		if (!c.connected)
+			continue;
+
+		// Delta against the newest snapshot the client has, if we still remember it
+		const NetSnapshot *baseline = NULL;
+		if (c.ackedTick != 0 && history[c.ackedTick % 32].tick == c.ackedTick)
+			baseline = &history[c.ackedTick % 32];
+
+		BitWriter writer(buffer, sizeof(buffer));
+		WriteHeader(writer, PacketSnapshot);
+		writer.Write(tick, 32);
+		writer.Write(baseline ? baseline->tick : 0, 32);
+		writer.Write(c.lastAppliedCommand, 32);
+		WriteSnapshot(snapshot, baseline, writer);
+		if (writer.Overflowed())
+			continue;
+
+		link.Send(socket, c.address, buffer, writer.GetBytes(), nowMs);
+		statsBytes += (uint32_t)writer.GetBytes() + 28;		// with IPv4 and UDP headers
+		statsSnapshots++;
+	}
+}
+
+void NetServer::Update(uint32_t nowMs)
+{
+	if (!socket.IsOpen())
+		return;
+
+	uint8_t buffer[NetMaxPacketSize];
+	NetAddress from;
+	size_t size;
+	for (int n = 0; n < 256 && (size = socket.Receive(from, buffer, sizeof(buffer))) > 0; n++)
+		HandlePacket(from, buffer, size, nowMs);
+
+	for (int i = 0; i < MaxNetClients; i++)
+	{
+		if (clients[i].connected && nowMs - clients[i].lastHeardMs > NetTimeoutMs)
+			RemoveClient(i);
+	}
+
+	// Catch up at most a couple of snapshots after a stall instead of flooding
+	if ((int32_t)(nowMs - nextSnapshotMs) > (int32_t)(3 * NetSnapshotIntervalMs))
+		nextSnapshotMs = nowMs;
+	while ((int32_t)(nowMs - nextSnapshotMs) >= 0)
+	{
+		SendSnapshots(nowMs);
+		nextSnapshotMs += NetSnapshotIntervalMs;
+	}
+
+	if (nowMs - statsStartMs >= 5000)
+	{
+		float clientSeconds = statsSnapshots * (NetSnapshotIntervalMs / 1000.0f);
+		bytesPerClientPerSecond = clientSeconds > 0.0f ? statsBytes / clientSeconds : 0.0f;
+		statsStartMs = nowMs;
+		statsBytes = 0;
+		statsSnapshots = 0;
+	}
+
+	link.Pump(socket, nowMs);
+}
+
+
+NetClient::NetClient()
+{
+	localRobot = -1;
+	havePredicted = false;
+	nextCommand = 1;
+	memset(received, 0, sizeof(received));
+	latestTick = 0;
+	haveClock = false;
+	serverClockOffset = 0.0;
+	nextHelloMs = 0;
+	nextInputMs = 0;
+	lastHeardMs = 0;
+}
+
+bool NetClient::Connect(const NetAddress &server)
+{
+	if (!socket.Open(0))
+		return false;
+
+	this->server = server;
+	localRobot = -1;
+	havePredicted = false;
+	pending.clear();
+	nextCommand = 1;
+	memset(received, 0, sizeof(received));
+	latestTick = 0;
+	haveClock = false;
+	nextHelloMs = NetTimeMs();
+	lastHeardMs = nextHelloMs;
+	return true;
+}
+
+void NetClient::Disconnect()
+{
+	if (!socket.IsOpen())
+		return;
+
+	// Straight out, the link simulator would hold it back past the close
+	uint8_t buffer[4];
+	BitWriter writer(buffer, sizeof(buffer));
+	WriteHeader(writer, PacketBye);
+	socket.Send(server, buffer, writer.GetBytes());
+	socket.Close();
+	localRobot = -1;
+}
+
+void NetClient::SendCommand(RobotCommand command)
+{
+	if (!IsConnected())
+		return;
+
+	command.sequence = nextCommand++;
+	pending.push_back(command);
+	if (havePredicted)
+		ApplyRobotCommand(predicted, command);
+
+	// Right away rather than at the next input tick, it saves up to a tick of latency
+	SendInput(NetTimeMs());
+}
+
+void NetClient::SendInput(uint32_t nowMs)
+{
+	uint8_t buffer[64];
+	BitWriter writer(buffer, sizeof(buffer));
+	WriteHeader(writer, PacketInput);
+	writer.Write(latestTick, 32);
+
+	// Everything not yet acknowledged, the oldest first, so a lost packet costs nothing
+	uint32_t count = pending.size() < NetMaxCommandsPerPacket ? (uint32_t)pending.size() : NetMaxCommandsPerPacket;
+	writer.Write(count, 6);
+	writer.Write(count > 0 ? pending[0].sequence : 0, 32);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		writer.WriteSigned(pending[i].turn, 2);
+		writer.WriteSigned(pending[i].move, 2);
+		writer.Write(pending[i].toggleSpinner ? 1 : 0, 1);
+	}
+
+	link.Send(socket, server, buffer, writer.GetBytes(), nowMs);
+	nextInputMs = nowMs + NetSnapshotIntervalMs;
+}
+
+const NetSnapshot *NetClient::FindSnapshot(uint32_t tick) const
+{
+	const NetSnapshot &snapshot = received[tick % 32];
+	return tick != 0 && snapshot.tick == tick ? &snapshot : NULL;
+}
+
+void NetClient::HandlePacket(const uint8_t *data, size_t size, uint32_t nowMs)
+{
+	BitReader reader(data, size);
+	int type = ReadHeader(reader);
+
+	if (type == PacketWelcome)
+	{
+		int robot = (int)reader.Read(6);
+		if (!reader.Overflowed() && localRobot < 0)
+		{
+			localRobot = robot;
+			printf("Joined the game as robot %d\n", robot);
+		}
+		lastHeardMs = nowMs;
+		return;
+	}
+	if (type == PacketFull)
+	{
+		printf("Server is full\n");
+		return;
+	}
+	if (type == PacketClosed)
+	{
+		printf("The server closed the game\n");
+		socket.Close();
+		localRobot = -1;
+		havePredicted = false;
+		pending.clear();
+		return;
+	}
+	if (type != PacketSnapshot || localRobot < 0)
+		return;
+
+	uint32_t tick = reader.Read(32);
+	uint32_t baselineTick = reader.Read(32);
+	uint32_t ackedCommand = reader.Read(32);
+	if (reader.Overflowed() || tick == 0 || FindSnapshot(tick))
+		return;
+
+	// Without its baseline the delta cannot be decoded, a later snapshot will do
+	const NetSnapshot *baseline = NULL;
+	if (baselineTick != 0)
+	{
+		baseline = FindSnapshot(baselineTick);
+		if (!baseline)
+			return;
+	}
+
+	NetSnapshot snapshot;
+	if (!ReadSnapshot(reader, baseline, snapshot))
+		return;
+	snapshot.tick = tick;
+	received[tick % 32] = snapshot;
+	lastHeardMs = nowMs;
+
+	// Server time is tick * interval. Follow the fastest arrivals quickly and drift
+	// slowly otherwise, so jitter does not shake the interpolation clock.
+	double sample = (double)tick * NetSnapshotIntervalMs - (double)nowMs;
+	if (!haveClock || sample > serverClockOffset)
+		serverClockOffset = sample;
+	else
+		serverClockOffset += 0.05 * (sample - serverClockOffset);
+	haveClock = true;
+
+	if (tick <= latestTick)
+		return;		// arrived out of order, still good for interpolation
+	latestTick = tick;
+
+	// Reconcile: start from the server's state and replay what it has not seen yet
+	while (!pending.empty() && pending[0].sequence <= ackedCommand)
+		pending.erase(pending.begin());
+
+	if ((snapshot.present >> localRobot) & 1)
+	{
+		DequantizeRobot(snapshot.robots[localRobot], predicted);
+		for (size_t i = 0; i < pending.size(); i++)
+			ApplyRobotCommand(predicted, pending[i]);
+		havePredicted = true;
+	}
+}
+
+void NetClient::Update(uint32_t nowMs)
+{
+	if (!socket.IsOpen())
+		return;
+
+	uint8_t buffer[NetMaxPacketSize];
+	NetAddress from;
+	size_t size;
+	for (int n = 0; n < 256 && (size = socket.Receive(from, buffer, sizeof(buffer))) > 0; n++)
+	{
+		if (from == server)
+			HandlePacket(buffer, size, nowMs);
+	}
+
+	if (!IsConnected())
+	{
+		if ((int32_t)(nowMs - nextHelloMs) >= 0)
+		{
+			uint8_t hello[4];
+			BitWriter writer(hello, sizeof(hello));
+			WriteHeader(writer, PacketHello);
+			link.Send(socket, server, hello, writer.GetBytes(), nowMs);
+			nextHelloMs = nowMs + 500;
+		}
+	}
+	else if (nowMs - lastHeardMs > NetTimeoutMs)
+	{
+		printf("Lost connection to the server\n");
+		localRobot = -1;
+		havePredicted = false;
+		pending.clear();
+		nextHelloMs = nowMs;
+	}
+	else if ((int32_t)(nowMs - nextInputMs) >= 0)
+		SendInput(nowMs);
+
+	link.Pump(socket, nowMs);
+}
+
+static float LerpAngle(float a, float b, float t)
+{
+	float difference = fmodf(b - a + 540.0f, 360.0f) - 180.0f;
+	return a + difference * t;
+}
+
+bool NetClient::GetRobot(int id, uint32_t nowMs, Robot &robot) const
+{
+	if (id < 0 || id >= MaxNetRobots)
+		return false;
+
+	const NetSnapshot *latest = FindSnapshot(latestTick);
+	if (!latest || !((latest->present >> id) & 1))
+		return false;
+
+	if (id == localRobot && havePredicted)
+	{
+		float spinnerAngle = robot.spinnerAngle;
+		robot = predicted;
+		robot.spinnerAngle = spinnerAngle;
+		return true;
+	}
+
+	// Between the two snapshots around the render time, or the latest one if those are missing
+	double renderTime = (double)nowMs + serverClockOffset - NetInterpolationDelayMs;
+	double tickTime = renderTime / NetSnapshotIntervalMs;
+	uint32_t tick = tickTime > 0.0 ? (uint32_t)tickTime : 0;
+	const NetSnapshot *from = FindSnapshot(tick);
+	const NetSnapshot *to = FindSnapshot(tick + 1);
+
+	if (from && to && ((from->present >> id) & 1) && ((to->present >> id) & 1))
+	{
+		Robot a, b;
+		DequantizeRobot(from->robots[id], a);
+		DequantizeRobot(to->robots[id], b);
+		float t = (float)(tickTime - (double)tick);
+		robot.x = a.x + (b.x - a.x) * t;
+		robot.z = a.z + (b.z - a.z) * t;
+		robot.angle = LerpAngle(a.angle, b.angle, t);
+		robot.leftWheelAngle = LerpAngle(a.leftWheelAngle, b.leftWheelAngle, t);
+		robot.rightWheelAngle = LerpAngle(a.rightWheelAngle, b.rightWheelAngle, t);
+		robot.spinnerOn = b.spinnerOn;
+		robot.UpdateForwards();
+	}
+	else
+		DequantizeRobot(latest->robots[id], robot);
+	return true;
+}
@@ -0,0 +1,168 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	NetGame.h
+//	Client/server multiplayer over UDP. The server owns the robots and applies
+//	each client's numbered RobotCommands exactly once; 20 times a second it sends
+//	every client a snapshot of all robots, quantized and delta-compressed against
+//	the last snapshot that client acknowledged, so unchanged robots cost one bit.
+//	The client predicts its own robot by applying commands as they are issued and
+//	replays the unacknowledged ones on top of each server state (reconciliation);
+//	other robots are drawn interpolated 100 ms in the past between snapshots.
+//	No GL in here: main.cpp mirrors the robots into its own pool for drawing.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef NETGAME_H
+#define NETGAME_H
+
+#include <stdint.h>
+#include <vector>
+#include "Net.h"
+#include "Robot.h"
+
+const int MaxNetRobots = 64;
+const int MaxNetClients = MaxNetRobots - 1;		// robot 0 is the host's, if there is a host
+const uint16_t DefaultNetPort = 27960;
+const uint32_t NetSnapshotIntervalMs = 50;
+const uint32_t NetInterpolationDelayMs = 100;
+
+class BitWriter;
+class BitReader;
+
+// A robot as it goes over the wire
+struct NetRobotState
+{
+	int32_t x, z;				// 1/256 units
+	uint16_t angle;				// 1/16 degree, 0 to 5759
+	uint8_t leftWheel;			// 1/256 turn
+	uint8_t rightWheel;
+	uint8_t spinnerOn;
+};
+
+struct NetSnapshot
+{
+	uint32_t tick;				// 0 for an empty slot, ticks start at 1
+	uint64_t present;			// bit per robot id
+	NetRobotState robots[MaxNetRobots];
+};
+
+void QuantizeRobot(const Robot &robot, NetRobotState &state);
+// Leaves spinnerAngle alone, it is only for show and every machine animates its own
+void DequantizeRobot(const NetRobotState &state, Robot &robot);
+
+// Delta against baseline, or against an empty snapshot when baseline is NULL
+void WriteSnapshot(const NetSnapshot &snapshot, const NetSnapshot *baseline, BitWriter &writer);
+bool ReadSnapshot(BitReader &reader, const NetSnapshot *baseline, NetSnapshot &snapshot);
+
+class NetServer
+{
+public:
+	NetServer();
+
+	// A dedicated server has no host robot, every robot belongs to a client or a bot
+	bool Start(uint16_t port, bool hostRobot = true);
+	void Stop();
+	bool IsRunning() const { return socket.IsOpen(); }
+
+	// The host drives robot 0 directly, without going over the network
+	int GetLocalRobot() const { return 0; }
+	void ApplyLocalCommand(const RobotCommand &command);
+
+	// Robots driven on the server itself (bots). Returns the robot id, -1 if the game is full.
+	int AddRobot();
+	void RemoveRobot(int id);
+	void ApplyCommand(int id, const RobotCommand &command);
+
+	// Receives commands, and sends snapshots when one is due
+	void Update(uint32_t nowMs);
+
+	// NULL if no robot has this id
+	const Robot *GetRobot(int id) const;
+
+	int GetClientCount() const;
+	// Average over the last few seconds
+	float GetBytesPerClientPerSecond() const { return bytesPerClientPerSecond; }
+
+	LinkSimulator link;
+
+private:
+	struct Client
+	{
+		bool connected;
+		NetAddress address;
+		int robot;
+		uint32_t lastHeardMs;
+		uint32_t lastAppliedCommand;
+		uint32_t ackedTick;
+	};
+
+	void HandlePacket(const NetAddress &from, const uint8_t *data, size_t size, uint32_t nowMs);
+	int FindClient(const NetAddress &address) const;
+	int AddClient(const NetAddress &address, uint32_t nowMs);
+	int SpawnRobot();
+	void RemoveClient(int client);
+	void SendSnapshots(uint32_t nowMs);
+	void SendWelcome(const Client &client, uint32_t nowMs);
+
+	UdpSocket socket;
+	Robot robots[MaxNetRobots];
+	uint64_t present;
+	Client clients[MaxNetClients];
+	NetSnapshot history[32];		// sent snapshots by tick % 32, the baselines for deltas
+
+	uint32_t tick;
+	uint32_t nextSnapshotMs;
+	uint32_t statsStartMs;
+	uint32_t statsBytes;
+	uint32_t statsSnapshots;
+	float bytesPerClientPerSecond;
+};
+
+class NetClient
+{
+public:
+	NetClient();
+
+	bool Connect(const NetAddress &server);
+	void Disconnect();
+	bool IsConnected() const { return localRobot >= 0; }
+
+	// -1 until the server has accepted us
+	int GetLocalRobot() const { return localRobot; }
+
+	// Applies the command to the predicted robot at once and sends it, the sequence is filled in
+	void SendCommand(RobotCommand command);
+
+	void Update(uint32_t nowMs);
+
+	// The predicted robot for GetLocalRobot(), the interpolated one for the others.
+	// False if the robot is not in the game.
+	bool GetRobot(int id, uint32_t nowMs, Robot &robot) const;
+
+	uint32_t GetPendingCommands() const { return (uint32_t)pending.size(); }
+
+	LinkSimulator link;
+
+private:
+	void HandlePacket(const uint8_t *data, size_t size, uint32_t nowMs);
+	void SendInput(uint32_t nowMs);
+	const NetSnapshot *FindSnapshot(uint32_t tick) const;
+
+	UdpSocket socket;
+	NetAddress server;
+	int localRobot;
+
+	Robot predicted;
+	bool havePredicted;
+	std::vector<RobotCommand> pending;	// sent, not yet applied by the server
+	uint32_t nextCommand;
+
+	NetSnapshot received[32];			// by tick % 32
+	uint32_t latestTick;
+	bool haveClock;
+	double serverClockOffset;			// server time minus local time, in ms (float loses whole ms after 4.7 h)
+
+	uint32_t nextHelloMs;
+	uint32_t nextInputMs;
+	uint32_t lastHeardMs;
+};
+
+#endif	//NETGAME_H
@@ -0,0 +1,239 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	ObjectPool.h
+//	Fixed-capacity object pool addressed through generational handles.
+//	Storage is allocated once at construction, Create() and Destroy() are O(1) and
+//	never touch the heap. A handle whose slot has been destroyed (and possibly reused)
+//	is detected through its generation and resolves to NULL instead of a wrong object.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <utility>
+
+struct PoolHandle
+{
+	uint32_t index;
+	uint32_t generation;	// 0 is never a live generation, so {0,0} is the null handle
+
+	PoolHandle() : index(0), generation(0)
+	{}
+
+	PoolHandle(uint32_t index, uint32_t generation) : index(index), generation(generation)
+	{}
+
+	bool IsNull() const { return generation == 0; }
+
+	bool operator==(const PoolHandle & rhs) const { return index == rhs.index && generation == rhs.generation; }
+	bool operator!=(const PoolHandle & rhs) const { return !((*this) == rhs); }
+};
+
+template <typename T>
+class ObjectPool
+{
+public:
+	ObjectPool(uint32_t capacity) : capacity(capacity), liveCount(0), freeHead(0)
+	{
+		storage = (T*)::operator new(sizeof(T) * capacity);
+		generations = new uint32_t[capacity];
+		nextFree = new uint32_t[capacity];
+		denseIndex = new uint32_t[capacity];
+		live = new uint32_t[capacity];
+
+		for (uint32_t i = 0; i < capacity; i++)
+		{
+			generations[i] = 1;
+			nextFree[i] = i + 1;	// capacity terminates the free list
+		}
+	}
+
+	~ObjectPool()
+	{
+		while (liveCount > 0)
+			DestroyIndex(live[liveCount - 1]);
+
+		::operator delete(storage);
+		delete[] generations;
+		delete[] nextFree;
+		delete[] denseIndex;
+		delete[] live;
+	}
+
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+
+	// Returns the null handle when the pool is full
+	template <typename... Args>
+	PoolHandle Create(Args &&... args)
+	{
+		if (freeHead >= capacity)
+			return PoolHandle();
+
+		uint32_t index = freeHead;
+		freeHead = nextFree[index];
+		nextFree[index] = InUse;
+
+		new (&storage[index]) T(std::forward<Args>(args)...);
+
+		denseIndex[index] = liveCount;
+		live[liveCount++] = index;
+
+		return PoolHandle(index, generations[index]);
+	}
+
+	// Stale or null handles are ignored
+	void Destroy(PoolHandle handle)
+	{
+		if (IsValid(handle))
+			DestroyIndex(handle.index);
+	}
+
+	bool IsValid(PoolHandle handle) const
+	{
+		return handle.generation != 0 && handle.index < capacity && generations[handle.index] == handle.generation
+			&& nextFree[handle.index] == InUse;
+	}
+
+	T *Get(PoolHandle handle) const
+	{
+		return IsValid(handle) ? &storage[handle.index] : NULL;
+	}
+
+	// Visit every live object, in no particular order. The visitor must not
+	// create or destroy objects in this pool.
+	template <typename F>
+	void ForEach(F visit)
+	{
+		for (uint32_t i = 0; i < liveCount; i++)
+			visit(storage[live[i]]);
+	}
+
+	template <typename F>
+	void ForEach(F visit) const
+	{
+		for (uint32_t i = 0; i < liveCount; i++)
+			visit((const T &)storage[live[i]]);
+	}
+
+	// Handle of the i-th live object, 0 <= i < GetLiveCount()
+	PoolHandle GetLiveHandle(uint32_t i) const
+	{
+		return PoolHandle(live[i], generations[live[i]]);
+	}
+
+	uint32_t GetLiveCount() const { return liveCount; }
+	uint32_t GetCapacity() const { return capacity; }
+
+private:
+	static const uint32_t InUse = 0xFFFFFFFFu;
+
+	void DestroyIndex(uint32_t index)
+	{
+		storage[index].~T();
+
+		// Bump the generation so outstanding handles go stale, skipping 0 on wrap
+		generations[index]++;
+		if (generations[index] == 0)
+			generations[index] = 1;
+
+		// Swap-remove from the dense live list
+		uint32_t slot = denseIndex[index];
+		uint32_t last = live[--liveCount];
+		live[slot] = last;
+		denseIndex[last] = slot;
+
+		nextFree[index] = freeHead;
+		freeHead = index;
+	}
+
+	T *storage;
+	uint32_t *generations;
+	uint32_t *nextFree;		// free-list link, or InUse while the slot holds an object
+	uint32_t *denseIndex;	// position of each live slot in live[]
+	uint32_t *live;			// dense list of live slot indices for iteration
+	uint32_t capacity;
+	uint32_t liveCount;
+	uint32_t freeHead;
+};
+
+// Move-only owner of a pooled object, destroys it when it goes out of scope
+template <typename T>
+class PoolPtr
+{
+public:
+	PoolPtr() : pool(NULL)
+	{}
+
+	PoolPtr(ObjectPool<T> &pool, PoolHandle handle) : pool(&pool), handle(handle)
+	{}
+
+	PoolPtr(PoolPtr && rhs) : pool(rhs.pool), handle(rhs.handle)
+	{
+		rhs.pool = NULL;
+		rhs.handle = PoolHandle();
+	}
+
+	PoolPtr &operator=(PoolPtr && rhs)
+	{
+		if (this != &rhs)
+		{
+			Reset();
+			pool = rhs.pool;
+			handle = rhs.handle;
+			rhs.pool = NULL;
+			rhs.handle = PoolHandle();
+		}
+		return *this;
+	}
+
+	PoolPtr(const PoolPtr &) = delete;
+	PoolPtr &operator=(const PoolPtr &) = delete;
+
+	~PoolPtr()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		if (pool)
+			pool->Destroy(handle);
+		pool = NULL;
+		handle = PoolHandle();
+	}
+
+	// Give up ownership without destroying the object
+	PoolHandle Release()
+	{
+		PoolHandle h = handle;
+		pool = NULL;
+		handle = PoolHandle();
+		return h;
+	}
+
+	T *Get() const { return pool ? pool->Get(handle) : NULL; }
+	T *operator->() const { return Get(); }
+	T &operator*() const { return *Get(); }
+	explicit operator bool() const { return Get() != NULL; }
+
+	PoolHandle GetHandle() const { return handle; }
+
+private:
+	ObjectPool<T> *pool;
+	PoolHandle handle;
+};
+
+// Construct an object in the pool and wrap it, empty if the pool is full
+template <typename T, typename... Args>
+PoolPtr<T> MakePooled(ObjectPool<T> &pool, Args &&... args)
+{
+	PoolHandle handle = pool.Create(std::forward<Args>(args)...);
+	if (handle.IsNull())
+		return PoolPtr<T>();
+	return PoolPtr<T>(pool, handle);
+}
+
+#endif	//OBJECTPOOL_H
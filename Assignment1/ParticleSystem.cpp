@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <gl/glut.h>
+#include "JobSystem.h"
+#include "ParticleSystem.h"
+
+// SSE2 is always there on x64 and the default for 32-bit builds
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PARTICLES_SSE 1
+#include <emmintrin.h>
+#endif
+
+
+ParticleSystem::ParticleSystem(uint32_t capacity)
+{
+	capacity = (capacity + 3) & ~3u;
+
+	// One block for every array, each one 16-byte aligned for SSE loads
+	size_t arrayBytes = ((size_t)capacity * sizeof(float) + 15) & ~(size_t)15;
+	size_t bytes = arrayBytes * 9 + (size_t)capacity * sizeof(DrawVertex) + 15;
+	block = (unsigned char*)malloc(bytes);
+	this->capacity = block ? capacity : 0;
+
+	unsigned char *aligned = (unsigned char*)(((uintptr_t)block + 15) & ~(uintptr_t)15);
+	float **arrays[8] = { &posX, &posY, &posZ, &velX, &velY, &velZ, &life, &invLifetime };
+	for (int i = 0; i < 8; i++)
+		*arrays[i] = (float*)(aligned + arrayBytes * i);
+	color = (uint32_t*)(aligned + arrayBytes * 8);
+	vertices = (DrawVertex*)(aligned + arrayBytes * 9);
+
+	gravity = -30.0f;
+	groundY = -2.5f;
+	restitution = 0.4f;
+	friction = 0.7f;
+	randomState = 0x9E3779B9u;
+	Clear();
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	free(block);
+	block = NULL;
+}
+
+void ParticleSystem::Clear()
+{
+	if (block)
+		memset(life, 0, capacity * sizeof(float));
+	head = 0;
+	windowSize = 0;
+	drawCount = 0;
+}
+
+// xorshift32, uniform in [-1, 1)
+float ParticleSystem::Random()
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return (float)(randomState >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+void ParticleSystem::Emit(const float position[3], const float velocity[3], float spread, uint32_t count,
+	float minLife, float maxLife, uint32_t color)
+{
+	if (capacity == 0)
+		return;
+	if (count > capacity)
+		count = capacity;
+
+	for (uint32_t n = 0; n < count; n++)
+	{
+		uint32_t i = head;
+		head = head + 1 < capacity ? head + 1 : 0;
+
+		posX[i] = position[0];
+		posY[i] = position[1];
+		posZ[i] = position[2];
+		velX[i] = velocity[0] + spread * Random();
+		velY[i] = velocity[1] + spread * Random();
+		velZ[i] = velocity[2] + spread * Random();
+		float lifetime = minLife + (maxLife - minLife) * (0.5f + 0.5f * Random());
+		life[i] = lifetime;
+		invLifetime[i] = 1.0f / lifetime;
+		this->color[i] = color;
+	}
+
+	windowSize = windowSize + count < capacity ? windowSize + count : capacity;
+}
+
+void ParticleSystem::UpdateRange(uint32_t begin, uint32_t end, float dt)
+{
+	uint32_t i = begin;
+
+#ifdef PARTICLES_SSE
+	const __m128 dt4 = _mm_set1_ps(dt);
+	const __m128 gravityDt = _mm_set1_ps(gravity * dt);
+	const __m128 ground = _mm_set1_ps(groundY);
+	const __m128 bounce = _mm_set1_ps(-restitution);
+	const __m128 slide = _mm_set1_ps(friction);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	// begin is a multiple of 4, only the tail of the last range may be short
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 vx = _mm_load_ps(velX + i);
+		__m128 vy = _mm_add_ps(_mm_load_ps(velY + i), gravityDt);
+		__m128 vz = _mm_load_ps(velZ + i);
+		__m128 px = _mm_add_ps(_mm_load_ps(posX + i), _mm_mul_ps(vx, dt4));
+		__m128 py = _mm_add_ps(_mm_load_ps(posY + i), _mm_mul_ps(vy, dt4));
+		__m128 pz = _mm_add_ps(_mm_load_ps(posZ + i), _mm_mul_ps(vz, dt4));
+
+		// Below the ground: put back on it, reflect and damp the vertical speed, slow down sideways
+		__m128 hit = _mm_cmplt_ps(py, ground);
+		py = _mm_or_ps(_mm_and_ps(hit, ground), _mm_andnot_ps(hit, py));
+		vy = _mm_or_ps(_mm_and_ps(hit, _mm_mul_ps(vy, bounce)), _mm_andnot_ps(hit, vy));
+		__m128 damping = _mm_or_ps(_mm_and_ps(hit, slide), _mm_andnot_ps(hit, one));
+		vx = _mm_mul_ps(vx, damping);
+		vz = _mm_mul_ps(vz, damping);
+
+		_mm_store_ps(posX + i, px);
+		_mm_store_ps(posY + i, py);
+		_mm_store_ps(posZ + i, pz);
+		_mm_store_ps(velX + i, vx);
+		_mm_store_ps(velY + i, vy);
+		_mm_store_ps(velZ + i, vz);
+		_mm_store_ps(life + i, _mm_sub_ps(_mm_load_ps(life + i), dt4));
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		velY[i] += gravity * dt;
+		posX[i] += velX[i] * dt;
+		posY[i] += velY[i] * dt;
+		posZ[i] += velZ[i] * dt;
+		if (posY[i] < groundY)
+		{
+			posY[i] = groundY;
+			velY[i] *= -restitution;
+			velX[i] *= friction;
+			velZ[i] *= friction;
+		}
+		life[i] -= dt;
+	}
+}
+
+void ParticleSystem::Update(float dt, JobSystem *jobs)
+{
+	if (windowSize == 0)
+		return;
+
+	// The window ends at head and may wrap around the end of the arrays. Work on
+	// whole groups of 4 from a 4-aligned start, dead particles in them cost nothing extra.
+	uint32_t start = 0, count = capacity;
+	if (windowSize + 4 <= capacity)
+	{
+		start = ((head + capacity - windowSize) % capacity) & ~3u;
+		count = (head + capacity - start) % capacity;
+	}
+
+	auto body = [this, start, count, dt](uint32_t begin, uint32_t end)
+	{
+		// Chunk boundaries are multiples of 4 within the window, map them to slots
+		uint32_t first = (start + begin) % capacity;
+		uint32_t length = end - begin;
+		if (first + length <= capacity)
+			UpdateRange(first, first + length, dt);
+		else
+		{
+			UpdateRange(first, capacity, dt);
+			UpdateRange(0, first + length - capacity, dt);
+		}
+	};
+
+	if (jobs && count >= 16384)
+		jobs->ParallelFor(count, 4096, body);
+	else
+		body(0, count);
+
+	// Shrink the window past particles that have died at its oldest end
+	while (windowSize > 0 && life[(head + capacity - windowSize) % capacity] <= 0.0f)
+		windowSize--;
+}
+
+void ParticleSystem::PrepareDraw()
+{
+	drawCount = 0;
+	uint32_t slot = (head + capacity - windowSize) % capacity;
+	for (uint32_t n = 0; n < windowSize; n++)
+	{
+		if (life[slot] > 0.0f)
+		{
+			DrawVertex &vertex = vertices[drawCount++];
+			float fade = life[slot] * invLifetime[slot];
+			uint32_t alpha = (uint32_t)(255.0f * (fade < 1.0f ? fade : 1.0f));
+			vertex.color = (color[slot] & 0x00FFFFFFu) | (alpha << 24);
+			vertex.position[0] = posX[slot];
+			vertex.position[1] = posY[slot];
+			vertex.position[2] = posZ[slot];
+		}
+		slot = slot + 1 < capacity ? slot + 1 : 0;
+	}
+}
+
+void ParticleSystem::Draw(float pointSize) const
+{
+	if (drawCount == 0)
+		return;
+
+	// Unlit, blended round points that do not hide each other
+	glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_POINT_SMOOTH);
+	glPointSize(pointSize);
+	glDepthMask(GL_FALSE);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(DrawVertex), &vertices[0].color);
+	glVertexPointer(3, GL_FLOAT, sizeof(DrawVertex), vertices[0].position);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)drawCount);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glPopAttrib();
+}
+
+
+double BenchmarkParticles(uint32_t count, int frames, JobSystem *jobs)
+{
+	ParticleSystem particles(count);
+	const float origin[3] = { 0.0f, 5.0f, 0.0f };
+	const float velocity[3] = { 0.0f, 10.0f, 0.0f };
+	particles.Emit(origin, velocity, 8.0f, count, 1000.0f, 1000.0f, 0xFF40A0FFu);
+
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < frames; i++)
+		particles.Update(1.0f / 60.0f, jobs);
+	double updateSeconds = std::chrono::duration<double>(Clock::now() - start).count() / frames;
+
+	start = Clock::now();
+	for (int i = 0; i < frames; i++)
+		particles.PrepareDraw();
+	double packSeconds = std::chrono::duration<double>(Clock::now() - start).count() / frames;
+
+	printf("Particle benchmark: %u particles, update %.3f ms (%s), pack for drawing %.3f ms per frame\n",
+		particles.GetDrawCount(), updateSeconds * 1000.0, jobs ? "parallel" : "single thread", packSeconds * 1000.0);
+	return updateSeconds;
+}
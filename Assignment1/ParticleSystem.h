@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	ParticleSystem.h
+//	Sparks and debris thrown off by the spinners. Particles live in one fixed block
+//	allocated up front, stored as separate arrays per attribute (structure of arrays)
+//	so Update() integrates four particles per SSE instruction. Emit() writes into a
+//	ring: when the system is full the oldest particles are overwritten, nothing is
+//	ever allocated after construction. Live particles are packed into a vertex
+//	array once per frame and drawn as GL_POINTS as often as there are views.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class JobSystem;
+
+class ParticleSystem
+{
+public:
+	// capacity is rounded up to a multiple of 4
+	ParticleSystem(uint32_t capacity = 262144);
+	~ParticleSystem();
+
+	ParticleSystem(const ParticleSystem &) = delete;
+	ParticleSystem &operator=(const ParticleSystem &) = delete;
+
+	// count particles at position with velocity plus a random offset of up to spread
+	// in every direction, living minLife to maxLife seconds. color is 0xAABBGGRR as
+	// GL reads GL_UNSIGNED_BYTE colours, alpha fades out with the remaining life.
+	void Emit(const float position[3], const float velocity[3], float spread, uint32_t count,
+		float minLife, float maxLife, uint32_t color);
+
+	// Gravity, bouncing off the ground plane and ageing. Spread over jobs when given.
+	void Update(float dt, JobSystem *jobs = NULL);
+
+	// Packs live particles for drawing, once per frame before any Draw()
+	void PrepareDraw();
+	void Draw(float pointSize) const;
+
+	void Clear();
+
+	uint32_t GetCapacity() const { return capacity; }
+	uint32_t GetWindowSize() const { return windowSize; }	// slots that may hold live particles
+	uint32_t GetDrawCount() const { return drawCount; }
+	bool HasLiveParticles() const { return windowSize > 0; }
+
+	float gravity;
+	float groundY;
+	float restitution;	// vertical speed kept on bouncing
+	float friction;		// horizontal speed kept on bouncing
+
+private:
+	void UpdateRange(uint32_t begin, uint32_t end, float dt);
+	float Random();
+
+	struct DrawVertex
+	{
+		uint32_t color;
+		float position[3];
+	};
+
+	unsigned char *block;
+	float *posX, *posY, *posZ;
+	float *velX, *velY, *velZ;
+	float *life, *invLifetime;
+	uint32_t *color;
+	DrawVertex *vertices;
+
+	uint32_t capacity;
+	uint32_t head;			// next slot Emit() writes
+	uint32_t windowSize;	// slots from head backwards that may still be alive
+	uint32_t drawCount;
+	uint32_t randomState;
+};
+
+// Updates count particles for frames frames and prints the time per frame
+double BenchmarkParticles(uint32_t count, int frames, JobSystem *jobs = NULL);
+
+#endif	//PARTICLESYSTEM_H
@@ -0,0 +1,17 @@
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <gl/gl.h>
+#include "Primitives.h"
+
+
+void DrawPrimitive(const PrimitiveView & primitive)
+{
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, primitive.positions);
+	glNormalPointer(GL_FLOAT, 0, primitive.normals);
+	glDrawElements(GL_TRIANGLES, primitive.numIndices, GL_UNSIGNED_SHORT, primitive.indices);
+	glPopClientAttrib();
+}
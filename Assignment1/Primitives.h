@@ -0,0 +1,257 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Primitives.h
+//	Compile-time generated primitive meshes: cube, cylinder, disk and wedge.
+//	Every generator is constexpr, so a tessellation such as MakeCylinder<100, 1>()
+//	is computed by the compiler and ends up as constant data that can be handed to
+//	glDrawElements (or a buffer upload) as is. Shapes match their GLU counterparts:
+//	the cylinder runs along +z from 0 to 1 with radius 1 like gluCylinder(q, 1, 1, 1, ...),
+//	the disk lies in z = 0 facing +z like gluDisk(q, 0, 1, ...).
+//	Triangles are counterclockwise seen from the side the normal points to.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <stdint.h>
+
+// Untyped view of a primitive's arrays, for code that does not care about its size
+struct PrimitiveView
+{
+	const float *positions;		// 3 floats per vertex
+	const float *normals;		// 3 floats per vertex
+	const uint16_t *indices;	// triangle list
+	int numVertices;
+	int numIndices;
+};
+
+template <int NumVertices, int NumIndices>
+struct PrimitiveMesh
+{
+	static_assert(NumVertices <= 65536, "16-bit indices");
+
+	float positions[NumVertices][3];
+	float normals[NumVertices][3];
+	uint16_t indices[NumIndices];
+
+	constexpr PrimitiveView View() const
+	{
+		return PrimitiveView{ &positions[0][0], &normals[0][0], indices, NumVertices, NumIndices };
+	}
+};
+
+// Draws with client-side vertex arrays, defined in Primitives.cpp (needs GL)
+void DrawPrimitive(const PrimitiveView & primitive);
+
+
+// constexpr sine and cosine, std::sin/cos are not usable at compile time
+constexpr double PrimitivePi = 3.14159265358979323846;
+
+constexpr double ConstSin(double x)
+{
+	// Reduce to [-pi, pi], then a Taylor series that is exact to double precision there
+	double turns = x / (2.0 * PrimitivePi);
+	long long k = (long long)(turns + (turns >= 0.0 ? 0.5 : -0.5));
+	x -= (double)k * 2.0 * PrimitivePi;
+
+	double term = x;
+	double sum = x;
+	for (int n = 1; n < 14; n++)
+	{
+		term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double ConstCos(double x)
+{
+	return ConstSin(x + 0.5 * PrimitivePi);
+}
+
+constexpr double ConstSqrt(double x)
+{
+	// Newton iteration from above converges monotonically
+	if (x <= 0.0)
+		return 0.0;
+	double r = x > 1.0 ? x : 1.0;
+	for (int i = 0; i < 64; i++)
+		r = 0.5 * (r + x / r);
+	return r;
+}
+
+
+// Standard size cube (width 2) centred at the origin, flat normals, 4 vertices per face
+constexpr PrimitiveMesh<24, 36> MakeCube()
+{
+	PrimitiveMesh<24, 36> mesh{};
+
+	// Normal, and two tangents with u x v = normal
+	const float faces[6][3][3] = {
+		{ { 0, 0, -1 }, { -1, 0, 0 }, { 0, 1, 0 } },	// back
+		{ { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },		// top
+		{ { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },		// left
+		{ { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },		// right
+		{ { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },		// front
+		{ { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } }		// bottom
+	};
+	const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+	for (int f = 0; f < 6; f++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int v = f * 4 + c;
+			for (int k = 0; k < 3; k++)
+			{
+				mesh.positions[v][k] = faces[f][0][k] + corners[c][0] * faces[f][1][k] + corners[c][1] * faces[f][2][k];
+				mesh.normals[v][k] = faces[f][0][k];
+			}
+		}
+
+		const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i < 6; i++)
+			mesh.indices[f * 6 + i] = (uint16_t)(f * 4 + quad[i]);
+	}
+	return mesh;
+}
+
+// Open cylinder, radius 1 along +z from 0 to 1. The seam column is duplicated so
+// every ring has Slices + 1 vertices.
+template <int Slices, int Stacks>
+constexpr PrimitiveMesh<(Slices + 1) * (Stacks + 1), Slices * Stacks * 6> MakeCylinder()
+{
+	PrimitiveMesh<(Slices + 1) * (Stacks + 1), Slices * Stacks * 6> mesh{};
+
+	for (int i = 0; i <= Slices; i++)
+	{
+		double angle = 2.0 * PrimitivePi * i / Slices;
+		float s = (float)ConstSin(angle);
+		float c = (float)ConstCos(angle);
+		for (int j = 0; j <= Stacks; j++)
+		{
+			int v = j * (Slices + 1) + i;
+			mesh.positions[v][0] = s;
+			mesh.positions[v][1] = c;
+			mesh.positions[v][2] = (float)j / Stacks;
+			mesh.normals[v][0] = s;
+			mesh.normals[v][1] = c;
+			mesh.normals[v][2] = 0.0f;
+		}
+	}
+
+	int n = 0;
+	for (int j = 0; j < Stacks; j++)
+	{
+		for (int i = 0; i < Slices; i++)
+		{
+			uint16_t a = (uint16_t)(j * (Slices + 1) + i);
+			uint16_t b = (uint16_t)(a + 1);
+			uint16_t c = (uint16_t)(a + Slices + 1);
+			uint16_t d = (uint16_t)(c + 1);
+			mesh.indices[n++] = a; mesh.indices[n++] = c; mesh.indices[n++] = b;
+			mesh.indices[n++] = b; mesh.indices[n++] = c; mesh.indices[n++] = d;
+		}
+	}
+	return mesh;
+}
+
+// Filled disk of radius 1 in the z = 0 plane facing +z: a centre vertex and
+// Loops concentric rings of Slices vertices
+template <int Slices, int Loops>
+constexpr PrimitiveMesh<1 + Slices * Loops, Slices * 3 + (Loops - 1) * Slices * 6> MakeDisk()
+{
+	PrimitiveMesh<1 + Slices * Loops, Slices * 3 + (Loops - 1) * Slices * 6> mesh{};
+
+	mesh.normals[0][2] = 1.0f;
+	for (int l = 0; l < Loops; l++)
+	{
+		float radius = (float)(l + 1) / Loops;
+		for (int i = 0; i < Slices; i++)
+		{
+			double angle = 2.0 * PrimitivePi * i / Slices;
+			int v = 1 + l * Slices + i;
+			mesh.positions[v][0] = radius * (float)ConstSin(angle);
+			mesh.positions[v][1] = radius * (float)ConstCos(angle);
+			mesh.normals[v][2] = 1.0f;
+		}
+	}
+
+	int n = 0;
+	for (int i = 0; i < Slices; i++)
+	{
+		mesh.indices[n++] = 0;
+		mesh.indices[n++] = (uint16_t)(1 + (i + 1) % Slices);
+		mesh.indices[n++] = (uint16_t)(1 + i);
+	}
+	for (int l = 0; l + 1 < Loops; l++)
+	{
+		for (int i = 0; i < Slices; i++)
+		{
+			uint16_t a = (uint16_t)(1 + l * Slices + i);
+			uint16_t b = (uint16_t)(1 + l * Slices + (i + 1) % Slices);
+			uint16_t c = (uint16_t)(a + Slices);
+			uint16_t d = (uint16_t)(b + Slices);
+			mesh.indices[n++] = a; mesh.indices[n++] = b; mesh.indices[n++] = c;
+			mesh.indices[n++] = b; mesh.indices[n++] = d; mesh.indices[n++] = c;
+		}
+	}
+	return mesh;
+}
+
+// Triangular slab: top face (1,0,0) (-1,0,0) (0,0,1) at y = 0, extruded down to
+// y = -thickness, flat normals on every face
+constexpr PrimitiveMesh<18, 24> MakeWedge(float thickness)
+{
+	PrimitiveMesh<18, 24> mesh{};
+
+	const float corner[3][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 } };	// (x, z), counterclockwise seen from +y
+
+	for (int i = 0; i < 3; i++)
+	{
+		// Top and bottom caps
+		mesh.positions[i][0] = corner[i][0];
+		mesh.positions[i][2] = corner[i][1];
+		mesh.normals[i][1] = 1.0f;
+
+		mesh.positions[3 + i][0] = corner[2 - i][0];
+		mesh.positions[3 + i][1] = -thickness;
+		mesh.positions[3 + i][2] = corner[2 - i][1];
+		mesh.normals[3 + i][1] = -1.0f;
+
+		mesh.indices[i] = (uint16_t)i;
+		mesh.indices[3 + i] = (uint16_t)(3 + i);
+	}
+
+	// Side quads, one per edge of the top face
+	for (int e = 0; e < 3; e++)
+	{
+		const float *p0 = corner[e];
+		const float *p1 = corner[(e + 1) % 3];
+
+		// Outward normal of edge p0 -> p1 of a counterclockwise (seen from +y) polygon in xz
+		float nx = -(p1[1] - p0[1]);
+		float nz = p1[0] - p0[0];
+		float length = (float)ConstSqrt(nx * nx + nz * nz);
+		nx /= length;
+		nz /= length;
+
+		int v = 6 + e * 4;
+		const float quad[4][3] = {
+			{ p0[0], 0.0f, p0[1] }, { p0[0], -thickness, p0[1] }, { p1[0], -thickness, p1[1] }, { p1[0], 0.0f, p1[1] }
+		};
+		for (int c = 0; c < 4; c++)
+		{
+			for (int k = 0; k < 3; k++)
+				mesh.positions[v + c][k] = quad[c][k];
+			mesh.normals[v + c][0] = nx;
+			mesh.normals[v + c][2] = nz;
+		}
+
+		int n = 6 + e * 6;
+		mesh.indices[n++] = (uint16_t)v; mesh.indices[n++] = (uint16_t)(v + 1); mesh.indices[n++] = (uint16_t)(v + 2);
+		mesh.indices[n++] = (uint16_t)v; mesh.indices[n++] = (uint16_t)(v + 2); mesh.indices[n++] = (uint16_t)(v + 3);
+	}
+	return mesh;
+}
+
+#endif	//PRIMITIVES_H
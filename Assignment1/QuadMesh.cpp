@@ -6,9 +6,18 @@
 #include <math.h>
 #include <utility>
 #include <vector>
+#include <stdint.h>
+#include <stdio.h>
 #include "VECTOR3D.h"
+#include "CompactVertex.h"
 
 #include "QuadMesh.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "VertexCache.h"
+
+// The cache stores vertices as 6 packed floats, which must match MeshVertex
+static_assert(sizeof(MeshVertex) == 6 * sizeof(float), "MeshVertex must be tightly packed");
 
 
 QuadMesh::QuadMesh(int maxMeshSize, float meshDim)
@@ -16,8 +25,11 @@ QuadMesh::QuadMesh(int maxMeshSize, float meshDim)
 	minMeshSize = 1;
 	numVertices = 0;
 	vertices = NULL;
+	currentMeshSize = 0;
+	vertexFormat = VertexFormatFloat;
 	numQuads = 0;
 	quads = NULL;
+	cacheFile = NULL;
 	numFacesDrawn = 0;
 
 	this->maxMeshSize = maxMeshSize < minMeshSize ? minMeshSize : maxMeshSize;
@@ -41,6 +53,53 @@ QuadMesh::QuadMesh(int maxMeshSize, float meshDim)
 
 }
 
+QuadMesh::QuadMesh(QuadMesh && rhs)
+{
+	vertices = NULL;
+	quads = NULL;
+	cacheFile = NULL;
+	*this = std::move(rhs);
+}
+
+QuadMesh &QuadMesh::operator=(QuadMesh && rhs)
+{
+	if (this == &rhs)
+		return *this;
+
+	FreeMemory();
+
+	maxMeshSize = rhs.maxMeshSize;
+	minMeshSize = rhs.minMeshSize;
+	meshDim = rhs.meshDim;
+	numFacesDrawn = rhs.numFacesDrawn;
+	memcpy(mat_ambient, rhs.mat_ambient, sizeof(mat_ambient));
+	memcpy(mat_specular, rhs.mat_specular, sizeof(mat_specular));
+	memcpy(mat_diffuse, rhs.mat_diffuse, sizeof(mat_diffuse));
+	memcpy(mat_shininess, rhs.mat_shininess, sizeof(mat_shininess));
+
+	// Quads point into the vertex array, which stays where it is, so the
+	// pointers remain valid after the arrays change hands
+	numVertices = rhs.numVertices;
+	vertices = rhs.vertices;
+	currentMeshSize = rhs.currentMeshSize;
+	vertexFormat = rhs.vertexFormat;
+	compact = std::move(rhs.compact);
+	strip = std::move(rhs.strip);
+	cacheFile = rhs.cacheFile;
+	numQuads = rhs.numQuads;
+	quads = rhs.quads;
+
+	rhs.cacheFile = NULL;
+	rhs.vertices = NULL;
+	rhs.numVertices = 0;
+	rhs.vertexFormat = VertexFormatFloat;
+	rhs.compact.Clear();
+	rhs.quads = NULL;
+	rhs.numQuads = 0;
+
+	return *this;
+}
+
 void QuadMesh::SetMaterial(VECTOR3D ambient, VECTOR3D diffuse, VECTOR3D specular, double shininess)
 {
 	mat_ambient[0] = ambient.x;
@@ -79,6 +138,11 @@ bool QuadMesh::CreateMemory()
 
 bool QuadMesh::InitMesh(int meshSize, VECTOR3D origin, double meshLength, double meshWidth, VECTOR3D dir1, VECTOR3D dir2)
 {
+	DropCompact();
+	if (!vertices)
+		return false;
+	currentMeshSize = meshSize;
+
 	VECTOR3D o;
 	int currentVertex = 0;
 	double sf1, sf2;
@@ -123,27 +187,89 @@ bool QuadMesh::InitMesh(int meshSize, VECTOR3D origin, double meshLength, double
 	}
 
 	// Build Quad Polygons
-	numQuads = (meshSize)*(meshSize);
-	int currentQuad = 0;
+	LinkQuads();
+	BuildStrip();
 
-	for (int j = 0; j < meshSize; j++)
+	this->ComputeNormals();
+
+	return true;
+}
+
+bool QuadMesh::InitMeshCached(const char *cacheDir, int meshSize, VECTOR3D origin, double meshLength, double meshWidth,
+	VECTOR3D dir1, VECTOR3D dir2)
+{
+	uint64_t key = MeshCacheKey(meshSize, origin, meshLength, meshWidth, dir1, dir2);
+	char path[512];
+	MeshCachePath(cacheDir, key, path, sizeof(path));
+
+	if (LoadCache(path, key, meshSize))
+		return true;
+
+	if (!InitMesh(meshSize, origin, meshLength, meshWidth, dir1, dir2))
+		return false;
+
+	if (!SaveCache(path, key, meshSize))
+		printf("Could not write mesh cache %s\n", path);
+
+	return true;
+}
+
+bool QuadMesh::LoadCache(const char *path, uint64_t key, int meshSize)
+{
+	if (meshSize > maxMeshSize)
+		return false;
+
+	MappedFile *file = new MappedFile();
+	const MeshCacheHeader *header = NULL;
+	if (file->Open(path))
+		header = ValidateMeshCache(*file, key);
+
+	if (!header || (int)header->meshSize != meshSize)
 	{
-		for (int k = 0; k < meshSize; k++)
-		{
-			// Counterclockwise order
-			quads[currentQuad].vertices[0] = &vertices[j*    (meshSize + 1) + k];
-			quads[currentQuad].vertices[1] = &vertices[j*    (meshSize + 1) + k + 1];
-			quads[currentQuad].vertices[2] = &vertices[(j + 1)*(meshSize + 1) + k + 1];
-			quads[currentQuad].vertices[3] = &vertices[(j + 1)*(meshSize + 1) + k];
-			currentQuad++;
-		}
+		delete file;
+		return false;
 	}
+	DropCompact();
+	currentMeshSize = meshSize;
+
+	// Drop whatever the mesh held before and use the mapped vertices in place
+	int quadCapacity = maxMeshSize * maxMeshSize;
+	if (cacheFile)
+		delete cacheFile;
+	else
+		delete[] vertices;
+	cacheFile = file;
 
-	this->ComputeNormals();
+	numVertices = (int)header->numVertices;
+	vertices = (MeshVertex*)(file->GetData() + header->vertexOffset);
+
+	// Quads hold pointers, so they are rebuilt from the stored indices
+	const uint32_t *indices = (const uint32_t*)(file->GetData() + header->indexOffset);
+	numQuads = (int)header->numQuads < quadCapacity ? (int)header->numQuads : quadCapacity;
+	for (int i = 0; i < numQuads; i++)
+	{
+		quads[i].vertices[0] = &vertices[indices[4 * i + 0]];
+		quads[i].vertices[1] = &vertices[indices[4 * i + 1]];
+		quads[i].vertices[2] = &vertices[indices[4 * i + 2]];
+		quads[i].vertices[3] = &vertices[indices[4 * i + 3]];
+	}
+	BuildStrip();
 
 	return true;
 }
 
+bool QuadMesh::SaveCache(const char *path, uint64_t key, int meshSize)
+{
+	std::vector<uint32_t> indices(numQuads * 4);
+	for (int i = 0; i < numQuads; i++)
+	{
+		for (int k = 0; k < 4; k++)
+			indices[4 * i + k] = (uint32_t)(quads[i].vertices[k] - vertices);
+	}
+
+	return WriteMeshCache(path, key, meshSize, (const float*)vertices, numVertices, indices.data(), numQuads);
+}
+
 void QuadMesh::DrawMesh(int meshSize)
 {
 	int currentQuad = 0;
@@ -153,6 +279,49 @@ void QuadMesh::DrawMesh(int meshSize)
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
 
+	if (vertexFormat != VertexFormatFloat)
+	{
+		// Decode one row of vertices ahead and draw the quads between it and the last,
+		// the scratch is shared by every mesh since drawing stays on the GL thread
+		static std::vector<float> rows;
+		int rowLength = meshSize + 1;
+		if ((meshSize + 1) * rowLength > compact.GetVertexCount())
+			return;
+		rows.resize(12 * rowLength);
+		float *lower = &rows[0], *upper = &rows[6 * rowLength];
+		compact.Decode(0, rowLength, lower);
+		for (int j = 0; j < meshSize; j++)
+		{
+			compact.Decode((j + 1) * rowLength, rowLength, upper);
+			glBegin(GL_QUADS);
+			for (int k = 0; k < meshSize; k++)
+			{
+				// Counterclockwise, as the quads are built in InitMesh()
+				const float *corners[4] = { &lower[6 * k], &lower[6 * (k + 1)], &upper[6 * (k + 1)], &upper[6 * k] };
+				for (int c = 0; c < 4; c++)
+				{
+					glNormal3f(corners[c][3], corners[c][4], corners[c][5]);
+					glVertex3f(corners[c][0], corners[c][1], corners[c][2]);
+				}
+			}
+			glEnd();
+			std::swap(lower, upper);
+		}
+		return;
+	}
+
+	if (meshSize == currentMeshSize && !strip.empty())
+	{
+		glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), &vertices[0].position.x);
+		glNormalPointer(GL_FLOAT, sizeof(MeshVertex), &vertices[0].normal.x);
+		glDrawElements(GL_TRIANGLE_STRIP, (GLsizei)strip.size(), GL_UNSIGNED_INT, strip.data());
+		glPopClientAttrib();
+		return;
+	}
+
 	for (int j = 0; j < meshSize; j++)
 	{
 		for (int k = 0; k < meshSize; k++)
@@ -201,10 +370,152 @@ void QuadMesh::DrawMesh(int meshSize)
 
 
 
+bool QuadMesh::SetVertexFormat(VertexFormat format)
+{
+	if (format == vertexFormat)
+		return true;
+
+	if (vertexFormat != VertexFormatFloat)
+	{
+		// Compact to float or to another compact format, both through floats
+		std::vector<float> decoded((size_t)numVertices * 6);
+		compact.Decode(0, numVertices, decoded.data());
+		if (format != VertexFormatFloat)
+		{
+			compact.Encode(format, decoded.data(), numVertices);
+			vertexFormat = format;
+			return true;
+		}
+
+		compact.Clear();
+		vertexFormat = VertexFormatFloat;
+		if (!CreateMemory())
+			return false;
+		for (int i = 0; i < numVertices; i++)
+		{
+			const float *vertex = &decoded[6 * i];
+			vertices[i].position = VECTOR3D(vertex[0], vertex[1], vertex[2]);
+			vertices[i].normal = VECTOR3D(vertex[3], vertex[4], vertex[5]);
+		}
+		LinkQuads();
+		return true;
+	}
+
+	compact.Encode(format, (const float*)vertices, numVertices);
+	vertexFormat = format;
+	if (cacheFile)
+		delete cacheFile;
+	else
+		delete[] vertices;
+	cacheFile = NULL;
+	vertices = NULL;
+	delete[] quads;
+	quads = NULL;
+	return true;
+}
+
+size_t QuadMesh::GetVertexBytes() const
+{
+	return vertexFormat == VertexFormatFloat ? numVertices * sizeof(MeshVertex) : compact.GetByteSize();
+}
+
+void QuadMesh::ReportVertexFormats(const char *name) const
+{
+	if (vertexFormat == VertexFormatFloat)
+	{
+		::ReportVertexFormats(name, (const float*)vertices, numVertices);
+		return;
+	}
+
+	std::vector<float> decoded((size_t)numVertices * 6);
+	compact.Decode(0, numVertices, decoded.data());
+	printf("(%s is stored as %s, measuring from the decoded vertices)\n", name, GetVertexFormatName(vertexFormat));
+	::ReportVertexFormats(name, decoded.data(), numVertices);
+}
+
+// Float vertices and quads again, ready to be generated or loaded over
+void QuadMesh::DropCompact()
+{
+	if (vertexFormat == VertexFormatFloat)
+		return;
+	compact.Clear();
+	vertexFormat = VertexFormatFloat;
+	CreateMemory();
+}
+
+// Quads over the grid of currentMeshSize, as InitMesh() builds them
+void QuadMesh::LinkQuads()
+{
+	int rowLength = currentMeshSize + 1;
+	numQuads = currentMeshSize * currentMeshSize;
+	int currentQuad = 0;
+	for (int j = 0; j < currentMeshSize; j++)
+	{
+		for (int k = 0; k < currentMeshSize; k++)
+		{
+			// Counterclockwise order
+			quads[currentQuad].vertices[0] = &vertices[j * rowLength + k];
+			quads[currentQuad].vertices[1] = &vertices[j * rowLength + k + 1];
+			quads[currentQuad].vertices[2] = &vertices[(j + 1) * rowLength + k + 1];
+			quads[currentQuad].vertices[3] = &vertices[(j + 1) * rowLength + k];
+			currentQuad++;
+		}
+	}
+}
+
+// Indices only depend on the grid size, so the strip survives format changes
+void QuadMesh::BuildStrip()
+{
+	int band = GetGridStripBand();
+	strip.resize(MakeGridStrip(currentMeshSize, currentMeshSize, band, NULL));
+	MakeGridStrip(currentMeshSize, currentMeshSize, band, strip.data());
+}
+
+void QuadMesh::ReportVertexCache(const char *name) const
+{
+	std::vector<uint32_t> rows;
+	RowTriangles(rows);
+
+	int count = (currentMeshSize + 1) * (currentMeshSize + 1);
+	VertexCacheStats before = MeasureVertexCache(rows.data(), (int)rows.size(), count);
+	VertexCacheStats after = MeasureVertexCache(strip.data(), (int)strip.size(), count, VertexCacheSize, true);
+	PrintVertexCacheStats(name, before, after);
+}
+
+void QuadMesh::GetTriangles(std::vector<float> &vertexData, std::vector<uint32_t> &indices) const
+{
+	vertexData.resize((size_t)numVertices * 6);
+	if (vertexFormat == VertexFormatFloat)
+		memcpy(vertexData.data(), vertices, vertexData.size() * sizeof(float));
+	else
+		compact.Decode(0, numVertices, vertexData.data());
+	RowTriangles(indices);
+}
+
+// Each quad as the two triangles GL_QUADS turns it into, row by row
+void QuadMesh::RowTriangles(std::vector<uint32_t> &indices) const
+{
+	int rowLength = currentMeshSize + 1;
+	indices.clear();
+	indices.reserve(6 * currentMeshSize * currentMeshSize);
+	for (int j = 0; j < currentMeshSize; j++)
+	{
+		for (int k = 0; k < currentMeshSize; k++)
+		{
+			uint32_t a = j * rowLength + k, b = a + 1, c = b + rowLength, d = a + rowLength;
+			uint32_t quad[6] = { a, b, c, a, c, d };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
 void QuadMesh::FreeMemory()
 {
-	if (vertices)
+	if (cacheFile)
+		delete cacheFile;
+	else if (vertices)
 		delete[] vertices;
+	cacheFile = NULL;
 	vertices = NULL;
 	numVertices = 0;
 
@@ -212,6 +523,10 @@ void QuadMesh::FreeMemory()
 		delete[] quads;
 	quads = NULL;
 	numQuads = 0;
+
+	compact.Clear();
+	vertexFormat = VertexFormatFloat;
+	strip.clear();
 }
 
 void QuadMesh::ComputeNormals()
@@ -1,3 +1,5 @@
+class MappedFile;
+
 struct MeshVertex
 {
 	VECTOR3D	position;
@@ -22,10 +24,24 @@ private:
 
 	int numVertices;
 	MeshVertex *vertices;
+	int currentMeshSize;
+
+	// In any other format the vertices live in compact only and vertices and quads
+	// are NULL, see SetVertexFormat()
+	VertexFormat vertexFormat;
+	CompactVertices compact;
+
+	// Non-NULL when vertices point into a mapped mesh cache file instead of
+	// the array allocated by CreateMemory()
+	MappedFile *cacheFile;
 
 	int numQuads;
 	MeshQuad *quads;
 
+	// The grid of currentMeshSize as one triangle strip in cache friendly bands,
+	// see MakeGridStrip()
+	std::vector<uint32_t> strip;
+
 	int numFacesDrawn;
 
 	GLfloat mat_ambient[4];
@@ -37,6 +53,12 @@ private:
 private:
 	bool CreateMemory();
 	void FreeMemory();
+	void DropCompact();
+	void LinkQuads();
+	void BuildStrip();
+	void RowTriangles(std::vector<uint32_t> &indices) const;
+	bool LoadCache(const char *path, uint64_t key, int meshSize);
+	bool SaveCache(const char *path, uint64_t key, int meshSize);
 
 public:
 
@@ -49,17 +71,47 @@ public:
 		FreeMemory();
 	}
 
+	// The mesh owns its vertex and quad arrays, so it can be moved but not copied
+	QuadMesh(const QuadMesh &) = delete;
+	QuadMesh &operator=(const QuadMesh &) = delete;
+	QuadMesh(QuadMesh && rhs);
+	QuadMesh &operator=(QuadMesh && rhs);
+
 	MaxMeshDim GetMaxMeshDimentions()
 	{
 		return MaxMeshDim(minMeshSize, maxMeshSize);
 	}
 
 	bool InitMesh(int meshSize, VECTOR3D origin, double meshLength, double meshWidth, VECTOR3D dir1, VECTOR3D dir2);
+	// Same as InitMesh(), but maps the vertices and normals from a cache file in cacheDir
+	// when one exists for these parameters, and writes one after generating otherwise
+	bool InitMeshCached(const char *cacheDir, int meshSize, VECTOR3D origin, double meshLength, double meshWidth,
+		VECTOR3D dir1, VECTOR3D dir2);
 	void DrawMesh(int meshSize);
 	void UpdateMesh();
 	void SetMaterial(VECTOR3D ambient, VECTOR3D diffuse, VECTOR3D specular, double shininess);
+	// Float vertices only
 	void ComputeNormals();
 
+	// Keeps the vertices in format from now on and decodes them while drawing, two
+	// rows at a time. A compact format frees the float vertices and the quads (or
+	// unmaps the cache file); going back to VertexFormatFloat decodes them again.
+	bool SetVertexFormat(VertexFormat format);
+	VertexFormat GetVertexFormat() const { return vertexFormat; }
+	size_t GetVertexBytes() const;
+
+	// Prints what each vertex format would save on this mesh and its error, see
+	// ReportVertexFormats(). Measured from the float vertices, or from the decoded
+	// compact ones when the mesh already uses another format.
+	void ReportVertexFormats(const char *name) const;
+
+	// Prints the simulated vertex cache misses of the strip DrawMesh() uses against
+	// the row by row quads it replaced
+	void ReportVertexCache(const char *name) const;
+
+	// The grid as a triangle list of 6 float vertices, decoded if the mesh is compact
+	void GetTriangles(std::vector<float> &vertexData, std::vector<uint32_t> &indices) const;
+
 
 };
 
@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Robot.h
+//	Per-robot state. The body dimensions are shared by every robot and stay in
+//	main.cpp, this only holds what differs from one robot to the next.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ROBOT_H
+#define ROBOT_H
+
+#include <math.h>
+#include <stdint.h>
+#include "FastTrig.h"
+#include "VECTOR3D.h"
+
+struct Robot
+{
+	// Position on the ground plane
+	float x, z;
+
+	// Rotation of the whole robot around the y axis, in degrees
+	float angle;
+
+	// Spinner rotation and whether it is currently spinning
+	float spinnerAngle;
+	bool spinnerOn;
+
+	// Wheel rotation, independent of each other
+	float leftWheelAngle;
+	float rightWheelAngle;
+
+	//Keep track of forwards vector that the robot is facing, uses sin and cos so values will be
+	//from -1 to 1, always a unit vector
+	VECTOR3D forwards;
+
+	Robot(float x = 0.0f, float z = 0.0f, float angle = 0.0f) : x(x), z(z), angle(angle), spinnerAngle(0.0f),
+		spinnerOn(false), leftWheelAngle(0.0f), rightWheelAngle(0.0f)
+	{
+		UpdateForwards();
+	}
+
+	void UpdateForwards()
+	{
+		float s, c;
+		FastSinCosDegrees(angle, s, c);
+		forwards.Set(s, 0.0f, c);
+	}
+};
+
+// One driver input, what a single arrow key or spacebar press does. Commands are
+// numbered so a server applies each exactly once and a client can replay the ones
+// the server has not acknowledged yet.
+struct RobotCommand
+{
+	uint32_t sequence;
+	int8_t turn;			// +1 counter-clockwise (left arrow), -1 clockwise (right arrow)
+	int8_t move;			// +1 forwards (up arrow), -1 backwards (down arrow)
+	uint8_t toggleSpinner;
+};
+
+// Continuous drive input, turn and move from -1 to 1. Full deflection is one arrow
+// key press: 3 degrees of rotation or one unit of travel.
+inline void ApplyRobotAction(Robot &robot, float turn, float move)
+{
+	if (turn != 0.0f)
+	{
+		robot.leftWheelAngle -= 8 * turn;
+		robot.rightWheelAngle += 8 * turn;
+		robot.angle += 3.0f * turn;
+		robot.UpdateForwards();
+	}
+	if (move != 0.0f)
+	{
+		robot.leftWheelAngle += 8 * move;
+		robot.rightWheelAngle += 8 * move;
+		robot.x += move * robot.forwards.GetX();
+		robot.z += move * robot.forwards.GetZ();
+	}
+}
+
+// Same on every machine, no GL and no timing, so prediction and server agree
+inline void ApplyRobotCommand(Robot &robot, const RobotCommand &command)
+{
+	ApplyRobotAction(robot, (float)command.turn, (float)command.move);
+	if (command.toggleSpinner)
+		robot.spinnerOn = !robot.spinnerOn;
+}
+
+#endif	//ROBOT_H
@@ -0,0 +1,648 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include "FastTrig.h"
+#include "JobSystem.h"
+#include "RobotAvoidance.h"
+
+static const float AvoidanceEpsilon = 1e-5f;
+
+// Velocities on the left of direction, through point, are allowed
+struct OrcaLine
+{
+	float pointX, pointZ;
+	float dirX, dirZ;
+};
+
+static float Det(float ax, float az, float bx, float bz)
+{
+	return ax * bz - az * bx;
+}
+
+// Best velocity on line lineNo within the speed circle and the earlier lines. With
+// directionOpt the furthest point along (optX, optZ), otherwise the closest to it.
+static bool LinearProgram1(const OrcaLine *lines, int lineNo, float radius, float optX, float optZ, bool directionOpt,
+	float &resultX, float &resultZ)
+{
+	const OrcaLine &line = lines[lineNo];
+	float dot = line.pointX * line.dirX + line.pointZ * line.dirZ;
+	float discriminant = dot * dot + radius * radius - (line.pointX * line.pointX + line.pointZ * line.pointZ);
+	if (discriminant < 0.0f)
+		return false;		// the speed circle misses the line
+
+	float root = sqrtf(discriminant);
+	float tLeft = -dot - root, tRight = -dot + root;
+	for (int i = 0; i < lineNo; i++)
+	{
+		float denominator = Det(line.dirX, line.dirZ, lines[i].dirX, lines[i].dirZ);
+		float numerator = Det(lines[i].dirX, lines[i].dirZ, line.pointX - lines[i].pointX, line.pointZ - lines[i].pointZ);
+		if (fabsf(denominator) <= AvoidanceEpsilon)
+		{
+			if (numerator < 0.0f)
+				return false;		// parallel and on the wrong side
+			continue;
+		}
+
+		float t = numerator / denominator;
+		if (denominator >= 0.0f)
+			tRight = std::min(tRight, t);
+		else
+			tLeft = std::max(tLeft, t);
+		if (tLeft > tRight)
+			return false;
+	}
+
+	float t;
+	if (directionOpt)
+		t = optX * line.dirX + optZ * line.dirZ > 0.0f ? tRight : tLeft;
+	else
+		t = std::max(tLeft, std::min(tRight, line.dirX * (optX - line.pointX) + line.dirZ * (optZ - line.pointZ)));
+	resultX = line.pointX + t * line.dirX;
+	resultZ = line.pointZ + t * line.dirZ;
+	return true;
+}
+
+// Incremental 2D linear program, returns the number of lines satisfied before the
+// first that could not be
+static int LinearProgram2(const OrcaLine *lines, int numLines, float radius, float optX, float optZ, bool directionOpt,
+	float &resultX, float &resultZ)
+{
+	float optLengthSq = optX * optX + optZ * optZ;
+	if (directionOpt)
+	{
+		resultX = optX * radius;
+		resultZ = optZ * radius;
+	}
+	else if (optLengthSq > radius * radius)
+	{
+		float scale = radius / sqrtf(optLengthSq);
+		resultX = optX * scale;
+		resultZ = optZ * scale;
+	}
+	else
+	{
+		resultX = optX;
+		resultZ = optZ;
+	}
+
+	for (int i = 0; i < numLines; i++)
+	{
+		if (Det(lines[i].dirX, lines[i].dirZ, lines[i].pointX - resultX, lines[i].pointZ - resultZ) <= 0.0f)
+			continue;
+		float keepX = resultX, keepZ = resultZ;
+		if (!LinearProgram1(lines, i, radius, optX, optZ, directionOpt, resultX, resultZ))
+		{
+			resultX = keepX;
+			resultZ = keepZ;
+			return i;
+		}
+	}
+	return numLines;
+}
+
+// When the lines leave no room, the velocity that violates them least
+static void LinearProgram3(const OrcaLine *lines, int numLines, int beginLine, float radius, float &resultX,
+	float &resultZ)
+{
+	OrcaLine projected[AvoidanceMaxNeighbours];
+	float distance = 0.0f;
+	for (int i = beginLine; i < numLines; i++)
+	{
+		if (Det(lines[i].dirX, lines[i].dirZ, lines[i].pointX - resultX, lines[i].pointZ - resultZ) <= distance)
+			continue;
+
+		int numProjected = 0;
+		for (int j = 0; j < i; j++)
+		{
+			OrcaLine &line = projected[numProjected];
+			float determinant = Det(lines[i].dirX, lines[i].dirZ, lines[j].dirX, lines[j].dirZ);
+			if (fabsf(determinant) <= AvoidanceEpsilon)
+			{
+				if (lines[i].dirX * lines[j].dirX + lines[i].dirZ * lines[j].dirZ > 0.0f)
+					continue;		// same direction
+				line.pointX = 0.5f * (lines[i].pointX + lines[j].pointX);
+				line.pointZ = 0.5f * (lines[i].pointZ + lines[j].pointZ);
+			}
+			else
+			{
+				float t = Det(lines[j].dirX, lines[j].dirZ, lines[i].pointX - lines[j].pointX,
+					lines[i].pointZ - lines[j].pointZ) / determinant;
+				line.pointX = lines[i].pointX + t * lines[i].dirX;
+				line.pointZ = lines[i].pointZ + t * lines[i].dirZ;
+			}
+			float dirX = lines[j].dirX - lines[i].dirX, dirZ = lines[j].dirZ - lines[i].dirZ;
+			float length = sqrtf(dirX * dirX + dirZ * dirZ);
+			if (length <= AvoidanceEpsilon)
+				continue;
+			line.dirX = dirX / length;
+			line.dirZ = dirZ / length;
+			numProjected++;
+		}
+
+		float keepX = resultX, keepZ = resultZ;
+		if (LinearProgram2(projected, numProjected, radius, -lines[i].dirZ, lines[i].dirX, true, resultX, resultZ)
+			< numProjected)
+		{
+			resultX = keepX;
+			resultZ = keepZ;
+		}
+		distance = Det(lines[i].dirX, lines[i].dirZ, lines[i].pointX - resultX, lines[i].pointZ - resultZ);
+	}
+}
+
+// Closest point to (px, pz) on the segment from a to b, or with ray on the ray from a
+// through b
+static void ClosestPoint(float px, float pz, float ax, float az, float bx, float bz, bool ray, float &resultX,
+	float &resultZ)
+{
+	float dx = bx - ax, dz = bz - az;
+	float lengthSq = dx * dx + dz * dz;
+	float t = lengthSq > 0.0f ? ((px - ax) * dx + (pz - az) * dz) / lengthSq : 0.0f;
+	t = ray ? std::max(0.0f, t) : std::max(0.0f, std::min(1.0f, t));
+	resultX = ax + t * dx;
+	resultZ = az + t * dz;
+}
+
+RobotAvoidance::RobotAvoidance(const AvoidanceSettings &settings) : settings(settings), gridMinX(0.0f),
+	gridMinZ(0.0f), gridCellSize(1.0f), gridWidth(0), gridHeight(0)
+{
+	this->settings.maxNeighbours = std::max(0, std::min(AvoidanceMaxNeighbours, settings.maxNeighbours));
+}
+
+void RobotAvoidance::SetAgentCount(int count)
+{
+	x.resize(count);
+	z.resize(count);
+	sinHeading.resize(count);
+	cosHeading.resize(count);
+	velX.resize(count);
+	velZ.resize(count);
+	preferredX.resize(count);
+	preferredZ.resize(count);
+	newVelX.resize(count);
+	newVelZ.resize(count);
+	avoids.resize(count);
+}
+
+void RobotAvoidance::SetAgent(int index, float x, float z, float heading, float velX, float velZ, float preferredX,
+	float preferredZ, bool avoids)
+{
+	this->x[index] = x;
+	this->z[index] = z;
+	FastSinCosDegrees(heading, sinHeading[index], cosHeading[index]);
+	this->velX[index] = velX;
+	this->velZ[index] = velZ;
+	this->preferredX[index] = preferredX;
+	this->preferredZ[index] = preferredZ;
+	this->avoids[index] = avoids;
+}
+
+void RobotAvoidance::GetVelocity(int index, float &velX, float &velZ) const
+{
+	velX = newVelX[index];
+	velZ = newVelZ[index];
+}
+
+// How far the body reaches from its centre along the unit direction. Forwards is
+// (sin, cos) of the heading, as in Robot::UpdateForwards(), and across is (cos, -sin).
+float RobotAvoidance::Extent(int index, float dirX, float dirZ) const
+{
+	float along = dirX * sinHeading[index] + dirZ * cosHeading[index];
+	float across = dirX * cosHeading[index] - dirZ * sinHeading[index];
+	return fabsf(along) * settings.halfDepth + fabsf(across) * settings.halfWidth;
+}
+
+// Corners of a body box centred on the origin, counter-clockwise from the lowest
+static void BoxCorners(float s, float c, float halfWidth, float halfDepth, float corners[4][2])
+{
+	const float signs[4][2] = { { 1.0f, 1.0f }, { -1.0f, 1.0f }, { -1.0f, -1.0f }, { 1.0f, -1.0f } };
+	for (int k = 0; k < 4; k++)
+	{
+		corners[k][0] = signs[k][0] * halfDepth * s + signs[k][1] * halfWidth * c;
+		corners[k][1] = signs[k][0] * halfDepth * c - signs[k][1] * halfWidth * s;
+	}
+	if (Det(corners[1][0] - corners[0][0], corners[1][1] - corners[0][1], corners[2][0] - corners[1][0],
+		corners[2][1] - corners[1][1]) < 0.0f)
+	{
+		std::swap(corners[1][0], corners[3][0]);
+		std::swap(corners[1][1], corners[3][1]);
+	}
+
+	int lowest = 0;
+	for (int k = 1; k < 4; k++)
+	{
+		if (corners[k][1] < corners[lowest][1] || (corners[k][1] == corners[lowest][1] && corners[k][0] < corners[lowest][0]))
+			lowest = k;
+	}
+	float rotated[4][2];
+	for (int k = 0; k < 4; k++)
+	{
+		rotated[k][0] = corners[(k + lowest) % 4][0];
+		rotated[k][1] = corners[(k + lowest) % 4][1];
+	}
+	memcpy(corners, rotated, sizeof(rotated));
+}
+
+// Minkowski sum of the two bodies (boxes are symmetric, so also a's body minus b's),
+// counter-clockwise, by merging the edges of both boxes in order of angle
+int RobotAvoidance::BodySum(int a, int b, float polygon[8][2]) const
+{
+	const float (*first)[2] = (const float (*)[2])&bodyCorners[8 * a];
+	const float (*second)[2] = (const float (*)[2])&bodyCorners[8 * b];
+
+	int count = 0, i = 0, j = 0;
+	while ((i < 4 || j < 4) && count < 8)
+	{
+		polygon[count][0] = first[i % 4][0] + second[j % 4][0];
+		polygon[count][1] = first[i % 4][1] + second[j % 4][1];
+		count++;
+		float cross = Det(first[(i + 1) % 4][0] - first[i % 4][0], first[(i + 1) % 4][1] - first[i % 4][1],
+			second[(j + 1) % 4][0] - second[j % 4][0], second[(j + 1) % 4][1] - second[j % 4][1]);
+		if (cross >= 0.0f && i < 4)
+			i++;
+		if (cross <= 0.0f && j < 4)
+			j++;
+	}
+	return count;
+}
+
+// Counting sort of the agents into cells of neighbourDistance
+void RobotAvoidance::BuildGrid()
+{
+	int count = (int)x.size();
+	float maxX = 0.0f, maxZ = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		gridMinX = i == 0 ? x[i] : std::min(gridMinX, x[i]);
+		gridMinZ = i == 0 ? z[i] : std::min(gridMinZ, z[i]);
+		maxX = i == 0 ? x[i] : std::max(maxX, x[i]);
+		maxZ = i == 0 ? z[i] : std::max(maxZ, z[i]);
+	}
+
+	// Agents scattered very far apart would want a huge grid, cells then grow instead
+	float cellSize = settings.neighbourDistance;
+	float cells = ((maxX - gridMinX) / cellSize + 1.0f) * ((maxZ - gridMinZ) / cellSize + 1.0f);
+	if (cells > 4.0f * count + 64.0f)
+		cellSize *= sqrtf(cells / (4.0f * count + 64.0f));
+	gridCellSize = cellSize;
+	gridWidth = (int)((maxX - gridMinX) / cellSize) + 1;
+	gridHeight = (int)((maxZ - gridMinZ) / cellSize) + 1;
+
+	cellStart.assign((size_t)gridWidth * gridHeight + 1, 0);
+	cellOf.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		int cx = std::min(gridWidth - 1, (int)((x[i] - gridMinX) / cellSize));
+		int cz = std::min(gridHeight - 1, (int)((z[i] - gridMinZ) / cellSize));
+		cellOf[i] = cz * gridWidth + cx;
+		cellStart[cellOf[i] + 1]++;
+	}
+	for (size_t c = 1; c < cellStart.size(); c++)
+		cellStart[c] += cellStart[c - 1];
+	cellAgents.resize(count);
+	cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+	for (int i = 0; i < count; i++)
+		cellAgents[cellFill[cellOf[i]]++] = i;
+}
+
+void RobotAvoidance::Solve(float dt, JobSystem *jobs)
+{
+	int count = (int)x.size();
+	if (count == 0)
+		return;
+	BuildGrid();
+	bodyCorners.resize(8 * count);
+	for (int i = 0; i < count; i++)
+		BoxCorners(sinHeading[i], cosHeading[i], settings.halfWidth, settings.halfDepth, (float (*)[2])&bodyCorners[8 * i]);
+
+	auto body = [this, dt](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			SolveAgent((int)i, dt);
+	};
+	if (jobs && count >= 512)
+		jobs->ParallelFor((uint32_t)count, 256, body);
+	else
+		body(0, (uint32_t)count);
+}
+
+void RobotAvoidance::SolveAgent(int index, float dt)
+{
+	float px = x[index], pz = z[index];
+	float vx = velX[index], vz = velZ[index];
+
+	// The nearest neighbours within range, kept sorted by an insertion pass
+	int neighbours[AvoidanceMaxNeighbours];
+	float neighbourDistSq[AvoidanceMaxNeighbours];
+	int numNeighbours = 0;
+	float rangeSq = settings.neighbourDistance * settings.neighbourDistance;
+	int reach = (int)ceilf(settings.neighbourDistance / gridCellSize);
+	int cx = cellOf[index] % gridWidth, cz = cellOf[index] / gridWidth;
+	for (int gz = std::max(0, cz - reach); gz <= std::min(gridHeight - 1, cz + reach); gz++)
+	{
+		for (int gx = std::max(0, cx - reach); gx <= std::min(gridWidth - 1, cx + reach); gx++)
+		{
+			int cell = gz * gridWidth + gx;
+			for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++)
+			{
+				int other = cellAgents[k];
+				float dx = x[other] - px, dz = z[other] - pz;
+				float distSq = dx * dx + dz * dz;
+				if (other == index || distSq > rangeSq)
+					continue;
+				if (numNeighbours == settings.maxNeighbours)
+				{
+					if (numNeighbours == 0 || distSq >= neighbourDistSq[numNeighbours - 1])
+						continue;
+					numNeighbours--;
+				}
+				int slot = numNeighbours++;
+				while (slot > 0 && neighbourDistSq[slot - 1] > distSq)
+				{
+					neighbours[slot] = neighbours[slot - 1];
+					neighbourDistSq[slot] = neighbourDistSq[slot - 1];
+					slot--;
+				}
+				neighbours[slot] = other;
+				neighbourDistSq[slot] = distSq;
+			}
+		}
+	}
+
+	OrcaLine lines[AvoidanceMaxNeighbours];
+	float invHorizon = 1.0f / settings.timeHorizon;
+	for (int n = 0; n < numNeighbours; n++)
+	{
+		int other = neighbours[n];
+		float relX = x[other] - px, relZ = z[other] - pz;
+		float relVelX = vx - velX[other], relVelZ = vz - velZ[other];
+		float distSq = neighbourDistSq[n];
+
+		// Where the two bodies touch: the sum of both boxes around the other robot
+		float polygon[8][2];
+		int corners = BodySum(index, other, polygon);
+		bool overlapping = true;
+		for (int k = 0; k < corners; k++)
+		{
+			polygon[k][0] += relX;
+			polygon[k][1] += relZ;
+		}
+		for (int k = 0; k < corners && overlapping; k++)
+		{
+			const float *a = polygon[k], *b = polygon[(k + 1) % corners];
+			overlapping = (b[1] - a[1]) * a[0] - (b[0] - a[0]) * a[1] >= 0.0f;
+		}
+
+		OrcaLine &line = lines[n];
+		float uX, uZ;		// smallest change of relative velocity that leaves the velocity obstacle
+		if (!overlapping)
+		{
+			// The velocity obstacle is the cone the polygon spans from the origin, cut off by
+			// the polygon shrunk to horizon: its legs and the near side of the shrunk polygon
+			int left = 0, right = 0;
+			for (int k = 1; k < corners; k++)
+			{
+				if (Det(polygon[left][0], polygon[left][1], polygon[k][0], polygon[k][1]) > 0.0f)
+					left = k;
+				if (Det(polygon[right][0], polygon[right][1], polygon[k][0], polygon[k][1]) < 0.0f)
+					right = k;
+			}
+
+			// Closest point on that boundary, and the outward normal of its side
+			float closestX = relVelX, closestZ = relVelZ, sideX = 0.0f, sideZ = 0.0f, bestSq = FLT_MAX;
+			const int legs[2] = { left, right };
+			for (int l = 0; l < 2; l++)
+			{
+				const float *corner = polygon[legs[l]];
+				float cx, cz;
+				ClosestPoint(relVelX, relVelZ, corner[0] * invHorizon, corner[1] * invHorizon, corner[0], corner[1], true,
+					cx, cz);
+				float distanceSq = (cx - relVelX) * (cx - relVelX) + (cz - relVelZ) * (cz - relVelZ);
+				if (distanceSq < bestSq)
+				{
+					bestSq = distanceSq;
+					closestX = cx;
+					closestZ = cz;
+					sideX = l == 0 ? -corner[1] : corner[1];
+					sideZ = l == 0 ? corner[0] : -corner[0];
+				}
+			}
+
+			// Meanwhile clip the ray along relVel against the polygon: relVel is in the
+			// obstacle if the ray enters the polygon within the horizon
+			float enter = 0.0f, exit = FLT_MAX;
+			for (int k = 0; k < corners; k++)
+			{
+				const float *a = polygon[k], *b = polygon[(k + 1) % corners];
+				float normalX = b[1] - a[1], normalZ = a[0] - b[0];
+				float facing = normalX * a[0] + normalZ * a[1];
+				if (facing < 0.0f)
+				{
+					float cx, cz;
+					ClosestPoint(relVelX, relVelZ, a[0] * invHorizon, a[1] * invHorizon, b[0] * invHorizon,
+						b[1] * invHorizon, false, cx, cz);
+					float distanceSq = (cx - relVelX) * (cx - relVelX) + (cz - relVelZ) * (cz - relVelZ);
+					if (distanceSq < bestSq)
+					{
+						bestSq = distanceSq;
+						closestX = cx;
+						closestZ = cz;
+						sideX = normalX;
+						sideZ = normalZ;
+					}
+				}
+
+				float along = normalX * relVelX + normalZ * relVelZ;
+				if (along < 0.0f)
+					enter = std::max(enter, facing / along);
+				else if (along > 0.0f)
+					exit = std::min(exit, facing / along);
+				else if (facing < 0.0f)
+					exit = -1.0f;
+			}
+			bool inside = enter <= exit && enter <= settings.timeHorizon;
+
+			uX = closestX - relVelX;
+			uZ = closestZ - relVelZ;
+			float length = sqrtf(uX * uX + uZ * uZ);
+			float normalX, normalZ;		// out of the obstacle
+			if (!inside && length > AvoidanceEpsilon)
+			{
+				// From outside the closest point may be a corner, the normal then points at relVel
+				normalX = -uX / length;
+				normalZ = -uZ / length;
+			}
+			else
+			{
+				// On or inside the boundary the side's own normal, u can be too short to tell
+				float sideLength = sqrtf(sideX * sideX + sideZ * sideZ);
+				normalX = sideX / sideLength;
+				normalZ = sideZ / sideLength;
+			}
+			line.dirX = normalZ;
+			line.dirZ = -normalX;
+		}
+		else
+		{
+			// Already overlapping: get apart along the line between the centres within this step
+			float dist = sqrtf(distSq);
+			float ux = dist > AvoidanceEpsilon ? relX / dist : 1.0f, uz = dist > AvoidanceEpsilon ? relZ / dist : 0.0f;
+			float radius = Extent(index, ux, uz) + Extent(other, ux, uz);
+			float invDt = 1.0f / dt;
+			float wX = relVelX - invDt * relX, wZ = relVelZ - invDt * relZ;
+			float wLength = sqrtf(wX * wX + wZ * wZ);
+			float unitX = wLength > AvoidanceEpsilon ? wX / wLength : -ux;
+			float unitZ = wLength > AvoidanceEpsilon ? wZ / wLength : -uz;
+			line.dirX = unitZ;
+			line.dirZ = -unitX;
+			uX = (radius * invDt - wLength) * unitX;
+			uZ = (radius * invDt - wLength) * unitZ;
+		}
+
+		// Half the correction each, all of it when the other robot does not avoid
+		float share = avoids[other] ? 0.5f : 1.0f;
+		line.pointX = vx + share * uX;
+		line.pointZ = vz + share * uZ;
+	}
+
+	float resultX, resultZ;
+	int satisfied = LinearProgram2(lines, numNeighbours, settings.maxSpeed, preferredX[index], preferredZ[index], false,
+		resultX, resultZ);
+	if (satisfied < numNeighbours)
+		LinearProgram3(lines, numNeighbours, satisfied, settings.maxSpeed, resultX, resultZ);
+	newVelX[index] = resultX;
+	newVelZ[index] = resultZ;
+}
+
+// Separating axis test of the two boxes on each of their axes, the depth of an
+// overlap is the least any axis overlaps by
+int RobotAvoidance::CountOverlaps(float *deepest) const
+{
+	int overlaps = 0;
+	float deepestDepth = 0.0f;
+	int count = (int)cellOf.size();
+	for (int i = 0; i < count; i++)
+	{
+		int cx = cellOf[i] % gridWidth, cz = cellOf[i] / gridWidth;
+		for (int gz = std::max(0, cz - 1); gz <= std::min(gridHeight - 1, cz + 1); gz++)
+		{
+			for (int gx = std::max(0, cx - 1); gx <= std::min(gridWidth - 1, cx + 1); gx++)
+			{
+				int cell = gz * gridWidth + gx;
+				for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++)
+				{
+					int j = cellAgents[k];
+					if (j <= i)
+						continue;
+					float dx = x[j] - x[i], dz = z[j] - z[i];
+					const float axes[4][2] = { { sinHeading[i], cosHeading[i] }, { cosHeading[i], -sinHeading[i] },
+						{ sinHeading[j], cosHeading[j] }, { cosHeading[j], -sinHeading[j] } };
+					float depth = FLT_MAX;
+					for (int a = 0; a < 4 && depth > 0.0f; a++)
+					{
+						float gap = fabsf(dx * axes[a][0] + dz * axes[a][1]);
+						depth = std::min(depth, Extent(i, axes[a][0], axes[a][1]) + Extent(j, axes[a][0], axes[a][1]) - gap);
+					}
+					if (depth > 0.0f)
+					{
+						overlaps++;
+						deepestDepth = std::max(deepestDepth, depth);
+					}
+				}
+			}
+		}
+	}
+	if (deepest)
+		*deepest = deepestDepth;
+	return overlaps;
+}
+
+double BenchmarkAvoidance(int numAgents, int numSteps, JobSystem *jobs)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// Robot sized boxes, spaced around the circle a little more than a body apart
+	AvoidanceSettings settings;
+	settings.neighbourDistance = 30.0f;
+	settings.maxNeighbours = 10;
+	settings.timeHorizon = 2.0f;
+	settings.maxSpeed = 20.0f;
+	settings.halfWidth = 7.5f;
+	settings.halfDepth = 2.5f;
+	float radius = std::max(50.0f, numAgents * 18.0f / 6.2831853f);
+	float dt = 0.05f;
+
+	RobotAvoidance avoidance(settings);
+	avoidance.SetAgentCount(numAgents);
+	std::vector<float> state(numAgents * 5);		// x, z, heading, velocity x and z
+	std::vector<float> goals(numAgents * 2);
+	for (int i = 0; i < numAgents; i++)
+	{
+		float s, c;
+		FastSinCos(6.2831853f * i / numAgents, s, c);
+		state[5 * i] = radius * c;
+		state[5 * i + 1] = radius * s;
+		state[5 * i + 2] = 0.0f;
+		state[5 * i + 3] = state[5 * i + 4] = 0.0f;
+		goals[2 * i] = -radius * c;
+		goals[2 * i + 1] = -radius * s;
+	}
+
+	double solveSeconds = 0.0;
+	int overlaps = 0;
+	float deepest = 0.0f;
+	for (int step = 0; step < numSteps; step++)
+	{
+		for (int i = 0; i < numAgents; i++)
+		{
+			float *agent = &state[5 * i];
+			float dx = goals[2 * i] - agent[0], dz = goals[2 * i + 1] - agent[1];
+			float length = sqrtf(dx * dx + dz * dz);
+			float speed = std::min(settings.maxSpeed, length / dt);
+			float scale = length > 0.0f ? speed / length : 0.0f;
+			avoidance.SetAgent(i, agent[0], agent[1], agent[2], agent[3], agent[4], dx * scale, dz * scale);
+		}
+
+		Clock::time_point start = Clock::now();
+		avoidance.Solve(dt, jobs);
+		solveSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+		// Robots turn to face where they go, 3 degrees a step, headings matter for the box extents
+		for (int i = 0; i < numAgents; i++)
+		{
+			float *agent = &state[5 * i];
+			avoidance.GetVelocity(i, agent[3], agent[4]);
+			agent[0] += agent[3] * dt;
+			agent[1] += agent[4] * dt;
+			if (agent[3] * agent[3] + agent[4] * agent[4] > 1.0f)
+			{
+				float turn = atan2f(agent[3], agent[4]) * 57.29578f - agent[2];
+				turn -= 360.0f * floorf((turn + 180.0f) / 360.0f);
+				agent[2] += std::max(-3.0f, std::min(3.0f, turn));
+			}
+		}
+
+		float depth;
+		overlaps += avoidance.CountOverlaps(&depth);
+		deepest = std::max(deepest, depth);
+	}
+
+	int arrived = 0;
+	for (int i = 0; i < numAgents; i++)
+	{
+		float dx = goals[2 * i] - state[5 * i], dz = goals[2 * i + 1] - state[5 * i + 1];
+		arrived += dx * dx + dz * dz < 25.0f;
+	}
+
+	double agentsPerSecond = (double)numAgents * numSteps / (solveSeconds > 0.0 ? solveSeconds : 1e-9);
+	printf("Avoidance benchmark: %d robots crossing a circle of radius %.0f, %d steps, %s\n", numAgents, radius,
+		numSteps, jobs ? "parallel" : "single thread");
+	printf("  %.3f ms per step, %.2f M agents/s, %d of %d arrived\n", solveSeconds * 1000.0 / numSteps,
+		agentsPerSecond / 1e6, arrived, numAgents);
+	printf("  %d overlapping pairs over all steps, deepest %.2f (bodies %.0f by %.0f)\n", overlaps, deepest,
+		2.0f * settings.halfWidth, 2.0f * settings.halfDepth);
+	return agentsPerSecond;
+}
@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	RobotAvoidance.h
+//	Local collision avoidance between robots with optimal reciprocal collision
+//	avoidance (ORCA, the reciprocal velocity obstacle method of RVO2). Each agent
+//	turns every neighbour into a half-plane of velocities that keep the two apart
+//	for timeHorizon seconds, each side taking half of the correction, then picks the
+//	velocity closest to the one it wants with a small linear program.
+//
+//	Robots are boxes, not discs: the distance two robots must keep is the extent of
+//	both boxes along the line between them, from their headings and the body half
+//	width and depth, so robots side by side pack as closely as the bodies allow.
+//	Neighbours come from a uniform grid rebuilt every Solve() and agents are solved
+//	in parallel, each writing only its own new velocity.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ROBOTAVOIDANCE_H
+#define ROBOTAVOIDANCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class JobSystem;
+
+// Most neighbours an agent considers, the nearest ones are kept
+const int AvoidanceMaxNeighbours = 16;
+
+struct AvoidanceSettings
+{
+	float neighbourDistance;	// centre to centre, also the grid cell size
+	int maxNeighbours;			// up to AvoidanceMaxNeighbours
+	float timeHorizon;			// seconds of lookahead
+	float maxSpeed;
+	float halfWidth;			// across the robot, wheels included
+	float halfDepth;			// along its heading
+};
+
+class RobotAvoidance
+{
+public:
+	RobotAvoidance(const AvoidanceSettings &settings);
+
+	// Agents keep their index until the count changes. Headings are in degrees, as
+	// Robot::angle. An agent that does not avoid (a player, say) is still avoided,
+	// its neighbours then take the whole correction.
+	void SetAgentCount(int count);
+	void SetAgent(int index, float x, float z, float heading, float velX, float velZ, float preferredX,
+		float preferredZ, bool avoids = true);
+
+	// New velocity of every agent for a step of dt seconds. jobs may be NULL.
+	void Solve(float dt, JobSystem *jobs);
+
+	void GetVelocity(int index, float &velX, float &velZ) const;
+
+	// Pairs of robot boxes that overlapped at the positions of the last Solve(), and
+	// optionally how deep the worst pair overlapped
+	int CountOverlaps(float *deepest = NULL) const;
+	int GetAgentCount() const { return (int)x.size(); }
+
+private:
+	void BuildGrid();
+	void SolveAgent(int index, float dt);
+	float Extent(int index, float dirX, float dirZ) const;
+	int BodySum(int a, int b, float polygon[8][2]) const;
+
+	AvoidanceSettings settings;
+
+	// Agents, structure of arrays
+	std::vector<float> x, z;
+	std::vector<float> sinHeading, cosHeading;
+	std::vector<float> velX, velZ;
+	std::vector<float> preferredX, preferredZ;
+	std::vector<float> newVelX, newVelZ;
+	std::vector<char> avoids;
+	std::vector<float> bodyCorners;		// 4 corners per agent, counter-clockwise
+
+	// Agents sorted by grid cell, cellStart[c] .. cellStart[c + 1] in cellAgents
+	float gridMinX, gridMinZ;
+	float gridCellSize;
+	int gridWidth, gridHeight;
+	std::vector<int> cellOf;
+	std::vector<int> cellStart;
+	std::vector<int> cellFill;
+	std::vector<int> cellAgents;
+};
+
+// numAgents robots on a circle all drive to the opposite side for numSteps steps,
+// turning towards their velocity as fast as steerRobot() turns. Prints milliseconds
+// per step and agents solved per second, and returns the latter; also counts the
+// robots found overlapping at the start of a step and the deepest overlap. The
+// middle of the circle is a jam where the robots cannot all keep apart.
+double BenchmarkAvoidance(int numAgents, int numSteps, JobSystem *jobs = NULL);
+
+#endif	//ROBOTAVOIDANCE_H
@@ -0,0 +1,506 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <gl/glut.h>
+#include "Transform.h"
+#include "FastTrig.h"
+
+// SSE is always there on x64 and the default for 32-bit builds
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define TRANSFORM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// out = a * b, out may be a or b
+static inline void MultiplyInto(const Matrix4 & a, const Matrix4 & b, Matrix4 & out)
+{
+#ifdef TRANSFORM_SSE
+	__m128 a0 = _mm_load_ps(a.m);
+	__m128 a1 = _mm_load_ps(a.m + 4);
+	__m128 a2 = _mm_load_ps(a.m + 8);
+	__m128 a3 = _mm_load_ps(a.m + 12);
+	for (int column = 0; column < 4; column++)
+	{
+		// Column c of the product only depends on column c of b
+		const float *bc = b.m + column * 4;
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+		_mm_store_ps(out.m + column * 4, r);
+	}
+#else
+	float result[16];
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+			result[column * 4 + row] = sum;
+		}
+	}
+	memcpy(out.m, result, sizeof(result));
+#endif
+}
+
+Matrix4 Matrix4::Identity()
+{
+	Matrix4 matrix;
+	memset(matrix.m, 0, sizeof(matrix.m));
+	matrix.m[0] = matrix.m[5] = matrix.m[10] = matrix.m[15] = 1.0f;
+	return matrix;
+}
+
+Matrix4 Matrix4::Translation(float x, float y, float z)
+{
+	Matrix4 matrix = Identity();
+	matrix.m[12] = x;
+	matrix.m[13] = y;
+	matrix.m[14] = z;
+	return matrix;
+}
+
+Matrix4 Matrix4::Scaling(float x, float y, float z)
+{
+	Matrix4 matrix = Identity();
+	matrix.m[0] = x;
+	matrix.m[5] = y;
+	matrix.m[10] = z;
+	return matrix;
+}
+
+Matrix4 Matrix4::Rotation(float angle, float x, float y, float z)
+{
+	Matrix4 matrix = Identity();
+	float length = sqrtf(x * x + y * y + z * z);
+	if (length == 0.0f)
+		return matrix;
+	x /= length;
+	y /= length;
+	z /= length;
+
+	float s, c;
+	FastSinCosDegrees(angle, s, c);
+	float t = 1.0f - c;
+	matrix.m[0] = x * x * t + c;
+	matrix.m[1] = y * x * t + z * s;
+	matrix.m[2] = x * z * t - y * s;
+	matrix.m[4] = x * y * t - z * s;
+	matrix.m[5] = y * y * t + c;
+	matrix.m[6] = y * z * t + x * s;
+	matrix.m[8] = x * z * t + y * s;
+	matrix.m[9] = y * z * t - x * s;
+	matrix.m[10] = z * z * t + c;
+	return matrix;
+}
+
+Matrix4 Matrix4::operator*(const Matrix4 & rhs) const
+{
+	Matrix4 result;
+	MultiplyInto(*this, rhs, result);
+	return result;
+}
+
+void Matrix4::TransformPoint(const float in[3], float out[3]) const
+{
+	float x = in[0], y = in[1], z = in[2];
+	for (int row = 0; row < 3; row++)
+		out[row] = m[row] * x + m[4 + row] * y + m[8 + row] * z + m[12 + row];
+}
+
+void Matrix4::TransformVector(const float in[3], float out[3]) const
+{
+	float x = in[0], y = in[1], z = in[2];
+	for (int row = 0; row < 3; row++)
+		out[row] = m[row] * x + m[4 + row] * y + m[8 + row] * z;
+}
+
+Matrix4 Matrix4::AffineInverse() const
+{
+	// Inverse of the upper 3x3 from its cofactors, then the translation moved back through it
+	float a = m[0], b = m[4], c = m[8];
+	float d = m[1], e = m[5], f = m[9];
+	float g = m[2], h = m[6], i = m[10];
+	float A = e * i - f * h, B = f * g - d * i, C = d * h - e * g;
+	float determinant = a * A + b * B + c * C;
+	float inv = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+
+	Matrix4 result = Identity();
+	result.m[0] = A * inv;
+	result.m[1] = B * inv;
+	result.m[2] = C * inv;
+	result.m[4] = (c * h - b * i) * inv;
+	result.m[5] = (a * i - c * g) * inv;
+	result.m[6] = (b * g - a * h) * inv;
+	result.m[8] = (b * f - c * e) * inv;
+	result.m[9] = (c * d - a * f) * inv;
+	result.m[10] = (a * e - b * d) * inv;
+
+	float translation[3] = { m[12], m[13], m[14] };
+	float moved[3];
+	result.TransformVector(translation, moved);
+	result.m[12] = -moved[0];
+	result.m[13] = -moved[1];
+	result.m[14] = -moved[2];
+	return result;
+}
+
+
+Quaternion Quaternion::Identity()
+{
+	Quaternion q = { 0.0f, 0.0f, 0.0f, 1.0f };
+	return q;
+}
+
+Quaternion Quaternion::FromAxisAngle(float angle, float x, float y, float z)
+{
+	float length = sqrtf(x * x + y * y + z * z);
+	if (length == 0.0f)
+		return Identity();
+
+	float s, c;
+	FastSinCosDegrees(0.5f * angle, s, c);
+	s /= length;
+	Quaternion q = { x * s, y * s, z * s, c };
+	return q;
+}
+
+Quaternion Quaternion::operator*(const Quaternion & rhs) const
+{
+	Quaternion q;
+	q.x = w * rhs.x + x * rhs.w + y * rhs.z - z * rhs.y;
+	q.y = w * rhs.y - x * rhs.z + y * rhs.w + z * rhs.x;
+	q.z = w * rhs.z + x * rhs.y - y * rhs.x + z * rhs.w;
+	q.w = w * rhs.w - x * rhs.x - y * rhs.y - z * rhs.z;
+	return q;
+}
+
+void Quaternion::Normalize()
+{
+	float length = sqrtf(x * x + y * y + z * z + w * w);
+	if (length > 0.0f)
+	{
+		float inv = 1.0f / length;
+		x *= inv;
+		y *= inv;
+		z *= inv;
+		w *= inv;
+	}
+}
+
+Matrix4 Quaternion::ToMatrix() const
+{
+	Matrix4 matrix = Matrix4::Identity();
+	float xx = x * x, yy = y * y, zz = z * z;
+	float xy = x * y, xz = x * z, yz = y * z;
+	float wx = w * x, wy = w * y, wz = w * z;
+	matrix.m[0] = 1.0f - 2.0f * (yy + zz);
+	matrix.m[1] = 2.0f * (xy + wz);
+	matrix.m[2] = 2.0f * (xz - wy);
+	matrix.m[4] = 2.0f * (xy - wz);
+	matrix.m[5] = 1.0f - 2.0f * (xx + zz);
+	matrix.m[6] = 2.0f * (yz + wx);
+	matrix.m[8] = 2.0f * (xz + wy);
+	matrix.m[9] = 2.0f * (yz - wx);
+	matrix.m[10] = 1.0f - 2.0f * (xx + yy);
+	return matrix;
+}
+
+void Quaternion::Rotate(const float in[3], float out[3]) const
+{
+	// v + 2w (q x v) + 2 q x (q x v)
+	float tx = 2.0f * (y * in[2] - z * in[1]);
+	float ty = 2.0f * (z * in[0] - x * in[2]);
+	float tz = 2.0f * (x * in[1] - y * in[0]);
+	out[0] = in[0] + w * tx + (y * tz - z * ty);
+	out[1] = in[1] + w * ty + (z * tx - x * tz);
+	out[2] = in[2] + w * tz + (x * ty - y * tx);
+}
+
+Quaternion Slerp(const Quaternion & a, const Quaternion & b, float t)
+{
+	float cosine = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	float sign = cosine < 0.0f ? -1.0f : 1.0f;
+	cosine *= sign;
+
+	// Nearly parallel, a normalized lerp is as good and avoids dividing by sin(~0)
+	float wa, wb;
+	if (cosine > 0.9995f)
+	{
+		wa = 1.0f - t;
+		wb = t;
+	}
+	else
+	{
+		float theta = acosf(cosine);
+		float inv = 1.0f / sinf(theta);
+		wa = sinf((1.0f - t) * theta) * inv;
+		wb = sinf(t * theta) * inv;
+	}
+	wb *= sign;
+
+	Quaternion q = { wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w };
+	q.Normalize();
+	return q;
+}
+
+
+Transform Transform::Identity()
+{
+	Transform transform;
+	transform.rotation = Quaternion::Identity();
+	transform.position[0] = transform.position[1] = transform.position[2] = 0.0f;
+	transform.scale[0] = transform.scale[1] = transform.scale[2] = 1.0f;
+	return transform;
+}
+
+Matrix4 Transform::ToMatrix() const
+{
+	Matrix4 matrix = rotation.ToMatrix();
+	for (int column = 0; column < 3; column++)
+		for (int row = 0; row < 3; row++)
+			matrix.m[column * 4 + row] *= scale[column];
+	matrix.m[12] = position[0];
+	matrix.m[13] = position[1];
+	matrix.m[14] = position[2];
+	return matrix;
+}
+
+
+MatrixStack::MatrixStack()
+{
+	depth = 0;
+	errors = 0;
+	stack[0] = Matrix4::Identity();
+}
+
+void MatrixStack::Push()
+{
+	if (depth + 1 >= MaxDepth)
+	{
+		errors++;
+		return;
+	}
+	stack[depth + 1] = stack[depth];
+	depth++;
+}
+
+void MatrixStack::Pop()
+{
+	if (depth == 0)
+	{
+		errors++;
+		return;
+	}
+	depth--;
+}
+
+void MatrixStack::LoadIdentity()
+{
+	stack[depth] = Matrix4::Identity();
+}
+
+void MatrixStack::LoadMatrix(const float m[16])
+{
+	memcpy(stack[depth].m, m, sizeof(stack[depth].m));
+}
+
+void MatrixStack::MultMatrix(const Matrix4 & m)
+{
+	MultiplyInto(stack[depth], m, stack[depth]);
+}
+
+void MatrixStack::Translate(float x, float y, float z)
+{
+	// Only the last column changes: top * T adds the first three columns weighted by x, y, z
+	float *m = stack[depth].m;
+	for (int row = 0; row < 4; row++)
+		m[12 + row] += m[row] * x + m[4 + row] * y + m[8 + row] * z;
+}
+
+void MatrixStack::Rotate(float angle, float x, float y, float z)
+{
+	MultMatrix(Matrix4::Rotation(angle, x, y, z));
+}
+
+void MatrixStack::Scale(float x, float y, float z)
+{
+	float *m = stack[depth].m;
+	for (int row = 0; row < 4; row++)
+	{
+		m[row] *= x;
+		m[4 + row] *= y;
+		m[8 + row] *= z;
+	}
+}
+
+
+void MultiplyMatrices(const Matrix4 & parent, const Matrix4 *locals, Matrix4 *out, int count)
+{
+#ifdef TRANSFORM_SSE
+	// The parent's columns stay in registers for the whole batch
+	__m128 p0 = _mm_load_ps(parent.m);
+	__m128 p1 = _mm_load_ps(parent.m + 4);
+	__m128 p2 = _mm_load_ps(parent.m + 8);
+	__m128 p3 = _mm_load_ps(parent.m + 12);
+	for (int i = 0; i < count; i++)
+	{
+		const float *b = locals[i].m;
+		float *o = out[i].m;
+		for (int column = 0; column < 4; column++)
+		{
+			const float *bc = b + column * 4;
+			__m128 r = _mm_mul_ps(p0, _mm_set1_ps(bc[0]));
+			r = _mm_add_ps(r, _mm_mul_ps(p1, _mm_set1_ps(bc[1])));
+			r = _mm_add_ps(r, _mm_mul_ps(p2, _mm_set1_ps(bc[2])));
+			r = _mm_add_ps(r, _mm_mul_ps(p3, _mm_set1_ps(bc[3])));
+			_mm_store_ps(o + column * 4, r);
+		}
+	}
+#else
+	for (int i = 0; i < count; i++)
+		MultiplyInto(parent, locals[i], out[i]);
+#endif
+}
+
+void MultiplyMatrices(const Matrix4 *a, const Matrix4 *b, Matrix4 *out, int count)
+{
+	for (int i = 0; i < count; i++)
+		MultiplyInto(a[i], b[i], out[i]);
+}
+
+void ComposeHierarchy(const Transform *locals, const int *parents, Matrix4 *worlds, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		Matrix4 local = locals[i].ToMatrix();
+		if (parents[i] >= 0)
+			MultiplyInto(worlds[parents[i]], local, worlds[i]);
+		else
+			worlds[i] = local;
+	}
+}
+
+void TransformPoints(const Matrix4 & matrix, const float *in, float *out, int count)
+{
+#ifdef TRANSFORM_SSE
+	__m128 c0 = _mm_load_ps(matrix.m);
+	__m128 c1 = _mm_load_ps(matrix.m + 4);
+	__m128 c2 = _mm_load_ps(matrix.m + 8);
+	__m128 c3 = _mm_load_ps(matrix.m + 12);
+	for (int i = 0; i < count; i++)
+	{
+		const float *p = in + i * 3;
+		__m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), c3);
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+		alignas(16) float result[4];
+		_mm_store_ps(result, r);
+		out[i * 3] = result[0];
+		out[i * 3 + 1] = result[1];
+		out[i * 3 + 2] = result[2];
+	}
+#else
+	for (int i = 0; i < count; i++)
+	{
+		float p[3] = { in[i * 3], in[i * 3 + 1], in[i * 3 + 2] };
+		matrix.TransformPoint(p, out + i * 3);
+	}
+#endif
+}
+
+
+double BenchmarkTransforms(int numObjects, int frames)
+{
+	typedef std::chrono::steady_clock Clock;
+	const int NumParts = 8;
+	float checksum = 0.0f;
+
+	// Each object: placed and turned, then parts offset, turned and scaled under it
+	auto objectX = [](int object) { return (float)(object % 100) * 3.0f; };
+	auto objectAngle = [](int object) { return (float)(object * 7 % 360); };
+	auto partOffset = [](int part) { return (float)part * 0.5f; };
+
+	// GL stack, reading every part back as culling or batching would need
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	float readBack[16];
+	Clock::time_point start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (int object = 0; object < numObjects; object++)
+		{
+			glPushMatrix();
+			glTranslatef(objectX(object), 0.0f, 5.0f);
+			glRotatef(objectAngle(object), 0.0f, 1.0f, 0.0f);
+			for (int part = 0; part < NumParts; part++)
+			{
+				glPushMatrix();
+				glTranslatef(partOffset(part), 0.5f, 8.0f);
+				glRotatef(90.0f, 1.0f, 0.0f, 0.0f);
+				glScalef(2.0f, 2.0f, 0.5f);
+				glGetFloatv(GL_MODELVIEW_MATRIX, readBack);
+				checksum += readBack[12];
+				glPopMatrix();
+			}
+			glPopMatrix();
+		}
+	}
+	double glSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	glPopMatrix();
+
+	// Same calls on the CPU stack
+	MatrixStack stack;
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (int object = 0; object < numObjects; object++)
+		{
+			stack.Push();
+			stack.Translate(objectX(object), 0.0f, 5.0f);
+			stack.Rotate(objectAngle(object), 0.0f, 1.0f, 0.0f);
+			for (int part = 0; part < NumParts; part++)
+			{
+				stack.Push();
+				stack.Translate(partOffset(part), 0.5f, 8.0f);
+				stack.Rotate(90.0f, 1.0f, 0.0f, 0.0f);
+				stack.Scale(2.0f, 2.0f, 0.5f);
+				checksum += stack.Top().m[12];
+				stack.Pop();
+			}
+			stack.Pop();
+		}
+	}
+	double stackSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	// Batched: part matrices built once, one kernel call per object
+	alignas(16) Matrix4 locals[NumParts];
+	for (int part = 0; part < NumParts; part++)
+		locals[part] = Matrix4::Translation(partOffset(part), 0.5f, 8.0f) * Matrix4::Rotation(90.0f, 1.0f, 0.0f, 0.0f)
+			* Matrix4::Scaling(2.0f, 2.0f, 0.5f);
+	std::vector<Matrix4> worlds((size_t)numObjects * NumParts);
+	start = Clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (int object = 0; object < numObjects; object++)
+		{
+			Matrix4 objectMatrix = Matrix4::Translation(objectX(object), 0.0f, 5.0f)
+				* Matrix4::Rotation(objectAngle(object), 0.0f, 1.0f, 0.0f);
+			MultiplyMatrices(objectMatrix, locals, &worlds[(size_t)object * NumParts], NumParts);
+		}
+		checksum += worlds[worlds.size() - 1].m[12];
+	}
+	double batchSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	double matrices = (double)numObjects * NumParts * frames;
+	printf("Transforms: %d objects x %d parts x %d frames\n", numObjects, NumParts, frames);
+	printf("  GL stack with readback %.3f s (%.1f M matrices/s)\n", glSeconds, matrices / glSeconds * 1e-6);
+	printf("  MatrixStack            %.3f s (%.1f M matrices/s)\n", stackSeconds, matrices / stackSeconds * 1e-6);
+	printf("  Batched kernel         %.3f s (%.1f M matrices/s), checksum %g\n", batchSeconds, matrices / batchSeconds * 1e-6, checksum);
+	return glSeconds / batchSeconds;
+}
@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Transform.h
+//	4x4 matrices, quaternions and a matrix stack on the CPU, so transforms built the
+//	glPushMatrix/glTranslatef/glRotatef way are also available for culling, collision
+//	and batching, and can be handed to glLoadMatrixf (or a shader uniform) as is.
+//	Matrices are column major like OpenGL's, and every operation composes the way
+//	its GL namesake does: Translate/Rotate/Scale multiply on the right.
+//	Products run four lanes at a time with SSE where available.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+struct alignas(16) Matrix4
+{
+	float m[16];	// column major, m[column * 4 + row]
+
+	static Matrix4 Identity();
+	static Matrix4 Translation(float x, float y, float z);
+	static Matrix4 Scaling(float x, float y, float z);
+	// angle in degrees around (x, y, z), same as glRotatef
+	static Matrix4 Rotation(float angle, float x, float y, float z);
+
+	Matrix4 operator*(const Matrix4 & rhs) const;
+
+	void TransformPoint(const float in[3], float out[3]) const;
+	void TransformVector(const float in[3], float out[3]) const;	// no translation
+
+	// Inverse of a rotation, translation and (non-zero) scale, no projection
+	Matrix4 AffineInverse() const;
+};
+
+struct alignas(16) Quaternion
+{
+	float x, y, z, w;
+
+	static Quaternion Identity();
+	// angle in degrees around (x, y, z), same rotation as glRotatef
+	static Quaternion FromAxisAngle(float angle, float x, float y, float z);
+
+	Quaternion operator*(const Quaternion & rhs) const;		// rhs applied first
+	void Normalize();
+	Matrix4 ToMatrix() const;
+	void Rotate(const float in[3], float out[3]) const;
+};
+
+// Shortest-arc interpolation, t from 0 (a) to 1 (b)
+Quaternion Slerp(const Quaternion & a, const Quaternion & b, float t);
+
+// Translation, rotation and non-uniform scale, applied scale first: T * R * S
+struct alignas(16) Transform
+{
+	Quaternion rotation;
+	float position[3];
+	float scale[3];
+
+	static Transform Identity();
+	Matrix4 ToMatrix() const;
+};
+
+// The modelview stack, on the CPU. Depth is fixed, Push() past it and Pop() past the
+// bottom are ignored and counted like GL_STACK_OVERFLOW / GL_STACK_UNDERFLOW.
+class MatrixStack
+{
+public:
+	static const int MaxDepth = 32;		// what GL guarantees for the modelview stack
+
+	MatrixStack();
+
+	void Push();
+	void Pop();
+	void LoadIdentity();
+	void LoadMatrix(const float m[16]);
+	void MultMatrix(const Matrix4 & m);
+	void Translate(float x, float y, float z);
+	void Rotate(float angle, float x, float y, float z);
+	void Scale(float x, float y, float z);
+
+	const Matrix4 & Top() const { return stack[depth]; }
+	int GetDepth() const { return depth; }
+	int GetErrorCount() const { return errors; }
+
+private:
+	Matrix4 stack[MaxDepth];
+	int depth;
+	int errors;
+};
+
+// Batched composition, count matrices per call
+// out[i] = parent * locals[i], e.g. every part of a robot under the robot's matrix
+void MultiplyMatrices(const Matrix4 & parent, const Matrix4 *locals, Matrix4 *out, int count);
+// out[i] = a[i] * b[i]
+void MultiplyMatrices(const Matrix4 *a, const Matrix4 *b, Matrix4 *out, int count);
+// World matrices of a hierarchy stored parents first: worlds[i] = worlds[parents[i]] * locals[i],
+// or locals[i] alone where parents[i] < 0
+void ComposeHierarchy(const Transform *locals, const int *parents, Matrix4 *worlds, int count);
+// count points, 3 floats each; in and out may be the same array
+void TransformPoints(const Matrix4 & matrix, const float *in, float *out, int count);
+
+// Builds numObjects small hierarchies (an object with several parts, like a robot)
+// frames times, with the GL matrix stack reading every part back, with MatrixStack,
+// and with the batched kernels. Needs a GL context. Prints the timings and returns
+// the speedup of the batched path over the GL stack.
+double BenchmarkTransforms(int numObjects, int frames);
+
+#endif	//TRANSFORM_H
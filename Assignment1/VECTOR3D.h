@@ -16,6 +16,8 @@
 #ifndef VECTOR3D_H
 #define VECTOR3D_H
 
+#include "FastTrig.h"
+
 class VECTOR3D
 {
 public:
@@ -32,6 +34,12 @@ public:
 	VECTOR3D(const VECTOR3D & rhs) : x(rhs.x), y(rhs.y), z(rhs.z)
 	{}
 
+	VECTOR3D & operator=(const VECTOR3D & rhs)
+	{
+		x = rhs.x;	y = rhs.y;	z = rhs.z;
+		return *this;
+	}
+
 	~VECTOR3D() {}	//empty
 
 	void Set(float newX, float newY, float newZ)
@@ -88,15 +96,62 @@ public:
 		return (x*x) + (y*y) + (z*z);
 	}
 
-	//rotations
-	void RotateX(double angle);
-	VECTOR3D GetRotatedX(double angle) const;
-	void RotateY(double angle);
-	VECTOR3D GetRotatedY(double angle) const;
-	void RotateZ(double angle);
-	VECTOR3D GetRotatedZ(double angle) const;
-	void RotateAxis(double angle, const VECTOR3D & axis);
-	VECTOR3D GetRotatedAxis(double angle, const VECTOR3D & axis) const;
+	//rotations, angles in degrees
+	void RotateX(double angle)
+	{
+		(*this) = GetRotatedX(angle);
+	}
+
+	VECTOR3D GetRotatedX(double angle) const
+	{
+		float s, c;
+		FastSinCosDegrees((float)angle, s, c);
+		return VECTOR3D(x, y*c - z * s, y*s + z * c);
+	}
+
+	void RotateY(double angle)
+	{
+		(*this) = GetRotatedY(angle);
+	}
+
+	VECTOR3D GetRotatedY(double angle) const
+	{
+		float s, c;
+		FastSinCosDegrees((float)angle, s, c);
+		return VECTOR3D(x*c + z * s, y, -x * s + z * c);
+	}
+
+	void RotateZ(double angle)
+	{
+		(*this) = GetRotatedZ(angle);
+	}
+
+	VECTOR3D GetRotatedZ(double angle) const
+	{
+		float s, c;
+		FastSinCosDegrees((float)angle, s, c);
+		return VECTOR3D(x*c - y * s, x*s + y * c, z);
+	}
+
+	void RotateAxis(double angle, const VECTOR3D & axis)
+	{
+		(*this) = GetRotatedAxis(angle, axis);
+	}
+
+	VECTOR3D GetRotatedAxis(double angle, const VECTOR3D & axis) const
+	{
+		VECTOR3D u = axis;
+		u.Normalize();
+
+		float s, c;
+		FastSinCosDegrees((float)angle, s, c);
+		const float t = 1.0f - c;
+
+		VECTOR3D row0(t*u.x*u.x + c, t*u.x*u.y - s * u.z, t*u.x*u.z + s * u.y);
+		VECTOR3D row1(t*u.x*u.y + s * u.z, t*u.y*u.y + c, t*u.y*u.z - s * u.x);
+		VECTOR3D row2(t*u.x*u.z - s * u.y, t*u.y*u.z + s * u.x, t*u.z*u.z + c);
+		return VECTOR3D(DotProduct(row0), DotProduct(row1), DotProduct(row2));
+	}
 
 	//pack to [0,1] for color
 	void PackTo01();
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "VertexCache.h"
+
+// Forsyth's scoring, with the constants from his article
+static const int ForsythCacheSize = 32;
+static const float ForsythCacheDecayPower = 1.5f;
+static const float ForsythLastTriangleScore = 0.75f;
+static const float ForsythValenceBoostScale = 2.0f;
+static const float ForsythValenceBoostPower = 0.5f;
+
+VertexCacheStats MeasureVertexCache(const uint32_t *indices, int numIndices, int numVertices, int cacheSize, bool strip)
+{
+	VertexCacheStats stats = { numIndices, 0, 0, 0.0f, 0.0f };
+
+	// A vertex is cached while fewer than cacheSize misses came after its own
+	std::vector<int> missedAt(numVertices, -cacheSize - 1);
+	std::vector<char> used(numVertices, 0);
+	int numUsed = 0;
+	for (int i = 0; i < numIndices; i++)
+	{
+		uint32_t v = indices[i];
+		if (stats.misses - missedAt[v] > cacheSize)
+			missedAt[v] = stats.misses++;
+		if (!used[v])
+		{
+			used[v] = 1;
+			numUsed++;
+		}
+	}
+
+	if (strip)
+	{
+		for (int i = 0; i + 2 < numIndices; i++)
+		{
+			if (indices[i] != indices[i + 1] && indices[i] != indices[i + 2] && indices[i + 1] != indices[i + 2])
+				stats.numTriangles++;
+		}
+	}
+	else
+	{
+		stats.numTriangles = numIndices / 3;
+	}
+
+	stats.acmr = stats.numTriangles > 0 ? (float)stats.misses / stats.numTriangles : 0.0f;
+	stats.atvr = numUsed > 0 ? (float)stats.misses / numUsed : 0.0f;
+	return stats;
+}
+
+// Triangles using each vertex, adjacency[offsets[v] .. offsets[v + 1]]
+static void BuildAdjacency(const uint32_t *indices, int numIndices, int numVertices, std::vector<int> &offsets,
+	std::vector<int> &adjacency)
+{
+	offsets.assign(numVertices + 1, 0);
+	for (int i = 0; i < numIndices; i++)
+		offsets[indices[i] + 1]++;
+	for (int v = 0; v < numVertices; v++)
+		offsets[v + 1] += offsets[v];
+
+	adjacency.resize(numIndices);
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int i = 0; i < numIndices; i++)
+		adjacency[fill[indices[i]]++] = i / 3;
+}
+
+void OptimizeVertexCacheTipsy(uint32_t *indices, int numIndices, int numVertices, int cacheSize)
+{
+	int numTriangles = numIndices / 3;
+	std::vector<int> offsets, adjacency;
+	BuildAdjacency(indices, numIndices, numVertices, offsets, adjacency);
+
+	std::vector<int> live(numVertices);
+	for (int v = 0; v < numVertices; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+	std::vector<int> cacheTime(numVertices, 0);
+	std::vector<char> emitted(numTriangles, 0);
+	std::vector<uint32_t> output;
+	output.reserve(numIndices);
+
+	// Vertices of emitted triangles, to fall back on when the fan runs dry
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	int timestamp = cacheSize + 1;
+	int cursor = 0;
+	int fanning = -1;
+
+	while (true)
+	{
+		if (fanning < 0)
+		{
+			// Latest dead end vertex still in use, or the next one in input order
+			while (!deadEnd.empty() && fanning < 0)
+			{
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					fanning = (int)v;
+			}
+			while (fanning < 0 && cursor < numVertices)
+			{
+				if (live[cursor] > 0)
+					fanning = cursor;
+				cursor++;
+			}
+			if (fanning < 0)
+				break;
+		}
+
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (int a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+		{
+			int t = adjacency[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = 1;
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t v = indices[3 * t + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (timestamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timestamp++;
+			}
+		}
+
+		// Next, the candidate that will still be cached after its remaining triangles,
+		// oldest in the cache first
+		int best = -1, bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			uint32_t v = candidates[c];
+			if (live[v] <= 0)
+				continue;
+			int priority = 0;
+			if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = timestamp - cacheTime[v];
+			if (priority > bestPriority)
+			{
+				best = (int)v;
+				bestPriority = priority;
+			}
+		}
+		fanning = best;
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+static float ForsythVertexScore(int cachePosition, int remaining)
+{
+	if (remaining == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle's vertices score the same, so it is not simply repeated
+		if (cachePosition < 3)
+			score = ForsythLastTriangleScore;
+		else
+			score = powf(1.0f - (float)(cachePosition - 3) / (ForsythCacheSize - 3), ForsythCacheDecayPower);
+	}
+	return score + ForsythValenceBoostScale * powf((float)remaining, -ForsythValenceBoostPower);
+}
+
+void OptimizeVertexCacheForsyth(uint32_t *indices, int numIndices, int numVertices)
+{
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+	std::vector<int> offsets, adjacency;
+	BuildAdjacency(indices, numIndices, numVertices, offsets, adjacency);
+
+	// Triangles not yet emitted are kept at the front of each vertex's adjacency
+	std::vector<int> remaining(numVertices);
+	std::vector<int> cachePosition(numVertices, -1);
+	std::vector<float> vertexScore(numVertices);
+	for (int v = 0; v < numVertices; v++)
+	{
+		remaining[v] = offsets[v + 1] - offsets[v];
+		vertexScore[v] = ForsythVertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<char> emitted(numTriangles, 0);
+	int best = 0;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+		if (triangleScore[t] > triangleScore[best])
+			best = t;
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(numIndices);
+	uint32_t cache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+	int cursor = 0;
+
+	while (best >= 0)
+	{
+		emitted[best] = 1;
+		uint32_t triangle[3] = { indices[3 * best], indices[3 * best + 1], indices[3 * best + 2] };
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = triangle[k];
+			output.push_back(v);
+
+			int *list = &adjacency[offsets[v]];
+			for (int a = 0; a < remaining[v]; a++)
+			{
+				if (list[a] == best)
+				{
+					std::swap(list[a], list[remaining[v] - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// The triangle's vertices move to the front, the rest shift back
+		uint32_t updated[ForsythCacheSize + 3];
+		int updatedCount = 0;
+		for (int k = 0; k < 3; k++)
+			updated[updatedCount++] = triangle[k];
+		for (int c = 0; c < cacheCount; c++)
+		{
+			if (cache[c] != triangle[0] && cache[c] != triangle[1] && cache[c] != triangle[2])
+				updated[updatedCount++] = cache[c];
+		}
+
+		for (int c = 0; c < updatedCount; c++)
+		{
+			uint32_t v = updated[c];
+			cachePosition[v] = c < ForsythCacheSize ? c : -1;
+			vertexScore[v] = ForsythVertexScore(cachePosition[v], remaining[v]);
+		}
+
+		// Rescore the triangles around the cache and take the best of them
+		best = -1;
+		float bestScore = -1.0f;
+		for (int c = 0; c < updatedCount; c++)
+		{
+			uint32_t v = updated[c];
+			for (int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+			{
+				int t = adjacency[a];
+				float score = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] +
+					vertexScore[indices[3 * t + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore)
+				{
+					best = t;
+					bestScore = score;
+				}
+			}
+		}
+
+		cacheCount = std::min(updatedCount, ForsythCacheSize);
+		memcpy(cache, updated, cacheCount * sizeof(uint32_t));
+
+		// Nothing around the cache, carry on from the first triangle left
+		if (best < 0)
+		{
+			while (cursor < numTriangles && emitted[cursor])
+				cursor++;
+			best = cursor < numTriangles ? cursor : -1;
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void OptimizeVertexCache(uint32_t *indices, int numIndices, int numVertices, VertexCacheStats *before,
+	VertexCacheStats *after)
+{
+	VertexCacheStats original = MeasureVertexCache(indices, numIndices, numVertices);
+	if (before)
+		*before = original;
+
+	std::vector<uint32_t> tipsy(indices, indices + numIndices);
+	std::vector<uint32_t> forsyth(indices, indices + numIndices);
+	OptimizeVertexCacheTipsy(tipsy.data(), numIndices, numVertices);
+	OptimizeVertexCacheForsyth(forsyth.data(), numIndices, numVertices);
+	VertexCacheStats tipsyStats = MeasureVertexCache(tipsy.data(), numIndices, numVertices);
+	VertexCacheStats forsythStats = MeasureVertexCache(forsyth.data(), numIndices, numVertices);
+
+	VertexCacheStats best = original;
+	if (tipsyStats.misses < best.misses)
+	{
+		best = tipsyStats;
+		memcpy(indices, tipsy.data(), numIndices * sizeof(uint32_t));
+	}
+	if (forsythStats.misses < best.misses)
+	{
+		best = forsythStats;
+		memcpy(indices, forsyth.data(), numIndices * sizeof(uint32_t));
+	}
+	if (after)
+		*after = best;
+}
+
+int MakeGridStrip(int columns, int rows, int bandWidth, uint32_t *strip)
+{
+	int rowLength = columns + 1;
+	int count = 0;
+	for (int first = 0; first < columns; first += bandWidth)
+	{
+		int last = std::min(first + bandWidth, columns);
+
+		// The band's bottom row goes through the cache first, every index twice so its
+		// triangles are degenerate. Otherwise the first row misses on both of its
+		// vertex rows and pushes the bottom one out before the next row gets to it.
+		// After another band its last index comes twice more, keeping the parity.
+		if (count > 0)
+		{
+			if (strip)
+				strip[count] = strip[count + 1] = strip[count - 1];
+			count += 2;
+		}
+		for (int k = first; k <= last; k++)
+		{
+			if (strip)
+				strip[count] = strip[count + 1] = (uint32_t)k;
+			count += 2;
+		}
+
+		for (int j = 0; j < rows; j++)
+		{
+			// Repeat the last index and the next first one, two degenerate triangles
+			// that keep the winding of the next run
+			if (strip)
+			{
+				strip[count] = strip[count - 1];
+				strip[count + 1] = (uint32_t)((j + 1) * rowLength + first);
+			}
+			count += 2;
+			for (int k = first; k <= last; k++)
+			{
+				if (strip)
+				{
+					strip[count] = (uint32_t)((j + 1) * rowLength + k);
+					strip[count + 1] = (uint32_t)(j * rowLength + k);
+				}
+				count += 2;
+			}
+		}
+	}
+	return count;
+}
+
+int GetGridStripBand(int cacheSize)
+{
+	// A vertex of the upper row is needed again a band width plus one misses later
+	return std::max(1, cacheSize - 2);
+}
+
+void PrintVertexCacheStats(const char *name, const VertexCacheStats &before, const VertexCacheStats &after)
+{
+	printf("%s: %d triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %d -> %d indices\n", name, after.numTriangles,
+		before.acmr, after.acmr, before.atvr, after.atvr, before.numIndices, after.numIndices);
+}
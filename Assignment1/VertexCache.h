@@ -0,0 +1,61 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	VertexCache.h
+//	Post-transform vertex cache optimization for indexed meshes. The GPU keeps the
+//	last few transformed vertices and only runs the vertex stage again for an index
+//	that has fallen out, so the order triangles are drawn in decides how often each
+//	vertex is transformed. MeasureVertexCache() simulates a FIFO cache of that kind
+//	and reports the average cache miss ratio (ACMR, transforms per triangle, 0.5 is
+//	the best a large regular mesh can do) and the transforms per vertex (ATVR, 1 is
+//	ideal).
+//
+//	OptimizeVertexCache() reorders a triangle list with Tipsy (Sander, Nehab and
+//	Barczak, linear in the triangle count) and with Forsyth's scored LRU greedy
+//	method, and keeps whichever simulates better. Regular grids do better still as
+//	a single strip run in bands narrow enough for a row of a band to stay cached,
+//	MakeGridStrip() builds one.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FIFO entries simulated, and the size Tipsy orders for
+const int VertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+	int numIndices;		// as drawn, degenerate strip joins included
+	int numTriangles;	// not counting degenerate ones
+	int misses;			// vertex transforms
+	float acmr;			// misses per triangle
+	float atvr;			// misses per vertex referenced
+};
+
+// indices is a triangle list, or with strip a triangle strip joined by repeated indices
+VertexCacheStats MeasureVertexCache(const uint32_t *indices, int numIndices, int numVertices,
+	int cacheSize = VertexCacheSize, bool strip = false);
+
+// Reorders triangles in place, each keeping its winding
+void OptimizeVertexCacheTipsy(uint32_t *indices, int numIndices, int numVertices, int cacheSize = VertexCacheSize);
+void OptimizeVertexCacheForsyth(uint32_t *indices, int numIndices, int numVertices);
+
+// Runs both and keeps the better order, or the original when neither beats it.
+// Fills before and after when given.
+void OptimizeVertexCache(uint32_t *indices, int numIndices, int numVertices, VertexCacheStats *before = NULL,
+	VertexCacheStats *after = NULL);
+
+// Strip over a grid of (columns + 1) x (rows + 1) vertices stored row by row. Quads
+// come out counterclockwise as QuadMesh builds them (a row up is the next row of
+// vertices), in bands of bandWidth columns, each band swept row by row. Returns the
+// number of indices written; strip may be NULL to size it first.
+int MakeGridStrip(int columns, int rows, int bandWidth, uint32_t *strip);
+
+// Widest band whose rows still hit in a FIFO cache of cacheSize
+int GetGridStripBand(int cacheSize = VertexCacheSize);
+
+// One line: triangles, ACMR, ATVR and indices before and after
+void PrintVertexCacheStats(const char *name, const VertexCacheStats &before, const VertexCacheStats &after);
+
+#endif	//VERTEXCACHE_H
@@ -1,29 +1,8 @@
-// Vertex positions of a standard size cube (width 2), centered at the origin
-// of its own Model Coordinate System
-GLfloat vertices[][3] = { {-1.0, -1.0,-1.0},
-						 { 1.0, -1.0,-1.0},
-						 { 1.0,  1.0,-1.0},
-						 {-1.0,  1.0,-1.0},
-						 {-1.0, -1.0, 1.0},
-						 { 1.0, -1.0, 1.0},
-						 { 1.0,  1.0, 1.0},
-						 {-1.0,  1.0, 1.0} };
-
-GLubyte quads[] = { 0, 3, 2, 1,	// back face
-				   2, 3, 7, 6,	// top face
-				   0, 4, 7, 3,  // left face
-				   1, 2, 6, 5,  // right face
-				   4, 5, 6, 7,  // front face
-				   0, 1, 5, 4 };	// bottom face
-
-GLfloat quadNormals[][3] = { { 0.0, 0.0, -1.0},	// Back Face 
-						  { 0.0, 1.0,  0.0},	// Top Face
-						  {-1.0, 0.0,  0.0},	// Left Face
-						  { 1.0, 0.0,  0.0},	// Right Face
-						  { 0.0, 0.0,  1.0},	// Front Face
-						  { 0.0,-1.0,  0.0} };	// Bottom Face
-
+#include "Primitives.h"
 
+// Standard size cube (width 2), centered at the origin of its own Model Coordinate
+// System, generated at compile time
+inline constexpr PrimitiveMesh<24, 36> cubePrimitive = MakeCube();
 
 
 typedef struct CubeMesh
@@ -43,12 +22,14 @@ typedef struct CubeMesh
 	float highlightMat_specular[4];
 	float highlightMat_diffuse[4];
 	float highlightMat_shininess[1];
+	bool selected;
+	float health;				// Breaks into debris when spinner hits bring this to 0
 } CubeMesh;
 
-CubeMesh *createCubeMesh()
+// Fill in the default transform and materials. Cubes are owned by an ObjectPool,
+// so this works on storage the caller already has.
+void initCubeMesh(CubeMesh *newCube)
 {
-	CubeMesh *newCube = (CubeMesh*)calloc(1, sizeof(CubeMesh));
-
 	newCube->angle = 0.0;
 	newCube->sfx = newCube->sfy = newCube->sfz = 1.0;
 	newCube->tx = 0.0;
@@ -83,59 +64,37 @@ CubeMesh *createCubeMesh()
 	newCube->highlightMat_diffuse[3] = 1.0;
 	newCube->highlightMat_shininess[0] = 0.0;
 
-	return newCube;
+	newCube->selected = false;
+	newCube->health = 1.0;
 }
 
 void drawCubeMesh(CubeMesh *cube)
 {
-	// Setup the material and lights used for the cube
-	// you may want to use the alternate material if this cube is selected
-	glMaterialfv(GL_FRONT, GL_AMBIENT, cube->mat_ambient);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, cube->mat_specular);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, cube->mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SHININESS, cube->mat_shininess);
+	// Setup the material and lights used for the cube, the alternate material if this cube is selected
+	if (cube->selected)
+	{
+		glMaterialfv(GL_FRONT, GL_AMBIENT, cube->highlightMat_ambient);
+		glMaterialfv(GL_FRONT, GL_SPECULAR, cube->highlightMat_specular);
+		glMaterialfv(GL_FRONT, GL_DIFFUSE, cube->highlightMat_diffuse);
+		glMaterialfv(GL_FRONT, GL_SHININESS, cube->highlightMat_shininess);
+	}
+	else
+	{
+		glMaterialfv(GL_FRONT, GL_AMBIENT, cube->mat_ambient);
+		glMaterialfv(GL_FRONT, GL_SPECULAR, cube->mat_specular);
+		glMaterialfv(GL_FRONT, GL_DIFFUSE, cube->mat_diffuse);
+		glMaterialfv(GL_FRONT, GL_SHININESS, cube->mat_shininess);
+	}
 
 	// Transform Cube
-	// you need to add code here
+	glPushMatrix();
+	glTranslatef(cube->tx, cube->ty, cube->tz);
+	glRotatef(cube->angle, 0.0, 1.0, 0.0);
+	glScalef(cube->sfx, cube->sfy, cube->sfz);
+
+	// Draw Cube from the constant vertex and index arrays
+	DrawPrimitive(cubePrimitive.View());
 
-	// Draw Cube using simple immediate mode rendering
-	glBegin(GL_QUADS);
-	// Back Face
-	glNormal3f(quadNormals[0][0], quadNormals[0][1], quadNormals[0][2]);
-	glVertex3f(vertices[quads[0]][0], vertices[quads[0]][1], vertices[quads[0]][2]);
-	glVertex3f(vertices[quads[1]][0], vertices[quads[1]][1], vertices[quads[1]][2]);
-	glVertex3f(vertices[quads[2]][0], vertices[quads[2]][1], vertices[quads[2]][2]);
-	glVertex3f(vertices[quads[3]][0], vertices[quads[3]][1], vertices[quads[3]][2]);
-	// Top Face
-	glNormal3f(quadNormals[1][0], quadNormals[1][1], quadNormals[1][2]);
-	glVertex3f(vertices[quads[4]][0], vertices[quads[4]][1], vertices[quads[4]][2]);
-	glVertex3f(vertices[quads[5]][0], vertices[quads[5]][1], vertices[quads[5]][2]);
-	glVertex3f(vertices[quads[6]][0], vertices[quads[6]][1], vertices[quads[6]][2]);
-	glVertex3f(vertices[quads[7]][0], vertices[quads[7]][1], vertices[quads[7]][2]);
-	// Left Face
-	glNormal3f(quadNormals[2][0], quadNormals[2][1], quadNormals[2][2]);
-	glVertex3f(vertices[quads[8]][0], vertices[quads[8]][1], vertices[quads[8]][2]);
-	glVertex3f(vertices[quads[9]][0], vertices[quads[9]][1], vertices[quads[9]][2]);
-	glVertex3f(vertices[quads[10]][0], vertices[quads[10]][1], vertices[quads[10]][2]);
-	glVertex3f(vertices[quads[11]][0], vertices[quads[11]][1], vertices[quads[11]][2]);
-	// Right Face
-	glNormal3f(quadNormals[3][0], quadNormals[3][1], quadNormals[3][2]);
-	glVertex3f(vertices[quads[12]][0], vertices[quads[12]][1], vertices[quads[12]][2]);
-	glVertex3f(vertices[quads[13]][0], vertices[quads[13]][1], vertices[quads[13]][2]);
-	glVertex3f(vertices[quads[14]][0], vertices[quads[14]][1], vertices[quads[14]][2]);
-	glVertex3f(vertices[quads[15]][0], vertices[quads[15]][1], vertices[quads[15]][2]);
-	// Front Face
-	glNormal3f(quadNormals[4][0], quadNormals[4][1], quadNormals[4][2]);
-	glVertex3f(vertices[quads[16]][0], vertices[quads[16]][1], vertices[quads[16]][2]);
-	glVertex3f(vertices[quads[17]][0], vertices[quads[17]][1], vertices[quads[17]][2]);
-	glVertex3f(vertices[quads[18]][0], vertices[quads[18]][1], vertices[quads[18]][2]);
-	glVertex3f(vertices[quads[19]][0], vertices[quads[19]][1], vertices[quads[19]][2]);
-	// Bottom Face
-	glNormal3f(quadNormals[5][0], quadNormals[5][1], quadNormals[5][2]);
-	glVertex3f(vertices[quads[20]][0], vertices[quads[20]][1], vertices[quads[20]][2]);
-	glVertex3f(vertices[quads[21]][0], vertices[quads[21]][1], vertices[quads[21]][2]);
-	glVertex3f(vertices[quads[22]][0], vertices[quads[22]][1], vertices[quads[22]][2]);
-	glVertex3f(vertices[quads[23]][0], vertices[quads[23]][1], vertices[quads[23]][2]);
-	glEnd();
+	glPopMatrix();
 
 }
@@ -4,13 +4,42 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
 #include <gl/glut.h>
+#include <gl/freeglut_ext.h>
+#include <chrono>
+#include <memory>
 #include <utility>
 #include <vector>
 #include "VECTOR3D.h"
+#include "Primitives.h"
 #include "cube.h"
+#include "CompactVertex.h"
 #include "QuadMesh.h"
+#include "FrameArena.h"
+#include "ObjectPool.h"
+#include "Robot.h"
+#include "JobSystem.h"
+#include "ModelLoader.h"
+#include "Bvh.h"
+#include "Camera.h"
+#include "ParticleSystem.h"
+#include "Debris.h"
+#include "NetGame.h"
+#include "BattleVecEnv.h"
+#include "FrameCapture.h"
+#include "Transform.h"
+#include "FastTrig.h"
+#include "MappedFile.h"
+#include "Arena.h"
+#include "ArenaGenerator.h"
+#include "NavGrid.h"
+#include "FlowField.h"
+#include "RobotAvoidance.h"
+#include "DiffDrive.h"
+#include "VertexCache.h"
+#include "MeshLod.h"
 #define PI 3.14159265358979323846
 
 const int vWidth = 1000;    // Viewport width in pixels
@@ -23,16 +52,6 @@ float topBodyLength = 0.03*robotBodyWidth;
 float wheelLength = 0.25*robotBodyWidth;
 float spinnerLength = 0.5*robotBodyWidth;
 
-// Control robot body rotation on base
-float robotAngle = 0.0;
-
-// Control spinner angle
-float spinnerAngle = 0.0;
-
-// Control wheel angle, independent of each other
-float leftWheelAngle = 0.0;
-float rightWheelAngle = 0.0;
-
 // Lighting/shading and material properties for robot
 // Robot RGBA material properties
 GLfloat robotBody_mat_ambient[] = { 0.24725f, 0.2245f, 0.0645f, 1.0f };
@@ -55,53 +74,259 @@ GLfloat robotSpinner_mat_diffuse[] = { 0.50754f, 0.50754f, 0.50754f, 1.0f };
 GLfloat robotSpinner_mat_specular[] = { 0.508273f, 0.508273f, 0.508273f, 1.0f };
 GLfloat robotSpinner_mat_shininess[] = { 51.2F };
 
-// Light properties
-GLfloat light_position0[] = { -4.0F, 8.0F, 8.0F, 1.0F };
-GLfloat light_position1[] = { 4.0F, 8.0F, 8.0F, 1.0F };
-GLfloat light_diffuse[] = { 1.0, 1.0, 1.0, 1.0 };
-GLfloat light_specular[] = { 1.0, 1.0, 1.0, 1.0 };
-GLfloat light_ambient[] = { 0.2F, 0.2F, 0.2F, 1.0F };
-
 // Mouse button
 int currentButton;
 
-// A template cube mesh
-CubeMesh *cubeMesh = createCubeMesh();
+// Fixed-size pools owning every obstacle cube, quad mesh and robot in the arena.
+// Declared before the owning pointers below so they are destroyed after them.
+// Arena files can hold 100k obstacles.
+ObjectPool<CubeMesh> cubePool(1 << 17);
+ObjectPool<QuadMesh> meshPool(ArenaMaxSurfaces);
+ObjectPool<Robot> robotPool(1024);
+
+// The arena (--arena <path>, --generate <settings>, the built-in one otherwise).
+// Obstacles live in cubePool, arena keeps the surfaces, lights and spawn points for
+// saving (--save-arena <path>). Robots other than the player's stand at the other spawns.
+struct SurfaceMesh
+{
+	ArenaSurface surface;
+	PoolPtr<QuadMesh> mesh;
+	std::unique_ptr<MeshLods> lods;		// built by the first reportLods(), never drawn
+};
+
+ArenaDescription arena;
+std::vector<SurfaceMesh> surfaceMeshes;
+std::vector<PoolPtr<Robot>> spawnedRobots;
+
+// The robot driven with the arrow keys
+PoolPtr<Robot> playerRobot;
+
+// Walkable cells of the terrain with obstacle and wall footprints stamped in. With
+// botsRunning the spawned robots find their way to the player's robot, each along its
+// own path, or from swarmSize robots on all down one flow field.
+NavGrid navGrid;
+FlowFieldCache flowFields(navGrid);
+const size_t swarmSize = 32;
+bool botsRunning = false;
+bool botTimerRunning = false;
+std::vector<NavPath> botPaths;
+
+// Robots move on their wheels: robot 0 is the player's, driven while arrow keys are
+// held when offline (the network still sends one command per press), and 1 + i is
+// spawned robot i. Wheels of radius wheelLength sit either side of the body.
+const DiffDriveSettings robotDriveSettings = { wheelLength, robotBodyWidth + wheelLength, 12.0f, 40.0f, 60.0f,
+	5.0f };
+DiffDrive robotDrive(robotDriveSettings);
+bool driveTimerRunning = false;
+
+// The drive is stepped at a fixed 100 Hz against real time, however often the timer
+// actually fires. At most driveMaxCatchUp seconds are made up after a stall.
+const float driveStep = 0.01f;
+const float driveMaxCatchUp = 0.1f;
+int lastDriveTime = 0;
+float driveTimeBehind = 0.0f;
+int heldArrowKeys = 0;		// bit per arrow key, see arrowKeyBit()
+
+// Local avoidance between the bots, and of the player's robot, on top of the routes.
+// Speeds are per second, up to what the wheels manage.
+const AvoidanceSettings botAvoidanceSettings = { 3.0f * robotBodyWidth, 10, 2.0f,
+	robotDriveSettings.wheelRadius * robotDriveSettings.maxWheelSpeed, 0.5f * robotBodyWidth + wheelLength,
+	0.5f * robotBodyDepth };
+RobotAvoidance botAvoidance(botAvoidanceSettings);
+
+// Background workers, and the models they decode. Robots are drawn from
+// robotModel once it is ready and from the hand-built parts until then.
+JobSystem jobSystem;
+ModelLoader modelLoader(jobSystem);
+int robotModel = -1;
+
+// Ray queries against the arena. Every obstacle, ground chunk, the wall and each
+// robot part has a box in a SceneLayer; owners says what each box belongs to. Only
+// robots move, so the ground, walls and obstacles are kept in staticScene and rebuilt
+// when sceneBvhDirty is set, and robotScene is refit every frame.
+enum SceneBoxKind
+{
+	SceneObstacle,
+	SceneGround,
+	SceneWall,
+	SceneRobotPart
+};
+
+struct SceneBoxOwner
+{
+	SceneBoxKind kind;
+	PoolHandle handle;	// obstacle cube or robot, null for ground and wall
+};
+
+struct SceneLayer
+{
+	std::vector<Aabb> boxes;
+	std::vector<SceneBoxOwner> owners;
+	Bvh bvh;
+};
+
+SceneLayer staticScene;
+SceneLayer robotScene;
+bool sceneBvhDirty = true;	// surfaces or obstacles were added or removed, rebuild staticScene
+
+PoolHandle selectedCube;
+
+// Views rendered every frame, tiled over the window. CameraFollow views track robot.
+struct SpectatorView
+{
+	Camera camera;
+	PoolHandle robot;
+};
+
+std::vector<SpectatorView> views;
+int windowWidth = vWidth;
+int windowHeight = vHeight;
+
+// Something drawable and the views that can see it, gathered once per frame for all views
+struct VisibleItem
+{
+	SceneBoxKind kind;
+	PoolHandle handle;
+	uint32_t viewMask;
+};
+
+// Generated meshes are cached here and mapped back in on later runs
+const char *meshCacheDir = "MeshCache";
+
+// Vertex format the surface meshes are kept in (--vertex-format float|half|quantized)
+VertexFormat surfaceVertexFormat = VertexFormatFloat;
+
+// Robot part tessellations, generated at compile time
+constexpr auto wheelCylinder = MakeCylinder<100, 1>();
+constexpr auto wheelDisk = MakeDisk<100, 1>();
+constexpr auto spinnerCylinder = MakeCylinder<20, 1>();
+constexpr auto spinnerDisk = MakeDisk<20, 1>();
+constexpr auto postCylinder = MakeCylinder<15, 1>();
+constexpr auto trianglePiece = MakeWedge(0.03f);
+
+// The parts by name, for the mesh reports
+struct NamedPrimitive
+{
+	const char *name;
+	PrimitiveView view;
+};
+
+const NamedPrimitive robotParts[] = {
+	{ "wheel cylinder", wheelCylinder.View() },
+	{ "wheel disk", wheelDisk.View() },
+	{ "spinner cylinder", spinnerCylinder.View() },
+	{ "spinner disk", spinnerDisk.View() },
+	{ "post cylinder", postCylinder.View() },
+	{ "triangle piece", trianglePiece.View() },
+	{ "cube", cubePrimitive.View() }
+};
+
+// Simplified wheels, built on the job system at startup and cached with the meshes.
+// A robot whose distance from the camera is past robotLodDistance draws the next
+// level, and one further for each doubling of the distance.
+const int wheelCylinderLodTargets[] = { 100, 48, 24 };
+const int wheelDiskLodTargets[] = { 48, 24, 12 };
+const float robotLodDistance = 60.0f;
+MeshLods wheelCylinderLods;
+MeshLods wheelDiskLods;
+int robotLodLevel = 0;
+
+// Sparks from spinner strikes and the pieces of broken obstacles, stepped by
+// effectsHandler while anything is moving
+ParticleSystem particles;
+DebrisSystem debris(2048, 16);
+bool effectsTimerRunning = false;
+int lastEffectsTime = 0;
+
+// Multiplayer: hosting (--server) or joining (--connect). netRobots mirrors the
+// network's robots into robotPool for drawing, the local one is playerRobot.
+enum NetMode
+{
+	NetOffline,
+	NetHost,
+	NetJoin
+};
+
+NetMode netMode = NetOffline;
+NetServer netServer;
+NetClient netClient;
+PoolHandle netRobots[MaxNetRobots];
+uint32_t lastNetReportMs = 0;
+bool animationRunning = false;
+
+// Recording of the window (--capture <path>, c starts and stops), read back without stalling
+FrameCapture frameCapture;
+const char *capturePath = "capture.y4m";
 
-// A flat open mesh
-QuadMesh *groundMesh = NULL;
-QuadMesh *wallMesh = NULL;
+// Robot transforms, kept on the CPU (see drawRobot)
+MatrixStack modelStack;
 
-// Default Mesh Size
-int meshSize = 10;
+// Transient per-frame allocations, reset at the end of every display()
+FrameArena frameArena(4 * 1024 * 1024);
+unsigned int reportedArenaOverflows = 0;
 
 // Prototypes for functions in this module
 void initOpenGL(int w, int h);
+bool loadArena(const char *path);
+bool generateArena(const ArenaGeneratorSettings &settings, const char *savePath);
+void buildArena(const ArenaView &view);
+void placeRobot(Robot &robot, const ArenaSpawn &spawn);
+void buildNavGrid();
+bool obstacleFootprint(const CubeMesh &cube, NavFootprint &footprint);
+bool saveArena(const char *path);
 void display(void);
 void reshape(int w, int h);
 void mouse(int button, int state, int x, int y);
 void mouseMotionHandler(int xMouse, int yMouse);
 void keyboard(unsigned char key, int x, int y);
 void functionKeys(int key, int x, int y);
+void functionKeysUp(int key, int x, int y);
+int arrowKeyBit(int key);
 void animationHandler(int param);
-void drawRobot();
+void modelPollHandler(int param);
+void effectsHandler(int param);
+void botHandler(int param);
+void steerBot(size_t bot, float targetX, float targetZ, float move);
+void resetRobotDrive();
+void reportVertexFormats();
+void reportVertexCache();
+void buildRobotLods();
+void reportLods();
+bool runBenchmark(const char *name);
+void startDrive();
+void driveHandler(int param);
+void netHandler(int param);
+void startNetwork(NetMode mode, const char *address, uint32_t latencyMs, uint32_t jitterMs, float lossRate);
+void stopNetwork();
+void syncNetRobots();
+void issueCommand(int turn, int move, bool toggleSpinner);
+void startAnimation();
+void toggleCapture();
+void stopCapture();
+void windowClosed();
+PoolHandle spawnObstacle(const ArenaObstacle &obstacle);
+void drawRobot(Robot &robot);
 void drawBody();
 void drawTopBody();
 void drawBottomBody();
-void drawLeftWheel();
-void drawRightWheel();
-void drawSpinner();
+void drawLeftWheel(float wheelAngle);
+void drawRightWheel(float wheelAngle);
+void drawRobotPart(const MeshLods &lods, const PrimitiveView &primitive);
+void drawSpinner(float spinnerAngle);
 void drawTopTriangle();
 void drawBottomTriangle();
-void drawCylinder();
-
-//Keep track of forwards vector that the robot is facing, uses sin and cos so values will be
-//from -1 to 1, always a unit vector
-VECTOR3D forwards = VECTOR3D(0.0f, 0.0f, 1.0f);
-
-//Keep track of robotX and robotZ to translate the robot
-float robotX = 0;
-float robotZ = 0;
+void drawCylinder(float spinnerAngle);
+void drawSolidCube();
+void loadModelMatrix();
+void gatherStaticBoxes();
+void gatherRobotBoxes();
+void updateSceneBvh();
+void pickObstacle(int x, int y);
+Aabb spinnerBox(const Robot &robot);
+void emitSpinnerSparks(PoolHandle robotHandle);
+void damageObstacle(PoolHandle cubeHandle, const float contact[3], float damage);
+void setupViews(int count);
+void drawView(int view, const VisibleItem *items, int numItems);
 
 int main(int argc, char **argv)
 {
@@ -115,6 +340,111 @@ int main(int argc, char **argv)
 	// Initialize GL
 	initOpenGL(vWidth, vHeight);
 
+	// Remaining arguments (GLUT has removed its own)
+	NetMode mode = NetOffline;
+	const char *netAddress = NULL;
+	const char *arenaPath = NULL;
+	const char *saveArenaPath = NULL;
+	const char *benchmark = NULL;
+	bool generate = false;
+	ArenaGeneratorSettings generator;
+	int numViews = 1;
+	bool capture = false;
+	uint32_t latencyMs = 0, jitterMs = 0;
+	float lossRate = 0.0f;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--robot-model") == 0 && i + 1 < argc)
+		{
+			robotModel = modelLoader.Request(argv[++i]);
+			glutTimerFunc(50, modelPollHandler, 0);
+		}
+		else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc)
+		{
+			numViews = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--arena") == 0 && i + 1 < argc)
+		{
+			arenaPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--save-arena") == 0 && i + 1 < argc)
+		{
+			saveArenaPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--generate") == 0 && i + 5 < argc)
+		{
+			generate = true;
+			generator.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+			generator.numObstacles = atoi(argv[++i]);
+			generator.numRobots = atoi(argv[++i]);
+			generator.numWalls = atoi(argv[++i]);
+			generator.terrainMeshSize = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--server") == 0)
+		{
+			mode = NetHost;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				netAddress = argv[++i];
+		}
+		else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc)
+		{
+			mode = NetJoin;
+			netAddress = argv[++i];
+		}
+		else if (strcmp(argv[i], "--net-sim") == 0 && i + 3 < argc)
+		{
+			latencyMs = (uint32_t)atoi(argv[++i]);
+			jitterMs = (uint32_t)atoi(argv[++i]);
+			lossRate = (float)atof(argv[++i]) / 100.0f;
+		}
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			capture = true;
+			capturePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+		{
+			benchmark = argv[++i];
+		}
+		else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+			for (int f = 0; f < VertexFormatCount; f++)
+			{
+				if (strcmp(name, GetVertexFormatName((VertexFormat)f)) == 0)
+					surfaceVertexFormat = (VertexFormat)f;
+			}
+		}
+	}
+
+	// Benchmarks take seconds, so they run instead of the game rather than from a key in it
+	if (benchmark)
+		return runBenchmark(benchmark) ? 0 : 1;
+
+	// The arena comes before the views, which follow its robots
+	if (generate)
+	{
+		if (!generateArena(generator, saveArenaPath))
+			printf("Arena settings out of range, using the built-in arena\n");
+		saveArenaPath = NULL;
+	}
+	if (surfaceMeshes.empty() && (!arenaPath || !loadArena(arenaPath)))
+	{
+		if (arenaPath)
+			printf("Arena %s could not be loaded, using the built-in arena\n", arenaPath);
+		MakeDefaultArena(arena);
+		buildArena(arena.View());
+	}
+	if (saveArenaPath && !saveArena(saveArenaPath))
+		printf("Arena could not be saved to %s\n", saveArenaPath);
+	setupViews(numViews);
+	buildRobotLods();
+
+	if (mode != NetOffline)
+		startNetwork(mode, netAddress, latencyMs, jitterMs, lossRate);
+	if (capture)
+		toggleCapture();
+
 	// Register callback functions
 	glutDisplayFunc(display);
 	glutReshapeFunc(reshape);
@@ -122,6 +452,8 @@ int main(int argc, char **argv)
 	glutMotionFunc(mouseMotionHandler);
 	glutKeyboardFunc(keyboard);
 	glutSpecialFunc(functionKeys);
+	glutSpecialUpFunc(functionKeysUp);
+	glutCloseFunc(windowClosed);
 
 	// Start event loop, never returns
 	glutMainLoop();
@@ -133,20 +465,8 @@ int main(int argc, char **argv)
 // Set up OpenGL. For viewport and projection setup see reshape(). 
 void initOpenGL(int w, int h)
 {
-	// Set up and enable lighting
-	glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
-	glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
-	glLightfv(GL_LIGHT0, GL_SPECULAR, light_specular);
-	glLightfv(GL_LIGHT1, GL_AMBIENT, light_ambient);
-	glLightfv(GL_LIGHT1, GL_DIFFUSE, light_diffuse);
-	glLightfv(GL_LIGHT1, GL_SPECULAR, light_specular);
-
-	glLightfv(GL_LIGHT0, GL_POSITION, light_position0);
-	glLightfv(GL_LIGHT1, GL_POSITION, light_position1);
-
+	// Enable lighting, the lights themselves come with the arena
 	glEnable(GL_LIGHTING);
-	glEnable(GL_LIGHT0);
-	glEnable(GL_LIGHT1);   
 
 	// Other OpenGL setup
 	glEnable(GL_DEPTH_TEST);   // Remove hidded surfaces
@@ -158,33 +478,769 @@ void initOpenGL(int w, int h)
 
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
+}
 
-	
-	// Set up ground quad mesh
-	VECTOR3D groundOrigin = VECTOR3D(-100.0f, 0.0f, 100.0f);
-	VECTOR3D groundDir1v = VECTOR3D(1.0f, 0.0f, 0.0f);
-	VECTOR3D groundDir2v = VECTOR3D(0.0f, 0.0f, -1.0f);
-	groundMesh = new QuadMesh(meshSize, 200.0);
-	groundMesh->InitMesh(meshSize, groundOrigin, 200.0, 200.0, groundDir1v, groundDir2v);
-	VECTOR3D groundAmbient = VECTOR3D(0.6f, 0.0f, 0.0f);
-	VECTOR3D groundDiffuse = VECTOR3D(0.2f, 0.2f, 0.2f);
-	VECTOR3D groundSpecular = VECTOR3D(0.04f, 0.04f, 0.04f);
-	float groundShininess = 0.05;
-	groundMesh->SetMaterial(groundAmbient, groundDiffuse, groundSpecular, groundShininess);
-	
+// Map an arena file and build the scene straight from its records. Returns false,
+// leaving the scene empty, if the file is missing, stale or corrupt.
+bool loadArena(const char *path)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	MappedFile file;
+	ArenaView view;
+	if (!file.Open(path) || !ValidateArenaFile(file, view))
+		return false;
+
+	// Surfaces, lights and spawns are small and kept for saving, obstacles go to cubePool only
+	arena.surfaces.assign(view.surfaces, view.surfaces + view.numSurfaces);
+	arena.obstacles.clear();
+	arena.lights.assign(view.lights, view.lights + view.numLights);
+	arena.spawns.assign(view.spawns, view.spawns + view.numSpawns);
+	buildArena(view);
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Arena %s: %d obstacles, %d surfaces loaded in %.1f ms\n", path, view.numObstacles, view.numSurfaces, ms);
+	return true;
+}
+
+// Generate an arena and play in it. With a savePath the generated arena is written there
+// in full, even the obstacles that do not fit the cube pool, with its manifest next to it.
+bool generateArena(const ArenaGeneratorSettings &settings, const char *savePath)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!GenerateArena(settings, arena))
+		return false;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Generated arena: %d obstacles, %d robots, %d surfaces in %.1f ms, hash %016llx\n",
+		(int)arena.obstacles.size(), (int)arena.spawns.size(), (int)arena.surfaces.size(), ms,
+		(unsigned long long)ArenaContentHash(arena.View()));
+
+	if (savePath)
+	{
+		char manifestPath[512];
+		snprintf(manifestPath, sizeof(manifestPath), "%s.manifest", savePath);
+		if (!WriteArenaFile(savePath, arena.View()) || !WriteArenaManifest(manifestPath, settings, arena.View()))
+			printf("Arena could not be saved to %s\n", savePath);
+	}
+
+	buildArena(arena.View());
+	arena.obstacles.clear();
+	return true;
+}
+
+// Surfaces become quad meshes, obstacles cubes, the lights are set up in eye space,
+// the player's robot starts at the first spawn point and idle robots stand at the rest
+void buildArena(const ArenaView &view)
+{
+	surfaceMeshes.clear();
+	surfaceMeshes.reserve(view.numSurfaces);
+	sceneBvhDirty = true;
+	debris.ClearWalls();
+	bool haveGround = false;
+	for (int i = 0; i < view.numSurfaces; i++)
+	{
+		const ArenaSurface &surface = view.surfaces[i];
+		SurfaceMesh surfaceMesh;
+		surfaceMesh.surface = surface;
+		surfaceMesh.mesh = MakePooled(meshPool, (int)surface.meshSize, surface.length);
+		if (!surfaceMesh.mesh)
+			break;
+		surfaceMesh.mesh->InitMeshCached(meshCacheDir, surface.meshSize, VECTOR3D(surface.origin), surface.length,
+			surface.width, VECTOR3D(surface.dir1), VECTOR3D(surface.dir2));
+		surfaceMesh.mesh->SetMaterial(VECTOR3D(surface.ambient), VECTOR3D(surface.diffuse), VECTOR3D(surface.specular),
+			surface.shininess);
+		surfaceMesh.mesh->SetVertexFormat(surfaceVertexFormat);
+
+		// Sparks and debris land on the terrain, which is level, and debris bounces off the walls
+		if (surface.kind == ArenaTerrain && !haveGround)
+		{
+			debris.groundY = particles.groundY = surface.origin[1];
+			haveGround = true;
+		}
+		else if (surface.kind == ArenaWall)
+			debris.AddWall(surface.origin, surface.dir1, surface.dir2, surface.length, surface.width);
+		surfaceMeshes.push_back(std::move(surfaceMesh));
+	}
+
+	int numObstacles = 0;
+	while (numObstacles < view.numObstacles && !spawnObstacle(view.obstacles[numObstacles]).IsNull())
+		numObstacles++;
+	if (numObstacles < view.numObstacles)
+		printf("Arena has %d obstacles, the first %d are used\n", view.numObstacles, numObstacles);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	for (int i = 0; i < ArenaMaxLights; i++)
+	{
+		GLenum light = GL_LIGHT0 + i;
+		if (i >= view.numLights)
+		{
+			glDisable(light);
+			continue;
+		}
+		glLightfv(light, GL_AMBIENT, view.lights[i].ambient);
+		glLightfv(light, GL_DIFFUSE, view.lights[i].diffuse);
+		glLightfv(light, GL_SPECULAR, view.lights[i].specular);
+		glLightfv(light, GL_POSITION, view.lights[i].position);
+		glEnable(light);
+	}
+
+	playerRobot = MakePooled(robotPool);
+	if (playerRobot && view.numSpawns > 0)
+		placeRobot(*playerRobot, view.spawns[0]);
+
+	spawnedRobots.clear();
+	for (int i = 1; i < view.numSpawns; i++)
+	{
+		PoolPtr<Robot> robot = MakePooled(robotPool);
+		if (!robot)
+			break;
+		placeRobot(*robot, view.spawns[i]);
+		spawnedRobots.push_back(std::move(robot));
+	}
+
+	buildNavGrid();
+	resetRobotDrive();
+}
+
+// Stand a robot at a spawn point
+void placeRobot(Robot &robot, const ArenaSpawn &spawn)
+{
+	robot.x = spawn.x;
+	robot.z = spawn.z;
+	robot.angle = spawn.angle;
+	robot.UpdateForwards();
+}
+
+// Grid over the terrain surfaces, with cells small enough for the robots to squeeze
+// between obstacles but never more than about 1024 across
+void buildNavGrid()
+{
+	float minX = 0.0f, minZ = 0.0f, maxX = 0.0f, maxZ = 0.0f;
+	bool any = false;
+	for (size_t i = 0; i < surfaceMeshes.size(); i++)
+	{
+		const ArenaSurface &surface = surfaceMeshes[i].surface;
+		if (surface.kind != ArenaTerrain)
+			continue;
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float u = (corner & 1) ? surface.length : 0.0f, v = (corner & 2) ? surface.width : 0.0f;
+			float x = surface.origin[0] + u * surface.dir1[0] + v * surface.dir2[0];
+			float z = surface.origin[2] + u * surface.dir1[2] + v * surface.dir2[2];
+			minX = any ? fminf(minX, x) : x;
+			minZ = any ? fminf(minZ, z) : z;
+			maxX = any ? fmaxf(maxX, x) : x;
+			maxZ = any ? fmaxf(maxZ, z) : z;
+			any = true;
+		}
+	}
+
+	// Half the robot's widest extent, wheels included, keeps it clear whichever way it faces
+	float extent = fmaxf(maxX - minX, maxZ - minZ);
+	float radius = 0.5f * fmaxf(robotBodyWidth + 2.0f * wheelLength, robotBodyDepth);
+	navGrid.Build(minX, minZ, maxX, maxZ, fmaxf(2.0f, extent / 1024.0f), radius);
+
+	NavFootprint footprint;
+	for (uint32_t i = 0; i < cubePool.GetLiveCount(); i++)
+	{
+		if (obstacleFootprint(*cubePool.Get(cubePool.GetLiveHandle(i)), footprint))
+			navGrid.AddBlocker(footprint);
+	}
+
+	// Upright walls block along their length
+	for (size_t i = 0; i < surfaceMeshes.size(); i++)
+	{
+		const ArenaSurface &surface = surfaceMeshes[i].surface;
+		if (surface.kind != ArenaWall || fabsf(surface.dir1[1]) > 0.01f)
+			continue;
+		footprint.x = surface.origin[0] + 0.5f * surface.length * surface.dir1[0];
+		footprint.z = surface.origin[2] + 0.5f * surface.length * surface.dir1[2];
+		footprint.halfX = 0.5f * surface.length;
+		footprint.halfZ = 0.5f;
+		footprint.angle = atan2f(-surface.dir1[2], surface.dir1[0]) * (float)(180.0 / PI);
+		navGrid.AddBlocker(footprint);
+	}
+	botPaths.assign(spawnedRobots.size(), NavPath());
+	flowFields.Clear();
+}
+
+// Obstacles the robots cannot pass under, that is whose bottom is below the robot's top
+bool obstacleFootprint(const CubeMesh &cube, NavFootprint &footprint)
+{
+	if (cube.ty - cube.sfy > 0.5f * robotBodyLength)
+		return false;
+	footprint.x = cube.tx;
+	footprint.z = cube.tz;
+	footprint.halfX = cube.sfx;
+	footprint.halfZ = cube.sfz;
+	footprint.angle = cube.angle;
+	return true;
+}
+
+// Write the arena as it is now, without the obstacles that have been destroyed
+bool saveArena(const char *path)
+{
+	ArenaDescription current;
+	current.surfaces = arena.surfaces;
+	current.lights = arena.lights;
+	current.spawns = arena.spawns;
+	current.obstacles.resize(cubePool.GetLiveCount());
+	for (uint32_t i = 0; i < cubePool.GetLiveCount(); i++)
+	{
+		const CubeMesh *cube = cubePool.Get(cubePool.GetLiveHandle(i));
+		ArenaObstacle &obstacle = current.obstacles[i];
+		obstacle.position[0] = cube->tx;
+		obstacle.position[1] = cube->ty;
+		obstacle.position[2] = cube->tz;
+		obstacle.scale[0] = cube->sfx;
+		obstacle.scale[1] = cube->sfy;
+		obstacle.scale[2] = cube->sfz;
+		obstacle.angle = cube->angle;
+		obstacle.health = cube->health;
+	}
+	return WriteArenaFile(path, current.View());
+}
+
+// Create an obstacle cube in the cube pool, returns the null handle if the pool is full
+PoolHandle spawnObstacle(const ArenaObstacle &obstacle)
+{
+	PoolHandle handle = cubePool.Create();
+	CubeMesh *cube = cubePool.Get(handle);
+	if (!cube)
+		return handle;
+
+	initCubeMesh(cube);
+	cube->tx = obstacle.position[0];
+	cube->ty = obstacle.position[1];
+	cube->tz = obstacle.position[2];
+	cube->sfx = obstacle.scale[0];
+	cube->sfy = obstacle.scale[1];
+	cube->sfz = obstacle.scale[2];
+	cube->angle = obstacle.angle;
+	cube->health = obstacle.health;
+	cube->center.Set(cube->tx, cube->ty, cube->tz);
+
+	sceneBvhDirty = true;
+	return handle;
+}
+
+// World-space box around a box of half extents (hx, hy, hz) centred at local (cx, cy, cz),
+// rotated around y by the angle with sine s and cosine c and then moved to (ox, oy, oz)
+static Aabb rotatedBox(float cx, float cy, float cz, float hx, float hy, float hz, float s, float c,
+	float ox, float oy, float oz)
+{
+	// Same rotation as glRotatef(angle, 0, 1, 0)
+	Aabb box;
+	box.min[0] = ox + c * cx + s * cz - (fabsf(c) * hx + fabsf(s) * hz);
+	box.max[0] = ox + c * cx + s * cz + (fabsf(c) * hx + fabsf(s) * hz);
+	box.min[1] = oy + cy - hy;
+	box.max[1] = oy + cy + hy;
+	box.min[2] = oz - s * cx + c * cz - (fabsf(s) * hx + fabsf(c) * hz);
+	box.max[2] = oz - s * cx + c * cz + (fabsf(s) * hx + fabsf(c) * hz);
+	return box;
+}
+
+// As rotatedBox(), rotated by angle degrees
+static Aabb transformedBox(float cx, float cy, float cz, float hx, float hy, float hz, float angle,
+	float ox, float oy, float oz)
+{
+	float s, c;
+	FastSinCosDegrees(angle, s, c);
+	return rotatedBox(cx, cy, cz, hx, hy, hz, s, c, ox, oy, oz);
+}
+
+static void addSceneBox(SceneLayer & layer, const Aabb & box, SceneBoxKind kind, PoolHandle handle)
+{
+	SceneBoxOwner owner;
+	owner.kind = kind;
+	owner.handle = handle;
+	layer.boxes.push_back(box);
+	layer.owners.push_back(owner);
+}
+
+// Collect the boxes of the ground, walls and obstacles
+void gatherStaticBoxes()
+{
+	staticScene.boxes.clear();
+	staticScene.owners.clear();
+
+	// One thin box per quad mesh cell of the ground and walls
+	for (size_t s = 0; s < surfaceMeshes.size(); s++)
+	{
+		const ArenaSurface &surface = surfaceMeshes[s].surface;
+		SceneBoxKind kind = surface.kind == ArenaWall ? SceneWall : SceneGround;
+		float step1 = surface.length / surface.meshSize;
+		float step2 = surface.width / surface.meshSize;
+		for (int i = 0; i < surface.meshSize; i++)
+		{
+			for (int j = 0; j < surface.meshSize; j++)
+			{
+				Aabb box;
+				box.SetEmpty();
+				for (int corner = 0; corner < 4; corner++)
+				{
+					float u = (i + (corner & 1)) * step1, v = (j + (corner >> 1)) * step2;
+					float p[3];
+					for (int k = 0; k < 3; k++)
+						p[k] = surface.origin[k] + u * surface.dir1[k] + v * surface.dir2[k];
+					box.Grow(p);
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					box.min[k] -= 0.05f;
+					box.max[k] += 0.05f;
+				}
+				addSceneBox(staticScene, box, kind, PoolHandle());
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < cubePool.GetLiveCount(); i++)
+	{
+		PoolHandle handle = cubePool.GetLiveHandle(i);
+		CubeMesh *cube = cubePool.Get(handle);
+		addSceneBox(staticScene, transformedBox(0, 0, 0, cube->sfx, cube->sfy, cube->sfz, cube->angle, cube->tx,
+			cube->ty, cube->tz), SceneObstacle, handle);
+	}
+}
+
+// Collect the boxes of the robot parts, in a stable order so that refitting only has
+// to recompute them
+void gatherRobotBoxes()
+{
+	robotScene.boxes.clear();
+	robotScene.owners.clear();
+
+	// Every robot heading in one batch, one at a time if the frame arena is full.
+	// Handed back before returning, so display() finds the arena empty.
+	FrameArena::Marker marker = frameArena.GetMarker();
+	uint32_t numRobots = robotPool.GetLiveCount();
+	float *headings = frameArena.AllocateArray<float>(numRobots);
+	float *sines = frameArena.AllocateArray<float>(numRobots);
+	float *cosines = frameArena.AllocateArray<float>(numRobots);
+	bool batched = headings && sines && cosines;
+	if (batched)
+	{
+		for (uint32_t i = 0; i < numRobots; i++)
+			headings[i] = robotPool.Get(robotPool.GetLiveHandle(i))->angle;
+		SinCosDegreesBatch(headings, sines, cosines, (int)numRobots);
+	}
+
+	for (uint32_t i = 0; i < numRobots; i++)
+	{
+		PoolHandle handle = robotPool.GetLiveHandle(i);
+		Robot *robot = robotPool.Get(handle);
+		float wheelX = 0.5f * robotBodyWidth + 0.5f * wheelLength;
+		float s, c;
+		if (batched)
+		{
+			s = sines[i];
+			c = cosines[i];
+		}
+		else
+			FastSinCosDegrees(robot->angle, s, c);
+
+		// Body with its top and bottom plates, the wheels and the spinner disk
+		addSceneBox(robotScene, rotatedBox(0, 0, 0, 0.5f * robotBodyWidth, 0.5f * robotBodyLength + topBodyLength,
+			0.5f * robotBodyDepth, s, c, robot->x, 0, robot->z), SceneRobotPart, handle);
+		addSceneBox(robotScene, rotatedBox(wheelX, 0, 0, 0.5f * wheelLength, wheelLength, wheelLength,
+			s, c, robot->x, 0, robot->z), SceneRobotPart, handle);
+		addSceneBox(robotScene, rotatedBox(-wheelX, 0, 0, 0.5f * wheelLength, wheelLength, wheelLength,
+			s, c, robot->x, 0, robot->z), SceneRobotPart, handle);
+		addSceneBox(robotScene, rotatedBox(0, 0.5f, 8, spinnerLength, 0.5f, spinnerLength, s, c, robot->x, 0,
+			robot->z), SceneRobotPart, handle);
+	}
+	frameArena.Rewind(marker);
+}
+
+// The spinner disk sits at (0, 0.5, 8) in robot space
+Aabb spinnerBox(const Robot &robot)
+{
+	return transformedBox(0, 0.5f, 8, spinnerLength, 0.5f, spinnerLength, robot.angle, robot.x, 0, robot.z);
+}
+
+// Throw sparks (and debris off obstacles) where a running spinner touches anything else
+void emitSpinnerSparks(PoolHandle robotHandle)
+{
+	Robot *robot = robotPool.Get(robotHandle);
+	Aabb spinner = spinnerBox(*robot);
+	float centre[3];
+	for (int k = 0; k < 3; k++)
+		centre[k] = 0.5f * (spinner.min[k] + spinner.max[k]);
+
+	// Overlaps from the frame arena, doubled until the query no longer fills them.
+	// Runs between frames, so it hands the memory back before returning.
+	FrameArena::Marker marker = frameArena.GetMarker();
+	FrameVector<int> touching(16, 0, FrameAllocator<int>(frameArena));
+	bool emitted = false;
+	const SceneLayer *layers[2] = { &staticScene, &robotScene };
+	for (const SceneLayer *layer : layers)
+	{
+		int numTouching;
+		while ((numTouching = layer->bvh.QueryOverlaps(spinner, touching.data(), (int)touching.size())) == (int)touching.size())
+			touching.resize(2 * touching.size());
+		for (int i = 0; i < numTouching; i++)
+		{
+			const SceneBoxOwner &owner = layer->owners[touching[i]];
+			if (owner.kind == SceneGround || (owner.kind == SceneRobotPart && owner.handle == robotHandle))
+				continue;
+
+			// Contact at the point of the other box nearest the spinner centre, sparks fly
+			// off along the rim: spin (0, w, 0) x (contact - centre)
+			const Aabb &box = layer->boxes[touching[i]];
+			float contact[3];
+			for (int k = 0; k < 3; k++)
+				contact[k] = centre[k] < box.min[k] ? box.min[k] : (centre[k] > box.max[k] ? box.max[k] : centre[k]);
+			float spin = 4.0f;
+			float velocity[3] = { spin * (contact[2] - centre[2]), 6.0f, -spin * (contact[0] - centre[0]) };
+
+			particles.Emit(contact, velocity, 6.0f, 1500, 0.3f, 0.8f, 0xFF2080FFu);
+			if (owner.kind == SceneObstacle)
+			{
+				particles.Emit(contact, velocity, 3.0f, 60, 1.0f, 2.0f, 0xFF505050u);
+				damageObstacle(owner.handle, contact, 0.02f);
+			}
+			emitted = true;
+		}
+	}
+	frameArena.Rewind(marker);
+
+	if (emitted && !effectsTimerRunning)
+	{
+		effectsTimerRunning = true;
+		lastEffectsTime = glutGet(GLUT_ELAPSED_TIME);
+		glutTimerFunc(16, effectsHandler, 0);
+	}
+}
+
+// Wear an obstacle down, bigger cubes last longer. At 0 health it shatters into debris.
+void damageObstacle(PoolHandle cubeHandle, const float contact[3], float damage)
+{
+	CubeMesh *cube = cubePool.Get(cubeHandle);
+	if (!cube)
+		return;		// already broken by an earlier box this tick
+
+	cube->health -= damage / cube->sfy;
+	if (cube->health > 0.0f)
+		return;
+
+	DebrisMaterial material;
+	for (int k = 0; k < 4; k++)
+	{
+		material.ambient[k] = cube->mat_ambient[k];
+		material.specular[k] = cube->mat_specular[k];
+		material.diffuse[k] = cube->mat_diffuse[k];
+	}
+	material.shininess[0] = cube->mat_shininess[0];
+
+	float center[3] = { cube->tx, cube->ty, cube->tz };
+	float scale[3] = { cube->sfx, cube->sfy, cube->sfz };
+	debris.Shatter(center, scale, cube->angle, contact, 15.0f, material);
+
+	if (selectedCube == cubeHandle)
+		selectedCube = PoolHandle();
+	NavFootprint footprint;
+	if (obstacleFootprint(*cube, footprint))
+		navGrid.RemoveBlocker(footprint);
+	cubePool.Destroy(cubeHandle);
+	sceneBvhDirty = true;
+}
+
+// Rebuild the static layer after surfaces or obstacles changed. The robot layer is
+// rebuilt when robots come or go, otherwise refit for the robots that moved.
+void updateSceneBvh()
+{
+	if (sceneBvhDirty)
+	{
+		gatherStaticBoxes();
+		staticScene.bvh.Build(staticScene.boxes.data(), (int)staticScene.boxes.size());
+		sceneBvhDirty = false;
+	}
+
+	size_t count = robotScene.boxes.size();
+	gatherRobotBoxes();
+	if (robotScene.boxes.size() != count)
+		robotScene.bvh.Build(robotScene.boxes.data(), (int)robotScene.boxes.size());
+	else
+		robotScene.bvh.Refit(robotScene.boxes.data());
+}
+
+// Cast a ray through the pixel, in whichever view it falls, and select the obstacle it hits first
+void pickObstacle(int x, int y)
+{
+	GLdouble winY = windowHeight - y;
+	int view = 0;
+	while (view < (int)views.size() && !views[view].camera.ContainsPixel(x, (int)winY))
+		view++;
+	if (view == (int)views.size())
+		return;
+
+	const Camera &camera = views[view].camera;
+	GLdouble modelview[16], projection[16];
+	GLint viewport[4];
+	for (int i = 0; i < 16; i++)
+	{
+		modelview[i] = camera.modelview.m[i];
+		projection[i] = camera.projection.m[i];
+	}
+	camera.GetPixelViewport(viewport);
+
+	GLdouble nearPoint[3], farPoint[3];
+	if (!gluUnProject(x, winY, 0.0, modelview, projection, viewport, &nearPoint[0], &nearPoint[1], &nearPoint[2])
+		|| !gluUnProject(x, winY, 1.0, modelview, projection, viewport, &farPoint[0], &farPoint[1], &farPoint[2]))
+		return;
+
+	BvhRay ray;
+	for (int k = 0; k < 3; k++)
+	{
+		ray.origin[k] = (float)nearPoint[k];
+		ray.dir[k] = (float)(farPoint[k] - nearPoint[k]);
+	}
+	ray.tMax = 1.0f;
+
+	CubeMesh *previous = cubePool.Get(selectedCube);
+	if (previous)
+		previous->selected = false;
+	selectedCube = PoolHandle();
+
+	// A robot in front of the obstacle takes the click
+	BvhHit hit;
+	if (!staticScene.bvh.Raycast(ray, hit) || staticScene.owners[hit.primitive].kind != SceneObstacle)
+		return;
+	ray.tMax = hit.t;
+	if (robotScene.bvh.Occluded(ray))
+		return;
+	selectedCube = staticScene.owners[hit.primitive].handle;
+	cubePool.Get(selectedCube)->selected = true;
+}
+
+// Tile count views over the window: the main camera, then a follow camera per robot,
+// an overhead view, and fixed cameras at the arena corners for the rest
+void setupViews(int count)
+{
+	if (count < 1)
+		count = 1;
+	if (count > BvhMaxFrustums)
+		count = BvhMaxFrustums;
+
+	int columns = 1;
+	while (columns * columns < count)
+		columns++;
+	int rows = (count + columns - 1) / columns;
+
+	views.clear();
+	views.resize(count);
+	uint32_t nextRobot = 0;
+	int nextCorner = 0;
+	for (int i = 0; i < count; i++)
+	{
+		SpectatorView &view = views[i];
+		Camera &camera = view.camera;
+
+		// Row 0 at the top of the window
+		int column = i % columns, row = i / columns;
+		camera.SetViewport((float)column / columns, 1.0f - (float)(row + 1) / rows, 1.0f / columns, 1.0f / rows);
+
+		if (i == 0)
+		{
+			// Set up the camera at position (0, 20, 40) looking at the origin
+			camera.mode = CameraFixed;
+			camera.SetLookAt(0.0f, 20.0f, 40.0f, 0.0f, 0.0f, 0.0f);
+		}
+		else if (nextRobot < robotPool.GetLiveCount())
+		{
+			camera.mode = CameraFollow;
+			view.robot = robotPool.GetLiveHandle(nextRobot++);
+		}
+		else if (nextCorner == 0)
+		{
+			camera.mode = CameraOverhead;
+			camera.SetLookAt(0.0f, 140.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+			camera.SetPerspective(80.0f, 1.0f, 200.0f);
+			nextCorner++;
+		}
+		else
+		{
+			float sx = (nextCorner & 1) ? 1.0f : -1.0f;
+			float sz = (nextCorner & 2) ? 1.0f : -1.0f;
+			camera.mode = CameraFixed;
+			camera.SetLookAt(70.0f * sx, 25.0f, 70.0f * sz, 0.0f, 0.0f, 0.0f);
+			camera.SetPerspective(60.0f, 0.2f, 250.0f);
+			nextCorner = nextCorner % 4 + 1;
+		}
+	}
+}
+
+
+// Host on a port or join host:port, with the link simulator on our outgoing packets
+void startNetwork(NetMode mode, const char *address, uint32_t latencyMs, uint32_t jitterMs, float lossRate)
+{
+	if (!InitNetworking())
+	{
+		printf("Could not start networking\n");
+		return;
+	}
+
+	if (mode == NetHost)
+	{
+		uint16_t port = address ? (uint16_t)atoi(address) : DefaultNetPort;
+		if (!netServer.Start(port))
+		{
+			printf("Could not open UDP port %u\n", port);
+			return;
+		}
+		netServer.link.Configure(latencyMs, jitterMs, lossRate);
+		netRobots[netServer.GetLocalRobot()] = playerRobot.GetHandle();
+		printf("Hosting on UDP port %u\n", port);
+	}
+	else
+	{
+		NetAddress server;
+		if (!ParseNetAddress(address, server) || !netClient.Connect(server))
+		{
+			printf("Could not connect to %s\n", address);
+			return;
+		}
+		netClient.link.Configure(latencyMs, jitterMs, lossRate);
+		printf("Connecting to %s\n", address);
+	}
+
+	netMode = mode;
+	atexit(stopNetwork);
+	glutTimerFunc(10, netHandler, 0);
+}
+
+// Closing the window exits the process, tell the server we are gone rather than time out
+void stopNetwork()
+{
+	netClient.Disconnect();
+	netServer.Stop();
+	ShutdownNetworking();
+}
+
+void toggleCapture()
+{
+	if (frameCapture.IsCapturing())
+	{
+		frameCapture.Stop();
+		return;
+	}
+
+	std::string error;
+	if (!frameCapture.Start(capturePath, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT), 60, error))
+	{
+		printf("Could not start capture: %s\n", error.c_str());
+		return;
+	}
+	printf("Recording to %s, press c to stop\n", capturePath);
 
-	// Set up wall quad mesh
-	VECTOR3D wallOrigin = VECTOR3D(-100.0f, 0.0f, -60.0f);
-	VECTOR3D wallDir1v = VECTOR3D(1.0f, 0.0f, 0.0f);
-	VECTOR3D wallDir2v = VECTOR3D(0.0f, 1.0f, 0.0f);
-	wallMesh = new QuadMesh(meshSize, 200.0);
-	wallMesh->InitMesh(meshSize, wallOrigin, 200.0, 200.0, wallDir1v, wallDir2v);
-	VECTOR3D wallAmbient = VECTOR3D(0.6f, 0.0f, 0.0f);
-	VECTOR3D wallDiffuse = VECTOR3D(0.3f, 0.3f, 0.3f);
-	VECTOR3D wallSpecular = VECTOR3D(0.04f, 0.04f, 0.04f);
-	float wallShininess = 0.05;
-	wallMesh->SetMaterial(wallAmbient, wallDiffuse, wallSpecular, wallShininess);
+	static bool stopRegistered = false;
+	if (!stopRegistered)
+	{
+		atexit(stopCapture);
+		stopRegistered = true;
+	}
+}
+
+// Closing the window destroys the GL context and then exits the process. The frames
+// still on the GPU are read back here, while the context is current.
+void windowClosed()
+{
+	frameCapture.Stop();
+}
+
+// Any other way out: no GL by now, finish the file so it stays playable
+void stopCapture()
+{
+	frameCapture.Finish();
+}
+
+// Copy the network's robots into robotPool, creating and destroying them as they come and go
+void syncNetRobots()
+{
+	uint32_t nowMs = NetTimeMs();
+	int localRobot = netMode == NetHost ? netServer.GetLocalRobot() : netClient.GetLocalRobot();
+	bool spinning = false;
+
+	for (int id = 0; id < MaxNetRobots; id++)
+	{
+		Robot state;
+		Robot *robot = robotPool.Get(netRobots[id]);
+		if (robot)
+			state.spinnerAngle = robot->spinnerAngle;
+
+		bool inGame;
+		if (netMode == NetHost)
+		{
+			const Robot *serverRobot = netServer.GetRobot(id);
+			inGame = serverRobot != NULL;
+			if (inGame)
+			{
+				float spinnerAngle = state.spinnerAngle;
+				state = *serverRobot;
+				state.spinnerAngle = spinnerAngle;
+			}
+		}
+		else
+			inGame = netClient.GetRobot(id, nowMs, state);
+
+		if (!inGame)
+		{
+			if (robot && netRobots[id] != playerRobot.GetHandle())
+				robotPool.Destroy(netRobots[id]);
+			netRobots[id] = PoolHandle();
+			continue;
+		}
+
+		if (!robot)
+		{
+			// Until the server says which robot is ours, the player robot stands in for none
+			netRobots[id] = id == localRobot ? playerRobot.GetHandle() : robotPool.Create();
+			robot = robotPool.Get(netRobots[id]);
+			if (!robot)
+				continue;
+		}
+
+		// The spinner angle is local animation, everything else comes from the network
+		state.spinnerAngle = robot->spinnerAngle;
+		*robot = state;
+		spinning = spinning || robot->spinnerOn;
+	}
+
+	if (spinning)
+		startAnimation();
+}
+
+// Route a driver input to wherever the player's robot lives
+void issueCommand(int turn, int move, bool toggleSpinner)
+{
+	RobotCommand command;
+	command.sequence = 0;
+	command.turn = (int8_t)turn;
+	command.move = (int8_t)move;
+	command.toggleSpinner = toggleSpinner ? 1 : 0;
+
+	if (netMode == NetJoin)
+		netClient.SendCommand(command);
+	else if (netMode == NetHost)
+		netServer.ApplyLocalCommand(command);
+	else
+		ApplyRobotCommand(*playerRobot, command);
+
+	if (netMode != NetOffline)
+		syncNetRobots();
+	if (playerRobot->spinnerOn)
+		startAnimation();
+}
 
+void startAnimation()
+{
+	if (!animationRunning)
+	{
+		animationRunning = true;
+		glutTimerFunc(10, animationHandler, 0);
+	}
 }
 
 
@@ -192,76 +1248,186 @@ void initOpenGL(int w, int h)
 // or glutPostRedisplay() has been called.
 void display(void)
 {
+	// Upload at most one finished model per frame to keep the frame time flat
+	modelLoader.PumpUploads(1);
+
+	glViewport(0, 0, windowWidth, windowHeight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glLoadIdentity();
-	// Create Viewing Matrix V
-	// Set up the camera at position (0, 20, 40) looking at the origin, up along positive y axis
-	gluLookAt(0.0, 20.0, 40.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+	// Scene preparation shared by all views: boxes, BVH refit and cameras
+	updateSceneBvh();
+
+	// The arena is empty here, so it is grown to fit the frame before anything is taken
+	int numViews = (int)views.size();
+	size_t numBoxes = staticScene.boxes.size() + robotScene.boxes.size();
+	size_t frameBytes = numViews * sizeof(BvhFrustum) + numBoxes * (sizeof(uint32_t) + sizeof(VisibleItem)) + 256;
+	if (frameBytes > frameArena.GetCapacity())
+		frameArena.Reserve(frameBytes + frameBytes / 2);
+	FrameAllocator<char> frameAllocator(frameArena);
+	FrameVector<BvhFrustum> frustums(numViews, BvhFrustum(), frameAllocator);
+	FrameVector<uint32_t> boxMasks(numBoxes, 0, frameAllocator);
+	FrameVector<VisibleItem> items(frameAllocator);
+	items.reserve(numBoxes);
+
+	for (int v = 0; v < numViews; v++)
+	{
+		SpectatorView &view = views[v];
+		Robot *robot = robotPool.Get(view.robot);
+		if (view.camera.mode == CameraFollow && robot)
+			view.camera.Follow(robot->x, robot->z, robot->angle);
+		view.camera.Update(windowWidth, windowHeight);
+		frustums[v] = view.camera.frustum;
+	}
 
-	// Draw Robot
-	// Current transformation matrix is set to IV, where I is identity matrix
-	// CTM = IV
-	drawRobot();
+	// One walk of each BVH culls for every view, then boxes are merged into drawables.
+	// Boxes of one owner are adjacent, the ground chunks and the wall share one drawable.
+	staticScene.bvh.CullFrustums(frustums.data(), numViews, boxMasks.data());
+	robotScene.bvh.CullFrustums(frustums.data(), numViews, boxMasks.data() + staticScene.boxes.size());
 
-	// Drawing a closed cube mesh
-	glPushMatrix();
+	const uint32_t *layerMasks = boxMasks.data();
+	const SceneLayer *layers[2] = { &staticScene, &robotScene };
+	for (const SceneLayer *layer : layers)
+	{
+		for (size_t i = 0; i < layer->owners.size(); i++)
+		{
+			SceneBoxKind kind = layer->owners[i].kind == SceneWall ? SceneGround : layer->owners[i].kind;
+			PoolHandle handle = layer->owners[i].handle;
+			if (!items.empty() && items.back().kind == kind && items.back().handle == handle)
+			{
+				items.back().viewMask |= layerMasks[i];
+				continue;
+			}
+			VisibleItem item = { kind, handle, layerMasks[i] };
+			items.push_back(item);
+		}
+		layerMasks += layer->owners.size();
+	}
 
-	glTranslatef(-12.0, -1.0, 7.0);
-	glScalef(2.0f, 2.0f, 2.0f);
-	drawCubeMesh(cubeMesh);
+	particles.PrepareDraw();
+	debris.PrepareDraw();
 
-	glPopMatrix();
+	for (int v = 0; v < numViews; v++)
+		drawView(v, items.data(), (int)items.size());
 
-	glPushMatrix();
-	glTranslatef(25.0, 1.5, -17.0);
-	glScalef(4.0f, 4.0f, 4.0f);
-	drawCubeMesh(cubeMesh);
+	frameCapture.CaptureFrame();
+	glutSwapBuffers();   // Double buffering, swap buffers
 
-	glPopMatrix();
+	// Per-frame data is dead once the frame is submitted. An arena that ran out this
+	// frame is doubled for the next.
+	frameArena.Reset();
+	if (frameArena.GetOverflowCount() != reportedArenaOverflows)
+	{
+		reportedArenaOverflows = frameArena.GetOverflowCount();
+		printf("Frame arena exhausted (%u overflows, peak %u bytes of %u), growing it\n", reportedArenaOverflows,
+			(unsigned int)frameArena.GetPeak(), (unsigned int)frameArena.GetCapacity());
+		frameArena.Reserve(2 * frameArena.GetCapacity());
+	}
+}
 
-	glPopMatrix();
+// Draw the items visible in one view
+void drawView(int view, const VisibleItem *items, int numItems)
+{
+	const Camera &camera = views[view].camera;
+	int viewport[4];
+	camera.GetPixelViewport(viewport);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
-	glPushMatrix();
-	glTranslatef(25.0, 7.5, -17.0);
-	glScalef(2.0f, 2.0f, 2.0f);
-	drawCubeMesh(cubeMesh);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(camera.projection.m);
+	glMatrixMode(GL_MODELVIEW);
 
-	glPopMatrix();
-	
-	// Draw ground
-	glPushMatrix();
+	// Create Viewing Matrix V
+	// Current transformation matrix is set to IV, where I is identity matrix
+	// CTM = IV
+	glLoadMatrixf(camera.modelview.m);
+	modelStack.LoadMatrix(camera.modelview.m);
 
-	glTranslatef(0.0, -2.5, 0.0);
-	groundMesh->DrawMesh(meshSize);
-	wallMesh->DrawMesh(meshSize);
+	uint32_t bit = 1u << view;
+	bool groundVisible = false;
+	for (int i = 0; i < numItems; i++)
+	{
+		if (!(items[i].viewMask & bit))
+			continue;
 
-	glPopMatrix();
+		switch (items[i].kind)
+		{
+		case SceneRobotPart:
+		{
+			Robot &robot = *robotPool.Get(items[i].handle);
+			float dx = robot.x - camera.eye[0], dy = camera.eye[1], dz = robot.z - camera.eye[2];
+			float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+			robotLodLevel = 0;
+			for (float limit = robotLodDistance; distance > limit; limit *= 2.0f)
+				robotLodLevel++;
+			drawRobot(robot);
+			break;
+		}
+		case SceneObstacle:
+			// Each cube carries its own transform
+			drawCubeMesh(cubePool.Get(items[i].handle));
+			break;
+		default:
+			groundVisible = true;
+			break;
+		}
+	}
 
-	glutSwapBuffers();   // Double buffering, swap buffers
+	// Draw ground and walls
+	if (groundVisible)
+	{
+		for (size_t s = 0; s < surfaceMeshes.size(); s++)
+			surfaceMeshes[s].mesh->DrawMesh(surfaceMeshes[s].surface.meshSize);
+	}
+
+	debris.Draw();
+	particles.Draw(3.0f);
 }
 
-void drawRobot()
+// The robot's transforms are built on modelStack, which drawView() starts with the
+// view matrix; every draw loads the top into GL and the view is loaded back at the end
+void drawRobot(Robot &robot)
 {
-	glPushMatrix();
+	modelStack.Push();
 
-	forwards.SetX(sin((PI / 180) * robotAngle));
-	forwards.SetZ(cos((PI / 180) * robotAngle));
+	modelStack.Translate(robot.x, 0, robot.z);
+	modelStack.Rotate(robot.angle, 0.0, 1.0, 0.0);
 
-	glTranslatef(robotX, 0, robotZ);
-	glRotatef(robotAngle, 0.0, 1.0, 0.0);
+	if (modelLoader.GetState(robotModel) == ModelReady)
+	{
+		// Fit the model's footprint to the robot body, centred on the robot
+		float boundsMin[3], boundsMax[3];
+		modelLoader.GetBounds(robotModel, boundsMin, boundsMax);
+		float extent = fmaxf(boundsMax[0] - boundsMin[0], boundsMax[2] - boundsMin[2]);
+		float scale = extent > 0.0f ? robotBodyWidth / extent : 1.0f;
+
+		glMaterialfv(GL_FRONT, GL_AMBIENT, robotBody_mat_ambient);
+		glMaterialfv(GL_FRONT, GL_SPECULAR, robotBody_mat_specular);
+		glMaterialfv(GL_FRONT, GL_DIFFUSE, robotBody_mat_diffuse);
+		glMaterialfv(GL_FRONT, GL_SHININESS, robotBody_mat_shininess);
+
+		modelStack.Scale(scale, scale, scale);
+		modelStack.Translate(-0.5f * (boundsMin[0] + boundsMax[0]), -0.5f * (boundsMin[1] + boundsMax[1]),
+			-0.5f * (boundsMin[2] + boundsMax[2]));
+		loadModelMatrix();
+		modelLoader.Draw(robotModel);
+
+		modelStack.Pop();
+		loadModelMatrix();
+		return;
+	}
 	
 	drawBody();
 	drawTopBody();
 	drawBottomBody();
-	drawLeftWheel();
-	drawRightWheel();
-	drawSpinner();
+	drawLeftWheel(robot.leftWheelAngle);
+	drawRightWheel(robot.rightWheelAngle);
+	drawSpinner(robot.spinnerAngle);
 	drawTopTriangle();
 	drawBottomTriangle();
-	drawCylinder();
+	drawCylinder(robot.spinnerAngle);
 
-	glPopMatrix();
+	modelStack.Pop();
+	loadModelMatrix();
 }
 
 
@@ -272,10 +1438,10 @@ void drawBody()
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotBody_mat_shininess);
 
-	glPushMatrix();
-	glScalef(robotBodyWidth, robotBodyLength, robotBodyDepth);
-	glutSolidCube(1.0);
-	glPopMatrix();
+	modelStack.Push();
+	modelStack.Scale(robotBodyWidth, robotBodyLength, robotBodyDepth);
+	drawSolidCube();
+	modelStack.Pop();
 }
 
 void drawTopBody()
@@ -286,18 +1452,18 @@ void drawTopBody()
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotTopBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotTopBody_mat_shininess);
 
-	glPushMatrix();
+	modelStack.Push();
 	// Position head with respect to parent (body)
-	glTranslatef(0, 0.5*robotBodyLength + 0.5*topBodyLength, 0); // this will be done last
+	modelStack.Translate(0, 0.5*robotBodyLength + 0.5*topBodyLength, 0); // this will be done last
 
 	// Build Head
-	glPushMatrix();
-	//glScalef(0.4*robotBodyWidth, 0.4*robotBodyWidth, 0.4*robotBodyWidth);
-	glScalef(robotBodyWidth, topBodyLength, robotBodyDepth);
-	glutSolidCube(1.0);
-	glPopMatrix();
+	modelStack.Push();
+	//modelStack.Scale(0.4*robotBodyWidth, 0.4*robotBodyWidth, 0.4*robotBodyWidth);
+	modelStack.Scale(robotBodyWidth, topBodyLength, robotBodyDepth);
+	drawSolidCube();
+	modelStack.Pop();
 
-	glPopMatrix();
+	modelStack.Pop();
 }
 
 void drawBottomBody()
@@ -308,163 +1474,155 @@ void drawBottomBody()
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotTopBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotTopBody_mat_shininess);
 
-	glPushMatrix();
+	modelStack.Push();
 	// Position head with respect to parent (body)
-	glTranslatef(0, -0.5*robotBodyLength - 0.5*topBodyLength, 0); // this will be done last
+	modelStack.Translate(0, -0.5*robotBodyLength - 0.5*topBodyLength, 0); // this will be done last
 
 	// Build Head
-	glPushMatrix();
-	//glScalef(0.4*robotBodyWidth, 0.4*robotBodyWidth, 0.4*robotBodyWidth);
-	glScalef(robotBodyWidth, topBodyLength, robotBodyDepth);
-	glutSolidCube(1.0);
-	glPopMatrix();
+	modelStack.Push();
+	//modelStack.Scale(0.4*robotBodyWidth, 0.4*robotBodyWidth, 0.4*robotBodyWidth);
+	modelStack.Scale(robotBodyWidth, topBodyLength, robotBodyDepth);
+	drawSolidCube();
+	modelStack.Pop();
 
-	glPopMatrix();
+	modelStack.Pop();
 }
 
-void drawLeftWheel()
+void drawLeftWheel(float wheelAngle)
 {
 	glMaterialfv(GL_FRONT, GL_AMBIENT, robotWheel_mat_ambient);
 	glMaterialfv(GL_FRONT, GL_SPECULAR, robotWheel_mat_specular);
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotWheel_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotWheel_mat_shininess);
 
-	GLUquadricObj *myCylinder;
-	myCylinder = gluNewQuadric();
-	gluQuadricDrawStyle(myCylinder, GLU_FILL);
-
-	GLUquadricObj *myDisk;
-	myDisk = gluNewQuadric();
-	gluQuadricDrawStyle(myDisk, GLU_FILL);
-
-	glPushMatrix();
-	glRotatef(leftWheelAngle, 1, 0, 0);
+	modelStack.Push();
+	modelStack.Rotate(wheelAngle, 1, 0, 0);
 
 	//Rotate wheel to be perpendicular to robot body
-	glPushMatrix();
-	glTranslatef(0.5*robotBodyWidth + 0.5*wheelLength, 0, 0.0);
-	glRotatef(90, 0.0, 1.0, 0.0);
-	glTranslatef(-0.5*robotBodyWidth - 0.5*wheelLength, 0, 0.0);
+	modelStack.Push();
+	modelStack.Translate(0.5*robotBodyWidth + 0.5*wheelLength, 0, 0.0);
+	modelStack.Rotate(90, 0.0, 1.0, 0.0);
+	modelStack.Translate(-0.5*robotBodyWidth - 0.5*wheelLength, 0, 0.0);
 	
 	//Position arm with respect to parent body
-	glPushMatrix();
-	glTranslatef(0.5*robotBodyWidth + 0.5*wheelLength, 0.0, -0.5*wheelLength);
+	modelStack.Push();
+	modelStack.Translate(0.5*robotBodyWidth + 0.5*wheelLength, 0.0, -0.5*wheelLength);
 	
 	//Create cylinder and scale the cylinder
-	glPushMatrix();
-	glScalef(wheelLength, wheelLength, 0.7*wheelLength);
-	gluCylinder(myCylinder, 1, 1, 1, 100, 100);
+	modelStack.Push();
+	modelStack.Scale(wheelLength, wheelLength, 0.7*wheelLength);
+	loadModelMatrix();
+	drawRobotPart(wheelCylinderLods, wheelCylinder.View());
 	
 	//Create disk for wheel
-	glPushMatrix();
-	glTranslatef(0, 0, 0.4*wheelLength);
-	gluDisk(myDisk, 0, 1, 100, 100);
+	modelStack.Push();
+	modelStack.Translate(0, 0, 0.4*wheelLength);
+	loadModelMatrix();
+	drawRobotPart(wheelDiskLods, wheelDisk.View());
 
-	glPushMatrix();
+	modelStack.Push();
 	glMaterialfv(GL_FRONT, GL_AMBIENT, robotTopBody_mat_ambient);
 	glMaterialfv(GL_FRONT, GL_SPECULAR, robotTopBody_mat_specular);
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotTopBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotTopBody_mat_shininess);
-	glScalef(1.7*(1 / wheelLength), 1.7*(1 / wheelLength), 1 / (0.8*wheelLength));
-	glutSolidCube(1);
-
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
+	modelStack.Scale(1.7*(1 / wheelLength), 1.7*(1 / wheelLength), 1 / (0.8*wheelLength));
+	drawSolidCube();
+
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
 }
 
-void drawRightWheel()
+void drawRightWheel(float wheelAngle)
 {
 	glMaterialfv(GL_FRONT, GL_AMBIENT, robotWheel_mat_ambient);
 	glMaterialfv(GL_FRONT, GL_SPECULAR, robotWheel_mat_specular);
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotWheel_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotWheel_mat_shininess);
 
-	GLUquadricObj *myCylinder;
-	myCylinder = gluNewQuadric();
-	gluQuadricDrawStyle(myCylinder, GLU_FILL);
-
-	GLUquadricObj *myDisk;
-	myDisk = gluNewQuadric();
-	gluQuadricDrawStyle(myDisk, GLU_FILL);
-
-	glPushMatrix();
-	glRotatef(rightWheelAngle, 1, 0, 0);
+	modelStack.Push();
+	modelStack.Rotate(wheelAngle, 1, 0, 0);
 
 	//Rotate wheel to be perpendicular to robot body
-	glPushMatrix();
-	glTranslatef(-0.5*robotBodyWidth - 0.5*wheelLength, 0, 0.0);
-	glRotatef(-90, 0.0, 1.0, 0.0);
-	glTranslatef(0.5*robotBodyWidth + 0.5*wheelLength, 0, 0.0);
+	modelStack.Push();
+	modelStack.Translate(-0.5*robotBodyWidth - 0.5*wheelLength, 0, 0.0);
+	modelStack.Rotate(-90, 0.0, 1.0, 0.0);
+	modelStack.Translate(0.5*robotBodyWidth + 0.5*wheelLength, 0, 0.0);
 
 	//Position arm with respect to parent body
-	glPushMatrix();
-	glTranslatef(-0.5*robotBodyWidth - 0.5*wheelLength, 0.0, -0.5*wheelLength);
+	modelStack.Push();
+	modelStack.Translate(-0.5*robotBodyWidth - 0.5*wheelLength, 0.0, -0.5*wheelLength);
 
 	//Create cylinder and scale the cylinder
-	glPushMatrix();
-	glScalef(wheelLength, wheelLength, 0.7*wheelLength);
-	gluCylinder(myCylinder, 1, 1, 1, 100, 100);
+	modelStack.Push();
+	modelStack.Scale(wheelLength, wheelLength, 0.7*wheelLength);
+	loadModelMatrix();
+	drawRobotPart(wheelCylinderLods, wheelCylinder.View());
 
 	//Create disk for wheel
-	glPushMatrix();
-	glTranslatef(0, 0, 0.4*wheelLength);
-	gluDisk(myDisk, 0, 1, 100, 100);
+	modelStack.Push();
+	modelStack.Translate(0, 0, 0.4*wheelLength);
+	loadModelMatrix();
+	drawRobotPart(wheelDiskLods, wheelDisk.View());
 
-	glPushMatrix();
+	modelStack.Push();
 	glMaterialfv(GL_FRONT, GL_AMBIENT, robotTopBody_mat_ambient);
 	glMaterialfv(GL_FRONT, GL_SPECULAR, robotTopBody_mat_specular);
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotTopBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotTopBody_mat_shininess);
-	glScalef(1.7*(1/wheelLength), 1.7*(1/wheelLength), 1/(0.8*wheelLength));
-	glutSolidCube(1);
+	modelStack.Scale(1.7*(1/wheelLength), 1.7*(1/wheelLength), 1/(0.8*wheelLength));
+	drawSolidCube();
 	
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
 }
 
-void drawSpinner()
+// The level robotLodLevel asks for, or the full primitive until the levels are built
+void drawRobotPart(const MeshLods &lods, const PrimitiveView &primitive)
+{
+	int level = robotLodLevel < lods.GetLevelCount() ? robotLodLevel : lods.GetLevelCount() - 1;
+	if (level > 0)
+		DrawMeshLevel(lods.GetLevel(level));
+	else
+		DrawPrimitive(primitive);
+}
+
+void drawSpinner(float spinnerAngle)
 {
 	glMaterialfv(GL_FRONT, GL_AMBIENT, robotSpinner_mat_ambient);
 	glMaterialfv(GL_FRONT, GL_SPECULAR, robotSpinner_mat_specular);
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotSpinner_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotSpinner_mat_shininess);
 
-	GLUquadricObj *myCylinder;
-	myCylinder = gluNewQuadric();
-	gluQuadricDrawStyle(myCylinder, GLU_FILL);
-
-	GLUquadricObj *myDisk;
-	myDisk = gluNewQuadric();
-	gluQuadricDrawStyle(myDisk, GLU_FILL);
-
 	//Create cylinder and scale
-	glPushMatrix();
-
-	glTranslatef(0, 0.5, 8);
-	glRotatef(spinnerAngle, 0.0, 1.0, 0.0);
-	glTranslatef(0, -0.5, -8);
-	glTranslatef(0, 0.5, 8);
-	glRotatef(90, 1.0, 0.0, 0.0);
-	glTranslatef(0, -0.5, -8);
-	glTranslatef(0, 0.5, 8);
-	glScalef(spinnerLength, spinnerLength, 0.2*spinnerLength);
-	gluCylinder(myCylinder, 1, 1, 1, 20, 20);
+	modelStack.Push();
+
+	modelStack.Translate(0, 0.5, 8);
+	modelStack.Rotate(spinnerAngle, 0.0, 1.0, 0.0);
+	modelStack.Translate(0, -0.5, -8);
+	modelStack.Translate(0, 0.5, 8);
+	modelStack.Rotate(90, 1.0, 0.0, 0.0);
+	modelStack.Translate(0, -0.5, -8);
+	modelStack.Translate(0, 0.5, 8);
+	modelStack.Scale(spinnerLength, spinnerLength, 0.2*spinnerLength);
+	loadModelMatrix();
+	DrawPrimitive(spinnerCylinder.View());
 
 	//Draw top disk of spinner
-	glPushMatrix();
-	glRotatef(180, 1.0, 0.0, 0.0);
-	gluDisk(myDisk, 0, 1, 20, 20);
+	modelStack.Push();
+	modelStack.Rotate(180, 1.0, 0.0, 0.0);
+	loadModelMatrix();
+	DrawPrimitive(spinnerDisk.View());
 	
-	glPopMatrix();
-	glPopMatrix();
+	modelStack.Pop();
+	modelStack.Pop();
 }
 
 void drawTopTriangle()
@@ -474,37 +1632,14 @@ void drawTopTriangle()
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotTopBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotTopBody_mat_shininess);
 
-	glPushMatrix();
-	glTranslatef(0, 0.5*robotBodyLength + topBodyLength, 0.5*robotBodyDepth);
-
-	glScalef(0.5*robotBodyWidth, 10, 8);
-	//Top piece
-	glBegin(GL_TRIANGLES);
-		glNormal3f(0, 1, 0);
-		glVertex3f(1, 0, 0);
-		glNormal3f(0, 1, 0);
-		glVertex3f(-1, 0, 0);
-		glNormal3f(0, 1, 0);
-		glVertex3f(0, 0, 1);
-
-		glVertex3f(0, 0, 1);
-		glVertex3f(0, -0.03, 1);
-		glVertex3f(-1, 0, 0);
-
-		glVertex3f(-1, -0.03, 0);
-		glVertex3f(-1, 0, 0);
-		glVertex3f(0, -0.03, 1);
-
-		glVertex3f(0, 0, 1);
-		glVertex3f(0, -0.03, 1);
-		glVertex3f(1, 0, 0);
-
-		glVertex3f(1, -0.03, 0);
-		glVertex3f(1, 0, 0);
-		glVertex3f(0, -0.03, 1);
-	glEnd();
+	modelStack.Push();
+	modelStack.Translate(0, 0.5*robotBodyLength + topBodyLength, 0.5*robotBodyDepth);
+
+	modelStack.Scale(0.5*robotBodyWidth, 10, 8);
+	loadModelMatrix();
+	DrawPrimitive(trianglePiece.View());
 	
-	glPopMatrix();
+	modelStack.Pop();
 }
 
 void drawBottomTriangle()
@@ -514,115 +1649,117 @@ void drawBottomTriangle()
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotTopBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotTopBody_mat_shininess);
 
-	glPushMatrix();
-	glTranslatef(0, -0.5*robotBodyLength, 0.5*robotBodyDepth);
-
-	glScalef(0.5*robotBodyWidth, 10, 8);
-	//Top piece
-	glBegin(GL_TRIANGLES);
-	glNormal3f(0, 1, 0);
-	glVertex3f(1, 0, 0);
-	glNormal3f(0, 1, 0);
-	glVertex3f(-1, 0, 0);
-	glNormal3f(0, 1, 0);
-	glVertex3f(0, 0, 1);
-
-	glVertex3f(0, 0, 1);
-	glVertex3f(0, -0.03, 1);
-	glVertex3f(-1, 0, 0);
-
-	glVertex3f(-1, -0.03, 0);
-	glVertex3f(-1, 0, 0);
-	glVertex3f(0, -0.03, 1);
+	modelStack.Push();
+	modelStack.Translate(0, -0.5*robotBodyLength, 0.5*robotBodyDepth);
 
-	glVertex3f(0, 0, 1);
-	glVertex3f(0, -0.03, 1);
-	glVertex3f(1, 0, 0);
+	modelStack.Scale(0.5*robotBodyWidth, 10, 8);
+	loadModelMatrix();
+	DrawPrimitive(trianglePiece.View());
 
-	glVertex3f(1, -0.03, 0);
-	glVertex3f(1, 0, 0);
-	glVertex3f(0, -0.03, 1);
-	glEnd();
-
-	glPopMatrix();
+	modelStack.Pop();
 }
 
-void drawCylinder() {
+void drawCylinder(float spinnerAngle) {
 	glMaterialfv(GL_FRONT, GL_AMBIENT, robotBody_mat_ambient);
 	glMaterialfv(GL_FRONT, GL_SPECULAR, robotBody_mat_specular);
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, robotBody_mat_diffuse);
 	glMaterialfv(GL_FRONT, GL_SHININESS, robotBody_mat_shininess);
 
-	GLUquadricObj *myCylinder;
-	myCylinder = gluNewQuadric();
-	gluQuadricDrawStyle(myCylinder, GLU_FILL);
-
-	GLUquadricObj *myDisk;
-	myDisk = gluNewQuadric();
-	gluQuadricDrawStyle(myDisk, GLU_FILL);
-
 	//Draw cylinder to hold spinner
-	glPushMatrix();
-
-	glTranslatef(0, -2, 8);
-	glRotatef(spinnerAngle, 0.0, 1.0, 0.0);
-	glTranslatef(0, 2, -8);
-	glTranslatef(0, -2, 8);
-	glScalef(0.5, 5, 0.5);
-	glTranslatef(0, 2, -8);
-	glTranslatef(0, -2, 8);
-	glRotatef(90, 0.0, 0.0, 1.0);
-	glRotatef(90, 0.0, 1.0, 0.0);
-	glTranslatef(0, 2, -8);
-	glTranslatef(0, -2, 8);
-	gluCylinder(myCylinder, 1, 1, 1, 15, 15);
+	modelStack.Push();
+
+	modelStack.Translate(0, -2, 8);
+	modelStack.Rotate(spinnerAngle, 0.0, 1.0, 0.0);
+	modelStack.Translate(0, 2, -8);
+	modelStack.Translate(0, -2, 8);
+	modelStack.Scale(0.5, 5, 0.5);
+	modelStack.Translate(0, 2, -8);
+	modelStack.Translate(0, -2, 8);
+	modelStack.Rotate(90, 0.0, 0.0, 1.0);
+	modelStack.Rotate(90, 0.0, 1.0, 0.0);
+	modelStack.Translate(0, 2, -8);
+	modelStack.Translate(0, -2, 8);
+	loadModelMatrix();
+	DrawPrimitive(postCylinder.View());
 
 	//Draw disk cap on spinner
-	glPushMatrix();
+	modelStack.Push();
 
-	glTranslatef(0, 0, 1);
-	gluDisk(myDisk, 0, 1, 100, 100);
+	modelStack.Translate(0, 0, 1);
+	loadModelMatrix();
+	drawRobotPart(wheelDiskLods, wheelDisk.View());
 
-	glPushMatrix();
+	modelStack.Push();
 
-	glTranslatef(0, 0, -0.5);
-	glScalef(10, 10, 0.1);
-	glutSolidCube(1);
+	modelStack.Translate(0, 0, -0.5);
+	modelStack.Scale(10, 10, 0.1);
+	drawSolidCube();
 
-	glPopMatrix();
-	glPopMatrix();
-	glPopMatrix();
+	modelStack.Pop();
+	modelStack.Pop();
+	modelStack.Pop();
 }
 
 
-// Callback, called at initialization and whenever user resizes the window.
-void reshape(int w, int h)
+// Unit cube, same as glutSolidCube(1.0) but from the compile-time cube primitive
+void drawSolidCube()
 {
-	// Set up viewport, projection, then change to modelview matrix mode - 
-	// display function will then set up camera and do modeling transforms.
-	glViewport(0, 0, (GLsizei)w, (GLsizei)h);
+	modelStack.Push();
+	modelStack.Scale(0.5f, 0.5f, 0.5f);
+	loadModelMatrix();
+	DrawPrimitive(cubePrimitive.View());
+	modelStack.Pop();
+}
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(60.0, (GLdouble)w / h, 0.2, 100.0);
+// Hands the CPU stack's current matrix to fixed-function GL
+void loadModelMatrix()
+{
+	glLoadMatrixf(modelStack.Top().m);
+}
 
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
 
-	// Set up the camera at position (0, 6, 22) looking at the origin, up along positive y axis
-	gluLookAt(0.0, 6.0, 22.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+// Callback, called at initialization and whenever user resizes the window.
+void reshape(int w, int h)
+{
+	// Viewports and projections are per view, the display function sets them up
+	// from the window size for every camera
+	windowWidth = w;
+	windowHeight = h > 0 ? h : 1;
 }
 
-bool spinnerStop = true;
-
 // Callback, handles input from the keyboard, non-arrow keys
 void keyboard(unsigned char key, int x, int y)
 {
 	switch (key)
 	{
 	case ' ':
-		glutTimerFunc(10, animationHandler, 0);
-		spinnerStop = !spinnerStop;
+		issueCommand(0, 0, true);
+		break;
+	case 'c':
+		toggleCapture();
+		break;
+	case 'a':
+		botsRunning = !botsRunning;
+		if (botsRunning && !botTimerRunning)
+		{
+			botTimerRunning = true;
+			glutTimerFunc(50, botHandler, 0);
+		}
+		if (botsRunning)
+			startDrive();
+		break;
+	case 'k':
+		reportVertexFormats();
+		break;
+	case 'i':
+		reportVertexCache();
+		break;
+	case 'l':
+		reportLods();
+		break;
+	case 'v':
+		// Cycle through 1, 2, 4 and 8 views
+		setupViews(views.size() >= 8 ? 1 : (int)views.size() * 2);
 		break;
 	}
 
@@ -632,15 +1769,354 @@ void keyboard(unsigned char key, int x, int y)
 
 void animationHandler(int param)
 {
-	if (!spinnerStop)
+	bool spinning = false;
+	for (uint32_t i = 0; i < robotPool.GetLiveCount(); i++)
+	{
+		PoolHandle handle = robotPool.GetLiveHandle(i);
+		Robot *robot = robotPool.Get(handle);
+		if (robot->spinnerOn)
+		{
+			robot->spinnerAngle += 5;
+			spinning = true;
+			emitSpinnerSparks(handle);
+		}
+	}
+
+	animationRunning = spinning;
+	if (spinning)
 	{
-		spinnerAngle += 5;
 		glutPostRedisplay();
 		glutTimerFunc(10, animationHandler, 0);
 	}
 }
 
 
+// Exchange packets, then show the robots as the network has them
+void netHandler(int param)
+{
+	uint32_t nowMs = NetTimeMs();
+	if (netMode == NetHost)
+	{
+		netServer.Update(nowMs);
+		if (netServer.GetClientCount() > 0 && nowMs - lastNetReportMs >= 5000)
+		{
+			printf("%d clients, %.0f bytes/s of snapshots per client\n", netServer.GetClientCount(),
+				netServer.GetBytesPerClientPerSecond());
+			lastNetReportMs = nowMs;
+		}
+	}
+	else
+		netClient.Update(nowMs);
+
+	syncNetRobots();
+	glutPostRedisplay();
+	glutTimerFunc(10, netHandler, 0);
+}
+
+
+
+// Step particles and debris in real time while any are moving
+void effectsHandler(int param)
+{
+	int now = glutGet(GLUT_ELAPSED_TIME);
+	float dt = 0.001f * (now - lastEffectsTime);
+	lastEffectsTime = now;
+	dt = dt < 0.1f ? dt : 0.1f;
+
+	particles.Update(dt, &jobSystem);
+	debris.Update(dt);
+	glutPostRedisplay();
+
+	effectsTimerRunning = particles.HasLiveParticles() || debris.HasAwakeChunks();
+	if (effectsTimerRunning)
+		glutTimerFunc(16, effectsHandler, 0);
+}
+
+
+// Spawned robots drive to the player's robot, asking for a path every tick and
+// leaving the grid's cache to make that cheap; a swarm samples one flow field
+// instead. They stop a couple of body widths short. The way they want to go is only
+// a preferred velocity, avoidance then picks velocities that keep every robot clear
+// of the others and of the player's, who does not take part and is avoided fully.
+void botHandler(int param)
+{
+	botTimerRunning = botsRunning;
+	if (!botsRunning)
+	{
+		// Let them roll to a stop
+		for (int i = 1; i < robotDrive.GetRobotCount(); i++)
+			robotDrive.SetDriveInput(i, 0.0f, 0.0f);
+		return;
+	}
+
+	const FlowField *field = NULL;
+	if (spawnedRobots.size() >= swarmSize)
+		field = flowFields.GetField(playerRobot->x, playerRobot->z, &jobSystem);
+
+	const float dt = 0.05f;
+	float maxSpeed = botAvoidanceSettings.maxSpeed;
+	size_t numBots = spawnedRobots.size();
+	botPaths.resize(numBots);
+	botAvoidance.SetAgentCount((int)numBots + 1);
+	for (size_t i = 0; i < numBots; i++)
+	{
+		Robot &robot = *spawnedRobots[i];
+		float dx = playerRobot->x - robot.x, dz = playerRobot->z - robot.z;
+		bool chasing = dx * dx + dz * dz >= 4.0f * robotBodyWidth * robotBodyWidth;
+		float dirX = 0.0f, dirZ = 0.0f;
+		if (chasing && field)
+		{
+			if (!field->Sample(robot.x, robot.z, dirX, dirZ))
+				dirX = dirZ = 0.0f;
+		}
+		else if (chasing)
+		{
+			NavPath &path = botPaths[i];
+			if (navGrid.FindPath(robot.x, robot.z, playerRobot->x, playerRobot->z, path))
+			{
+				float toX = path.points[2] - robot.x, toZ = path.points[3] - robot.z;
+				float length = sqrtf(toX * toX + toZ * toZ);
+				dirX = length > 0.0f ? toX / length : 0.0f;
+				dirZ = length > 0.0f ? toZ / length : 0.0f;
+			}
+		}
+		float speed = robotDrive.GetSpeed(1 + (int)i);
+		botAvoidance.SetAgent((int)i, robot.x, robot.z, robot.angle, speed * robot.forwards.GetX(),
+			speed * robot.forwards.GetZ(), dirX * maxSpeed, dirZ * maxSpeed);
+	}
+	float playerSpeed = netMode == NetOffline ? robotDrive.GetSpeed(0) : 0.0f;
+	botAvoidance.SetAgent((int)numBots, playerRobot->x, playerRobot->z, playerRobot->angle,
+		playerSpeed * playerRobot->forwards.GetX(), playerSpeed * playerRobot->forwards.GetZ(), 0.0f, 0.0f, false);
+	botAvoidance.Solve(dt, &jobSystem);
+
+	// Drive along the new velocity as well as turning and driving allow
+	for (size_t i = 0; i < numBots; i++)
+	{
+		Robot &robot = *spawnedRobots[i];
+		float velX, velZ;
+		botAvoidance.GetVelocity((int)i, velX, velZ);
+		float speed = sqrtf(velX * velX + velZ * velZ);
+		if (speed > 0.05f * maxSpeed)
+			steerBot(i, robot.x + velX, robot.z + velZ, fminf(1.0f, speed / maxSpeed));
+		else
+			robotDrive.SetDriveInput(1 + (int)i, 0.0f, 0.0f);
+	}
+	startDrive();
+
+	glutPostRedisplay();
+	glutTimerFunc(50, botHandler, 0);
+}
+
+
+// Set a bot's wheels to turn towards the target point, driving at the given fraction
+// of full speed once roughly facing it
+void steerBot(size_t bot, float targetX, float targetZ, float move)
+{
+	const Robot &robot = *spawnedRobots[bot];
+	float heading = atan2f(targetX - robot.x, targetZ - robot.z) * (float)(180.0 / PI);
+	float error = fmodf(heading - robot.angle, 360.0f);
+	error = error > 180.0f ? error - 360.0f : (error < -180.0f ? error + 360.0f : error);
+	float turn = fmaxf(-1.0f, fminf(1.0f, error / 20.0f));
+	robotDrive.SetDriveInput(1 + (int)bot, turn, fabsf(error) < 30.0f ? move : 0.0f);
+}
+
+
+// Every robot's wheels at rest, after the robots have been placed
+void resetRobotDrive()
+{
+	robotDrive.SetRobotCount(1 + (int)spawnedRobots.size());
+	if (playerRobot)
+		robotDrive.ReadRobot(0, *playerRobot, true);
+	for (size_t i = 0; i < spawnedRobots.size(); i++)
+		robotDrive.ReadRobot(1 + (int)i, *spawnedRobots[i], true);
+}
+
+// What each vertex format would save on the surface meshes and the robot parts. The
+// parts keep positions and normals apart, so they are interleaved for the report.
+void reportVertexFormats()
+{
+	char name[64];
+	for (size_t i = 0; i < surfaceMeshes.size(); i++)
+	{
+		const QuadMesh &mesh = *surfaceMeshes[i].mesh;
+		sprintf(name, "surface %d (%s, %zu bytes)", (int)i, GetVertexFormatName(mesh.GetVertexFormat()),
+			mesh.GetVertexBytes());
+		mesh.ReportVertexFormats(name);
+	}
+
+	ModelMesh interleaved;
+	for (const NamedPrimitive &part : robotParts)
+	{
+		PrimitiveToMesh(part.view, interleaved);
+		ReportVertexFormats(part.name, interleaved.vertices.data(), part.view.numVertices);
+	}
+}
+
+// Surfaces are drawn as banded strips. The robot parts are measured before and after
+// reordering their triangles, but are drawn as generated: their ring by ring order
+// already transforms each vertex about once.
+void reportVertexCache()
+{
+	char name[64];
+	for (size_t i = 0; i < surfaceMeshes.size(); i++)
+	{
+		sprintf(name, "surface %d", (int)i);
+		surfaceMeshes[i].mesh->ReportVertexCache(name);
+	}
+
+	for (const NamedPrimitive &part : robotParts)
+	{
+		std::vector<uint32_t> indices(part.view.indices, part.view.indices + part.view.numIndices);
+		VertexCacheStats before, after;
+		OptimizeVertexCache(indices.data(), part.view.numIndices, part.view.numVertices, &before, &after);
+		PrintVertexCacheStats(part.name, before, after);
+	}
+}
+
+void buildRobotLods()
+{
+	ModelMesh source;
+	PrimitiveToMesh(wheelCylinder.View(), source);
+	wheelCylinderLods.Build("wheel cylinder", source, wheelCylinderLodTargets,
+		sizeof(wheelCylinderLodTargets) / sizeof(wheelCylinderLodTargets[0]), meshCacheDir, jobSystem);
+	PrimitiveToMesh(wheelDisk.View(), source);
+	wheelDiskLods.Build("wheel disk", source, wheelDiskLodTargets,
+		sizeof(wheelDiskLodTargets) / sizeof(wheelDiskLodTargets[0]), meshCacheDir, jobSystem);
+}
+
+// The surfaces' levels are only built on the first report. They are never drawn: the
+// spotlights are lit per vertex, and a flat floor comes down to two triangles.
+void reportLods()
+{
+	wheelCylinderLods.Report();
+	wheelDiskLods.Report();
+	for (size_t i = 0; i < surfaceMeshes.size(); i++)
+	{
+		SurfaceMesh &surfaceMesh = surfaceMeshes[i];
+		if (!surfaceMesh.lods)
+		{
+			// A quarter of the triangles per level, as a grid of half the resolution would have
+			ModelMesh source;
+			surfaceMesh.mesh->GetTriangles(source.vertices, source.indices);
+			int targets[3], numTargets = 0;
+			for (int triangles = (int)source.indices.size() / 12; triangles >= 2 && numTargets < 3; triangles /= 4)
+				targets[numTargets++] = triangles;
+			char name[32];
+			sprintf(name, "surface %d", (int)i);
+			surfaceMesh.lods.reset(new MeshLods);
+			surfaceMesh.lods->Build(name, source, targets, numTargets, meshCacheDir, jobSystem);
+		}
+		surfaceMesh.lods->Report();
+	}
+}
+
+// Run with --bench <name>, or --bench all, in place of the game
+struct NamedBenchmark
+{
+	const char *name;
+	const char *description;
+	void (*run)();
+};
+
+const NamedBenchmark benchmarks[] = {
+	{ "bvh", "BVH ray casting", []() { BenchmarkBvh(10000, 1000000, &jobSystem); } },
+	{ "particles", "the particle system", []() { BenchmarkParticles(262144, 100, &jobSystem); } },
+	{ "env", "the training environments", []() { BenchmarkBattleEnv(4096, 1000, &jobSystem); } },
+	{ "transforms", "CPU transforms against the GL matrix stack", []() { BenchmarkTransforms(10000, 20); } },
+	{ "trig", "fast sincos accuracy and speed", []() { MeasureFastTrigError(); } },
+	{ "nav", "bot pathfinding, and paths checked against the grid", []() { CheckNavGridPaths(20000, 60.0f); BenchmarkNavGrid(500, 100, 200.0f); } },
+	{ "flow", "flow field steering", []() { BenchmarkFlowFields(10000, 100, 200.0f, &jobSystem); } },
+	{ "avoidance", "collision avoidance between robots", []() { BenchmarkAvoidance(1000, 600, &jobSystem); } },
+	{ "drive", "differential drive kinematics", []() { BenchmarkDiffDrive(100000, 200, &jobSystem); } }
+};
+
+bool runBenchmark(const char *name)
+{
+	bool found = false;
+	for (const NamedBenchmark &benchmark : benchmarks)
+	{
+		if (strcmp(name, "all") == 0 || strcmp(name, benchmark.name) == 0)
+		{
+			benchmark.run();
+			found = true;
+		}
+	}
+	if (!found)
+	{
+		printf("Unknown benchmark %s, one of:\n", name);
+		for (const NamedBenchmark &benchmark : benchmarks)
+			printf("  %-12s %s\n", benchmark.name, benchmark.description);
+		printf("  %-12s every one of them\n", "all");
+	}
+	return found;
+}
+
+void startDrive()
+{
+	if (!driveTimerRunning)
+	{
+		driveTimerRunning = true;
+		lastDriveTime = glutGet(GLUT_ELAPSED_TIME);
+		driveTimeBehind = 0.0f;
+		glutTimerFunc(10, driveHandler, 0);
+	}
+}
+
+
+// Advance every robot on its wheels in one batch, for as long as arrow keys are held,
+// the bots run or anything still rolls. The robots are read back in first so that
+// anything else that moved them (the network, a new arena) is kept.
+void driveHandler(int param)
+{
+	if (!playerRobot || robotDrive.GetRobotCount() != 1 + (int)spawnedRobots.size())
+	{
+		driveTimerRunning = false;
+		return;
+	}
+
+	bool offline = netMode == NetOffline;
+	robotDrive.ReadRobot(0, *playerRobot, !offline);
+	for (size_t i = 0; i < spawnedRobots.size(); i++)
+		robotDrive.ReadRobot(1 + (int)i, *spawnedRobots[i]);
+	if (offline)
+	{
+		float turn = (float)((heldArrowKeys & arrowKeyBit(GLUT_KEY_LEFT)) != 0) -
+			(float)((heldArrowKeys & arrowKeyBit(GLUT_KEY_RIGHT)) != 0);
+		float move = (float)((heldArrowKeys & arrowKeyBit(GLUT_KEY_UP)) != 0) -
+			(float)((heldArrowKeys & arrowKeyBit(GLUT_KEY_DOWN)) != 0);
+		robotDrive.SetDriveInput(0, turn, move);
+	}
+
+	int now = glutGet(GLUT_ELAPSED_TIME);
+	driveTimeBehind += 0.001f * (now - lastDriveTime);
+	lastDriveTime = now;
+	driveTimeBehind = driveTimeBehind < driveMaxCatchUp ? driveTimeBehind : driveMaxCatchUp;
+	while (driveTimeBehind >= driveStep)
+	{
+		robotDrive.Step(driveStep, &jobSystem);
+		driveTimeBehind -= driveStep;
+	}
+
+	if (offline)
+		robotDrive.WriteRobot(0, *playerRobot);
+	for (size_t i = 0; i < spawnedRobots.size(); i++)
+		robotDrive.WriteRobot(1 + (int)i, *spawnedRobots[i]);
+	glutPostRedisplay();
+
+	driveTimerRunning = heldArrowKeys != 0 || botsRunning || robotDrive.IsMoving();
+	if (driveTimerRunning)
+		glutTimerFunc(10, driveHandler, 0);
+}
+
+
+// Redraw while models are loading so finished ones get uploaded and shown
+void modelPollHandler(int param)
+{
+	glutPostRedisplay();
+	if (modelLoader.HasPendingWork())
+		glutTimerFunc(50, modelPollHandler, 0);
+}
+
 
 // Callback, handles input from the keyboard, function and arrow keys
 void functionKeys(int key, int x, int y)
@@ -650,45 +2126,69 @@ void functionKeys(int key, int x, int y)
 	{
 		printf("CONTROLS\n");
 		printf("========================================\n");
-		printf("Use left arrow key to rotate counter-clockwise\n");
-		printf("Use right arrow key to rotate clockwise\n");
-		printf("Use up arrow key to increment forwards\n");
-		printf("Use down arrow key to increment backwards\n");
+		printf("Hold left arrow key to rotate counter-clockwise\n");
+		printf("Hold right arrow key to rotate clockwise\n");
+		printf("Hold up arrow key to drive forwards\n");
+		printf("Hold down arrow key to drive backwards\n");
 		printf("Use spacebar to turn the spinner on or off\n");
+		printf("Click on an obstacle to select it\n");
+		printf("Press v to switch between 1, 2, 4 and 8 views\n");
+		printf("Press c to start or stop recording the window\n");
+		printf("Press a to start or stop the other robots chasing yours\n");
+		printf("Press k to report compact vertex formats for the arena and robot meshes\n");
+		printf("Press i to report vertex cache misses for the arena and robot meshes\n");
+		printf("Press l to report simplified levels of the wheels and arena surfaces (built on first press)\n");
+		printf("Benchmarks run instead of the game: start with --bench <name> (bvh, particles, env,\n");
+		printf("transforms, trig, nav, flow, avoidance, drive) or --bench all\n");
 		printf("\n");
 	}
+	// Offline the arrow keys drive the wheels while held, see driveHandler()
+	else if (netMode == NetOffline && arrowKeyBit(key))
+	{
+		heldArrowKeys |= arrowKeyBit(key);
+		startDrive();
+	}
 	// Do transformations with arrow keys
 	// GLUT_KEY_DOWN, GLUT_KEY_UP, GLUT_KEY_RIGHT, GLUT_KEY_LEFT
+	// Each press is one RobotCommand, see ApplyRobotCommand() in Robot.h
 	else if (key == GLUT_KEY_RIGHT)   
 	{
-		leftWheelAngle += 8;
-		rightWheelAngle -= 8;
-		robotAngle -= 3.0;
+		issueCommand(-1, 0, false);
 	}
 	else if (key == GLUT_KEY_LEFT)
 	{
-		leftWheelAngle -= 8;
-		rightWheelAngle += 8;
-		robotAngle += 3.0;
+		issueCommand(1, 0, false);
 	}
 	else if (key == GLUT_KEY_UP)
 	{
-		leftWheelAngle += 8;
-		rightWheelAngle += 8;
-		robotX += forwards.GetX();
-		robotZ += forwards.GetZ();
+		issueCommand(0, 1, false);
 	}
 	else if (key == GLUT_KEY_DOWN)
 	{
-		leftWheelAngle -= 8;
-		rightWheelAngle -= 8;
-		robotX -= forwards.GetX();
-		robotZ -= forwards.GetZ();
+		issueCommand(0, -1, false);
 	}
 
 	glutPostRedisplay();   // Trigger a window redisplay
 }
 
+// Callback, an arrow key let go stops driving that way
+void functionKeysUp(int key, int x, int y)
+{
+	heldArrowKeys &= ~arrowKeyBit(key);
+}
+
+int arrowKeyBit(int key)
+{
+	switch (key)
+	{
+	case GLUT_KEY_LEFT: return 1;
+	case GLUT_KEY_RIGHT: return 2;
+	case GLUT_KEY_UP: return 4;
+	case GLUT_KEY_DOWN: return 8;
+	default: return 0;
+	}
+}
+
 
 // Mouse button callback - use only if you want to 
 void mouse(int button, int state, int x, int y)
@@ -700,8 +2200,7 @@ void mouse(int button, int state, int x, int y)
 	case GLUT_LEFT_BUTTON:
 		if (state == GLUT_DOWN)
 		{
-			;
-
+			pickObstacle(x, y);
 		}
 		break;
 	case GLUT_RIGHT_BUTTON:
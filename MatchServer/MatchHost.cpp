@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <chrono>
+#include "MatchHost.h"
+
+// Assumed cost of a match nothing has been measured for yet
+static const float DefaultMatchCostUs = 50.0f;
+
+
+Match::Match(int id, uint16_t port, int bots)
+{
+	this->id = id;
+	this->port = port;
+	nextCommand = 1;
+	randomState = 0x9E3779B9u ^ (uint32_t)id * 2654435761u;
+	ticks = 0;
+	tickCostUs = 0.0f;
+	this->bots.resize(bots > 0 ? bots : 0);
+}
+
+Match::~Match()
+{
+	server.Stop();
+}
+
+bool Match::Start()
+{
+	if (!server.Start(port, false))
+		return false;
+
+	for (size_t i = 0; i < bots.size(); i++)
+	{
+		bots[i].robot = server.AddRobot();
+		bots[i].turnTicks = 0;
+		bots[i].turn = 0;
+	}
+	return true;
+}
+
+void Match::Tick(uint32_t nowMs)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	// Bots drive forwards and now and then turn for a while, as a player holding keys would
+	for (size_t i = 0; i < bots.size(); i++)
+	{
+		Bot &bot = bots[i];
+		randomState ^= randomState << 13;
+		randomState ^= randomState >> 17;
+		randomState ^= randomState << 5;
+		if (bot.turnTicks == 0 && (randomState & 63) == 0)
+		{
+			bot.turnTicks = 10 + (int)((randomState >> 6) & 31);
+			bot.turn = (randomState >> 11) & 1 ? 1 : -1;
+		}
+
+		RobotCommand command;
+		command.sequence = nextCommand++;
+		command.turn = bot.turnTicks > 0 ? bot.turn : 0;
+		command.move = 1;
+		command.toggleSpinner = 0;
+		bot.turnTicks -= bot.turnTicks > 0 ? 1 : 0;
+
+		// Back towards the middle before leaving the arena
+		const Robot *robot = server.GetRobot(bot.robot);
+		if (robot && robot->x * robot->x + robot->z * robot->z > 90.0f * 90.0f)
+			command.turn = 1;
+		server.ApplyCommand(bot.robot, command);
+	}
+
+	server.Update(nowMs);
+
+	// A plain mean while warming up, so no single slow tick sets the average
+	float costUs = std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+	ticks++;
+	float weight = ticks < MatchWarmupTicks ? 1.0f / ticks : 0.05f;
+	tickCostUs += weight * (costUs - tickCostUs);
+}
+
+
+MatchPorts::MatchPorts(uint16_t basePort)
+{
+	nextPort = basePort > 0 ? basePort : 1;		// 0 means none left
+}
+
+uint16_t MatchPorts::Acquire()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!freePorts.empty())
+	{
+		uint16_t port = freePorts.back();
+		freePorts.pop_back();
+		return port;
+	}
+	return nextPort <= 65535 ? (uint16_t)nextPort++ : 0;
+}
+
+void MatchPorts::Release(uint16_t port)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	freePorts.push_back(port);
+}
+
+
+MatchShard::MatchShard(int index, uint32_t tickRate, float matchBudgetUs, MatchPorts &ports)
+	: ports(ports), quit(false), matchCount(0), playerCount(0), tickCostUs(0.0f), overruns(0), evicted(0)
+{
+	this->index = index;
+	tickPeriodUs = 1000000 / (tickRate > 0 ? tickRate : 1);
+	this->matchBudgetUs = matchBudgetUs;
+	thread = std::thread(&MatchShard::ThreadMain, this);
+}
+
+MatchShard::~MatchShard()
+{
+	quit = true;
+	thread.join();
+
+	for (size_t i = 0; i < matches.size(); i++)
+		delete matches[i];
+	for (size_t i = 0; i < incoming.size(); i++)
+		delete incoming[i];
+}
+
+void MatchShard::Add(Match *match)
+{
+	matchCount++;
+	std::lock_guard<std::mutex> lock(incomingMutex);
+	incoming.push_back(match);
+}
+
+void MatchShard::GetStats(ShardStats &stats) const
+{
+	stats.matches = matchCount.load();
+	stats.players = playerCount.load();
+	stats.tickCostUs = tickCostUs.load();
+	stats.load = stats.tickCostUs / tickPeriodUs;
+	stats.overruns = overruns.load();
+	stats.evicted = evicted.load();
+}
+
+void MatchShard::ThreadMain()
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration period = std::chrono::microseconds(tickPeriodUs);
+	Clock::time_point nextTick = Clock::now();
+
+	while (!quit.load())
+	{
+		{
+			std::lock_guard<std::mutex> lock(incomingMutex);
+			matches.insert(matches.end(), incoming.begin(), incoming.end());
+			incoming.clear();
+		}
+
+		Clock::time_point start = Clock::now();
+		uint32_t nowMs = NetTimeMs();
+		int players = 0;
+		for (size_t i = 0; i < matches.size();)
+		{
+			Match *match = matches[i];
+			match->Tick(nowMs);
+			players += match->GetPlayerCount();
+
+			// Over budget once warmed up: close it rather than let it slow down its neighbours
+			if (match->IsWarmedUp() && match->GetTickCostUs() > matchBudgetUs)
+			{
+				printf("Shard %d: closing match %d on port %u, tick cost %.0f us is over the %.0f us budget\n",
+					index, match->GetId(), match->GetPort(), match->GetTickCostUs(), matchBudgetUs);
+				uint16_t port = match->GetPort();
+				delete match;
+				ports.Release(port);
+				matches[i] = matches.back();
+				matches.pop_back();
+				matchCount--;
+				evicted++;
+				continue;
+			}
+			i++;
+		}
+		playerCount = players;
+
+		float costUs = std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+		float smoothed = tickCostUs.load();
+		tickCostUs = smoothed == 0.0f ? costUs : smoothed + 0.05f * (costUs - smoothed);
+
+		// Fixed rate. When a tick runs long, skip the missed slots instead of bursting.
+		nextTick += period;
+		Clock::time_point now = Clock::now();
+		if (now > nextTick)
+		{
+			overruns++;
+			nextTick = now;
+		}
+		else
+			std::this_thread::sleep_until(nextTick);
+	}
+}
+
+
+MatchHost::MatchHost(int shards, uint32_t tickRate, float targetLoad, uint16_t basePort)
+	: ports(basePort)
+{
+	if (shards <= 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		shards = hardwareThreads > 0 ? (int)hardwareThreads : 1;
+	}
+
+	tickPeriodUs = 1000000 / (tickRate > 0 ? tickRate : 1);
+	this->targetLoad = targetLoad;
+	nextMatch = 0;
+
+	// A single match may use a quarter of a tick before it is considered broken
+	for (int i = 0; i < shards; i++)
+		this->shards.push_back(new MatchShard(i, tickRate, 0.25f * tickPeriodUs, ports));
+}
+
+MatchHost::~MatchHost()
+{
+	for (size_t i = 0; i < shards.size(); i++)
+		delete shards[i];
+}
+
+int MatchHost::GetMatchCount() const
+{
+	int count = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+		count += shards[i]->GetMatchCount();
+	return count;
+}
+
+float MatchHost::GetMatchCostUs() const
+{
+	float cost = 0.0f;
+	int count = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		if (shards[i]->GetMatchCount() > 0 && shards[i]->GetTickCostUs() > 0.0f)
+		{
+			cost += shards[i]->GetTickCostUs();
+			count += shards[i]->GetMatchCount();
+		}
+	}
+	return count > 0 ? cost / count : DefaultMatchCostUs;
+}
+
+float MatchHost::GetMatchesPerCore() const
+{
+	return targetLoad * tickPeriodUs / GetMatchCostUs();
+}
+
+uint16_t MatchHost::TryAddMatch(int bots)
+{
+	// Projected cost of each shard: measured, but never less than its match count at
+	// the average cost, so matches admitted since the last measurement count too
+	float matchCostUs = GetMatchCostUs();
+	MatchShard *best = NULL;
+	float bestCost = 0.0f;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		float projected = shards[i]->GetMatchCount() * matchCostUs;
+		float cost = shards[i]->GetTickCostUs() > projected ? shards[i]->GetTickCostUs() : projected;
+		if (!best || cost < bestCost)
+		{
+			best = shards[i];
+			bestCost = cost;
+		}
+	}
+
+	if (!best || bestCost + matchCostUs > targetLoad * tickPeriodUs)
+		return 0;
+
+	// A port that cannot be opened is left out of the pool, something else holds it
+	uint16_t port = ports.Acquire();
+	if (port == 0)
+	{
+		printf("No UDP ports left for another match\n");
+		return 0;
+	}
+	Match *match = new Match(nextMatch++, port, bots);
+	if (!match->Start())
+	{
+		delete match;
+		return 0;
+	}
+
+	best->Add(match);
+	return port;
+}
+
+void MatchHost::PrintStats() const
+{
+	int matches = 0, players = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		ShardStats stats;
+		shards[i]->GetStats(stats);
+		matches += stats.matches;
+		players += stats.players;
+		printf("  shard %2d: %4d matches, %3d players, tick %7.1f us, load %5.1f%%, %u overruns, %u evicted\n",
+			(int)i, stats.matches, stats.players, stats.tickCostUs, 100.0f * stats.load, stats.overruns, stats.evicted);
+	}
+	printf("%d matches, %d players, %.1f us per match tick, room for %.0f matches per core at %.0f%% load\n",
+		matches, players, GetMatchCostUs(), GetMatchesPerCore(), 100.0f * targetLoad);
+}
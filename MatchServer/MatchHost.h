@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	MatchHost.h
+//	Many independent arenas in one headless process. Each Match is a NetServer with
+//	its own UDP port and state, touched only by the shard thread that owns it.
+//	Shards tick their matches at a fixed rate and measure what every tick costs;
+//	MatchHost admits a new match only onto a shard whose measured load leaves room
+//	for it, and closes a match whose tick cost runs over its budget so it cannot
+//	starve the matches sharing its shard. A new match is only judged once it has
+//	warmed up, and its players are told before it closes.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MATCHHOST_H
+#define MATCHHOST_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "NetGame.h"
+
+// Ticks a new match runs before its cost is held against its budget. The first ones
+// pay for cold caches, page faults and the first socket reads.
+const uint32_t MatchWarmupTicks = 120;
+
+class Match
+{
+public:
+	// bots: robots driven on the server, wandering the arena
+	Match(int id, uint16_t port, int bots);
+	// Tells the connected players the match is closing
+	~Match();
+
+	Match(const Match &) = delete;
+	Match &operator=(const Match &) = delete;
+
+	bool Start();
+	void Tick(uint32_t nowMs);
+
+	int GetId() const { return id; }
+	uint16_t GetPort() const { return port; }
+	int GetPlayerCount() const { return server.GetClientCount(); }
+
+	// Smoothed cost of one Tick(), in microseconds: the mean until the match has warmed
+	// up, a moving average after that
+	float GetTickCostUs() const { return tickCostUs; }
+	bool IsWarmedUp() const { return ticks >= MatchWarmupTicks; }
+
+private:
+	struct Bot
+	{
+		int robot;
+		int turnTicks;		// ticks left turning before driving straight again
+		int8_t turn;
+	};
+
+	NetServer server;
+	std::vector<Bot> bots;
+	int id;
+	uint16_t port;
+	uint32_t nextCommand;
+	uint32_t randomState;
+	uint32_t ticks;
+	float tickCostUs;
+};
+
+// UDP ports for the matches, from basePort up. Ports of closed matches are handed out
+// again, so a long running server never goes past the top of the range.
+class MatchPorts
+{
+public:
+	MatchPorts(uint16_t basePort);
+
+	// 0 when every port from basePort to 65535 is in use
+	uint16_t Acquire();
+	void Release(uint16_t port);
+
+private:
+	std::mutex mutex;
+	std::vector<uint16_t> freePorts;
+	uint32_t nextPort;
+};
+
+struct ShardStats
+{
+	int matches;
+	int players;
+	float tickCostUs;		// smoothed cost of ticking every match once
+	float load;				// tickCostUs as a fraction of the tick period
+	uint32_t overruns;		// ticks that ran past their slot
+	uint32_t evicted;		// matches closed for running over budget
+};
+
+class MatchShard
+{
+public:
+	MatchShard(int index, uint32_t tickRate, float matchBudgetUs, MatchPorts &ports);
+	~MatchShard();
+
+	MatchShard(const MatchShard &) = delete;
+	MatchShard &operator=(const MatchShard &) = delete;
+
+	// Takes ownership, the match starts ticking on the shard thread at its next tick
+	void Add(Match *match);
+
+	int GetMatchCount() const { return matchCount.load(); }
+	float GetTickCostUs() const { return tickCostUs.load(); }
+	void GetStats(ShardStats &stats) const;
+
+private:
+	void ThreadMain();
+
+	int index;
+	uint32_t tickPeriodUs;
+	float matchBudgetUs;
+	MatchPorts &ports;
+
+	std::thread thread;
+	std::atomic<bool> quit;
+
+	std::mutex incomingMutex;
+	std::vector<Match*> incoming;		// handed over by Add(), picked up by the shard thread
+	std::vector<Match*> matches;		// shard thread only
+
+	std::atomic<int> matchCount;		// including incoming
+	std::atomic<int> playerCount;
+	std::atomic<float> tickCostUs;
+	std::atomic<uint32_t> overruns;
+	std::atomic<uint32_t> evicted;
+};
+
+class MatchHost
+{
+public:
+	// shards 0 means one per hardware thread. targetLoad is the fraction of every
+	// tick the shards may spend ticking before new matches are turned away.
+	MatchHost(int shards, uint32_t tickRate, float targetLoad, uint16_t basePort);
+	~MatchHost();
+
+	// Returns the new match's port, 0 if no shard has room or no port could be opened
+	uint16_t TryAddMatch(int bots);
+
+	int GetShardCount() const { return (int)shards.size(); }
+	int GetMatchCount() const;
+	// What one match costs per tick on average, measured once matches are running
+	float GetMatchCostUs() const;
+	// Matches one core could hold at targetLoad, at the measured cost per match
+	float GetMatchesPerCore() const;
+
+	void PrintStats() const;
+
+private:
+	std::vector<MatchShard*> shards;
+	MatchPorts ports;
+	uint32_t tickPeriodUs;
+	float targetLoad;
+	int nextMatch;
+};
+
+#endif	//MATCHHOST_H
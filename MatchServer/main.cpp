@@ -0,0 +1,103 @@
+/*******************************************************************
+		   Headless Match Server
+********************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "Net.h"
+#include "MatchHost.h"
+
+int main(int argc, char **argv)
+{
+	uint16_t basePort = 28000;
+	int shards = 0;
+	uint32_t tickRate = 60;
+	float targetLoad = 0.75f;
+	int matches = 16;
+	int bots = 0;
+	bool fill = false;
+	int duration = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+			basePort = (uint16_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+			shards = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+			tickRate = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--target-load") == 0 && i + 1 < argc)
+			targetLoad = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc)
+			matches = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc)
+			bots = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--fill") == 0)
+			fill = true;
+		else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc)
+			duration = atoi(argv[++i]);
+		else
+		{
+			printf("Usage: MatchServer [--port first] [--shards n] [--tick-rate hz] [--target-load 0..1]\n");
+			printf("                   [--matches n] [--bots per match] [--fill] [--duration seconds]\n");
+			printf("--fill keeps opening matches while admission control lets them in\n");
+			return 1;
+		}
+	}
+
+	if (!InitNetworking())
+	{
+		printf("Could not start networking\n");
+		return 1;
+	}
+
+	MatchHost host(shards, tickRate, targetLoad, basePort);
+	printf("Match server: %d shards ticking at %u Hz, matches on UDP ports from %u\n", host.GetShardCount(), tickRate, basePort);
+
+	// Open matches gradually so tick costs are measured before the next admission decisions.
+	// After a run of refusals, wait until a match has gone or a few seconds have passed.
+	int wanted = fill ? 65535 - basePort : matches;
+	int refused = 0;
+	int countAtRefusal = 0;
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	Clock::time_point nextReport = start + std::chrono::seconds(5);
+	Clock::time_point retryAt = start;
+	for (;;)
+	{
+		int matchCount = host.GetMatchCount();
+		bool backingOff = refused >= 20 && matchCount >= countAtRefusal && Clock::now() < retryAt;
+		if (matchCount < wanted && !backingOff)
+		{
+			if (host.TryAddMatch(bots) == 0)
+			{
+				if (refused++ == 0)
+					printf("Admission control: no room for match %d\n", matchCount + 1);
+				if (refused >= 20)
+				{
+					countAtRefusal = matchCount;
+					retryAt = Clock::now() + std::chrono::seconds(5);
+				}
+			}
+			else
+				refused = 0;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		Clock::time_point now = Clock::now();
+		if (now >= nextReport)
+		{
+			host.PrintStats();
+			nextReport = now + std::chrono::seconds(5);
+		}
+		if (duration > 0 && now - start >= std::chrono::seconds(duration))
+			break;
+	}
+
+	host.PrintStats();
+	ShutdownNetworking();
+	return 0;
+}
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "JobSystem.h"
+#include "Tournament.h"
+
+// Matches handed to a worker at a time, enough to keep the shared counter cold
+static const uint32_t MatchGrain = 8;
+
+
+Tournament::Tournament()
+{
+	seed = 1;
+	arenaHalfSize = 90.0f;
+	maxTicks = 6000;
+}
+
+int Tournament::AddDesign(const char *name, const RobotDesign &design)
+{
+	if (strlen(name) >= sizeof(TournamentFileDesign::name) || FindDesign(name) >= 0 || designs.size() >= 65535)
+		return -1;
+
+	Entry entry;
+	entry.name = name;
+	entry.design = design;
+	designs.push_back(entry);
+	return (int)designs.size() - 1;
+}
+
+int Tournament::FindDesign(const char *name) const
+{
+	for (size_t i = 0; i < designs.size(); i++)
+		if (designs[i].name == name)
+			return (int)i;
+	return -1;
+}
+
+void Tournament::AddMatches(int designA, int designB, int count)
+{
+	Pairing pairing;
+	pairing.designs[0] = (uint16_t)designA;
+	pairing.designs[1] = (uint16_t)designB;
+	pairing.seed = 0;
+	for (int i = 0; i < count; i++)
+		matches.push_back(pairing);
+}
+
+void Tournament::AddRoundRobin(int count)
+{
+	for (size_t a = 0; a < designs.size(); a++)
+		for (size_t b = 0; b < designs.size(); b++)
+			if (a != b)
+				AddMatches((int)a, (int)b, count);
+}
+
+// Reads key=value overrides of a design's parameters
+static bool ParseDesignParameter(const char *token, RobotDesign &design)
+{
+	const char *equals = strchr(token, '=');
+	if (!equals)
+		return false;
+
+	std::string key(token, equals - token);
+	char *end;
+	float value = strtof(equals + 1, &end);
+	if (*end != '\0' || value <= 0.0f)
+		return false;
+
+	if (key == "robotBodyWidth")
+		design.bodyWidth = value;
+	else if (key == "robotBodyLength")
+		design.bodyLength = value;
+	else if (key == "robotBodyDepth")
+		design.bodyDepth = value;
+	else if (key == "wheelLength")
+		design.wheelLength = value;
+	else if (key == "spinnerLength")
+		design.spinnerLength = value;
+	else
+		return false;
+	return true;
+}
+
+bool Tournament::Load(const char *path, std::string &error)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		error = std::string("cannot open ") + path;
+		return false;
+	}
+
+	char line[1024];
+	int lineNumber = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+		char *comment = strchr(line, '#');
+		if (comment)
+			*comment = '\0';
+
+		// Split on whitespace in place
+		char *tokens[16];
+		int numTokens = 0;
+		for (char *p = line; *p && numTokens < 16; )
+		{
+			while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+				*p++ = '\0';
+			if (!*p)
+				break;
+			tokens[numTokens++] = p;
+			while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+				p++;
+		}
+		if (numTokens == 0)
+			continue;
+
+		const char *keyword = tokens[0];
+		if (strcmp(keyword, "seed") == 0 && numTokens == 2)
+			seed = (uint32_t)strtoul(tokens[1], NULL, 10);
+		else if (strcmp(keyword, "arena") == 0 && numTokens == 2 && atof(tokens[1]) > 0.0)
+			arenaHalfSize = (float)atof(tokens[1]);
+		else if (strcmp(keyword, "time") == 0 && numTokens == 2 && atof(tokens[1]) > 0.0)
+			maxTicks = (int)(atof(tokens[1]) * 100.0);		// 10 ms ticks
+		else if (strcmp(keyword, "design") == 0 && numTokens >= 2)
+		{
+			RobotDesign design = DefaultRobotDesign();
+			for (int i = 2; i < numTokens && ok; i++)
+				ok = ParseDesignParameter(tokens[i], design);
+			ok = ok && AddDesign(tokens[1], design) >= 0;
+		}
+		else if (strcmp(keyword, "match") == 0 && numTokens == 4)
+		{
+			int a = FindDesign(tokens[1]);
+			int b = FindDesign(tokens[2]);
+			int count = atoi(tokens[3]);
+			ok = a >= 0 && b >= 0 && count > 0;
+			if (ok)
+				AddMatches(a, b, count);
+		}
+		else if (strcmp(keyword, "roundrobin") == 0 && numTokens == 2 && atoi(tokens[1]) > 0)
+			AddRoundRobin(atoi(tokens[1]));
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			char message[64];
+			snprintf(message, sizeof(message), ":%d: ", lineNumber);
+			error = std::string(path) + message + "cannot read '" + keyword + "' line";
+		}
+	}
+
+	fclose(file);
+	return ok;
+}
+
+double Tournament::Run(JobSystem *jobs)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	// Seeds come from the position in the list, never from the thread that plays the match
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		uint32_t hash = seed ^ (uint32_t)i * 0x9E3779B9u;
+		hash ^= hash >> 16;
+		hash *= 0x85EBCA6Bu;
+		hash ^= hash >> 13;
+		matches[i].seed = hash;
+	}
+	records.resize(matches.size());
+
+	auto playRange = [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const Pairing &pairing = matches[i];
+			BattleConfig config = DefaultBattleConfig(pairing.seed);
+			config.designs[0] = designs[pairing.designs[0]].design;
+			config.designs[1] = designs[pairing.designs[1]].design;
+			config.arenaHalfSize = arenaHalfSize;
+			config.maxTicks = maxTicks;
+			BattleResult result = RunBattle(config);
+
+			TournamentRecord &record = records[i];
+			record.seed = pairing.seed;
+			record.designs[0] = pairing.designs[0];
+			record.designs[1] = pairing.designs[1];
+			record.ticks = (uint16_t)std::min(result.ticks, 65535);
+			record.winner = (int8_t)result.winner;
+			for (int k = 0; k < 2; k++)
+			{
+				record.health[k] = (uint8_t)(result.health[k] * 255.0f + 0.5f);
+				record.hits[k] = (uint8_t)std::min(result.hits[k], 255);
+			}
+			record.reserved = 0;
+		}
+	};
+
+	if (jobs)
+		jobs->ParallelFor((uint32_t)matches.size(), MatchGrain, playRange);
+	else
+		playRange(0, (uint32_t)matches.size());
+
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+uint64_t Tournament::GetSimulatedTicks() const
+{
+	uint64_t ticks = 0;
+	for (size_t i = 0; i < records.size(); i++)
+		ticks += records[i].ticks;
+	return ticks;
+}
+
+bool Tournament::WriteResults(const char *path, std::string &error) const
+{
+	FILE *file = fopen(path, "wb");
+	if (!file)
+	{
+		error = std::string("cannot create ") + path;
+		return false;
+	}
+
+	TournamentFileHeader header;
+	memcpy(header.magic, "BTRN", 4);
+	header.version = TournamentFileVersion;
+	header.designCount = (uint32_t)designs.size();
+	header.recordCount = (uint32_t)records.size();
+	header.seed = seed;
+	header.arenaHalfSize = arenaHalfSize;
+	header.maxTicks = maxTicks;
+	header.reserved = 0;
+
+	std::vector<TournamentFileDesign> fileDesigns(designs.size());
+	for (size_t i = 0; i < designs.size(); i++)
+	{
+		memset(fileDesigns[i].name, 0, sizeof(fileDesigns[i].name));
+		memcpy(fileDesigns[i].name, designs[i].name.c_str(), designs[i].name.size());
+		fileDesigns[i].design = designs[i].design;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (!fileDesigns.empty())
+		ok = ok && fwrite(&fileDesigns[0], sizeof(TournamentFileDesign), fileDesigns.size(), file) == fileDesigns.size();
+	if (!records.empty())
+		ok = ok && fwrite(&records[0], sizeof(TournamentRecord), records.size(), file) == records.size();
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+		error = std::string("cannot write ") + path;
+	return ok;
+}
+
+bool Tournament::WriteCsv(const char *path, std::string &error) const
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+	{
+		error = std::string("cannot create ") + path;
+		return false;
+	}
+
+	fprintf(file, "seed,designA,designB,winner,ticks,healthA,healthB,hitsA,hitsB\n");
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const TournamentRecord &record = records[i];
+		fprintf(file, "%u,%s,%s,%d,%u,%.3f,%.3f,%u,%u\n", record.seed,
+			designs[record.designs[0]].name.c_str(), designs[record.designs[1]].name.c_str(),
+			record.winner, record.ticks, record.health[0] / 255.0f, record.health[1] / 255.0f,
+			record.hits[0], record.hits[1]);
+	}
+
+	bool ok = fclose(file) == 0;
+	if (!ok)
+		error = std::string("cannot write ") + path;
+	return ok;
+}
+
+void Tournament::PrintSummary() const
+{
+	struct Tally
+	{
+		int design;
+		int wins, losses, draws;
+	};
+	std::vector<Tally> tallies(designs.size());
+	for (size_t i = 0; i < designs.size(); i++)
+	{
+		tallies[i].design = (int)i;
+		tallies[i].wins = tallies[i].losses = tallies[i].draws = 0;
+	}
+
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const TournamentRecord &record = records[i];
+		for (int k = 0; k < 2; k++)
+		{
+			Tally &tally = tallies[record.designs[k]];
+			if (record.winner < 0)
+				tally.draws++;
+			else if (record.winner == k)
+				tally.wins++;
+			else
+				tally.losses++;
+		}
+	}
+
+	// Best win rate first, draws count half
+	std::sort(tallies.begin(), tallies.end(), [](const Tally &a, const Tally &b)
+	{
+		int playedA = a.wins + a.losses + a.draws, playedB = b.wins + b.losses + b.draws;
+		double scoreA = playedA ? (a.wins + 0.5 * a.draws) / playedA : 0.0;
+		double scoreB = playedB ? (b.wins + 0.5 * b.draws) / playedB : 0.0;
+		return scoreA != scoreB ? scoreA > scoreB : a.design < b.design;
+	});
+
+	printf("%-31s %8s %8s %8s %7s\n", "design", "wins", "losses", "draws", "score");
+	for (size_t i = 0; i < tallies.size(); i++)
+	{
+		const Tally &tally = tallies[i];
+		int played = tally.wins + tally.losses + tally.draws;
+		printf("%-31s %8d %8d %8d %6.1f%%\n", designs[tally.design].name.c_str(), tally.wins, tally.losses,
+			tally.draws, played ? 100.0 * (tally.wins + 0.5 * tally.draws) / played : 0.0);
+	}
+}
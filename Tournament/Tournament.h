@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////////////////////
+//	Tournament.h
+//	Batch evaluation of robot designs: a list of matches between named designs is
+//	played headless with BattleSim, spread over JobSystem workers, as fast as the
+//	cores allow. Every match gets its own seed from the tournament seed and its
+//	position in the list and writes only its own result slot, so the results do
+//	not depend on the number of threads or the order they finish in.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "BattleSim.h"
+
+class JobSystem;
+
+// One result in the output file, 16 bytes. Health is quantized to 0-255 and the
+// hit counts and ticks saturate.
+struct TournamentRecord
+{
+	uint32_t seed;
+	uint16_t designs[2];
+	uint16_t ticks;
+	int8_t winner;			// 0 or 1 for designs[0] or designs[1], -1 for a draw
+	uint8_t health[2];
+	uint8_t hits[2];
+	uint8_t reserved;
+};
+
+// File layout: header, designCount TournamentFileDesign, recordCount TournamentRecord
+struct TournamentFileHeader
+{
+	char magic[4];			// "BTRN"
+	uint32_t version;
+	uint32_t designCount;
+	uint32_t recordCount;
+	uint32_t seed;
+	float arenaHalfSize;
+	int32_t maxTicks;
+	uint32_t reserved;
+};
+
+struct TournamentFileDesign
+{
+	char name[32];
+	RobotDesign design;
+};
+
+const uint32_t TournamentFileVersion = 1;
+
+class Tournament
+{
+public:
+	Tournament();
+
+	// Reads a match list. Lines are one of
+	//	seed <n>
+	//	arena <half size>
+	//	time <seconds per match>
+	//	design <name> [robotBodyWidth=10] [robotBodyLength=4] [robotBodyDepth=5] [wheelLength=2.5] [spinnerLength=5]
+	//	match <design> <design> <count>
+	//	roundrobin <count>				every ordered pair of distinct designs declared so far
+	// with # starting a comment.
+	bool Load(const char *path, std::string &error);
+
+	// Returns the design index, or -1 if the name is taken or too long
+	int AddDesign(const char *name, const RobotDesign &design);
+	int FindDesign(const char *name) const;
+	void AddMatches(int designA, int designB, int count);
+	void AddRoundRobin(int count);
+
+	void SetSeed(uint32_t seed) { this->seed = seed; }
+	void SetArenaHalfSize(float halfSize) { arenaHalfSize = halfSize; }
+	void SetMaxTicks(int ticks) { maxTicks = ticks; }
+
+	// Plays every match, on jobs when given, otherwise on the calling thread.
+	// Returns the wall clock time taken in seconds.
+	double Run(JobSystem *jobs);
+
+	bool WriteResults(const char *path, std::string &error) const;
+	bool WriteCsv(const char *path, std::string &error) const;
+
+	// Win, loss and draw counts per design
+	void PrintSummary() const;
+
+	int GetMatchCount() const { return (int)matches.size(); }
+	uint64_t GetSimulatedTicks() const;
+
+private:
+	struct Entry
+	{
+		std::string name;
+		RobotDesign design;
+	};
+
+	struct Pairing
+	{
+		uint16_t designs[2];
+		uint32_t seed;
+	};
+
+	std::vector<Entry> designs;
+	std::vector<Pairing> matches;
+	std::vector<TournamentRecord> records;
+	uint32_t seed;
+	float arenaHalfSize;
+	int maxTicks;
+};
+
+#endif	//TOURNAMENT_H
@@ -0,0 +1,130 @@
+/*******************************************************************
+		   Headless Tournament Runner
+********************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "JobSystem.h"
+#include "Tournament.h"
+
+int main(int argc, char **argv)
+{
+	const char *configPath = NULL;
+	const char *outputPath = "results.btrn";
+	const char *csvPath = NULL;
+	int threads = 0;
+	bool seedGiven = false;
+	uint32_t seed = 0;
+	bool scaling = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+			csvPath = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+			seedGiven = true;
+		}
+		else if (strcmp(argv[i], "--scaling") == 0)
+			scaling = true;
+		else if (argv[i][0] != '-' && !configPath)
+			configPath = argv[i];
+		else
+			configPath = NULL, i = argc;
+	}
+
+	if (!configPath)
+	{
+		printf("Usage: Tournament <match list> [-o results.btrn] [--csv results.csv] [--threads n] [--seed n] [--scaling]\n");
+		printf("--threads counts every thread playing matches, 0 uses all cores\n");
+		printf("--scaling plays the list with 1, 2, 4... threads up to --threads and checks the results agree\n");
+		return 1;
+	}
+
+	Tournament tournament;
+	std::string error;
+	if (!tournament.Load(configPath, error))
+	{
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	if (seedGiven)
+		tournament.SetSeed(seed);
+	if (tournament.GetMatchCount() == 0)
+	{
+		printf("%s lists no matches\n", configPath);
+		return 1;
+	}
+
+	if (threads <= 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threads = hardwareThreads > 0 ? (int)hardwareThreads : 1;
+	}
+
+	// Each run uses its own worker set, the caller plays matches too
+	std::vector<int> threadCounts;
+	if (scaling)
+		for (int count = 1; count < threads; count *= 2)
+			threadCounts.push_back(count);
+	threadCounts.push_back(threads);
+
+	std::string reference;
+	double baseSeconds = 0.0;
+	for (size_t run = 0; run < threadCounts.size(); run++)
+	{
+		int count = threadCounts[run];
+		JobSystem *jobs = count > 1 ? new JobSystem(count - 1) : NULL;
+		double seconds = tournament.Run(jobs);
+		delete jobs;
+
+		if (run == 0)
+			baseSeconds = seconds;
+		double simulated = tournament.GetSimulatedTicks() * 0.01;
+		printf("%d matches on %d threads in %.3f s: %.0f matches/s, %.0fx real time", tournament.GetMatchCount(), count,
+			seconds, tournament.GetMatchCount() / seconds, simulated / seconds);
+		if (scaling)
+			printf(", speedup %.2f", baseSeconds / seconds);
+		printf("\n");
+
+		// Same results whatever the thread count, compared as written to disk
+		if (scaling)
+		{
+			if (!tournament.WriteResults(outputPath, error))
+			{
+				printf("%s\n", error.c_str());
+				return 1;
+			}
+			FILE *file = fopen(outputPath, "rb");
+			std::string contents;
+			char buffer[65536];
+			size_t read;
+			while (file && (read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+				contents.append(buffer, read);
+			if (file)
+				fclose(file);
+			if (run == 0)
+				reference = contents;
+			else if (contents != reference)
+				printf("Results on %d threads differ from 1 thread\n", count);
+		}
+	}
+
+	if (!tournament.WriteResults(outputPath, error) || (csvPath && !tournament.WriteCsv(csvPath, error)))
+	{
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+
+	tournament.PrintSummary();
+	printf("Results written to %s\n", outputPath);
+	return 0;
+}